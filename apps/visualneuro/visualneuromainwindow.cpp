@@ -37,12 +37,17 @@
 #include <inviwo/core/util/settings/systemsettings.h>
 #include <inviwo/core/util/utilities.h>
 #include <inviwo/core/util/licenseinfo.h>
+#include <inviwo/core/util/logcentral.h>
 #include <inviwo/core/util/vectoroperations.h>
 #include <inviwo/core/util/stringconversion.h>
 #include <inviwo/core/util/stdextensions.h>
 #include <inviwo/core/util/rendercontext.h>
 #include <inviwo/core/network/workspacemanager.h>
 #include <inviwo/core/processors/exporter.h>
+#include <inviwo/core/properties/boolproperty.h>
+#include <inviwo/core/properties/buttonproperty.h>
+#include <inviwo/core/properties/fileproperty.h>
+#include <inviwo/core/util/settings/settings.h>
 #include <inviwo/qt/applicationbase/qtapptools.h>
 
 #include "consolewidget.h"
@@ -99,6 +104,39 @@
 
 namespace inviwo {
 
+namespace {
+
+// Property of the VisualNeuro module settings. The module is loaded at runtime and not linked, so
+// its functionality is reached through the core property types.
+template <typename T>
+T* visualNeuroSetting(InviwoApplication* app, std::string_view identifier) {
+    auto module = app->getModuleByIdentifier("VisualNeuro");
+    if (!module) return nullptr;
+    for (auto& settings : module->getSettings()) {
+        if (auto property = dynamic_cast<T*>(settings->getPropertyByIdentifier(identifier))) {
+            return property;
+        }
+    }
+    return nullptr;
+}
+
+// Write a file with a file and button property of the VisualNeuro settings, see
+// VisualNeuroSettings
+void saveThroughSettings(InviwoApplication* app, std::string_view fileIdentifier,
+                         std::string_view buttonIdentifier, const std::filesystem::path& path) {
+    auto file = visualNeuroSetting<FileProperty>(app, fileIdentifier);
+    auto button = visualNeuroSetting<ButtonProperty>(app, buttonIdentifier);
+    if (!file || !button) {
+        LogErrorCustom("VisualNeuroMainWindow",
+                       "Unable to save " << path << ", the VisualNeuro module is not loaded");
+        return;
+    }
+    file->set(path);
+    button->pressButton();
+}
+
+}  // namespace
+
 VisualNeuroMainWindow::VisualNeuroMainWindow(InviwoApplication* app)
     : QMainWindow()
     , app_(app)
@@ -244,6 +282,33 @@ void VisualNeuroMainWindow::addActions() {
         fileMenuItem->addAction(workspaceActionSaveAsCopy);
     }
 
+    {
+        fileMenuItem->addSeparator();
+        auto saveMetricsAction = new QAction(tr("Save &Processing Metrics..."), this);
+        connect(saveMetricsAction, &QAction::triggered, this,
+                &VisualNeuroMainWindow::saveProcessingMetrics);
+        fileMenuItem->addAction(saveMetricsAction);
+
+        auto recordTraceAction = new QAction(tr("&Record Trace"), this);
+        recordTraceAction->setCheckable(true);
+        connect(recordTraceAction, &QAction::toggled, this, [this](bool record) {
+            if (auto recordTrace = visualNeuroSetting<BoolProperty>(app_, "recordTrace")) {
+                recordTrace->set(record);
+            }
+        });
+        // Tracing may also have been enabled from the command line
+        connect(fileMenuItem, &QMenu::aboutToShow, this, [this, recordTraceAction]() {
+            auto recordTrace = visualNeuroSetting<BoolProperty>(app_, "recordTrace");
+            recordTraceAction->setEnabled(recordTrace != nullptr);
+            recordTraceAction->setChecked(recordTrace && recordTrace->get());
+        });
+        fileMenuItem->addAction(recordTraceAction);
+
+        auto saveTraceAction = new QAction(tr("Save &Trace..."), this);
+        connect(saveTraceAction, &QAction::triggered, this, &VisualNeuroMainWindow::saveTrace);
+        fileMenuItem->addAction(saveTraceAction);
+    }
+
     {
         fileMenuItem->addSeparator();
         auto recentWorkspaceMenu = fileMenuItem->addMenu(tr("&Recent Workspaces"));
@@ -602,6 +667,34 @@ void VisualNeuroMainWindow::saveWorkspaceAsCopy() {
     }
 }
 
+void VisualNeuroMainWindow::saveProcessingMetrics() {
+    InviwoFileDialog saveFileDialog(this, "Save Processing Metrics ...", "metrics");
+    saveFileDialog.setFileMode(FileMode::AnyFile);
+    saveFileDialog.setAcceptMode(AcceptMode::Save);
+    saveFileDialog.setOption(QFileDialog::Option::DontConfirmOverwrite, false);
+    saveFileDialog.addExtension("json", "JSON File");
+
+    if (saveFileDialog.exec()) {
+        std::filesystem::path path = utilqt::toPath(saveFileDialog.selectedFiles().at(0));
+        if (path.extension() != ".json") path += ".json";
+        saveThroughSettings(app_, "metricsFile", "saveMetrics", path);
+    }
+}
+
+void VisualNeuroMainWindow::saveTrace() {
+    InviwoFileDialog saveFileDialog(this, "Save Trace ...", "trace");
+    saveFileDialog.setFileMode(FileMode::AnyFile);
+    saveFileDialog.setAcceptMode(AcceptMode::Save);
+    saveFileDialog.setOption(QFileDialog::Option::DontConfirmOverwrite, false);
+    saveFileDialog.addExtension("json", "Chrome Trace File");
+
+    if (saveFileDialog.exec()) {
+        std::filesystem::path path = utilqt::toPath(saveFileDialog.selectedFiles().at(0));
+        if (path.extension() != ".json") path += ".json";
+        saveThroughSettings(app_, "traceFile", "saveTrace", path);
+    }
+}
+
 void VisualNeuroMainWindow::exitInviwo(bool /*saveIfModified*/) {
     /// if (!saveIfModified) getNetworkEditor()->setModified(false);
     QMainWindow::close();
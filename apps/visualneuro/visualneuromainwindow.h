@@ -114,6 +114,15 @@ public:
      * leaves the current workspace file as current workspace
      */
     void saveWorkspaceAsCopy();
+    /*
+     * Save the timings of the VisualNeuro processors as JSON using a file dialog
+     */
+    void saveProcessingMetrics();
+    /*
+     * Save the recorded trace events as a Chrome trace using a file dialog,
+     * written by the VisualNeuro module, see VisualNeuroSettings
+     */
+    void saveTrace();
     bool askToSaveWorkspaceChanges();
     void exitInviwo(bool saveIfModified = true);
     void showAboutBox();
@@ -0,0 +1,191 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include "cohort.h"
+
+#include <inviwo/core/common/inviwoapplication.h>
+#include <inviwo/core/io/datareaderfactory.h>
+#include <inviwo/core/util/exception.h>
+#include <inviwo/core/util/filesystem.h>
+#include <inviwo/core/util/logcentral.h>
+#include <inviwo/dataframe/io/csvreader.h>
+#include <modules/visualneuro/util/tracerecorder.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace inviwo {
+
+namespace cli {
+
+namespace {
+
+bool isNiftiFilename(const std::string& str) { return str.find(".nii") != std::string::npos; }
+
+std::shared_ptr<const Column> findColumn(const DataFrame& dataFrame, const std::string& header) {
+    auto col = dataFrame.getColumn(header);
+    if (!col) {
+        throw Exception(fmt::format("Column '{}' not found in patient data", header),
+                        IVW_CONTEXT_CUSTOM("VisualNeuroCLI"));
+    }
+    return col;
+}
+
+}  // namespace
+
+std::vector<double> Cohort::parameter(const std::string& column) const {
+    auto col = findColumn(*patients, column);
+    std::vector<double> values(rows.size(), std::numeric_limits<double>::quiet_NaN());
+    if (dynamic_cast<const CategoricalColumn*>(col.get())) return values;
+
+    std::transform(rows.begin(), rows.end(), values.begin(),
+                   [&](size_t row) { return col->getAsDouble(row); });
+    return values;
+}
+
+std::pair<std::vector<size_t>, std::vector<size_t>> Cohort::groupIndices(
+    const std::string& column, const std::string& groupA, const std::string& groupB) const {
+    auto col = findColumn(*patients, column);
+    std::pair<std::vector<size_t>, std::vector<size_t>> res;
+    for (size_t i = 0; i < volumes.size(); ++i) {
+        const auto value = col->getAsString(rows[i]);
+        if (value == groupA) {
+            res.first.push_back(i);
+        } else if (value == groupB) {
+            res.second.push_back(i);
+        }
+    }
+    return res;
+}
+
+VolumeSequence Cohort::subset(const std::vector<size_t>& indices) const {
+    VolumeSequence res;
+    for (auto i : indices) res.push_back(volumes[i]);
+    return res;
+}
+
+std::vector<std::string> Cohort::numericColumns() const {
+    std::vector<std::string> headers;
+    if (!patients) return headers;
+    for (const auto& col : *patients) {
+        if (col == patients->getIndexColumn() || col->getHeader() == filenameColumn ||
+            dynamic_cast<const CategoricalColumn*>(col.get())) {
+            continue;
+        }
+        headers.push_back(col->getHeader());
+    }
+    return headers;
+}
+
+std::shared_ptr<Volume> loadVolume(InviwoApplication& app, const std::filesystem::path& file) {
+    const util::TraceSpan span("Read", "io", {{"file", file.generic_string()}});
+    auto rf = app.getDataReaderFactory();
+    if (auto reader = rf->getReaderForTypeAndExtension<Volume>(file)) {
+        return reader->readData(file);
+    } else if (auto seqReader = rf->getReaderForTypeAndExtension<VolumeSequence>(file)) {
+        auto sequence = seqReader->readData(file);
+        if (sequence && !sequence->empty()) return sequence->front();
+    }
+    throw Exception(fmt::format("Could not read volume: {}", file),
+                    IVW_CONTEXT_CUSTOM("VisualNeuroCLI"));
+}
+
+Cohort loadCohort(InviwoApplication& app, const std::filesystem::path& folder,
+                  const std::string& filter,
+                  const std::optional<std::filesystem::path>& patientsCsv,
+                  const std::string& filenameColumn) {
+    Cohort cohort;
+
+    auto files = filesystem::getDirectoryContents(folder, filesystem::ListMode::Files);
+    std::sort(files.begin(), files.end());
+
+    std::unordered_map<std::string, size_t> fileToRow;
+    if (patientsCsv) {
+        util::TraceSpan span("Read", "io", {{"file", patientsCsv->generic_string()}});
+        CSVReader reader;
+        auto patients = reader.readData(*patientsCsv);
+        span.end();
+        cohort.patients = patients;
+
+        std::shared_ptr<const Column> fileCol;
+        if (!filenameColumn.empty()) {
+            fileCol = findColumn(*patients, filenameColumn);
+        } else {
+            auto it = std::find_if(patients->begin(), patients->end(), [](const auto& col) {
+                return col->getSize() > 0 && isNiftiFilename(col->getAsString(0));
+            });
+            if (it == patients->end()) {
+                throw Exception("Could not find a column with volume filenames, use "
+                                "--filename-column",
+                                IVW_CONTEXT_CUSTOM("VisualNeuroCLI"));
+            }
+            fileCol = *it;
+        }
+        cohort.filenameColumn = fileCol->getHeader();
+        for (size_t row = 0; row < fileCol->getSize(); ++row) {
+            const auto [it, inserted] = fileToRow.try_emplace(fileCol->getAsString(row), row);
+            if (!inserted) {
+                LogWarnCustom("VisualNeuroCLI", "Duplicate filename " << it->first << " in rows "
+                                                                      << it->second << " and "
+                                                                      << row);
+            }
+        }
+    }
+
+    for (const auto& f : files) {
+        const auto file = folder / f;
+        if (!filesystem::wildcardStringMatch(filter, file.filename().generic_string())) continue;
+
+        std::optional<size_t> row;
+        if (patientsCsv) {
+            auto it = fileToRow.find(file.filename().generic_string());
+            if (it == fileToRow.end()) {
+                LogWarnCustom("VisualNeuroCLI", "Volume " << file.filename()
+                                                          << " has no patient data row, skipped");
+                continue;
+            }
+            row = it->second;
+        }
+        auto volume = loadVolume(app, file);
+        volume->setMetaData<StringMetaData>("filename", file.generic_string());
+        cohort.volumes.push_back(volume);
+        cohort.files.push_back(file);
+        if (row) cohort.rows.push_back(*row);
+    }
+
+    if (cohort.volumes.empty()) {
+        throw Exception(fmt::format("No volumes matching '{}' found in {}", filter, folder),
+                        IVW_CONTEXT_CUSTOM("VisualNeuroCLI"));
+    }
+    return cohort;
+}
+
+}  // namespace cli
+
+}  // namespace inviwo
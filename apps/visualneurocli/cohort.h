@@ -0,0 +1,100 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <inviwo/core/common/inviwo.h>
+#include <inviwo/core/datastructures/volume/volume.h>
+#include <inviwo/dataframe/datastructures/dataframe.h>
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace inviwo {
+
+class InviwoApplication;
+
+namespace cli {
+
+/**
+ * \brief Volumes of a cohort folder joined with the rows of a patient DataFrame.
+ * volumes[i] belongs to patient row rows[i]. Volumes without a matching row are dropped when
+ * loading with a DataFrame.
+ */
+struct Cohort {
+    VolumeSequence volumes;
+    std::vector<std::filesystem::path> files;
+    std::shared_ptr<const DataFrame> patients;
+    std::vector<size_t> rows;
+
+    size_t size() const { return volumes.size(); }
+    /*
+     * Values of column for each volume, non-numeric and missing values are NaN.
+     * @throws Exception if the column does not exist
+     */
+    std::vector<double> parameter(const std::string& column) const;
+    /*
+     * Split the volumes into two groups by the string value of column.
+     * @return indices of the volumes in each group
+     * @throws Exception if the column does not exist
+     */
+    std::pair<std::vector<size_t>, std::vector<size_t>> groupIndices(
+        const std::string& column, const std::string& groupA, const std::string& groupB) const;
+    VolumeSequence subset(const std::vector<size_t>& indices) const;
+    /*
+     * Headers of all numeric columns, excluding the index and filename columns.
+     */
+    std::vector<std::string> numericColumns() const;
+
+    std::string filenameColumn;
+};
+
+/**
+ * \brief Load the first volume of each file in folder matching filter, sorted by filename.
+ * If patientsCsv is given, each volume is joined with the row whose filenameColumn equals the
+ * volume filename. If filenameColumn is empty, the first column containing .nii filenames is used.
+ * @throws Exception if no volumes could be loaded or the filename column is not found.
+ */
+Cohort loadCohort(InviwoApplication& app, const std::filesystem::path& folder,
+                  const std::string& filter,
+                  const std::optional<std::filesystem::path>& patientsCsv,
+                  const std::string& filenameColumn);
+
+/**
+ * \brief Load a single volume, e.g. a mask.
+ * @throws Exception if the file could not be read.
+ */
+std::shared_ptr<Volume> loadVolume(InviwoApplication& app, const std::filesystem::path& file);
+
+}  // namespace cli
+
+}  // namespace inviwo
@@ -0,0 +1,105 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include "niftiwriter.h"
+
+#include <inviwo/core/datastructures/volume/volumeram.h>
+#include <inviwo/core/util/exception.h>
+
+#include <nifti1_io.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace inviwo {
+
+namespace cli {
+
+void writeNifti(const Volume& volume, const std::filesystem::path& file) {
+    if (volume.getDataFormat()->getComponents() != 1) {
+        throw Exception(fmt::format("Can only write scalar volumes to {}", file),
+                        IVW_CONTEXT_CUSTOM("NiftiWriter"));
+    }
+    const auto dims = volume.getDimensions();
+    const auto nVoxels = glm::compMul(dims);
+
+    std::vector<float> data(nVoxels);
+    const auto ram = volume.getRepresentation<VolumeRAM>();
+    ram->dispatch<void, dispatching::filter::Scalars>([&](auto vrprecision) {
+        const auto src = vrprecision->getDataTyped();
+        std::transform(src, src + nVoxels, data.begin(),
+                       [](auto v) { return static_cast<float>(v); });
+    });
+
+    int niftiDims[8] = {3, static_cast<int>(dims.x), static_cast<int>(dims.y),
+                        static_cast<int>(dims.z), 1, 1, 1, 1};
+    nifti_image* nim = nifti_make_new_nim(niftiDims, DT_FLOAT32, 0);
+    if (!nim) {
+        throw Exception(fmt::format("Could not create NIfTI image for {}", file),
+                        IVW_CONTEXT_CUSTOM("NiftiWriter"));
+    }
+
+    const mat4 indexToWorld = volume.getCoordinateTransformer().getIndexToWorldMatrix();
+    for (int row = 0; row < 3; ++row) {
+        for (int col = 0; col < 4; ++col) {
+            nim->sto_xyz.m[row][col] = indexToWorld[col][row];
+        }
+    }
+    nim->sto_xyz.m[3][0] = nim->sto_xyz.m[3][1] = nim->sto_xyz.m[3][2] = 0.f;
+    nim->sto_xyz.m[3][3] = 1.f;
+    nim->sform_code = NIFTI_XFORM_MNI_152;
+    nim->qform_code = NIFTI_XFORM_UNKNOWN;
+    nim->sto_ijk = nifti_mat44_inverse(nim->sto_xyz);
+    nim->dx = nim->pixdim[1] = glm::length(vec3(indexToWorld[0]));
+    nim->dy = nim->pixdim[2] = glm::length(vec3(indexToWorld[1]));
+    nim->dz = nim->pixdim[3] = glm::length(vec3(indexToWorld[2]));
+    nim->xyz_units = NIFTI_UNITS_MM;
+
+    const auto range = volume.dataMap.valueRange;
+    nim->cal_min = static_cast<float>(range.x);
+    nim->cal_max = static_cast<float>(range.y);
+    nim->data = data.data();
+
+    const auto filename = file.string();
+    const bool failed =
+        nifti_set_filenames(nim, filename.c_str(), 0, nifti_short_order()) != 0;
+    if (!failed) nifti_image_write(nim);
+    // data is owned by the vector, do not let nifti free it
+    nim->data = nullptr;
+    nifti_image_free(nim);
+
+    if (failed || !std::filesystem::exists(file)) {
+        throw Exception(fmt::format("Could not write {}", file),
+                        IVW_CONTEXT_CUSTOM("NiftiWriter"));
+    }
+}
+
+}  // namespace cli
+
+}  // namespace inviwo
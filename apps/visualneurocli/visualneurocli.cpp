@@ -0,0 +1,453 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include "cohort.h"
+#include "niftiwriter.h"
+
+#include <inviwo/core/common/inviwo.h>
+#include <inviwo/core/common/inviwoapplication.h>
+#include <inviwo/core/common/coremodulesharedlibrary.h>
+#include <inviwo/core/datastructures/volume/volumeram.h>
+#include <inviwo/core/util/consolelogger.h>
+#include <inviwo/core/util/exception.h>
+#include <inviwo/core/util/filesystem.h>
+#include <inviwo/core/util/logcentral.h>
+#include <inviwo/core/util/stringconversion.h>
+#include <modules/nifti/niftimodulesharedlibrary.h>
+#include <modules/visualneuro/algorithm/volume/cohortfile.h>
+#include <modules/visualneuro/algorithm/volume/voxelstatistics.h>
+#include <modules/visualneuro/distributed/shardedstatistics.h>
+#include <modules/visualneuro/util/jobmetrics.h>
+#include <modules/visualneuro/util/tracerecorder.h>
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <tclap/CmdLine.h>
+#include <warn/pop>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <thread>
+
+using namespace inviwo;
+
+namespace {
+
+struct MapSummary {
+    std::string map;
+    std::filesystem::path file;
+    size_t subjects;
+    size_t significant;
+    double min;
+    double max;
+};
+
+MapSummary summarize(const Volume& volume, std::string map, std::filesystem::path file,
+                     size_t subjects) {
+    MapSummary summary{std::move(map), std::move(file), subjects, 0,
+                       std::numeric_limits<double>::max(), std::numeric_limits<double>::lowest()};
+    const auto ram = volume.getRepresentation<VolumeRAM>();
+    ram->dispatch<void, dispatching::filter::Scalars>([&](auto vrprecision) {
+        const auto data = vrprecision->getDataTyped();
+        const auto n = glm::compMul(vrprecision->getDimensions());
+        for (size_t i = 0; i < n; ++i) {
+            const auto v = static_cast<double>(data[i]);
+            if (v != 0.0) ++summary.significant;
+            summary.min = std::min(summary.min, v);
+            summary.max = std::max(summary.max, v);
+        }
+    });
+    return summary;
+}
+
+// Make a parameter name safe to use as part of a filename
+std::string sanitize(std::string_view name) {
+    std::string res{name};
+    std::replace_if(
+        res.begin(), res.end(),
+        [](char c) { return !(std::isalnum(static_cast<unsigned char>(c)) || c == '-'); }, '_');
+    return res;
+}
+
+stats::TailTest parseTail(const std::string& tail) {
+    if (tail == "both") return stats::TailTest::Both;
+    if (tail == "greater") return stats::TailTest::Greater;
+    if (tail == "less") return stats::TailTest::Less;
+    throw Exception(fmt::format("Invalid tail '{}', expected both, greater or less", tail),
+                    IVW_CONTEXT_CUSTOM("VisualNeuroCLI"));
+}
+
+// Quote a CSV field, embedded quotes are doubled
+std::string csvField(std::string_view field) {
+    std::string res{"\""};
+    for (auto c : field) {
+        if (c == '"') res += '"';
+        res += c;
+    }
+    res += '"';
+    return res;
+}
+
+void writeSummary(const std::vector<MapSummary>& summaries, const std::filesystem::path& file) {
+    std::ofstream out(file);
+    if (!out) {
+        throw Exception(fmt::format("Could not write {}", file),
+                        IVW_CONTEXT_CUSTOM("VisualNeuroCLI"));
+    }
+    out << "Map,File,Subjects,Significant voxels,Min,Max\n";
+    for (const auto& s : summaries) {
+        out << csvField(s.map) << ',' << csvField(s.file.filename().generic_string()) << ','
+            << s.subjects << ',' << s.significant << ',' << s.min << ',' << s.max << '\n';
+    }
+}
+
+std::pair<std::string, std::uint16_t> parseAddress(const std::string& str) {
+    const auto colon = str.rfind(':');
+    if (colon == std::string::npos) {
+        throw Exception(fmt::format("Invalid address '{}', expected host:port", str),
+                        IVW_CONTEXT_CUSTOM("VisualNeuroCLI"));
+    }
+    return {str.substr(0, colon), static_cast<std::uint16_t>(std::stoul(str.substr(colon + 1)))};
+}
+
+// Write the cohort file used by the shard workers, unless it already holds the same volumes.
+// The volumes are compared by filename and by the size and modification time of their files.
+void packCohort(const cli::Cohort& cohort, const std::filesystem::path& file) {
+    std::vector<std::string> names;
+    std::vector<stats::CohortSourceStamp> stamps;
+    for (const auto& f : cohort.files) {
+        names.push_back(f.filename().generic_string());
+        stamps.push_back(stats::CohortSourceStamp::of(f));
+    }
+
+    if (std::filesystem::exists(file)) {
+        try {
+            const stats::CohortFileVoxelSource existing(file);
+            if (existing.getSubjectNames() == names && existing.getSourceStamps() == stamps &&
+                existing.getDimensions() == cohort.volumes.front()->getDimensions()) {
+                LogInfoCustom("VisualNeuroCLI", "Using cohort file " << file);
+                return;
+            }
+        } catch (const Exception&) {
+            // Not a valid cohort file, overwrite it
+        }
+    }
+    LogInfoCustom("VisualNeuroCLI", "Writing cohort file " << file);
+    stats::writeCohortFile(stats::VolumeSequenceVoxelSource(cohort.volumes), names, file, {},
+                           stamps);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    auto logger = std::make_shared<ConsoleLogger>();
+    LogCentral logCentral;
+    LogCentral::init(&logCentral);
+    logCentral.registerLogger(logger);
+
+    TCLAP::CmdLine cmd(
+        "Compute voxel-wise statistics of a cohort of volumes without a graphical interface.\n"
+        "Commands: mean, ttest, correlation, pack, worker",
+        ' ', "1.0");
+    TCLAP::UnlabeledValueArg<std::string> command(
+        "command", "mean, ttest, correlation, pack (write --cohort-file) or worker", true, "",
+        "command", cmd);
+    TCLAP::ValueArg<std::string> volumesArg("v", "volumes", "Folder with volumes", false, "",
+                                            "folder", cmd);
+    TCLAP::ValueArg<std::string> filterArg("f", "filter", "Volume filename filter", false, "*.nii*",
+                                           "wildcard", cmd);
+    TCLAP::ValueArg<std::string> csvArg("c", "csv", "Patient data, one row per volume", false, "",
+                                        "file", cmd);
+    TCLAP::ValueArg<std::string> filenameColumnArg(
+        "", "filename-column",
+        "Patient data column with volume filenames, detected automatically if not given", false,
+        "", "header", cmd);
+    TCLAP::ValueArg<std::string> parametersArg(
+        "p", "parameters", "Comma separated patient data columns to correlate with", false, "",
+        "headers", cmd);
+    TCLAP::SwitchArg allParametersArg("", "all-parameters",
+                                      "Correlate with all numeric patient data columns", cmd);
+    TCLAP::ValueArg<std::string> groupColumnArg("g", "group-column",
+                                                "Patient data column defining the t-test groups",
+                                                false, "", "header", cmd);
+    TCLAP::ValueArg<std::string> groupAArg("", "group-a", "Value of the first group", false, "",
+                                           "value", cmd);
+    TCLAP::ValueArg<std::string> groupBArg("", "group-b", "Value of the second group", false, "",
+                                           "value", cmd);
+    TCLAP::ValueArg<std::string> methodArg("m", "method", "Correlation method, spearman or pearson",
+                                           false, "spearman", "method", cmd);
+    TCLAP::ValueArg<std::string> tailArg("t", "tail", "Tail test, both, greater or less", false,
+                                         "both", "tail", cmd);
+    TCLAP::ValueArg<double> pValueArg("", "pval", "Significance level", false, 0.05, "p", cmd);
+    TCLAP::SwitchArg equalVarianceArg("", "equal-variance",
+                                      "Assume equal variance in the t-test", cmd);
+    TCLAP::ValueArg<std::string> maskArg("", "mask", "Restrict correlation to non-zero voxels",
+                                         false, "", "file", cmd);
+    TCLAP::ValueArg<std::string> outputArg("o", "output", "Output folder", false, ".", "folder",
+                                           cmd);
+    TCLAP::ValueArg<size_t> threadsArg("j", "threads", "Number of threads, 0 uses all cores",
+                                       false, 0, "n", cmd);
+    TCLAP::ValueArg<size_t> workersArg(
+        "w", "workers",
+        "Split the volume over n worker processes. Started on this machine unless --listen is "
+        "given",
+        false, 0, "n", cmd);
+    TCLAP::ValueArg<std::string> listenArg(
+        "", "listen", "Wait for --workers workers started on other hosts to connect", false, "",
+        "address:port", cmd);
+    TCLAP::ValueArg<std::string> connectArg("", "connect", "Coordinator to compute shards for",
+                                            false, "", "host:port", cmd);
+    TCLAP::ValueArg<std::string> cohortFileArg(
+        "", "cohort-file",
+        "Cohort file mapped by the workers, must be reachable from all hosts. Defaults to "
+        "cohort.vncohort in the output folder",
+        false, "", "file", cmd);
+    TCLAP::ValueArg<std::string> metricsArg(
+        "", "metrics", "Write the timings of each computed map as JSON to file", false, "", "file",
+        cmd);
+    TCLAP::ValueArg<std::string> traceArg(
+        "", "trace", "Record file reads and computation phases as a Chrome trace to file", false,
+        "", "file", cmd);
+
+    try {
+        cmd.parse(argc, argv);
+    } catch (const TCLAP::ArgException& e) {
+        std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+        return 1;
+    }
+
+    // Only register the modules needed to read volumes. The VisualNeuro module library is linked
+    // for the statistics but the module itself is not created since it requires OpenGL.
+    InviwoApplication app(argc, argv, "VisualNeuro CLI");
+    {
+        std::vector<std::unique_ptr<InviwoModuleFactoryObject>> modules;
+        modules.emplace_back(createInviwoCore());
+        modules.emplace_back(createNiftiModule());
+        app.registerModules(std::move(modules));
+    }
+    const size_t threads = threadsArg.getValue() > 0
+                               ? threadsArg.getValue()
+                               : std::max(1u, std::thread::hardware_concurrency());
+    // The calling thread takes part in the computations
+    app.resizePool(threads - 1);
+
+    if (traceArg.isSet()) util::TraceRecorder::get().setEnabled(true);
+
+    try {
+        const auto& cmdName = command.getValue();
+        if (cmdName == "worker") {
+            const auto [host, port] = parseAddress(connectArg.getValue());
+            stats::runShardWorker(host, port);
+            return 0;
+        }
+        if (!volumesArg.isSet()) {
+            throw Exception(fmt::format("{} requires --volumes", cmdName),
+                            IVW_CONTEXT_CUSTOM("VisualNeuroCLI"));
+        }
+
+        const std::filesystem::path output{outputArg.getValue()};
+        std::filesystem::create_directories(output);
+
+        std::optional<std::filesystem::path> csv;
+        if (csvArg.isSet()) csv = csvArg.getValue();
+        const auto cohort = cli::loadCohort(app, volumesArg.getValue(), filterArg.getValue(), csv,
+                                            filenameColumnArg.getValue());
+        LogInfoCustom("VisualNeuroCLI", "Loaded " << cohort.size() << " volumes");
+
+        const auto cohortFile = cohortFileArg.isSet()
+                                    ? std::filesystem::path{cohortFileArg.getValue()}
+                                    : output / "cohort.vncohort";
+        if (cmdName == "pack") {
+            packCohort(cohort, cohortFile);
+            return 0;
+        }
+
+        // With workers, each map is computed by splitting the voxels over the worker processes
+        std::unique_ptr<stats::ShardCoordinator> coordinator;
+        if (const auto nWorkers = workersArg.getValue(); nWorkers > 0) {
+            packCohort(cohort, cohortFile);
+            if (listenArg.isSet()) {
+                const auto [address, port] = parseAddress(listenArg.getValue());
+                coordinator = std::make_unique<stats::ShardCoordinator>(address, port);
+                LogInfoCustom("VisualNeuroCLI", "Waiting for " << nWorkers << " workers on port "
+                                                               << coordinator->getPort());
+                coordinator->waitForWorkers(nWorkers, std::chrono::minutes{10});
+            } else {
+                coordinator = std::make_unique<stats::ShardCoordinator>();
+                const auto workerThreads = std::max<size_t>(threads / nWorkers, 1);
+                coordinator->spawnWorkers(filesystem::getExecutablePath(),
+                                          {"worker", "-j", std::to_string(workerThreads)},
+                                          nWorkers);
+                coordinator->waitForWorkers(nWorkers);
+            }
+        }
+        auto runSharded = [&](stats::ShardTask task) {
+            task.cohortFile = cohortFile;
+            return stats::shardResultToVolume(task, *coordinator->run(task), cohort.volumes);
+        };
+
+        // Sharded maps are computed by the workers and only report the time to write the result
+        auto startMetrics = [](std::string_view map) {
+            auto metrics = std::make_unique<util::JobMetrics>("VisualNeuroCLI", map);
+            metrics->start();
+            return metrics;
+        };
+        std::vector<MapSummary> summaries;
+        auto write = [&](const Volume& volume, const std::string& map,
+                         const std::filesystem::path& file, size_t subjects,
+                         util::JobMetrics& metrics) {
+            util::PhaseTimer timer(&metrics, util::JobPhase::Publish);
+            cli::writeNifti(volume, file);
+            timer.stop();
+            metrics.finish();
+            summaries.push_back(summarize(volume, map, file, subjects));
+            LogInfoCustom("VisualNeuroCLI", "Wrote " << file);
+        };
+
+        const auto start = std::chrono::steady_clock::now();
+        if (cmdName == "mean") {
+            const auto metrics = startMetrics(cmdName);
+            auto mean = coordinator ? runSharded({stats::ShardKernel::Mean})
+                                    : stats::volumeSequenceMean(cohort.volumes,
+                                                                {{}, {}, metrics.get()});
+            write(*mean, "Mean", output / "mean.nii", cohort.size(), *metrics);
+        } else if (cmdName == "ttest") {
+            if (!csv || !groupColumnArg.isSet() || !groupAArg.isSet() || !groupBArg.isSet()) {
+                throw Exception("ttest requires --csv, --group-column, --group-a and --group-b",
+                                IVW_CONTEXT_CUSTOM("VisualNeuroCLI"));
+            }
+            const auto [groupA, groupB] = cohort.groupIndices(
+                groupColumnArg.getValue(), groupAArg.getValue(), groupBArg.getValue());
+            if (groupA.size() < 2 || groupB.size() < 2) {
+                throw Exception(fmt::format("Each group needs at least two volumes, got {} and {}",
+                                            groupA.size(), groupB.size()),
+                                IVW_CONTEXT_CUSTOM("VisualNeuroCLI"));
+            }
+            const stats::TTestSettings settings{
+                equalVarianceArg.getValue() ? stats::EqualVariance::Yes : stats::EqualVariance::No,
+                parseTail(tailArg.getValue()), pValueArg.getValue()};
+            const auto metrics = startMetrics(cmdName);
+            std::shared_ptr<Volume> tTest;
+            if (coordinator) {
+                stats::ShardTask task{stats::ShardKernel::TTest};
+                task.groupA.assign(groupA.begin(), groupA.end());
+                task.groupB.assign(groupB.begin(), groupB.end());
+                task.tTest = settings;
+                tTest = runSharded(std::move(task));
+            } else {
+                tTest = stats::volumeTTest(cohort.subset(groupA), cohort.subset(groupB), settings,
+                                           {{}, {}, metrics.get()});
+            }
+            write(*tTest,
+                  fmt::format("t-test {} ({}) vs {} ({})", groupAArg.getValue(), groupA.size(),
+                              groupBArg.getValue(), groupB.size()),
+                  output / "ttest.nii", groupA.size() + groupB.size(), *metrics);
+        } else if (cmdName == "correlation") {
+            if (!csv) {
+                throw Exception("correlation requires --csv", IVW_CONTEXT_CUSTOM("VisualNeuroCLI"));
+            }
+            auto parameters = allParametersArg.getValue()
+                                  ? cohort.numericColumns()
+                                  : util::splitString(parametersArg.getValue(), ',');
+            parameters.erase(std::remove_if(parameters.begin(), parameters.end(),
+                                            [](const auto& p) { return util::trim(p).empty(); }),
+                             parameters.end());
+            if (parameters.empty()) {
+                throw Exception("correlation requires --parameters or --all-parameters",
+                                IVW_CONTEXT_CUSTOM("VisualNeuroCLI"));
+            }
+            stats::CorrelationSettings settings;
+            const auto& method = methodArg.getValue();
+            if (method == "pearson") {
+                settings.method = stats::CorrelationMethod::Pearson;
+            } else if (method != "spearman") {
+                throw Exception(
+                    fmt::format("Invalid method '{}', expected spearman or pearson", method),
+                    IVW_CONTEXT_CUSTOM("VisualNeuroCLI"));
+            }
+            settings.tail = parseTail(tailArg.getValue());
+            settings.pValue = pValueArg.getValue();
+
+            std::shared_ptr<Volume> mask;
+            if (maskArg.isSet()) mask = cli::loadVolume(app, maskArg.getValue());
+            std::vector<unsigned char> gridMask;
+            if (mask && coordinator) gridMask = stats::maskToGrid(*mask, *cohort.volumes.front());
+
+            for (const auto& p : parameters) {
+                const std::string parameterName{util::trim(p)};
+                const auto parameter = cohort.parameter(parameterName);
+                const auto subjects = static_cast<size_t>(std::count_if(
+                    parameter.begin(), parameter.end(), [](double v) { return !std::isnan(v); }));
+                const auto metrics = startMetrics(cmdName);
+                std::shared_ptr<Volume> corr;
+                if (coordinator) {
+                    stats::ShardTask task{stats::ShardKernel::Correlation};
+                    task.parameter = parameter;
+                    task.correlation = settings;
+                    task.mask = gridMask;
+                    corr = runSharded(std::move(task));
+                } else {
+                    corr = stats::parameterVolumeCorrelation(cohort.volumes, parameter, settings,
+                                                             mask.get(), {{}, {}, metrics.get()});
+                }
+                write(*corr, parameterName,
+                      output / fmt::format("correlation_{}.nii", sanitize(parameterName)),
+                      subjects, *metrics);
+            }
+        } else {
+            throw Exception(fmt::format("Unknown command '{}'", cmdName),
+                            IVW_CONTEXT_CUSTOM("VisualNeuroCLI"));
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        LogInfoCustom("VisualNeuroCLI", fmt::format("Computed {} map(s) in {:.2f} s",
+                                                    summaries.size(), elapsed.count()));
+
+        writeSummary(summaries, output / "summary.csv");
+        if (metricsArg.isSet()) {
+            util::MetricsRegistry::get().writeJSON(std::filesystem::path{metricsArg.getValue()});
+        }
+        if (traceArg.isSet()) {
+            util::TraceRecorder::get().writeJSON(std::filesystem::path{traceArg.getValue()});
+        }
+    } catch (const Exception& e) {
+        util::log(e.getContext(), e.getFullMessage(), LogLevel::Error);
+        return 1;
+    } catch (const std::exception& e) {
+        LogErrorCustom("VisualNeuroCLI", e.what());
+        return 1;
+    }
+
+    return 0;
+}
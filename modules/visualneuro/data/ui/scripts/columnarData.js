@@ -0,0 +1,167 @@
+// Decoder for the binary columnar frames sent by the DataFrameWebBrowserProcessor, see
+// util::serializeColumnarFrame and util::serializeColumnarDelta. The processor injects this
+// script into every loaded page and calls onInviwoColumnarData(url, port) when a data frame
+// changed and onInviwoBrushingDelta(delta) when the filtered or selected rows changed.
+
+var inviwoTypedArrays = {
+  int8: Int8Array, uint8: Uint8Array, int16: Int16Array, uint16: Uint16Array,
+  int32: Int32Array, uint32: Uint32Array, float32: Float32Array, float64: Float64Array,
+  categorical: Uint32Array
+};
+
+// Returns {kind, version, base, rows, port, processor, columns, toRows()}. Numeric columns are
+// typed arrays viewing the buffer, with the components of vector columns interleaved.
+// Categorical columns are {codes, categories}. Columns of a delta hold the rows from
+// column.firstRow to the end of the frame.
+function decodeColumnarFrame(buffer) {
+  var header = new Uint32Array(buffer, 0, 4);
+  var magic = String.fromCharCode.apply(null, new Uint8Array(buffer, 0, 4));
+  if (magic !== "VNCF" || header[1] !== 1) {
+    throw new Error("Unsupported columnar frame");
+  }
+  var metadataBytes = header[2];
+  var metadata = JSON.parse(new TextDecoder().decode(new Uint8Array(buffer, 16, metadataBytes)));
+  var dataOffset = 16 + metadataBytes;
+
+  var columns = {};
+  metadata.columns.forEach(function(column) {
+    var ArrayType = inviwoTypedArrays[column.type];
+    var values = new ArrayType(buffer, dataOffset + column.offset,
+                               column.bytes / ArrayType.BYTES_PER_ELEMENT);
+    columns[column.name] = column.type === "categorical" ?
+      {codes: values, categories: column.categories} : values;
+    columns[column.name].components = column.components;
+    columns[column.name].firstRow = column.firstRow;
+  });
+  return makeColumnarFrame(metadata, columns);
+}
+
+function makeColumnarFrame(metadata, columns) {
+  return {
+    kind: metadata.kind,
+    version: metadata.version,
+    base: metadata.base,
+    rows: metadata.rows,
+    port: metadata.port,
+    processor: metadata.processor,
+    columns: columns,
+    // Row objects as sent by earlier versions, one property per column
+    toRows: function() {
+      var names = Object.keys(columns);
+      var rows = new Array(metadata.rows);
+      for (var i = 0; i < metadata.rows; i++) {
+        var row = {};
+        names.forEach(function(name) {
+          var column = columns[name];
+          if (column.categories) {
+            row[name] = column.categories[column.codes[i]];
+          } else if (column.components > 1) {
+            row[name] = Array.from(column.subarray(i * column.components,
+                                                   (i + 1) * column.components));
+          } else {
+            row[name] = column[i];
+          }
+        });
+        rows[i] = row;
+      }
+      return rows;
+    }
+  };
+}
+
+// Values of the first rows of a column followed by the values of tail
+function inviwoConcatValues(values, components, rows, tail) {
+  var res = new values.constructor((rows + tail.length / components) * components);
+  res.set(values.subarray(0, rows * components));
+  res.set(tail, rows * components);
+  res.components = components;
+  res.firstRow = 0;
+  return res;
+}
+
+// Apply a delta frame to the frame it is based on
+function applyColumnarDelta(frame, delta) {
+  var columns = {};
+  Object.keys(frame.columns).forEach(function(name) {
+    var column = frame.columns[name];
+    var changed = delta.columns[name];
+    var keep = Math.min(frame.rows, delta.rows);
+    if (changed && changed.firstRow === 0) {
+      columns[name] = changed;
+    } else if (column.categories) {
+      var codes = inviwoConcatValues(column.codes, 1, keep,
+                                     changed ? changed.codes : new Uint32Array(0));
+      columns[name] = {codes: codes, categories: changed ? changed.categories : column.categories,
+                       components: 1, firstRow: 0};
+    } else {
+      columns[name] = inviwoConcatValues(column, column.components, keep,
+                                         changed || new column.constructor(0));
+    }
+  });
+  return makeColumnarFrame(delta, columns);
+}
+
+// Frames of each port, applied in the order they were sent
+var inviwoColumnarFrames = {};
+var inviwoColumnarQueue = Promise.resolve();
+
+// Pages can define onInviwoColumnarDataChanged(frame, port) to use the columns directly,
+// otherwise onInviwoDataChanged(rows, port) is called.
+function onInviwoColumnarData(url, port) {
+  var fetched = fetch(url).then(function(response) {
+    if (!response.ok) throw new Error("Could not fetch " + url);
+    return response.arrayBuffer();
+  });
+  inviwoColumnarQueue = inviwoColumnarQueue.then(function() {
+    return fetched;
+  }).then(function(buffer) {
+    var key = port.processor + "." + port.port;
+    var frame = decodeColumnarFrame(buffer);
+    if (frame.kind === "delta") {
+      var current = inviwoColumnarFrames[key];
+      if (!current || current.version !== frame.base) {
+        console.warn("Ignoring delta " + frame.version + " of " + key +
+                     ", the page does not have frame " + frame.base);
+        return;
+      }
+      frame = applyColumnarDelta(current, frame);
+    }
+    inviwoColumnarFrames[key] = frame;
+    if (typeof onInviwoColumnarDataChanged === "function") {
+      onInviwoColumnarDataChanged(frame, port);
+    } else if (typeof onInviwoDataChanged === "function") {
+      onInviwoDataChanged(frame.toRows(), port);
+    }
+  }).catch(function(error) {
+    console.error(error);
+  });
+}
+
+// Filtered and selected row indices, updated by onInviwoBrushingDelta
+var inviwoBrushing = {version: 0, filtered: new Set(), selected: new Set()};
+
+function inviwoApplyRanges(set, added, removed) {
+  removed.forEach(function(range) {
+    for (var i = range[0]; i < range[1]; i++) set.delete(i);
+  });
+  added.forEach(function(range) {
+    for (var i = range[0]; i < range[1]; i++) set.add(i);
+  });
+}
+
+// Pages can define onInviwoBrushingChanged(state, delta) to react to brushing changes
+function onInviwoBrushingDelta(delta) {
+  if (delta.base === 0) {
+    inviwoBrushing = {version: 0, filtered: new Set(), selected: new Set()};
+  } else if (delta.base !== inviwoBrushing.version) {
+    console.warn("Ignoring brushing delta " + delta.version + ", the page has version " +
+                 inviwoBrushing.version);
+    return;
+  }
+  inviwoApplyRanges(inviwoBrushing.filtered, delta.filtered.added, delta.filtered.removed);
+  inviwoApplyRanges(inviwoBrushing.selected, delta.selected.added, delta.selected.removed);
+  inviwoBrushing.version = delta.version;
+  if (typeof onInviwoBrushingChanged === "function") {
+    onInviwoBrushingChanged(inviwoBrushing, delta);
+  }
+}
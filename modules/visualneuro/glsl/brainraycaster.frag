@@ -52,6 +52,19 @@ uniform sampler3D atlas;
 uniform sampler2D transferFunction;
 uniform sampler2D activityTransferFunction;
 uniform sampler2D atlasTransferFunction;
+#ifdef ATLAS_LABEL_COLORS
+// Texel i holds the color of label i, see LabelColorLUT
+uniform sampler2D atlasColors;
+// Data range of the atlas, used to convert normalized voxel values back to labels
+uniform vec2 atlasValueRange;
+
+vec4 atlasLabelColor(float normalizedValue) {
+    int label = int(floor(mix(atlasValueRange.x, atlasValueRange.y, normalizedValue) + 0.5));
+    ivec2 size = textureSize(atlasColors, 0);
+    if (label < 0 || label >= size.x * size.y) return vec4(0.0);
+    return texelFetch(atlasColors, ivec2(label % size.x, label / size.x), 0);
+}
+#endif
 
 uniform ImageParameters entryParameters;
 uniform sampler2D entryColor;
@@ -174,7 +187,11 @@ vec4 rayTraversal(vec3 entryPoint, vec3 exitPoint, vec2 texCoords, float backgro
             vec3((atlasParameters.worldToTexture * worldSpacePosition).xyz);
         if (!(any(lessThan(atlasSamplePos, vec3(0))) || any(greaterThan(atlasSamplePos, vec3(1))))) {
             vec4 voxelAtlas = getNormalizedVoxel(atlas, atlasParameters, atlasSamplePos);
+#ifdef ATLAS_LABEL_COLORS
+            vec4 colorAtlas = atlasLabelColor(voxelAtlas.r);
+#else
             vec4 colorAtlas = APPLY_CLASSIFICATION(atlasTransferFunction, voxelAtlas);
+#endif
             result = compositeDVR(result, colorAtlas, t, tDepth, tIncr);
         }
 #endif
@@ -0,0 +1,58 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+
+#include <inviwo/core/common/inviwo.h>
+#include <inviwo/dataframe/datastructures/dataframe.h>
+
+#include <memory>
+#include <vector>
+
+namespace inviwo {
+
+namespace dataframe {
+
+/**
+ * \brief Append the rows of all frames into a new DataFrame, in order.
+ * Columns are matched by header with the columns of the first frame once, every output column is
+ * allocated for all rows up front and filled with one typed copy per frame, one column per task
+ * in parallel. In contrast to repeated calls to appendRows, the time is linear in the total
+ * number of rows. The index column of the result is renumbered.
+ * @throws Exception if frames is empty, or if a frame does not have the same columns, with the
+ * same types, as the first frame
+ */
+IVW_MODULE_VISUALNEURO_API std::shared_ptr<DataFrame> concatenateRows(
+    const std::vector<std::shared_ptr<const DataFrame>>& frames);
+
+}  // namespace dataframe
+
+}  // namespace inviwo
@@ -0,0 +1,170 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+
+#include <inviwo/core/common/inviwo.h>
+#include <inviwo/dataframe/datastructures/dataframe.h>
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace inviwo {
+
+namespace dataframe {
+
+/**
+ * \brief Parameter values of a set of subjects, e.g. the columns of a DataFrame for the subjects
+ * of a volume sequence, in one column-major matrix of doubles.
+ *
+ * Every column starts at a 64 byte boundary. Missing values are NaN and marked as invalid in a
+ * per-column bit mask with one bit per subject. The number of valid values, the mean and the
+ * standard deviation of the valid values of each column are computed once at construction.
+ */
+class IVW_MODULE_VISUALNEURO_API ParameterMatrix {
+public:
+    // Row of a subject without data, see ParameterMatrix(const DataFrame&, ...)
+    static constexpr std::uint32_t noRow = std::numeric_limits<std::uint32_t>::max();
+
+    ParameterMatrix() = default;
+    /*
+     * Extract columns of frame with one typed read per column, in parallel. The values of
+     * vector columns are their first components.
+     * @param rows the row of each subject, or noRow for subjects without data
+     * @throws Exception if a column or row index is out of range
+     */
+    ParameterMatrix(const DataFrame& frame, const std::vector<size_t>& columns,
+                    const std::vector<std::uint32_t>& rows);
+    /*
+     * @param columns one vector per parameter with one value per subject, NaN if missing
+     * @throws Exception if the columns differ in size
+     */
+    explicit ParameterMatrix(const std::vector<std::vector<double>>& columns,
+                             std::vector<std::string> names = {});
+
+    size_t getNumberOfParameters() const { return stats_.size(); }
+    size_t getNumberOfSubjects() const { return subjects_; }
+    const std::string& getName(size_t parameter) const { return stats_[parameter].name; }
+
+    /*
+     * @return the getNumberOfSubjects() values of parameter, 64 byte aligned
+     */
+    const double* getValues(size_t parameter) const { return data_.get() + parameter * stride_; }
+    /*
+     * Validity bits of parameter, bit i % 64 of word i / 64 is set if subject i has a value.
+     * @return getValidityWords() words
+     */
+    const std::uint64_t* getValidity(size_t parameter) const {
+        return validity_.data() + parameter * words_;
+    }
+    size_t getValidityWords() const { return words_; }
+    bool isValid(size_t parameter, size_t subject) const {
+        return (getValidity(parameter)[subject / 64] >> (subject % 64)) & 1;
+    }
+
+    size_t getNumberOfValid(size_t parameter) const { return stats_[parameter].valid; }
+    /*
+     * Mean and population standard deviation of the valid values, NaN if there are none.
+     */
+    double getMean(size_t parameter) const { return stats_[parameter].mean; }
+    double getStandardDeviation(size_t parameter) const {
+        return stats_[parameter].standardDeviation;
+    }
+
+    /*
+     * The subjects with a value for parameter, in ascending order.
+     */
+    std::vector<std::uint32_t> getValidSubjects(size_t parameter) const;
+    /*
+     * The values of the valid subjects, ordered as getValidSubjects.
+     */
+    std::vector<double> getValidValues(size_t parameter) const;
+    /*
+     * (value - mean) / standard deviation of the valid subjects, ordered as getValidSubjects.
+     */
+    std::vector<double> getStandardizedValues(size_t parameter) const;
+    /*
+     * Group the parameters with identical validity bits, i.e. with the same missing subjects.
+     * Groups are ordered by their first parameter and list their parameters in ascending order.
+     */
+    std::vector<std::vector<size_t>> groupByValidity() const;
+
+private:
+    struct AlignedDelete {
+        void operator()(double* data) const;
+    };
+    struct ColumnStats {
+        std::string name;
+        size_t valid = 0;
+        double mean = std::numeric_limits<double>::quiet_NaN();
+        double standardDeviation = std::numeric_limits<double>::quiet_NaN();
+    };
+
+    void allocate(size_t parameters, size_t subjects);
+    // Validity and statistics of a column whose values have been written
+    void finish(size_t parameter);
+
+    size_t subjects_ = 0;
+    // Values between the starts of two columns
+    size_t stride_ = 0;
+    size_t words_ = 0;
+    std::unique_ptr<double[], AlignedDelete> data_;
+    std::vector<std::uint64_t> validity_;
+    std::vector<ColumnStats> stats_;
+};
+
+/**
+ * \brief ParameterMatrix of all columns of the latest data frame and subject rows, shared
+ * between the jobs of a processor so that the parameters are only extracted again when the data
+ * frame or the rows change. Thread safe.
+ */
+class IVW_MODULE_VISUALNEURO_API ParameterMatrixCache {
+public:
+    /*
+     * @param rows the row of each subject, see ParameterMatrix
+     */
+    std::shared_ptr<const ParameterMatrix> get(const std::shared_ptr<const DataFrame>& frame,
+                                               const std::vector<std::uint32_t>& rows);
+
+private:
+    std::mutex mutex_;
+    std::weak_ptr<const DataFrame> frame_;
+    std::vector<std::uint32_t> rows_;
+    std::shared_ptr<const ParameterMatrix> matrix_;
+};
+
+}  // namespace dataframe
+
+}  // namespace inviwo
@@ -0,0 +1,142 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+#include <modules/visualneuro/util/parallelforblocks.h>
+
+#include <inviwo/core/common/inviwo.h>
+#include <inviwo/dataframe/datastructures/dataframe.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace inviwo {
+
+namespace dataframe {
+
+/**
+ * \brief Extracts patient ids from volume filenames, the id is the run of letters and digits
+ * following a keyword, optionally separated by '-' or '_', e.g. "Subject_0042" with keyword
+ * "Subject" gives "0042". The pattern is compiled once and can be used from several threads.
+ */
+class IVW_MODULE_VISUALNEURO_API PatientIdPattern {
+public:
+    /*
+     * @throws Exception if keyword is empty
+     */
+    explicit PatientIdPattern(std::string_view keyword);
+
+    /*
+     * @return the id following the first occurrence of the keyword, empty if there is none
+     */
+    std::string_view extract(std::string_view filename) const;
+
+private:
+    std::regex regex_;
+};
+
+/**
+ * \brief Volume file of a patient, see PatientDataSyncPlan.
+ */
+struct IVW_MODULE_VISUALNEURO_API PatientVolumeFile {
+    std::filesystem::path path;
+    // Patient id of the data frame, empty if the mapping has no entry for the id of the file
+    std::string id;
+};
+
+/**
+ * \brief Changes that synchronize a folder of patient volumes with a data frame of patient data,
+ * see planPatientDataSync.
+ */
+struct IVW_MODULE_VISUALNEURO_API PatientDataSyncPlan {
+    std::filesystem::path folder;
+    // Folder for volumes without patient data, non_matching_scans in folder
+    std::filesystem::path unmatchedFolder;
+    // Rows of the patient data with and without a volume, in row order
+    std::vector<std::uint32_t> matchedRows;
+    std::vector<std::uint32_t> unmatchedRows;
+    // Volumes in folder without patient data, to be moved to unmatchedFolder
+    std::vector<PatientVolumeFile> moves;
+    // Volumes in unmatchedFolder that still have no patient data
+    std::vector<PatientVolumeFile> unmatchedVolumes;
+    // Number of .nii files in folder
+    size_t volumes = 0;
+    // .nii files in folder without a patient id in their name, these are not moved
+    std::vector<std::filesystem::path> skipped;
+};
+
+/**
+ * \brief Join the .nii volumes of folder with the rows of patientData.
+ * The patient id of a volume is extracted from its filename with pattern and translated from the
+ * second to the first id column of mapping. A row has a volume if its first column holds the
+ * translated id of a volume in folder. Both folders are listed once, the entries are then checked
+ * and their ids extracted in parallel. The joins use hash maps.
+ * @return the plan, or std::nullopt if control requested a stop
+ * @throws Exception if mapping has less than two or patientData less than one column besides the
+ * index column, or if folder cannot be listed
+ */
+IVW_MODULE_VISUALNEURO_API std::optional<PatientDataSyncPlan> planPatientDataSync(
+    const DataFrame& mapping, const DataFrame& patientData, const std::filesystem::path& folder,
+    const PatientIdPattern& pattern, const util::BlockControl& control = {});
+
+/**
+ * \brief Move the volumes of plan.moves to plan.unmatchedFolder, in parallel.
+ * Files that cannot be moved are logged and skipped.
+ * @return number of moved files
+ */
+IVW_MODULE_VISUALNEURO_API size_t applyPatientDataSync(const PatientDataSyncPlan& plan,
+                                                       const util::BlockControl& control = {});
+
+/**
+ * \brief Write the volumes without patient data and the patients without volume side by side
+ * as a .csv log.
+ */
+IVW_MODULE_VISUALNEURO_API void writePatientDataSyncLog(std::ostream& os,
+                                                        const PatientDataSyncPlan& plan,
+                                                        const DataFrame& patientData);
+
+/**
+ * \brief The changes of plan as a data frame with the columns Action ("Move volume" or
+ * "Drop row"), ID and File, the filename of a volume or the row of the patient data.
+ */
+IVW_MODULE_VISUALNEURO_API std::shared_ptr<DataFrame> patientDataSyncActions(
+    const PatientDataSyncPlan& plan, const DataFrame& patientData);
+
+}  // namespace dataframe
+
+}  // namespace inviwo
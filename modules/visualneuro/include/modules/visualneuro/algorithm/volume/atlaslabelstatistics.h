@@ -0,0 +1,105 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+#include <modules/visualneuro/util/parallelforblocks.h>
+
+#include <inviwo/core/common/inviwo.h>
+#include <inviwo/core/datastructures/volume/volume.h>
+
+#include <limits>
+#include <optional>
+#include <vector>
+
+namespace inviwo {
+
+namespace stats {
+
+/**
+ * \brief Voxel count and position of one atlas label, in voxel index coordinates of the atlas.
+ */
+struct IVW_MODULE_VISUALNEURO_API LabelStatistics {
+    int label = 0;
+    size_t voxels = 0;
+    // Inclusive bounding box of the voxels with the label
+    size3_t lower{std::numeric_limits<size_t>::max()};
+    size3_t upper{0};
+    // Mean voxel position, may lie outside the region for non-convex regions
+    dvec3 centroid{0.0};
+    // Voxel of the region closest to centroid in world space
+    size3_t center{0};
+};
+
+/**
+ * \brief Dense table of LabelStatistics indexed by label for all labels between the smallest and
+ * largest label of an atlas. Lookups are O(1), labels without voxels are reported as missing.
+ */
+class IVW_MODULE_VISUALNEURO_API AtlasLabelStatistics {
+public:
+    AtlasLabelStatistics() = default;
+    AtlasLabelStatistics(size3_t dims, int firstLabel, std::vector<LabelStatistics> table);
+
+    /*
+     * @return statistics of label or nullptr if no voxel has the label.
+     */
+    const LabelStatistics* find(int label) const;
+    /*
+     * Labels with at least one voxel, in ascending order.
+     */
+    std::vector<int> getLabels() const;
+    const std::vector<LabelStatistics>& getTable() const;
+    size3_t getDimensions() const;
+
+private:
+    size3_t dims_{0};
+    int firstLabel_ = 0;
+    std::vector<LabelStatistics> table_;
+};
+
+/**
+ * \brief Largest number of distinct label values, i.e. largest - smallest label + 1, supported by
+ * computeLabelStatistics.
+ */
+constexpr size_t maxDenseLabelRange = size_t{1} << 16;
+
+/**
+ * \brief Compute voxel count, bounding box, centroid and nearest voxel to the centroid of every
+ * label in atlas. Voxel values are truncated to int. Runs two parallel passes over the voxels
+ * with per-worker partial results, so memory use is proportional to the number of labels.
+ * @return the statistics or std::nullopt if stopped through control
+ * @throws Exception if the labels span more than maxDenseLabelRange values
+ */
+IVW_MODULE_VISUALNEURO_API std::optional<AtlasLabelStatistics> computeLabelStatistics(
+    const Volume& atlas, const util::BlockControl& control = {});
+
+}  // namespace stats
+
+}  // namespace inviwo
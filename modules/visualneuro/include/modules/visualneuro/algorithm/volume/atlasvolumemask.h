@@ -30,9 +30,12 @@
 #pragma once
 
 #include <modules/visualneuro/visualneuromoduledefine.h>
+#include <modules/visualneuro/util/parallelforblocks.h>
+#include <modules/visualneuro/datastructures/atlasvoxelindex.h>
 #include <inviwo/core/common/inviwo.h>
 #include <inviwo/core/datastructures/volume/volume.h>
 
+#include <memory>
 #include <unordered_set>
 
 
@@ -44,4 +47,39 @@ namespace inviwo {
 // 0 otherwise. 
 IVW_MODULE_VISUALNEURO_API void atlasVolumeMask(Volume* resMask, const Volume& volume, const Volume& atlas, const std::unordered_set<size_t>& atlasFilter);
 
+// Maintains the mask of atlasVolumeMask while regions are added to and removed from the filter.
+// The brain bit is computed once on construction together with an index of the atlas voxels in
+// the grid of the volume. Selecting or deselecting a region then only updates the voxels of that
+// region. The mask is edited in place.
+class IVW_MODULE_VISUALNEURO_API AtlasVolumeMaskBuilder {
+public:
+    AtlasVolumeMaskBuilder(const Volume& volume, const Volume& atlas);
+
+    // Select exactly labels, updating only regions that are added or removed
+    void setSelection(const std::unordered_set<int>& labels);
+    // Returns false if the region already was selected
+    bool addRegion(int label);
+    // Returns false if the region was not selected
+    bool removeRegion(int label);
+    const std::unordered_set<int>& getSelection() const;
+
+    // uint8 volume with the model and world matrices of volume
+    std::shared_ptr<const Volume> getMask() const;
+    // Number of voxels written by region updates since construction
+    size_t getNumberOfUpdatedVoxels() const;
+
+private:
+    void updateRegion(int label, bool selected);
+
+    AtlasVoxelIndex index_;
+    std::shared_ptr<Volume> mask_;
+    std::unordered_set<int> selection_;
+    size_t updatedVoxels_ = 0;
+};
+
+// Compute a uint8 mask where each voxel is 1 << 7 if any of the volumes is not zero and 0
+// otherwise. Returns nullptr if stopped through control.
+IVW_MODULE_VISUALNEURO_API std::shared_ptr<Volume> brainMask(
+    const VolumeSequence& volumes, const util::BlockControl& control = {});
+
 }  // namespace inviwo
@@ -0,0 +1,138 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+#include <modules/visualneuro/algorithm/volume/voxelstatistics.h>
+#include <modules/visualneuro/util/mappedfile.h>
+
+#include <inviwo/core/common/inviwo.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace inviwo {
+
+namespace stats {
+
+/**
+ * \brief Size and modification time of the file a subject was read from. Stored in cohort files
+ * to detect that the volumes changed after the file was written.
+ */
+struct IVW_MODULE_VISUALNEURO_API CohortSourceStamp {
+    std::uint64_t size = 0;
+    std::int64_t modified = 0;
+
+    /*
+     * @throws Exception if the size or modification time of file cannot be read.
+     */
+    static CohortSourceStamp of(const std::filesystem::path& file);
+
+    bool operator==(const CohortSourceStamp& rhs) const {
+        return size == rhs.size && modified == rhs.modified;
+    }
+    bool operator!=(const CohortSourceStamp& rhs) const { return !(*this == rhs); }
+};
+
+/**
+ * \brief Store the values of all subjects in source in a cohort file.
+ * The file contains a header, the values as 32-bit floats stored voxel-major (all subjects of a
+ * voxel are adjacent), the subject names and optionally the stamps of their source files.
+ * Voxel-major storage lets a process read any voxel range of the cohort as one contiguous region,
+ * see CohortFileVoxelSource.
+ * @param subjectNames one name per subject, e.g. the volume filenames
+ * @param sourceStamps none, or one stamp per subject of the file it was read from
+ * @return false if stopped through control, the file is then incomplete.
+ * @throws Exception if the file cannot be written.
+ */
+IVW_MODULE_VISUALNEURO_API bool writeCohortFile(
+    const VoxelSource& source, const std::vector<std::string>& subjectNames,
+    const std::filesystem::path& file, const util::BlockControl& control = {},
+    const std::vector<CohortSourceStamp>& sourceStamps = {});
+
+/**
+ * \brief VoxelSource reading a memory mapped cohort file written by writeCohortFile.
+ * Only the pages of the gathered voxel ranges are loaded, so processes working on different voxel
+ * ranges of a large cohort only need memory for their own range.
+ */
+class IVW_MODULE_VISUALNEURO_API CohortFileVoxelSource : public VoxelSource {
+public:
+    /*
+     * @throws Exception if the file cannot be opened or is not a valid cohort file.
+     */
+    explicit CohortFileVoxelSource(const std::filesystem::path& file);
+
+    virtual size_t getNumberOfSubjects() const override;
+    virtual size3_t getDimensions() const override;
+    virtual size_t getBytesPerVoxel() const override;
+    virtual void gather(size_t firstVoxel, size_t nVoxels, VoxelBlock& block) const override;
+
+    const std::vector<std::string>& getSubjectNames() const;
+    /*
+     * Stamps of the files the subjects were read from, empty if the file does not store them.
+     */
+    const std::vector<CohortSourceStamp>& getSourceStamps() const;
+    const std::filesystem::path& getPath() const;
+
+private:
+    util::MappedFile file_;
+    const float* values_ = nullptr;
+    size3_t dims_{0};
+    size_t nSubjects_ = 0;
+    std::vector<std::string> subjectNames_;
+    std::vector<CohortSourceStamp> sourceStamps_;
+};
+
+/**
+ * \brief VoxelSource exposing a subset of the subjects of another source, e.g. one group of a
+ * t-test. The other source must outlive this object.
+ */
+class IVW_MODULE_VISUALNEURO_API SubjectSubsetVoxelSource : public VoxelSource {
+public:
+    /*
+     * @throws Exception if a subject index is outside of source.
+     */
+    SubjectSubsetVoxelSource(const VoxelSource& source, std::vector<size_t> subjects);
+
+    virtual size_t getNumberOfSubjects() const override;
+    virtual size3_t getDimensions() const override;
+    virtual size_t getBytesPerVoxel() const override;
+    virtual void gather(size_t firstVoxel, size_t nVoxels, VoxelBlock& block) const override;
+
+private:
+    const VoxelSource& source_;
+    std::vector<size_t> subjects_;
+};
+
+}  // namespace stats
+
+}  // namespace inviwo
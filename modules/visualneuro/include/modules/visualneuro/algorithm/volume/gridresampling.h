@@ -0,0 +1,77 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+#include <modules/visualneuro/util/parallelforblocks.h>
+
+#include <inviwo/core/common/inviwo.h>
+#include <inviwo/core/datastructures/volume/volume.h>
+#include <inviwo/core/datastructures/volume/volumeram.h>
+#include <inviwo/core/util/indexmapper.h>
+
+namespace inviwo {
+
+namespace util {
+
+/**
+ * \brief Resample source into the voxel grid of reference through world coordinates, e.g. an
+ * atlas or a mask into the grid of a cohort. Calls callback(voxel, value) in parallel for each
+ * linear voxel index of reference inside source, with the typed value of the source voxel at its
+ * world position. Voxels outside of source are skipped.
+ */
+template <typename Callback>
+void forEachResampledVoxel(const Volume& source, const Volume& reference, Callback callback) {
+    const auto dims = reference.getDimensions();
+    const ivec3 sourceDims(source.getDimensions());
+    const mat4 toSourceIndex = source.getCoordinateTransformer().getWorldToIndexMatrix() *
+                               reference.getCoordinateTransformer().getIndexToWorldMatrix();
+
+    source.getRepresentation<VolumeRAM>()->dispatch<void, dispatching::filter::Scalars>(
+        [&](auto vr) {
+            const auto data = vr->getDataTyped();
+            const util::IndexMapper3D referenceIndex(dims);
+            const util::IndexMapper3D sourceIndex(source.getDimensions());
+            util::parallelForBlocks(
+                glm::compMul(dims), size_t{1} << 16, [&](size_t, size_t first, size_t last) {
+                    for (size_t i = first; i < last; ++i) {
+                        const ivec3 pos(toSourceIndex * vec4(vec3(referenceIndex(i)), 1.0f));
+                        if (glm::all(glm::greaterThanEqual(pos, ivec3(0))) &&
+                            glm::all(glm::lessThan(pos, sourceDims))) {
+                            callback(i, data[sourceIndex(size3_t(pos))]);
+                        }
+                    }
+                });
+        });
+}
+
+}  // namespace util
+
+}  // namespace inviwo
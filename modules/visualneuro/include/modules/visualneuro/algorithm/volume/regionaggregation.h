@@ -0,0 +1,142 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+#include <modules/visualneuro/algorithm/volume/voxelstatistics.h>
+
+#include <inviwo/core/common/inviwo.h>
+#include <inviwo/core/datastructures/volume/volume.h>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace inviwo {
+
+class AtlasVoxelIndex;
+
+namespace stats {
+
+/**
+ * \brief Region of each voxel of a reference grid, with atlas labels mapped to dense region
+ * indices. Label 0 is treated as background and is not a region.
+ */
+struct IVW_MODULE_VISUALNEURO_API RegionLookup {
+    size3_t dims{0};
+    // Atlas label of each region, ascending
+    std::vector<int> labels;
+    // Number of voxels of each region
+    std::vector<size_t> voxels;
+    // Region index of each voxel, -1 for background and voxels outside of the atlas
+    std::vector<std::int32_t> voxelRegion;
+    // Position of each voxel among the voxels of its region, in voxel order
+    std::vector<std::uint32_t> voxelRank;
+};
+
+/**
+ * \brief Region lookup of the labels of index, in the voxel grid of the index.
+ */
+IVW_MODULE_VISUALNEURO_API RegionLookup regionLookup(const AtlasVoxelIndex& index);
+
+/**
+ * \brief Resample the labels of atlas into the voxel grid of reference through world coordinates,
+ * see AtlasVoxelIndex::resampled.
+ * @throws Exception if the labels span more than stats::maxDenseLabelRange values
+ */
+IVW_MODULE_VISUALNEURO_API RegionLookup atlasRegionLookup(const Volume& atlas,
+                                                          const Volume& reference);
+
+/**
+ * \brief Per subject and region aggregates of a cohort.
+ * Values are stored subject-major, the value of region r for subject s is at
+ * s * labels.size() + r.
+ */
+struct IVW_MODULE_VISUALNEURO_API RegionAggregates {
+    std::vector<int> labels;
+    std::vector<size_t> voxels;
+    size_t subjects = 0;
+    std::vector<double> means;
+    // Empty if medians were not requested
+    std::vector<double> medians;
+
+    double mean(size_t subject, size_t region) const {
+        return means[subject * labels.size() + region];
+    }
+    double median(size_t subject, size_t region) const {
+        return medians[subject * labels.size() + region];
+    }
+};
+
+/**
+ * \brief Mean, and optionally median, of the voxels of each region for every subject, computed
+ * in one parallel pass over the voxels. Regions without voxels get NaN.
+ * Medians are exact and require one float per region voxel and subject.
+ * @return the aggregates or std::nullopt if stopped through control
+ * @throws Exception if the dimensions of source and lookup differ
+ */
+IVW_MODULE_VISUALNEURO_API std::optional<RegionAggregates> aggregateRegions(
+    const VoxelSource& source, const RegionLookup& lookup, bool medians,
+    const util::BlockControl& control = {});
+
+/**
+ * \brief Summary of a scalar map, e.g. a t or correlation map, within each region.
+ * NaN voxels are skipped. Regions without finite values get NaN mean and peak value.
+ */
+struct IVW_MODULE_VISUALNEURO_API ZonalStatistics {
+    std::vector<int> labels;
+    // Number of voxels of each region
+    std::vector<size_t> voxels;
+    std::vector<double> means;
+    std::vector<double> maxima;
+    // Fraction of the region voxels with an absolute value above the significance threshold
+    std::vector<double> significantFractions;
+    // Value and voxel position of the largest absolute value, the lowest voxel index on ties
+    std::vector<double> peakValues;
+    std::vector<size3_t> peaks;
+};
+
+/**
+ * \brief Zonal statistics of map in one parallel pass over the voxels, reduced per worker.
+ * Voxel values are mapped to the value range of map.dataMap before they are aggregated.
+ * @param significanceThreshold voxels with absolute value above the threshold are significant,
+ * in the value domain.
+ * The default counts all non-zero voxels, which matches maps where voxels with p-values above
+ * the significance level are set to zero.
+ * @return the statistics or std::nullopt if stopped through control
+ * @throws Exception if the dimensions of map and lookup differ
+ */
+IVW_MODULE_VISUALNEURO_API std::optional<ZonalStatistics> zonalStatistics(
+    const Volume& map, const RegionLookup& lookup, double significanceThreshold = 0.0,
+    const util::BlockControl& control = {});
+
+}  // namespace stats
+
+}  // namespace inviwo
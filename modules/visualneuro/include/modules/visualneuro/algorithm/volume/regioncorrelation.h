@@ -0,0 +1,137 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+#include <modules/visualneuro/algorithm/dataframe/parametermatrix.h>
+#include <modules/visualneuro/algorithm/volume/voxelstatistics.h>
+
+#include <inviwo/core/common/inviwo.h>
+#include <inviwo/core/datastructures/volume/volume.h>
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+namespace inviwo {
+
+namespace stats {
+
+/**
+ * \brief Resample the labels of atlas into the voxel grid of reference through world coordinates.
+ * @param isSelected called with the label of each voxel
+ * @return one value per voxel of reference, 1 if the voxel is inside the atlas and its label is
+ * selected, 0 otherwise.
+ */
+IVW_MODULE_VISUALNEURO_API std::vector<unsigned char> atlasRegionsToGrid(
+    const Volume& atlas, const Volume& reference, const std::function<bool(int)>& isSelected);
+
+/**
+ * \brief Significant correlations between each parameter and each voxel inside the regions.
+ * Parameters missing the same subjects are correlated together, so the voxel values are
+ * standardized, or ranked, once per missingness pattern, see ParameterMatrix::groupByValidity.
+ * @param parameters one value per subject in source for each parameter. Subjects without a
+ * valid value are excluded from the correlations of that parameter.
+ * @param regionMask one value per voxel, voxels with 0 are skipped, see atlasRegionsToGrid
+ * @return the correlations with p-value below settings.pValue for each parameter, sorted in
+ * ascending order, or std::nullopt if stopped through control.
+ */
+IVW_MODULE_VISUALNEURO_API std::optional<std::vector<std::vector<double>>>
+regionParameterCorrelations(const VoxelSource& source,
+                            const dataframe::ParameterMatrix& parameters,
+                            const std::vector<unsigned char>& regionMask,
+                            const CorrelationSettings& settings,
+                            const util::BlockControl& control = {});
+
+/**
+ * \brief See regionParameterCorrelations above, with one vector per parameter.
+ */
+IVW_MODULE_VISUALNEURO_API std::optional<std::vector<std::vector<double>>>
+regionParameterCorrelations(const VoxelSource& source,
+                            const std::vector<std::vector<double>>& parameters,
+                            const std::vector<unsigned char>& regionMask,
+                            const CorrelationSettings& settings,
+                            const util::BlockControl& control = {});
+
+/**
+ * \brief Significant correlations between each parameter and each of the listed voxels.
+ * Only the listed voxels are read, so the cost is proportional to the size of the regions rather
+ * than the volume. The work is split over chunks of voxels and, for small regions, over the
+ * parameters as well. Parameters are grouped by missingness pattern as above.
+ * @param parameters one value per subject in source for each parameter. Subjects without a
+ * valid value are excluded from the correlations of that parameter.
+ * @param voxels sorted linear voxel indices, see AtlasVoxelIndex::selectVoxels
+ * @return the correlations with p-value below settings.pValue for each parameter, sorted in
+ * ascending order, or std::nullopt if stopped through control.
+ */
+IVW_MODULE_VISUALNEURO_API std::optional<std::vector<std::vector<double>>>
+regionParameterCorrelations(const VoxelSource& source,
+                            const dataframe::ParameterMatrix& parameters,
+                            const std::vector<std::uint32_t>& voxels,
+                            const CorrelationSettings& settings,
+                            const util::BlockControl& control = {});
+
+/**
+ * \brief See regionParameterCorrelations above, with one vector per parameter.
+ */
+IVW_MODULE_VISUALNEURO_API std::optional<std::vector<std::vector<double>>>
+regionParameterCorrelations(const VoxelSource& source,
+                            const std::vector<std::vector<double>>& parameters,
+                            const std::vector<std::uint32_t>& voxels,
+                            const CorrelationSettings& settings,
+                            const util::BlockControl& control = {});
+
+struct IVW_MODULE_VISUALNEURO_API CorrelationQuantiles {
+    double min;
+    double firstQuartile;
+    double median;
+    double thirdQuartile;
+    double max;
+};
+
+/**
+ * \brief Quantiles of sorted correlation values, all NaN if there are no values.
+ */
+IVW_MODULE_VISUALNEURO_API CorrelationQuantiles
+correlationQuantiles(const std::vector<double>& sorted);
+
+/**
+ * \brief Quantiles of the union of several sorted runs of correlation values, e.g. the cached
+ * correlations of each selected region. Equal to correlationQuantiles of the merged and sorted
+ * runs, but each quantile is selected by binary searches in the runs instead of merging them.
+ * All NaN if there are no values.
+ */
+IVW_MODULE_VISUALNEURO_API CorrelationQuantiles
+correlationQuantiles(const std::vector<const std::vector<double>*>& sortedRuns);
+
+}  // namespace stats
+
+}  // namespace inviwo
@@ -0,0 +1,272 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+#include <modules/visualneuro/algorithm/dataframe/parametermatrix.h>
+#include <modules/visualneuro/statistics/correlation.h>
+#include <modules/visualneuro/statistics/ttest.h>
+#include <modules/visualneuro/util/parallelforblocks.h>
+#include <modules/visualneuro/util/volumememoryaccountant.h>
+
+#include <inviwo/core/common/inviwo.h>
+#include <inviwo/core/datastructures/volume/volume.h>
+
+#include <memory>
+#include <vector>
+
+namespace inviwo {
+class VolumeRAM;
+
+namespace stats {
+
+/**
+ * \brief Values of all subjects for a contiguous range of voxels.
+ * Stored voxel-major, i.e. the values of all subjects of one voxel are adjacent in memory, so
+ * that the per-voxel kernels read contiguous data.
+ */
+class IVW_MODULE_VISUALNEURO_API VoxelBlock {
+public:
+    void resize(size_t firstVoxel, size_t nVoxels, size_t nSubjects);
+
+    size_t getFirstVoxel() const { return firstVoxel_; }
+    size_t getNumberOfVoxels() const { return nVoxels_; }
+    size_t getNumberOfSubjects() const { return nSubjects_; }
+
+    /*
+     * Values of all subjects for voxel getFirstVoxel() + i.
+     */
+    const double* voxel(size_t i) const { return values_.data() + i * nSubjects_; }
+    double* voxel(size_t i) { return values_.data() + i * nSubjects_; }
+
+private:
+    size_t firstVoxel_ = 0;
+    size_t nVoxels_ = 0;
+    size_t nSubjects_ = 0;
+    std::vector<double> values_;
+};
+
+/**
+ * \brief Voxel values of a cohort of equally sized volumes, one volume per subject.
+ * Values are returned in the value domain, i.e. with the DataMapper of each subject applied.
+ */
+class IVW_MODULE_VISUALNEURO_API VoxelSource {
+public:
+    virtual ~VoxelSource() = default;
+
+    virtual size_t getNumberOfSubjects() const = 0;
+    virtual size3_t getDimensions() const = 0;
+    size_t getNumberOfVoxels() const;
+    /*
+     * Bytes read from the underlying data when gathering one voxel of all subjects.
+     */
+    virtual size_t getBytesPerVoxel() const = 0;
+    /*
+     * Fill block with the values of voxels [firstVoxel, firstVoxel + nVoxels) of all subjects.
+     */
+    virtual void gather(size_t firstVoxel, size_t nVoxels, VoxelBlock& block) const = 0;
+};
+
+/**
+ * \brief VoxelSource reading the RAM representations of the volumes in a VolumeSequence.
+ * \pre All volumes have the same dimensions, otherwise an inviwo::Exception is thrown.
+ */
+class IVW_MODULE_VISUALNEURO_API VolumeSequenceVoxelSource : public VoxelSource {
+public:
+    explicit VolumeSequenceVoxelSource(const VolumeSequence& volumes);
+
+    virtual size_t getNumberOfSubjects() const override;
+    virtual size3_t getDimensions() const override;
+    virtual size_t getBytesPerVoxel() const override;
+    virtual void gather(size_t firstVoxel, size_t nVoxels, VoxelBlock& block) const override;
+
+private:
+    std::vector<std::shared_ptr<const Volume>> volumes_;
+    // Keeps volumeRAMs_ from being evicted by util::VolumeMemoryAccountant
+    util::VolumeMemoryAccountant::Pin pin_;
+    std::vector<const VolumeRAM*> volumeRAMs_;
+    // Linear data to value mapping, value = scale * data + offset
+    std::vector<dvec2> scaleOffset_;
+    size3_t dims_{0};
+    size_t bytesPerVoxel_ = 0;
+};
+
+struct IVW_MODULE_VISUALNEURO_API TTestSettings {
+    EqualVariance equalVariance = EqualVariance::No;
+    TailTest tail = TailTest::Both;
+    double pValue = 0.05;
+};
+
+struct IVW_MODULE_VISUALNEURO_API CorrelationSettings {
+    CorrelationMethod method = CorrelationMethod::Spearman;
+    TailTest tail = TailTest::Both;
+    double pValue = 0.05;
+};
+
+/**
+ * \brief Gather a block from source and add the time and bytes read to the metrics of control.
+ */
+IVW_MODULE_VISUALNEURO_API void gatherBlock(const VoxelSource& source, size_t firstVoxel,
+                                            size_t nVoxels, VoxelBlock& block,
+                                            const util::BlockControl& control);
+
+/**
+ * \brief Mean over all subjects for voxels [firstVoxel, firstVoxel + nVoxels).
+ * @param out receives nVoxels values
+ * @return false if stopped through control
+ */
+IVW_MODULE_VISUALNEURO_API bool computeMean(const VoxelSource& source, size_t firstVoxel,
+                                            size_t nVoxels, float* out,
+                                            const util::BlockControl& control = {});
+
+/**
+ * \brief t-test between two groups for voxels [firstVoxel, firstVoxel + nVoxels).
+ * The t-value is written where the test is significant according to settings, 0 otherwise.
+ * @param out receives nVoxels values
+ * @return false if stopped through control
+ */
+IVW_MODULE_VISUALNEURO_API bool computeTTest(const VoxelSource& groupA, const VoxelSource& groupB,
+                                             const TTestSettings& settings, size_t firstVoxel,
+                                             size_t nVoxels, float* out,
+                                             const util::BlockControl& control = {});
+
+/**
+ * \brief Correlation between a parameter and voxels [firstVoxel, firstVoxel + nVoxels).
+ * The correlation is written where it is significant according to settings, 0 otherwise.
+ * @param parameter one value per subject in source. Subjects with NaN values are excluded.
+ * @param mask optional, one value per voxel in the whole volume. Voxels with 0 are skipped.
+ * @param out receives nVoxels values
+ * @return false if stopped through control
+ */
+IVW_MODULE_VISUALNEURO_API bool computeCorrelation(const VoxelSource& source,
+                                                   const std::vector<double>& parameter,
+                                                   const CorrelationSettings& settings,
+                                                   const std::vector<unsigned char>* mask,
+                                                   size_t firstVoxel, size_t nVoxels, float* out,
+                                                   const util::BlockControl& control = {});
+
+/**
+ * \brief Correlation between parameter of parameters and voxels [firstVoxel, firstVoxel + nVoxels),
+ * see computeCorrelation above. Subjects without a valid value are excluded.
+ */
+IVW_MODULE_VISUALNEURO_API bool computeCorrelation(const VoxelSource& source,
+                                                   const dataframe::ParameterMatrix& parameters,
+                                                   size_t parameter,
+                                                   const CorrelationSettings& settings,
+                                                   const std::vector<unsigned char>* mask,
+                                                   size_t firstVoxel, size_t nVoxels, float* out,
+                                                   const util::BlockControl& control = {});
+
+/**
+ * \brief Resample mask into the voxel grid of reference through world coordinates.
+ * @return one value per voxel of reference, 1 where mask is non-zero and 0 otherwise.
+ */
+IVW_MODULE_VISUALNEURO_API std::vector<unsigned char> maskToGrid(const Volume& mask,
+                                                                 const Volume& reference);
+
+/**
+ * \brief Average of the value ranges of volumes, the range of their voxel-wise mean.
+ */
+IVW_MODULE_VISUALNEURO_API dvec2 meanValueRange(const VolumeSequence& volumes);
+
+/**
+ * \brief Voxel-wise mean of a volume sequence.
+ * Data and value range of the result are the average of the input ranges, see meanValueRange.
+ * @return result in float precision or nullptr if stopped.
+ */
+IVW_MODULE_VISUALNEURO_API std::shared_ptr<Volume> volumeSequenceMean(
+    const VolumeSequence& volumes, const util::BlockControl& control = {});
+
+/**
+ * \brief Voxel-wise sum of a changing set of volumes. Volumes are added and removed
+ * individually, so updating the mean after a change of the cohort reads only the changed volumes.
+ */
+class IVW_MODULE_VISUALNEURO_API VoxelSum {
+public:
+    /*
+     * Add the volumes in added and subtract the volumes in removed, which must have been added
+     * before. The sum is cleared if stopped, since it is then only partially updated.
+     * @return false if stopped through control
+     * @throws Exception if the dimensions differ from the earlier volumes or more volumes are
+     * removed than were added
+     */
+    bool update(const VolumeSequence& added, const VolumeSequence& removed,
+                const util::BlockControl& control = {});
+    void clear();
+
+    size_t getNumberOfSubjects() const;
+    size3_t getDimensions() const;
+    /*
+     * Voxel-wise mean of the summed volumes with the average value range of the volumes, zero if
+     * all volumes were removed.
+     * @return result in float precision or nullptr if no volume was added since the last clear
+     */
+    std::shared_ptr<Volume> mean() const;
+
+private:
+    size3_t dims_{0};
+    std::vector<double> sums_;
+    size_t nSubjects_ = 0;
+    dvec2 valueRangeSum_{0.0};
+    // Basis and offset of the result
+    std::shared_ptr<const Volume> reference_;
+};
+
+/**
+ * \brief Voxel-wise t-test between two volume sequences, see computeTTest.
+ * @return result in float precision or nullptr if stopped.
+ */
+IVW_MODULE_VISUALNEURO_API std::shared_ptr<Volume> volumeTTest(
+    const VolumeSequence& groupA, const VolumeSequence& groupB, const TTestSettings& settings,
+    const util::BlockControl& control = {});
+
+/**
+ * \brief Voxel-wise correlation between a parameter and a volume sequence, see
+ * computeCorrelation.
+ * @param mask optional, voxels where the mask is zero are set to 0.
+ * @return result in float precision with range [-1 1] or nullptr if stopped.
+ */
+IVW_MODULE_VISUALNEURO_API std::shared_ptr<Volume> parameterVolumeCorrelation(
+    const VolumeSequence& volumes, const std::vector<double>& parameter,
+    const CorrelationSettings& settings, const Volume* mask = nullptr,
+    const util::BlockControl& control = {});
+
+/**
+ * \brief Voxel-wise correlation between parameter of parameters and a volume sequence, with one
+ * subject per volume, see parameterVolumeCorrelation above.
+ */
+IVW_MODULE_VISUALNEURO_API std::shared_ptr<Volume> parameterVolumeCorrelation(
+    const VolumeSequence& volumes, const dataframe::ParameterMatrix& parameters, size_t parameter,
+    const CorrelationSettings& settings, const Volume* mask = nullptr,
+    const util::BlockControl& control = {});
+
+}  // namespace stats
+
+}  // namespace inviwo
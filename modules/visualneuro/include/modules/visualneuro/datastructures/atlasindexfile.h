@@ -0,0 +1,106 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+#include <modules/visualneuro/algorithm/volume/atlaslabelstatistics.h>
+#include <modules/visualneuro/datastructures/atlasvoxelindex.h>
+
+#include <inviwo/core/common/inviwo.h>
+#include <inviwo/core/datastructures/volume/volume.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+
+namespace inviwo {
+
+/**
+ * \brief Structures derived from an atlas volume in its own voxel grid, shared by VolumeAtlas,
+ * VolumeAtlasCenterPositions and the region statistics.
+ */
+struct IVW_MODULE_VISUALNEURO_API PrecomputedAtlas {
+    stats::AtlasLabelStatistics statistics;
+    AtlasVoxelIndex voxelIndex;
+};
+
+namespace util {
+
+/**
+ * \brief Sidecar index file of an atlas file, the atlas path with ".vnidx" appended, e.g.
+ * atlas116.nii.vnidx.
+ */
+IVW_MODULE_VISUALNEURO_API std::filesystem::path atlasIndexPath(
+    const std::filesystem::path& atlasFile);
+
+/**
+ * \brief 64-bit FNV-1a hash of the contents of file, used to detect changed atlas files.
+ * @throws Exception if the file cannot be read
+ */
+IVW_MODULE_VISUALNEURO_API std::uint64_t hashFile(const std::filesystem::path& file);
+
+/**
+ * \brief Write the label statistics and voxel index of an atlas to an index file.
+ * The file starts with a versioned header holding sourceHash, followed by the label statistics
+ * table, the labels and offsets of the voxel index and its voxels. The file is written to a
+ * uniquely named temporary file first and then renamed, so readers never see a partially written
+ * file and concurrent writers do not interfere.
+ * @throws Exception if the file cannot be written
+ */
+IVW_MODULE_VISUALNEURO_API void writeAtlasIndexFile(const std::filesystem::path& file,
+                                                    std::uint64_t sourceHash,
+                                                    const PrecomputedAtlas& atlas);
+
+/**
+ * \brief Read an index file written by writeAtlasIndexFile. The file is memory mapped and the
+ * voxels of the voxel index are used in place, only the small label tables are copied.
+ * @return the structures, or std::nullopt if the file does not exist, has another version, was
+ * written for a file with another hash, is truncated or indexes voxels outside the volume.
+ */
+IVW_MODULE_VISUALNEURO_API std::optional<PrecomputedAtlas> readAtlasIndexFile(
+    const std::filesystem::path& file, std::uint64_t sourceHash);
+
+/**
+ * \brief Label statistics and voxel index of atlas.
+ * If the atlas was read from a file and not edited since, the sidecar index file is used when it
+ * matches the hash of the atlas file. The file is only hashed again when its size or modification
+ * time changed. Otherwise the structures are computed and the sidecar is written for the next
+ * time. Failing to write the sidecar is not an error and is logged once per sidecar. Atlases read
+ * from the same file share the structures while they are in use.
+ * @return the structures or nullptr if stopped through control
+ * @throws Exception if the labels span more than stats::maxDenseLabelRange values
+ */
+IVW_MODULE_VISUALNEURO_API std::shared_ptr<const PrecomputedAtlas> precomputedAtlas(
+    const Volume& atlas, const BlockControl& control = {});
+
+}  // namespace util
+
+}  // namespace inviwo
@@ -0,0 +1,134 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+
+#include <inviwo/core/common/inviwo.h>
+#include <inviwo/core/datastructures/volume/volume.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace inviwo {
+
+/**
+ * \brief Inverted index from atlas label to the voxels with that label, stored in compressed
+ * sparse row form: one offset per label into a flat array of linear voxel indices.
+ *
+ * The voxels of each label are sorted in ascending order. Iterating the voxels of a set of labels
+ * costs time proportional to the number of voxels in those labels instead of the whole volume.
+ * The index can be built for the grid of the atlas itself or for the grid of another volume, in
+ * which case the atlas is resampled through world coordinates and voxels outside of the atlas are
+ * not indexed.
+ */
+class IVW_MODULE_VISUALNEURO_API AtlasVoxelIndex {
+public:
+    /**
+     * \brief Linear voxel indices of one label.
+     */
+    struct VoxelRange {
+        const std::uint32_t* first = nullptr;
+        const std::uint32_t* last = nullptr;
+
+        const std::uint32_t* begin() const { return first; }
+        const std::uint32_t* end() const { return last; }
+        size_t size() const { return static_cast<size_t>(last - first); }
+        bool empty() const { return first == last; }
+    };
+
+    AtlasVoxelIndex() = default;
+    /*
+     * Index the voxels of atlas in its own grid. Voxel values are truncated to int.
+     * @throws Exception if the labels span more than stats::maxDenseLabelRange values or the
+     * atlas has more than 2^32 voxels.
+     */
+    explicit AtlasVoxelIndex(const Volume& atlas);
+    /*
+     * Index the voxels of reference by the label of the atlas at their world position.
+     * @throws Exception if the labels span more than stats::maxDenseLabelRange values or
+     * reference has more than 2^32 voxels.
+     */
+    static AtlasVoxelIndex resampled(const Volume& atlas, const Volume& reference);
+    /*
+     * Index from its serialized parts, see getLabels, getOffsets and getVoxelData. voxels may
+     * point into memory owned by another object, e.g. a memory mapped file, through the aliasing
+     * constructor of std::shared_ptr. It is shared by all copies of the index.
+     * @throws Exception if the labels are not ascending or the offsets are inconsistent
+     */
+    AtlasVoxelIndex(size3_t dims, std::vector<int> labels, std::vector<size_t> offsets,
+                    std::shared_ptr<const std::uint32_t> voxels);
+
+    size3_t getDimensions() const;
+    /*
+     * Labels with at least one voxel, in ascending order.
+     */
+    const std::vector<int>& getLabels() const;
+    size_t getNumberOfVoxels(int label) const;
+    /*
+     * @return sorted linear voxel indices of label, empty if no voxel has the label
+     */
+    VoxelRange getVoxels(int label) const;
+    /*
+     * Call callback(label, voxelIndex) for all voxels of labels, label by label.
+     */
+    void forEachVoxel(const std::vector<int>& labels,
+                      const std::function<void(int, size_t)>& callback) const;
+    /*
+     * Linear voxel indices of all labels for which isSelected returns true, in ascending order.
+     */
+    std::vector<std::uint32_t> selectVoxels(const std::function<bool(int)>& isSelected) const;
+
+    /*
+     * Voxels of getLabels()[i] are getVoxelData()[offsets[i]] to getVoxelData()[offsets[i + 1]].
+     */
+    const std::vector<size_t>& getOffsets() const;
+    const std::uint32_t* getVoxelData() const;
+
+private:
+    AtlasVoxelIndex(size3_t dims, const std::vector<std::int32_t>& voxelLabels);
+    void updateLabelPositions();
+    // Position of label in labels_, or -1
+    std::int32_t findLabel(int label) const;
+
+    size3_t dims_{0};
+    std::vector<int> labels_;
+    // Voxels of labels_[i] are voxels_[offsets_[i]] to voxels_[offsets_[i + 1]]
+    std::vector<size_t> offsets_;
+    // Immutable and shared between copies
+    std::shared_ptr<const std::uint32_t> voxels_;
+    // Position in labels_ of label firstLabel_ + i, -1 for labels without voxels
+    int firstLabel_ = 0;
+    std::vector<std::int32_t> labelPosition_;
+};
+
+}  // namespace inviwo
@@ -0,0 +1,122 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+
+#include <inviwo/core/common/inviwo.h>
+#include <inviwo/core/datastructures/image/layer.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace inviwo {
+
+/**
+ * \brief Dense table of RGBA colors indexed by atlas label id, replacing transfer function
+ * control points for coloring atlas regions.
+ *
+ * Entry i holds the color of label i. Labels outside of the table are transparent. Changed
+ * entries are recorded as dirty ranges so that a renderer only has to upload what changed, e.g.
+ * two entries when the hovered region changes.
+ *
+ * The colors are stored in a layer of layerWidth columns and as many rows as needed, label i at
+ * (i % layerWidth, i / layerWidth). The shader recovers the label by rounding the voxel value
+ * in data units and fetches the texel, see brainraycaster.frag.
+ */
+class IVW_MODULE_VISUALNEURO_API LabelColorLUT {
+public:
+    /**
+     * \brief Half-open range [first, last) of table entries.
+     */
+    struct Range {
+        size_t first = 0;
+        size_t last = 0;
+        bool operator==(const Range& rhs) const {
+            return first == rhs.first && last == rhs.last;
+        }
+    };
+    static constexpr size_t layerWidth = 1024;
+
+    LabelColorLUT() = default;
+    /*
+     * Transparent table for the labels 0 to maxLabel. All entries are dirty.
+     * @throws Exception if maxLabel is negative or exceeds stats::maxDenseLabelRange
+     */
+    explicit LabelColorLUT(int maxLabel);
+
+    size_t size() const;
+    bool contains(int label) const;
+    /*
+     * @return color of label, transparent if label is outside of the table
+     */
+    const vec4& getColor(int label) const;
+    /*
+     * Set the color of label and mark it as dirty if the color changed. Labels outside of the
+     * table are ignored.
+     * @return true if the color changed
+     */
+    bool setColor(int label, const vec4& color);
+    const std::vector<vec4>& getColors() const;
+
+    /*
+     * CPU equivalent of the shader lookup: rounds value, in data units, to the nearest label.
+     */
+    const vec4& sample(double value) const;
+
+    /*
+     * Sorted, non-overlapping and non-adjacent ranges of entries changed since clearDirty().
+     */
+    const std::vector<Range>& getDirtyRanges() const;
+    bool isDirty() const;
+    void clearDirty();
+    /*
+     * Call callback for each dirty range split into rows of the layer.
+     * @param callback receives the layer position of the first texel, the number of texels and
+     * their colors
+     */
+    void forEachDirtyRow(
+        const std::function<void(size2_t pos, size_t count, const vec4* colors)>& callback) const;
+
+    size2_t getLayerDimensions() const;
+    /*
+     * Layer with a RAM representation of format DataVec4Float32 holding the whole table.
+     */
+    std::shared_ptr<Layer> createLayer() const;
+
+private:
+    void markDirty(size_t first, size_t last);
+
+    std::vector<vec4> colors_;
+    std::vector<Range> dirty_;
+};
+
+}  // namespace inviwo
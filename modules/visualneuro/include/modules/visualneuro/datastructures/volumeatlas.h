@@ -29,7 +29,8 @@
 #pragma once
 
 #include <modules/visualneuro/visualneuromoduledefine.h>
-
+#include <modules/visualneuro/algorithm/volume/atlaslabelstatistics.h>
+#include <modules/visualneuro/datastructures/atlasvoxelindex.h>
 
 #include <inviwo/core/datastructures/volume/volume.h>
 #include <inviwo/core/util/glm.h>
@@ -39,6 +40,9 @@
 
 #include <string>
 #include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace inviwo {
 
@@ -46,6 +50,12 @@ namespace inviwo {
  * \brief Labels for each position in a volume
  * Each label has a name and may be associated with a color.
  *
+ * Labels are stored in a dense table indexed by label id and names in a hash map, so all lookups
+ * are O(1). Voxel counts, centroids and center points of all labels and the voxels of each label
+ * are obtained on construction through util::precomputedAtlas. They are read from the sidecar
+ * index of the atlas file when it is valid, otherwise computed in three passes over the atlas, two
+ * parallel ones in stats::computeLabelStatistics and one to build the AtlasVoxelIndex. Atlases
+ * read from the same file share them.
  */
 class IVW_MODULE_VISUALNEURO_API VolumeAtlas {
 public:
@@ -54,7 +64,7 @@ public:
         std::optional<glm::vec4> color;
         bool operator==(std::string label) { return name == label; }
     };
-    using const_iterator = std::map<int, Label>::const_iterator;
+    using const_iterator = std::vector<std::pair<int, Label>>::const_iterator;
     /*
      * Create an AtlasVolume associating indices in the Volume with labels.
      * Each label may optionally have a color, which are assumed to be in column "Color".
@@ -64,7 +74,8 @@ public:
      * contain label indices. Column "Region" will be used as name of the label. If no "Region"
      * column is found the first CategoricalColumn will be used, and if none exist the labels will
      * have empty names. If no column with name "Color" is found the labels will not have colors.
-     * @throws inviwo::Exception if index column could not be found.
+     * @throws inviwo::Exception if index column could not be found or the atlas volume contains
+     * more than stats::maxDenseLabelRange distinct label values.
      */
     VolumeAtlas(std::shared_ptr<const Volume> atlas, std::shared_ptr<const DataFrame> labels);
      /*
@@ -111,16 +122,48 @@ public:
      */
     bool hasColors() const;
 
+    /*
+     * Get world position of the voxel of label closest to the mean position of the label, i.e. a
+     * center point that is inside the region also for non-convex regions.
+     * @return center point, or vec3(0) if no voxel has the label.
+     */
     vec3 getCenterPoint(int label) const;
-
+    /*
+     * Get mean world position of the voxels of label.
+     * @return centroid, or vec3(0) if no voxel has the label.
+     */
+    vec3 getCentroid(int label) const;
+    /*
+     * Get number of voxels of label.
+     */
+    size_t getVoxelCount(int label) const;
+    /*
+     * Get fraction of all atlas voxels that have label.
+     */
+    float getCoverage(int label) const;
+    const stats::AtlasLabelStatistics& getLabelStatistics() const;
+    /*
+     * Get the voxels of each label in the grid of the atlas volume.
+     */
+    const AtlasVoxelIndex& getVoxelIndex() const;
 
     const_iterator begin() const;
     const_iterator end() const;
 private:
+    const Label* findLabel(int id) const;
+    vec3 indexToWorld(const dvec3& indexPos) const;
+
     std::shared_ptr<const Volume> atlas_;
-    std::map<int, Label> labels_;
-    std::map<int, vec3> centerPoints_;
-    std::map<int, float> coverage_;
+    // Sorted by label id
+    std::vector<std::pair<int, Label>> labels_;
+    // Position in labels_ of label id firstLabelId_ + i, -1 if there is no such label. Empty if
+    // the ids span more than stats::maxDenseLabelRange values, labels_ is searched instead.
+    int firstLabelId_ = 0;
+    std::vector<int> labelIndex_;
+    // First label id of each name
+    std::unordered_map<std::string, int> nameToId_;
+    stats::AtlasLabelStatistics statistics_;
+    AtlasVoxelIndex voxelIndex_;
 };
 
 }  // namespace inviwo
@@ -0,0 +1,101 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+
+#include <inviwo/core/common/inviwo.h>
+#include <inviwo/core/datastructures/bitset.h>
+#include <inviwo/core/datastructures/volume/volume.h>
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+namespace inviwo {
+
+/**
+ * \brief Subset of a volume sequence, given by the parent sequence and a BitSet of the selected
+ * volume indices, without copying the volumes.
+ *
+ * Each selection has a unique version and records which volumes were added and removed since the
+ * previous selection of the same producer. Consumers that computed a result for the previous
+ * version, e.g. a voxel-wise sum, can update it with the changed volumes only. A selection whose
+ * previous version is 0 holds no delta and all selected volumes are reported as added.
+ */
+class IVW_MODULE_VISUALNEURO_API VolumeSequenceSelection {
+public:
+    /*
+     * @param previous earlier selection of the same producer or nullptr. The delta is relative to
+     * previous if it has the same parent.
+     * @throws Exception if selected contains indices outside of parent
+     */
+    VolumeSequenceSelection(std::shared_ptr<const VolumeSequence> parent, BitSet selected,
+                            const VolumeSequenceSelection* previous = nullptr);
+
+    const std::shared_ptr<const VolumeSequence>& getParent() const;
+    /*
+     * Indices into getParent() of the selected volumes.
+     */
+    const BitSet& getSelected() const;
+    size_t size() const;
+    bool empty() const;
+
+    std::uint64_t getVersion() const;
+    /*
+     * Version getAdded() and getRemoved() are relative to, 0 if there is no previous version.
+     */
+    std::uint64_t getPreviousVersion() const;
+    const BitSet& getAdded() const;
+    const BitSet& getRemoved() const;
+
+    /*
+     * Volumes of parent with the given indices, in parent order.
+     */
+    VolumeSequence getVolumes(const BitSet& indices) const;
+    /*
+     * Selected volumes, in parent order.
+     */
+    VolumeSequence getVolumes() const;
+
+    static constexpr std::string_view classIdentifier{"org.inviwo.VolumeSequenceSelection"};
+    static constexpr std::string_view dataName{"VolumeSequenceSelection"};
+    static constexpr uvec3 colorCode{168, 80, 120};
+
+private:
+    std::shared_ptr<const VolumeSequence> parent_;
+    BitSet selected_;
+    std::uint64_t version_;
+    std::uint64_t previousVersion_ = 0;
+    BitSet added_;
+    BitSet removed_;
+};
+
+}  // namespace inviwo
@@ -0,0 +1,211 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+#include <inviwo/core/util/exception.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace inviwo {
+
+namespace stats {
+
+enum class ShardMessageType : std::uint32_t { Job = 1, Result, Error, Shutdown };
+
+// Largest payload of a shard message, headers with larger sizes are treated as corrupt
+constexpr std::uint64_t maxShardMessageSize = std::uint64_t{1} << 32;
+
+/**
+ * \brief Append values to a binary message payload.
+ * Values are stored in native byte order, coordinator and workers are expected to run on the same
+ * architecture.
+ */
+class IVW_MODULE_VISUALNEURO_API ShardMessageWriter {
+public:
+    template <typename T>
+    void write(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const auto begin = reinterpret_cast<const std::byte*>(&value);
+        buffer_.insert(buffer_.end(), begin, begin + sizeof(T));
+    }
+    void write(const std::string& str) {
+        write(static_cast<std::uint64_t>(str.size()));
+        const auto begin = reinterpret_cast<const std::byte*>(str.data());
+        buffer_.insert(buffer_.end(), begin, begin + str.size());
+    }
+    template <typename T>
+    void write(const std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        write(static_cast<std::uint64_t>(values.size()));
+        const auto begin = reinterpret_cast<const std::byte*>(values.data());
+        buffer_.insert(buffer_.end(), begin, begin + values.size() * sizeof(T));
+    }
+
+    const std::vector<std::byte>& buffer() const { return buffer_; }
+    std::vector<std::byte>& buffer() { return buffer_; }
+
+private:
+    std::vector<std::byte> buffer_;
+};
+
+/**
+ * \brief Read values written by ShardMessageWriter, in the same order.
+ * Reading past the end of the payload throws an Exception.
+ */
+class IVW_MODULE_VISUALNEURO_API ShardMessageReader {
+public:
+    explicit ShardMessageReader(const std::vector<std::byte>& buffer) : buffer_{buffer} {}
+
+    template <typename T>
+    T read() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+    std::string readString() {
+        const auto size = static_cast<size_t>(read<std::uint64_t>());
+        const auto data = take(size);
+        return std::string(reinterpret_cast<const char*>(data), size);
+    }
+    template <typename T>
+    std::vector<T> readVector() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const auto size = static_cast<size_t>(read<std::uint64_t>());
+        // Check before allocating, size comes from the network
+        if (size > (buffer_.size() - pos_) / sizeof(T)) throwEndOfMessage();
+        std::vector<T> values(size);
+        std::memcpy(values.data(), take(size * sizeof(T)), size * sizeof(T));
+        return values;
+    }
+
+    bool atEnd() const { return pos_ == buffer_.size(); }
+
+private:
+    [[noreturn]] static void throwEndOfMessage() {
+        throw Exception("Unexpected end of shard message",
+                        IVW_CONTEXT_CUSTOM("ShardMessageReader"));
+    }
+    const std::byte* take(size_t bytes) {
+        if (bytes > buffer_.size() - pos_) throwEndOfMessage();
+        const auto data = buffer_.data() + pos_;
+        pos_ += bytes;
+        return data;
+    }
+
+    const std::vector<std::byte>& buffer_;
+    size_t pos_ = 0;
+};
+
+/**
+ * \brief Message based TCP connection between a shard coordinator and a worker.
+ * Each message is framed by a 16 byte header holding a magic number, the message type and the
+ * payload size. Requires POSIX sockets, constructing a connection throws an Exception on other
+ * platforms.
+ */
+class IVW_MODULE_VISUALNEURO_API ShardConnection {
+public:
+    /*
+     * Connect to a coordinator, address can be a host name or an IPv4 address.
+     * @throws Exception if the connection fails.
+     */
+    static ShardConnection connect(const std::string& address, std::uint16_t port);
+
+    explicit ShardConnection(int socket);
+    ShardConnection(ShardConnection&& rhs) noexcept;
+    ShardConnection& operator=(ShardConnection&& rhs) noexcept;
+    ShardConnection(const ShardConnection&) = delete;
+    ShardConnection& operator=(const ShardConnection&) = delete;
+    ~ShardConnection();
+
+    /*
+     * @throws Exception if the connection is closed or payload is larger than
+     * maxShardMessageSize.
+     */
+    void send(ShardMessageType type, const std::vector<std::byte>& payload = {});
+    /*
+     * Block until a complete message has arrived.
+     * @throws Exception if the connection is closed, the data is not a shard message or its
+     * size exceeds maxShardMessageSize. Nothing is allocated for such sizes.
+     */
+    std::pair<ShardMessageType, std::vector<std::byte>> receive();
+
+    int socket() const { return socket_; }
+
+private:
+    int socket_ = -1;
+};
+
+/**
+ * \brief Wait at most timeout until a message arrives on any of the connections.
+ * @return indices of the connections with pending data. Closed connections are also returned,
+ * receive will then throw.
+ */
+IVW_MODULE_VISUALNEURO_API std::vector<size_t> waitForMessages(
+    const std::vector<const ShardConnection*>& connections, std::chrono::milliseconds timeout);
+
+/**
+ * \brief Listening socket accepting worker connections.
+ */
+class IVW_MODULE_VISUALNEURO_API ShardListener {
+public:
+    /*
+     * Listen on an IPv4 address, e.g. 127.0.0.1 for local workers only or 0.0.0.0 for workers on
+     * other hosts. Port 0 selects a free port, see getPort().
+     * @throws Exception if the socket cannot be bound.
+     */
+    ShardListener(const std::string& address, std::uint16_t port);
+    ShardListener(const ShardListener&) = delete;
+    ShardListener& operator=(const ShardListener&) = delete;
+    ~ShardListener();
+
+    std::uint16_t getPort() const { return port_; }
+    /*
+     * Wait at most timeout for a worker to connect.
+     */
+    std::optional<ShardConnection> accept(std::chrono::milliseconds timeout);
+
+private:
+    int socket_ = -1;
+    std::uint16_t port_ = 0;
+};
+
+}  // namespace stats
+
+}  // namespace inviwo
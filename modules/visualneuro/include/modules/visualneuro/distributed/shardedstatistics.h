@@ -0,0 +1,177 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+#include <modules/visualneuro/algorithm/volume/voxelstatistics.h>
+#include <modules/visualneuro/distributed/shardconnection.h>
+
+#include <inviwo/core/common/inviwo.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace inviwo {
+
+namespace stats {
+
+enum class ShardKernel : std::uint32_t { Mean, TTest, Correlation };
+
+/**
+ * \brief Voxel-wise statistics of a cohort file to compute with several worker processes.
+ * Each worker maps cohortFile, so it must be accessible from all workers under the same path.
+ */
+struct IVW_MODULE_VISUALNEURO_API ShardTask {
+    ShardKernel kernel = ShardKernel::Mean;
+    std::filesystem::path cohortFile;
+    // TTest: subject indices of the two groups in the cohort file
+    std::vector<std::uint64_t> groupA;
+    std::vector<std::uint64_t> groupB;
+    TTestSettings tTest;
+    // Correlation: one value per subject, NaN excludes the subject
+    std::vector<double> parameter;
+    CorrelationSettings correlation;
+    // Correlation: optional, one value per voxel, voxels with 0 are skipped
+    std::vector<unsigned char> mask;
+};
+
+/**
+ * \brief The part of a ShardTask computed by one worker, voxels [firstVoxel, firstVoxel + nVoxels).
+ * Only the mask values of the range are sent.
+ */
+struct IVW_MODULE_VISUALNEURO_API ShardJob {
+    std::uint64_t id = 0;
+    std::uint64_t firstVoxel = 0;
+    std::uint64_t nVoxels = 0;
+    ShardTask task;
+};
+
+IVW_MODULE_VISUALNEURO_API std::vector<std::byte> serialize(const ShardJob& job);
+/*
+ * @throws Exception if the payload is not a valid job.
+ */
+IVW_MODULE_VISUALNEURO_API ShardJob deserializeShardJob(const std::vector<std::byte>& payload);
+
+/**
+ * \brief Compute a job with the voxel statistics kernels, using the application thread pool.
+ * @param cohort the cohort file of the job
+ * @return one value per voxel of the job
+ */
+IVW_MODULE_VISUALNEURO_API std::vector<float> computeShard(const VoxelSource& cohort,
+                                                           const ShardJob& job);
+
+/**
+ * \brief Distributes the voxel range of a ShardTask over worker processes and stitches their
+ * results.
+ *
+ * Workers connect to the coordinator, either spawned on this machine with spawnWorkers or started
+ * on other hosts with runShardWorker. The voxel range is split into shards, several per worker,
+ * which are handed out as workers finish so that slower workers get fewer shards. Shards of a
+ * worker that disconnects, cannot read its job or exceeds the shard timeout are given to the
+ * remaining workers, and that worker receives no further shards.
+ */
+class IVW_MODULE_VISUALNEURO_API ShardCoordinator {
+public:
+    /*
+     * Listen for workers on address:port, see ShardListener.
+     */
+    explicit ShardCoordinator(const std::string& address = "127.0.0.1", std::uint16_t port = 0);
+    ShardCoordinator(const ShardCoordinator&) = delete;
+    ShardCoordinator& operator=(const ShardCoordinator&) = delete;
+    /*
+     * Shuts down all connected workers and waits for spawned processes to exit. Processes still
+     * running after 10 s, e.g. stuck in a shard, are killed.
+     */
+    ~ShardCoordinator();
+
+    std::uint16_t getPort() const;
+    /*
+     * Start n processes of executable with args followed by "--connect <address>:<port>".
+     * @throws Exception if a process cannot be started.
+     */
+    void spawnWorkers(const std::filesystem::path& executable, const std::vector<std::string>& args,
+                      size_t n);
+    /*
+     * Wait until n workers are connected.
+     * @throws Exception if fewer workers connected within timeout.
+     */
+    void waitForWorkers(size_t n, std::chrono::milliseconds timeout = std::chrono::seconds{60});
+    size_t getNumberOfWorkers() const;
+
+    /*
+     * Time a worker may take for one shard before it is considered lost, 10 minutes by default.
+     */
+    void setShardTimeout(std::chrono::milliseconds timeout);
+    std::chrono::milliseconds getShardTimeout() const;
+
+    /*
+     * Compute task over all voxels of its cohort file.
+     * @param shardsPerWorker shards per connected worker, more shards give better load balancing
+     * @return one value per voxel or std::nullopt if stopped through control.
+     * @throws Exception if all workers failed or a shard failed on every worker.
+     */
+    std::optional<std::vector<float>> run(const ShardTask& task, size_t shardsPerWorker = 4,
+                                          const util::BlockControl& control = {});
+
+private:
+    std::string address_;
+    ShardListener listener_;
+    std::vector<ShardConnection> workers_;
+    std::vector<int> processes_;  // Ids of spawned worker processes
+    // Job ids start at 1, a worker that cannot read the id of its job replies with 0
+    std::uint64_t nextJobId_ = 1;
+    std::chrono::milliseconds shardTimeout_ = std::chrono::minutes{10};
+};
+
+/**
+ * \brief Connect to a ShardCoordinator and compute jobs until it shuts down.
+ * Cohort files are mapped once and reused for consecutive jobs. Errors while reading or computing
+ * a job are reported to the coordinator together with the job id.
+ * @throws Exception if the connection fails or is lost.
+ */
+IVW_MODULE_VISUALNEURO_API void runShardWorker(const std::string& address, std::uint16_t port);
+
+/**
+ * \brief Create a volume from the stitched result of a task, with the same data map as the
+ * single process functions, e.g. volumeSequenceMean. The geometry is copied from the first volume.
+ * @param volumes the volumes of the cohort file of the task
+ * @throws Exception if volumes is empty or result does not match their dimensions.
+ */
+IVW_MODULE_VISUALNEURO_API std::shared_ptr<Volume> shardResultToVolume(
+    const ShardTask& task, std::vector<float> result, const VolumeSequence& volumes);
+
+}  // namespace stats
+
+}  // namespace inviwo
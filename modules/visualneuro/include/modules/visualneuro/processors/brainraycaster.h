@@ -40,6 +40,8 @@
 #include <inviwo/core/properties/volumeindicatorproperty.h>
 #include <inviwo/core/ports/imageport.h>
 #include <inviwo/core/ports/volumeport.h>
+#include <inviwo/core/ports/datainport.h>
+#include <inviwo/core/datastructures/image/layer.h>
 
 #include <modules/opengl/shader/shader.h>
 
@@ -63,6 +65,8 @@ namespace inviwo {
  * processor)
 *   * __bg__ optional background image. The depth channel is used to terminated the raycasting.
 *   * __atlas__ Brain region atlas.
+*   * __atlasColors__ Brain region atlas label colors, texel i holds the color of label i (see
+*     LabelColorLUT). Used instead of atlasTransferFunction when connected.
 *   * __atlasTransferFunction__ Brain region atlas color map.
 * 
 * ### Outports
@@ -94,6 +98,7 @@ protected:
     ImageInport entryPort_;
     ImageInport exitPort_;
     VolumeInport atlasPort_;
+    DataInport<Layer> atlasColors_;
     DataInport<TransferFunction> atlasTransferFunction_;
     ImageInport backgroundPort_;
     ImageOutport outport_;
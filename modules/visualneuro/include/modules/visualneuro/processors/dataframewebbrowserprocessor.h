@@ -37,6 +37,17 @@
 #include <modules/webbrowser/renderhandlergl.h>
 
 #include <inviwo/dataframe/datastructures/dataframe.h>
+#include <inviwo/core/datastructures/bitset.h>
+#include <modules/brushingandlinking/ports/brushingandlinkingports.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <modules/webbrowser/processors/webbrowserprocessor.h>
 
@@ -47,7 +58,14 @@ namespace inviwo {
  * Display webpage, including transparency, on top of optional background and enable synchronization
  * of properties.
  * Takes DataFrames as input and sends content to webpage as soon as it changes.
- * calls onInviwoDataChanged(data, inportIdentifier)
+ * The data frames are serialized to binary columnar frames on a background thread and fetched
+ * by the page, see util::serializeColumnarFrame and data/ui/scripts/columnarData.js, which is
+ * injected into every loaded page. After the first frame of a port only the changed columns and
+ * appended rows are sent, see util::serializeColumnarDelta, and applied by the script. The page
+ * is notified through onInviwoColumnarDataChanged(frame, port) if defined, otherwise through
+ * onInviwoDataChanged(data, port) with one object per row.
+ * Changes of the filtered and selected rows are sent as index ranges and the page is notified
+ * through onInviwoBrushingChanged(state, delta) if defined.
  *
  * Synchronization from Invwo to web page requires its html element id, i.e.
  * \code{.html}
@@ -73,6 +91,8 @@ namespace inviwo {
  *
  * ### Inports
  *   * __background__ Background to render web page ontop of.
+ *   * __dataFrames__ Data frames sent to the page.
+ *   * __brushing__ Filtered and selected rows sent to the page.
  *
  * ### Outports
  *   * __webpage__ GUI elements rendered by web browser.
@@ -92,7 +112,7 @@ namespace inviwo {
 class IVW_MODULE_VISUALNEURO_API DataFrameWebBrowserProcessor : public WebBrowserProcessor {
 public:
     DataFrameWebBrowserProcessor(InviwoApplication* app);
-    virtual ~DataFrameWebBrowserProcessor() = default;
+    virtual ~DataFrameWebBrowserProcessor();
 
     virtual void process() override;
 
@@ -100,8 +120,58 @@ public:
     static const ProcessorInfo processorInfo_;
 
     DataFrameMultiInport dataFramePort_;
+    BrushingAndLinkingInport brushing_;
+
 private:
+    /*
+     * Serialize dataFrame, or its changes since the previous frame of source if full is false,
+     * in the thread pool and notify the page once the frame can be fetched.
+     */
+    void sendDataFrame(std::shared_ptr<const DataFrame> dataFrame, const Outport& source,
+                       bool full);
+    void sendBrushing();
+    /*
+     * Forget the frames of sources that are no longer connected, so that their data frames are
+     * released.
+     */
+    void pruneSources();
+
     bool reloaded_ = true;
+    // Defines onInviwoColumnarData in the page, the content of data/ui/scripts/columnarData.js
+    std::string columnarScript_;
+
+    // Latest frame dispatched for each source, the base of the next delta
+    struct SentFrame {
+        std::shared_ptr<const DataFrame> frame;
+        std::uint64_t version = 0;
+    };
+    std::unordered_map<std::string, SentFrame> sent_;
+
+    // Brushing state of the page
+    std::uint64_t brushingVersion_ = 0;
+    BitSet sentFiltered_;
+    BitSet sentSelected_;
+
+    // Frames of the inport sources, shared with the serialization jobs. Deltas build on each
+    // other and are published in the order they were dispatched.
+    struct ColumnarTransfer {
+        struct Frame {
+            std::shared_ptr<const std::vector<std::byte>> data;
+            bool full = false;
+        };
+        struct Source {
+            std::deque<std::uint64_t> pending;
+            std::unordered_map<std::uint64_t, Frame> ready;
+            // Published frames that might not have been fetched yet
+            std::vector<std::uint64_t> published;
+            // A frame could not be serialized, the next frame has to be full
+            bool failed = false;
+        };
+        std::mutex mutex;
+        bool alive = true;
+        std::unordered_map<std::string, Source> sources;
+    };
+    std::shared_ptr<ColumnarTransfer> transfer_;
     IMPLEMENT_REFCOUNTING(DataFrameWebBrowserProcessor);
 
 };
@@ -43,9 +43,12 @@
 #include <inviwo/core/properties/ordinalproperty.h>
 #include <inviwo/core/properties/stringproperty.h>
 
+#include <modules/visualneuro/algorithm/dataframe/parametermatrix.h>
 #include <modules/visualneuro/statistics/ttest.h>
 #include <modules/visualneuro/statistics/correlation.h>
 
+#include <memory>
+
 namespace inviwo {
 class VolumeRAM;
 
@@ -58,7 +61,8 @@ class VolumeRAM;
  *
  * If one parameter is missing data for a specific volume, this volume is not included in the
  * correlation calculation, neither is it included if it its corresponding row in the dataframe is
- * brushed away.
+ * brushed away. The parameters are extracted into a dataframe::ParameterMatrix once per data frame
+ * and set of filtered rows, so selecting another parameter only computes the correlation.
  *
  * ### Inports
  *   * __volumes__ Volumes for computing correlation.
@@ -98,6 +102,9 @@ private:
     OptionProperty<stats::CorrelationMethod> correlationMethod_;
     FloatProperty pVal_;
     OptionProperty<stats::TailTest> tailTest_;
+
+    // Parameters of the volumes, extracted when the data frame or the filtered rows change
+    std::shared_ptr<dataframe::ParameterMatrixCache> parameters_;
 };
 
 }  // namespace inviwo
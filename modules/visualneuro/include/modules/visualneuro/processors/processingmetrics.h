@@ -0,0 +1,80 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+#include <inviwo/core/processors/processor.h>
+#include <inviwo/core/ports/dataoutport.h>
+#include <inviwo/core/properties/buttonproperty.h>
+#include <inviwo/core/properties/optionproperty.h>
+#include <inviwo/dataframe/datastructures/dataframe.h>
+
+#include <functional>
+#include <memory>
+
+namespace inviwo {
+
+/** \docpage{org.inviwo.ProcessingMetrics, Processing Metrics}
+ * ![](org.inviwo.ProcessingMetrics.png?classIdentifier=org.inviwo.ProcessingMetrics)
+ *
+ * Outputs the timings recorded by the statistics processors, e.g. Volume T-Test, as a DataFrame.
+ * Each job is split into the phases queue wait, gather, compute, threshold and publish. The
+ * output is updated whenever a job finishes. The memory output lists the RAM and OpenGL
+ * representations tracked by util::VolumeMemoryAccountant for each outport.
+ *
+ * ### Outports
+ *   * __metrics__ One row per processor, job or outport, times are in milliseconds.
+ *
+ * ### Properties
+ *   * __Output__ Summary per processor, the individual jobs or volume memory per outport.
+ *   * __Clear__ Remove all recorded jobs.
+ */
+class IVW_MODULE_VISUALNEURO_API ProcessingMetrics : public Processor {
+public:
+    enum class Output { Summary, Jobs, Memory };
+
+    ProcessingMetrics();
+    virtual ~ProcessingMetrics() = default;
+
+    virtual void process() override;
+
+    virtual const ProcessorInfo getProcessorInfo() const override;
+    static const ProcessorInfo processorInfo_;
+
+private:
+    DataOutport<DataFrame> metrics_;
+
+    OptionProperty<Output> output_;
+    ButtonProperty clear_;
+
+    std::shared_ptr<std::function<void()>> onRecord_;
+};
+
+}  // namespace inviwo
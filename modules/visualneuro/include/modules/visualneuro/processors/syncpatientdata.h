@@ -33,7 +33,9 @@
 #include <modules/visualneuro/visualneuromoduledefine.h>
 #include <inviwo/core/common/inviwo.h>
 #include <inviwo/core/ports/datainport.h>
-#include <inviwo/core/processors/processor.h>
+#include <inviwo/core/ports/dataoutport.h>
+#include <inviwo/core/processors/poolprocessor.h>
+#include <inviwo/core/properties/boolproperty.h>
 #include <inviwo/core/properties/directoryproperty.h>
 #include <inviwo/core/properties/buttonproperty.h>
 #include <inviwo/core/properties/stringproperty.h>
@@ -45,34 +47,31 @@ namespace inviwo {
 /** \docpage{org.inviwo.SyncPatientData, Sync Patient Data}
  * ![](org.inviwo.SyncPatientData.png?classIdentifier=org.inviwo.SyncPatientData)
  *
- *	Synchronizes patient data. Moves volumes that does not have any corresponding data in the
- *	file with patient data to a separate folder and creates a new .csv-file containing only data
- *	that has a corresponding volume. The processor also creates a .csv logfile with all the
- *	volumes that were moved and all the lines that were not included in the new synchronized
- *	.csv-file.
+ * Synchronizes patient data. Moves volumes that does not have any corresponding data in the
+ * file with patient data to a separate folder and creates a new .csv-file containing only data
+ * that has a corresponding volume. The processor also creates a .csv logfile with all the
+ * volumes that were moved and all the lines that were not included in the new synchronized
+ * .csv-file. The folder is scanned, joined and written in the background, see
+ * dataframe::planPatientDataSync.
  *
  * ### Inports
- *   * __mapping__ Dataframe containing a mapping between 2 types of patient id's
- *	 * __patientData__ Dataframe containing patient data
- *	 * __folder__ Folder containting patient volumes
+ *   * __mapping__ Dataframe containing a mapping between 2 types of patient id's, the id of the
+ *     patient data in the first and the id of the volume filenames in the second column
+ *   * __patientData__ Dataframe containing patient data, with the patient id in the first column
  *
  * ### Outports
- *   * __<Outport1>__ <description>.
+ *   * __actions__ The volumes that are moved and the rows that are left out of the new .csv-file.
  *
  * ### Properties
- *   * __sync__ When pressed, moves volumes with no corresponding patient data to a separate folder
- *		and creates a new .csv-file containing only the patient data that has a
- *corresponding volume
- *   * __volumeFileIdKeyword__ Tells the processor after which keyword in the volume filenames that
- *		the patient id comes
+ *   * __Volume folder__ Folder containing patient volumes
+ *   * __Sync patient data__ When pressed, moves volumes with no corresponding patient data to a
+ *     separate folder and creates a new .csv-file containing only the patient data that has a
+ *     corresponding volume
+ *   * __Dry run__ Only compute the actions, without moving or writing any files
+ *   * __Volume file id keyword__ Tells the processor after which keyword in the volume filenames
+ *     that the patient id comes
  */
-
-/**
- * \class SyncPatientData
- * \brief VERY_BRIEFLY_DESCRIBE_THE_PROCESSOR
- * DESCRIBE_THE_PROCESSOR_FROM_A_DEVELOPER_PERSPECTIVE
- */
-class IVW_MODULE_VISUALNEURO_API SyncPatientData : public Processor {
+class IVW_MODULE_VISUALNEURO_API SyncPatientData : public PoolProcessor {
 public:
     SyncPatientData();
     virtual ~SyncPatientData() = default;
@@ -85,17 +84,15 @@ public:
 private:
     DataInport<DataFrame> mapping_;
     DataInport<DataFrame> patientData_;
+    DataOutport<DataFrame> actions_;
 
     DirectoryProperty folder_;
     ButtonProperty sync_;
+    BoolProperty dryRun_;
 
     StringProperty volumeFileIdKeyword_;
 
     bool buttonPressed_ = false;
-
-    // Function for adding filenames and patient id's to a map.
-    void addFilesToMap(std::map<std::string, std::pair<std::string, std::string>> &m,
-                       std::map<std::string, std::string> mapping, std::string directory);
 };
 
 }  // namespace inviwo
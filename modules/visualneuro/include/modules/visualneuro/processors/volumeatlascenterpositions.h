@@ -48,6 +48,8 @@ namespace inviwo {
  *
  * Computes center positions of each label in the input volume.
  * Output is stored in columns "Region position".
+ * The center of a label is the voxel of the label closest to the mean position of its voxels.
+ * Computed in parallel using memory proportional to the number of labels.
  *
  * ### Inports
  *   * __indexedVolume__ Label volume.
@@ -30,8 +30,10 @@
 
 #include <modules/visualneuro/visualneuromoduledefine.h>
 #include <modules/visualneuro/datastructures/volumeatlas.h>
+#include <modules/visualneuro/datastructures/labelcolorlut.h>
 
 #include <inviwo/core/common/inviwo.h>
+#include <inviwo/core/datastructures/image/layer.h>
 #include <inviwo/core/datastructures/volume/volumeram.h>
 #include <inviwo/core/processors/processor.h>
 #include <inviwo/core/properties/boolproperty.h>
@@ -53,8 +55,11 @@ namespace inviwo {
 /** \docpage{org.inviwo.VolumeAtlas, Volume Atlas}
  * ![](org.inviwo.VolumeAtlas.png?classIdentifier=org.inviwo.VolumeAtlas)
  * Combines an indexed voxels and a dataframe with labels for each index.
- * The input volume is forwarded to the outport. A transfer function property is modified to
- * create a peak at the selected index, only showing the voxels with that same index.
+ * The input volume is forwarded to the outport. The color of each label is written to a label
+ * color table, a layer where texel i holds the color of label i, see LabelColorLUT. Only the
+ * entries that change are updated, e.g. two when the hovered region changes. For compatibility,
+ * a transfer function with peaks at the labels is also produced when atlasTF is connected, and
+ * the picking transfer function only when pickingTF is connected.
  *
  *
  * ### Inports
@@ -65,7 +70,8 @@ namespace inviwo {
  *
  * ### Outports
  *   * __outport__ The same volume as was sent to inport.
- *   * __atlasTF__ Transfer function showing selected labels.
+ *   * __labelColors__ Label color table showing selected labels.
+ *   * __atlasTF__ Transfer function showing selected labels. Only computed when connected.
  *
  * ### Properties
  *   * __Result__ Atlas label at Coordinate.
@@ -94,6 +100,19 @@ public:
 
 private:
     void updateTransferFunction();
+    /*
+     * Lay out three control points per label of the atlas TF and two per label of the picking
+     * TF. Only done when the corresponding outport is connected.
+     */
+    void updateLabelControlPoints();
+    void updatePickingTransferFunction();
+    /*
+     * Update the label color table, either all labels or only the previously and currently
+     * hovered ones, and upload the changed entries to labelColorsLayer_.
+     */
+    void updateLabelColors(bool allLabels);
+    vec4 getLabelColor(int labelId) const;
+    void uploadLabelColors();
     void updateBrushing();
     void updateSelectableRegionProperties();
     void handlePicking(PickingEvent*);
@@ -108,6 +127,7 @@ private:
     DataInport<DataFrame> atlasRegionCenterpoints_;
     BrushingAndLinkingInport brushingAndLinking_;
     VolumeOutport outport_;
+    DataOutport<Layer> labelColorsOutport_;
     DataOutport<TransferFunction> atlasTFOutport_;
     DataOutport<TransferFunction> pickingTFOutport_;
 
@@ -140,8 +160,15 @@ private:
     std::unique_ptr<VolumeAtlas> atlas_;
     std::vector<int> pickingToLabelId_;
     std::shared_ptr<TransferFunction> pickingTF_ = std::make_shared<TransferFunction>();
+    // The labels changed since the control points of the transfer functions were laid out
+    bool labelControlPointsDirty_ = false;
+    bool pickingTFDirty_ = false;
 
     int hoverAtlasId_ = -1;
+    // Hovered label when the label colors were last updated
+    int labelColorsHoverId_ = -1;
+    LabelColorLUT labelColors_;
+    std::shared_ptr<Layer> labelColorsLayer_;
 
     bool brushingDirty_ = true;
 };
@@ -0,0 +1,105 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+#include <modules/visualneuro/algorithm/volume/regionaggregation.h>
+#include <inviwo/core/common/inviwo.h>
+#include <inviwo/core/ports/dataoutport.h>
+#include <inviwo/core/ports/volumeport.h>
+#include <inviwo/core/processors/poolprocessor.h>
+#include <inviwo/core/properties/boolproperty.h>
+#include <inviwo/dataframe/datastructures/dataframe.h>
+
+#include <memory>
+
+namespace inviwo {
+
+class VolumeAtlas;
+
+/** \docpage{org.inviwo.VolumeAtlasRegionAggregator, Volume Atlas Region Aggregator}
+ * ![](org.inviwo.VolumeAtlasRegionAggregator.png?classIdentifier=org.inviwo.VolumeAtlasRegionAggregator)
+ *
+ * Computes the mean, and optionally the median, value of each atlas region for every subject in
+ * one parallel pass over the voxels. The atlas is resampled to the grid of the volumes and label 0
+ * is treated as background. The result is kept while the volumes and the atlas are unchanged, so
+ * changing the label names does not recompute it. Region level statistics, e.g. correlations or
+ * t-tests on the region means, only need to process the regions instead of all voxels.
+ *
+ * ### Inports
+ *   * __volumes__ One volume per subject, all with the same dimensions.
+ *   * __atlas__ Region label volume.
+ *   * __labels__ Optional atlas labels with Index and Region columns, used to name the regions.
+ *
+ * ### Outports
+ *   * __means__ One row per subject and one column per region with the region mean. Columns
+ *     of regions that share a name get the label appended, e.g. "Cortex (12)".
+ *   * __medians__ One row per subject and one column per region with the region median, no data
+ *     unless Compute Medians is enabled.
+ *   * __regions__ Label, name and number of voxels of each region.
+ *
+ * ### Properties
+ *   * __Compute Medians__ Medians require storing the region voxels of all subjects as floats,
+ *     off by default.
+ */
+class IVW_MODULE_VISUALNEURO_API VolumeAtlasRegionAggregator : public PoolProcessor {
+public:
+    VolumeAtlasRegionAggregator();
+    virtual ~VolumeAtlasRegionAggregator() = default;
+
+    virtual void process() override;
+
+    virtual const ProcessorInfo getProcessorInfo() const override;
+    static const ProcessorInfo processorInfo_;
+
+private:
+    void publish(const stats::RegionAggregates& aggregates, const VolumeAtlas* names);
+
+    VolumeSequenceInport volumes_;
+    VolumeInport atlas_;
+    DataInport<DataFrame> labels_;
+
+    DataOutport<DataFrame> means_;
+    DataOutport<DataFrame> medians_;
+    DataOutport<DataFrame> regions_;
+
+    BoolProperty computeMedians_;
+
+    // Result of the last computation and the data it was computed from
+    struct Cache {
+        std::weak_ptr<const VolumeSequence> volumes;
+        std::weak_ptr<const Volume> atlas;
+        bool medians = false;
+        std::shared_ptr<const stats::RegionAggregates> aggregates;
+    };
+    Cache cache_;
+};
+
+}  // namespace inviwo
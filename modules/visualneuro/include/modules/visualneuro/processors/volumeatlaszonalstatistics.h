@@ -0,0 +1,102 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+#include <modules/visualneuro/algorithm/volume/regionaggregation.h>
+#include <inviwo/core/common/inviwo.h>
+#include <inviwo/core/ports/dataoutport.h>
+#include <inviwo/core/ports/volumeport.h>
+#include <inviwo/core/processors/poolprocessor.h>
+#include <inviwo/core/properties/ordinalproperty.h>
+#include <inviwo/dataframe/datastructures/dataframe.h>
+
+#include <memory>
+#include <mutex>
+
+namespace inviwo {
+
+/** \docpage{org.inviwo.VolumeAtlasZonalStatistics, Volume Atlas Zonal Statistics}
+ * ![](org.inviwo.VolumeAtlasZonalStatistics.png?classIdentifier=org.inviwo.VolumeAtlasZonalStatistics)
+ *
+ * Summarizes a scalar map, e.g. the output of Volume T-Test or Parameter Volume Sequence
+ * Correlation, within each atlas region for reporting. The statistics are computed in one
+ * parallel pass over the map. The atlas is resampled to the grid of the map once per atlas and
+ * grid, so the table updates quickly while the map changes. Label 0 is treated as background.
+ * The result can be shown in a DataFrame Web Browser table.
+ *
+ * ### Inports
+ *   * __map__ Scalar volume to summarize.
+ *   * __atlas__ Region label volume.
+ *   * __labels__ Optional atlas labels with Index and Region columns, used to name the regions.
+ *
+ * ### Outports
+ *   * __statistics__ One row per region with label, name, number of voxels, mean, maximum,
+ *     fraction of significant voxels and the value and world position of the peak, i.e. the
+ *     voxel with the largest absolute value.
+ *
+ * ### Properties
+ *   * __Significance Threshold__ Voxels with an absolute value above the threshold are
+ *     significant. Maps where non-significant voxels are zero can use 0.
+ */
+class IVW_MODULE_VISUALNEURO_API VolumeAtlasZonalStatistics : public PoolProcessor {
+public:
+    VolumeAtlasZonalStatistics();
+    virtual ~VolumeAtlasZonalStatistics() = default;
+
+    virtual void process() override;
+
+    virtual const ProcessorInfo getProcessorInfo() const override;
+    static const ProcessorInfo processorInfo_;
+
+private:
+    VolumeInport map_;
+    VolumeInport atlas_;
+    DataInport<DataFrame> labels_;
+
+    DataOutport<DataFrame> statistics_;
+
+    DoubleProperty significanceThreshold_;
+
+    // Regions of the voxels of the map. Shared with the jobs, which rebuild the lookup when the
+    // atlas or the grid of the map has changed.
+    struct LookupCache {
+        std::shared_ptr<const stats::RegionLookup> get(const std::shared_ptr<const Volume>& atlas,
+                                                       const Volume& reference);
+
+        std::mutex mutex;
+        std::weak_ptr<const Volume> atlas;
+        mat4 indexToWorld{0.0f};
+        std::shared_ptr<const stats::RegionLookup> lookup;
+    };
+    std::shared_ptr<LookupCache> lookup_;
+};
+
+}  // namespace inviwo
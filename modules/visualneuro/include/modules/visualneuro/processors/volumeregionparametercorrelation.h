@@ -34,6 +34,7 @@
 #include <inviwo/core/processors/processor.h>
 #include <inviwo/core/ports/volumeport.h>
 #include <inviwo/core/datastructures/volume/volumeram.h>
+#include <inviwo/core/datastructures/bitset.h>
 #include <inviwo/dataframe/datastructures/dataframe.h>
 #include <inviwo/dataframe/properties/columnoptionproperty.h>
 #include <modules/brushingandlinking/ports/brushingandlinkingports.h>
@@ -45,15 +46,35 @@
 #include <inviwo/core/properties/optionproperty.h>
 #include <inviwo/core/properties/stringproperty.h>
 
+#include <modules/visualneuro/algorithm/dataframe/parametermatrix.h>
 #include <modules/visualneuro/statistics/correlation.h>
 #include <modules/visualneuro/statistics/ttest.h>
 
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace inviwo {
+class AtlasVoxelIndex;
+}
+
 namespace inviwo {
 
 /** \docpage{org.inviwo.VolumeRegionParameterCorrelation, Volume Region Parameter Correlation}
  * ![](org.inviwo.VolumeRegionParameterCorrelation.png?classIdentifier=org.inviwo.VolumeRegionParameterCorrelation)
  *
  * Computes correlation between selected regions and all parameters in input DataFrame.
+ * Only the voxels of the selected regions are processed. They are looked up in an index of the
+ * atlas voxels in the grid of the volumes, which is built once per atlas and grid.
+ * The significant correlations of each region are computed once and cached as sorted runs per
+ * parameter. The quantiles of a selection of regions are computed from the cached runs, so
+ * adding a region to the selection only computes the correlations of that region. The cache is
+ * cleared when the volumes, parameters, filtered rows, atlas or correlation settings change, and
+ * the least recently used regions are evicted when the cached correlations exceed 256 MB.
+ * The parameter values are extracted into a dataframe::ParameterMatrix once per data frame and
+ * set of filtered rows.
  *
  *
  * ### Inports
@@ -96,6 +117,45 @@ private:
     OptionProperty<stats::CorrelationMethod> correlationMethod_;
     FloatProperty pVal_;
     OptionProperty<stats::TailTest> tailTest_;
+
+    // Voxels of each atlas label in the grid of the volumes. Shared with the jobs, which build
+    // the index when the atlas or the grid has changed.
+    struct VoxelIndexCache {
+        std::shared_ptr<const AtlasVoxelIndex> get(const std::shared_ptr<const Volume>& atlas,
+                                                   const Volume& reference);
+
+        std::mutex mutex;
+        std::weak_ptr<const Volume> atlas;
+        size3_t dims{0};
+        mat4 indexToWorld{0.0f};
+        std::shared_ptr<const AtlasVoxelIndex> index;
+    };
+    std::shared_ptr<VoxelIndexCache> voxelIndex_;
+
+    // Significant correlations of each region sorted per parameter, for one set of inputs.
+    // Replaced by an empty cache when the inputs change. The least recently used regions are
+    // evicted when the correlations exceed the budget, the latest region is always kept.
+    struct RegionCorrelationCache {
+        using Correlations = std::vector<std::vector<double>>;
+        static constexpr size_t budget = size_t{256} << 20;  // bytes
+
+        std::shared_ptr<const Correlations> get(int label);
+        void set(int label, std::shared_ptr<const Correlations> correlations);
+
+        struct Entry {
+            int label;
+            std::shared_ptr<const Correlations> correlations;
+            size_t bytes;
+        };
+        std::mutex mutex;
+        std::list<Entry> entries;  // Most recently used first
+        std::unordered_map<int, std::list<Entry>::iterator> regions;
+        size_t bytes = 0;
+    };
+    std::shared_ptr<RegionCorrelationCache> regionCorrelations_;
+    // Parameters of the rows that are not filtered, extracted when the rows change
+    std::shared_ptr<dataframe::ParameterMatrixCache> parameters_;
+    BitSet filteredRows_;
 };
 
 }  // namespace inviwo
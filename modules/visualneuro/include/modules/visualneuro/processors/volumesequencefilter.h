@@ -31,6 +31,7 @@
 #define IVW_VOLUMESEQUENCEFILTER_H
 
 #include <modules/visualneuro/visualneuromoduledefine.h>
+#include <modules/visualneuro/datastructures/volumesequenceselection.h>
 #include <inviwo/core/common/inviwo.h>
 #include <inviwo/core/processors/processor.h>
 #include <inviwo/core/ports/volumeport.h>
@@ -40,6 +41,12 @@
 #include <inviwo/dataframe/properties/columnoptionproperty.h>
 #include <inviwo/core/util/zip.h>
 
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
 namespace inviwo {
 
 /** \docpage{org.inviwo.VolumeSequenceFilter, Volume Sequence Filter}
@@ -57,6 +64,8 @@ namespace inviwo {
  * ### Outports
  *   * __outport__ Filtered volume sequence
  *   * __selectedVolumesOutport__ Dataframe containing the id's of the currently selected volumes
+ *   * __selection__ The selected volumes as a view of the input sequence, with the volumes that
+ *      were added and removed since the previous selection
  *
  * ### Properties
  *	 * __fMRI Scan id__ Choose the column of the .csv file that contains the volume id
@@ -81,8 +90,31 @@ private:
     BrushingAndLinkingInport brushingAndLinking_;
     VolumeSequenceOutport volumesOutport_;
     DataOutport<DataFrame> dataOutport_;
+    DataOutport<VolumeSequenceSelection> selectionOutport_;
 
     ColumnOptionProperty filenameIdColumn_;
+
+    /*
+     * Rebuild join_ if the volumes, the data frame or the filename column changed.
+     */
+    void updateJoin(const std::shared_ptr<const VolumeSequence>& volumes,
+                    const std::shared_ptr<const DataFrame>& dataFrame);
+
+    // Volumes joined with the rows of the data frame through their filenames. Changes of the
+    // brushing only apply the filter to the joined rows.
+    struct Join {
+        std::weak_ptr<const VolumeSequence> volumes;
+        std::weak_ptr<const DataFrame> dataFrame;
+        int column = -1;
+        // Index and row of each volume with a matching filename, in volume order
+        std::vector<std::pair<size_t, std::uint32_t>> volumeRows;
+        // Rows with a unique filename and their filenames, in row order
+        std::vector<std::uint32_t> rows;
+        std::vector<std::string> filenames;
+    };
+    Join join_;
+    // Last selection, the delta of the next selection is relative to it
+    std::shared_ptr<const VolumeSequenceSelection> selection_;
 };
 
 }  // namespace inviwo
@@ -36,6 +36,12 @@
 #include <inviwo/core/ports/volumeport.h>
 #include <inviwo/core/datastructures/volume/volumeramprecision.h>
 #include <inviwo/core/processors/poolprocessor.h>
+#include <modules/visualneuro/algorithm/volume/voxelstatistics.h>
+#include <modules/visualneuro/datastructures/volumesequenceselection.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
 
 namespace inviwo {
 
@@ -46,7 +52,9 @@ namespace inviwo {
  *
  *
  * ### Inports
- *   * __inport__ Input volumes.
+ *   * __inport__ Input volumes, optional if selection is connected.
+ *   * __selection__ Optional selection of volumes, used instead of inport when connected. When
+ *      the selection changes only the added and removed volumes are read.
  *
  * ### Outports
  *   * __outport__ Average of input volumes.
@@ -63,8 +71,20 @@ public:
     static const ProcessorInfo processorInfo_;
 
 private:
+    void processSelection();
+
     VolumeSequenceInport inport_;
+    DataInport<VolumeSequenceSelection> selection_;
     VolumeOutport outport_;
+
+    // Running sum of the selected volumes and the selection version it holds
+    struct SelectionSum {
+        std::mutex mutex;
+        std::shared_ptr<const VolumeSequence> parent;
+        std::uint64_t version = 0;
+        stats::VoxelSum sum;
+    };
+    std::shared_ptr<SelectionSum> selectionSum_;
 };
 
 }  // namespace inviwo
@@ -33,15 +33,24 @@
 
 #include <inviwo/core/util/assertion.h>
 
+#include <cstddef>
 #include <tuple>
+#include <vector>
 
 namespace inviwo {
 
 namespace stats {
 
 enum class IVW_MODULE_VISUALNEURO_API CorrelationMethod { Spearman, Pearson };
+
+/**
+ * \brief p-value of correlation r between n pairs of values according to Student's
+ * t-distribution.
+ */
+IVW_MODULE_VISUALNEURO_API double correlationPValue(double r, size_t n, TailTest tailTest);
+
 /**
- * \brief Compute correlation and p-value for two equally sized groups.
+ * \brief Compute correlation and p-value, see correlationPValue, for two equally sized groups.
  * @return Correlation value in [-1 1] and its probability, p-value, in [0 1]
  * \pre A must have same size as B
  */
@@ -63,11 +72,8 @@ std::tuple<double, double> corrTest(Iterator firstA, Iterator lastA,
             IVW_ASSERT(true, "Correlation method not implemented");
             break;
     }
-    auto n = std::distance(firstA, lastA);
-    // Test for significance according to Student's t-distribution
-    auto t = r * sqrt((n - 2) / (1.0 - r * r));
-    auto p = stats::tailTest(t, static_cast<double>(n-2), tailTest);
-    return {r, p};
+    const auto n = static_cast<size_t>(std::distance(firstA, lastA));
+    return {r, correlationPValue(r, n, tailTest)};
 }
 
 IVW_MODULE_VISUALNEURO_API std::tuple<double, double> corrTest(const std::vector<double>& A,
@@ -75,6 +81,15 @@ IVW_MODULE_VISUALNEURO_API std::tuple<double, double> corrTest(const std::vector
                                                                 CorrelationMethod method,
                                                                 TailTest tailTest);
 
+/**
+ * \brief Pearson correlation and p-value of n values a and b, given the standardized values of
+ * a, (a - mean) / population standard deviation, e.g. from
+ * dataframe::ParameterMatrix::getStandardizedValues. Equal to corrTest with
+ * CorrelationMethod::Pearson, but only the mean and deviation of b are computed.
+ */
+IVW_MODULE_VISUALNEURO_API std::tuple<double, double> standardizedPearsonTest(
+    const double* standardizedA, const double* b, size_t n, TailTest tailTest);
+
 }  // namespace stats
 
 }  // namespace inviwo
@@ -0,0 +1,123 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+#include <modules/visualneuro/util/dataframedelta.h>
+
+#include <inviwo/core/common/inviwo.h>
+#include <inviwo/dataframe/datastructures/dataframe.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace inviwo {
+
+namespace util {
+
+/**
+ * \brief Description of one column in a columnar frame, see serializeColumnarFrame.
+ */
+struct IVW_MODULE_VISUALNEURO_API ColumnarColumn {
+    std::string name;
+    // Element type of the data, the name of the matching JavaScript typed array without "Array",
+    // e.g. "float64" for Float64Array. Categorical columns are "categorical" with uint32 codes.
+    std::string type;
+    size_t components = 1;
+    // Row of the first value, the column holds the rows from firstRow to the end of the frame
+    size_t firstRow = 0;
+    // Byte offset from the start of the frame and byte length of the data
+    size_t offset = 0;
+    size_t bytes = 0;
+    // Values of the codes of categorical columns
+    std::vector<std::string> categories;
+};
+
+/**
+ * \brief Header of a columnar frame, see serializeColumnarFrame.
+ */
+struct IVW_MODULE_VISUALNEURO_API ColumnarFrameInfo {
+    // "full" for a whole frame or "delta" for changes to the frame with version base
+    std::string kind;
+    std::uint64_t version = 0;
+    std::uint64_t base = 0;
+    size_t rows = 0;
+    std::string port;
+    std::string processor;
+    std::vector<ColumnarColumn> columns;
+};
+
+/**
+ * \brief Version of the columnar frame layout written by serializeColumnarFrame.
+ */
+constexpr std::uint32_t columnarFrameVersion = 1;
+
+/**
+ * \brief Binary columnar encoding of a DataFrame, sent to the web UI instead of JSON text.
+ *
+ * Layout, all numbers little-endian:
+ *   * 4 bytes magic "VNCF", uint32 version, uint32 byte length of the metadata, uint32 0
+ *   * metadata, UTF-8 JSON padded with spaces to a multiple of 8 bytes, with the kind, version,
+ *     number of rows, port, processor and a description of every column, see ColumnarFrameInfo
+ *     and ColumnarColumn. Column offsets in the metadata are relative to the end of the metadata.
+ *   * column data, each column starting at a multiple of 8 bytes from the start of the frame
+ *
+ * Numeric columns are copied as is, with the components of vector types interleaved, so that the
+ * page can view them as typed arrays without parsing. 64-bit integers are converted to float64,
+ * since JavaScript has no typed array for them that converts to Number.
+ */
+IVW_MODULE_VISUALNEURO_API std::vector<std::byte> serializeColumnarFrame(
+    const DataFrame& frame, std::string_view port, std::string_view processor,
+    std::uint64_t version = 0);
+
+/**
+ * \brief Columnar frame of kind "delta" that turns the frame with version base into frame.
+ * Changed columns are sent in full, the other columns only hold the appended rows. Rows removed
+ * from the end are given by the row count. A delta that requires the whole frame is serialized
+ * with serializeColumnarFrame.
+ */
+IVW_MODULE_VISUALNEURO_API std::vector<std::byte> serializeColumnarDelta(
+    const DataFrame& frame, const DataFrameDelta& delta, std::string_view port,
+    std::string_view processor, std::uint64_t version, std::uint64_t base);
+
+/**
+ * \brief Read and validate the header of a frame written by serializeColumnarFrame.
+ * The offsets of the returned columns are from the start of the frame.
+ * @throws Exception if the frame is truncated, has another version or inconsistent offsets
+ */
+IVW_MODULE_VISUALNEURO_API ColumnarFrameInfo readColumnarFrameInfo(const std::byte* data,
+                                                                   size_t size);
+
+}  // namespace util
+
+}  // namespace inviwo
@@ -0,0 +1,110 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace inviwo {
+
+namespace util {
+
+/**
+ * \brief Serialized columnar frames, see serializeColumnarFrame, waiting to be fetched by web
+ * pages. Each frame gets a random token and is served as columnarFrameURL(token) by the scheme
+ * handler registered with registerColumnarFrameScheme, so data reaches the page as binary without
+ * passing through JavaScript source text. A frame is only served to the main frame of the browser
+ * it was published for. All functions are thread safe.
+ */
+class IVW_MODULE_VISUALNEURO_API ColumnarFrameStore {
+public:
+    static ColumnarFrameStore& get();
+
+    /*
+     * Unique version for a new frame.
+     */
+    std::uint64_t nextVersion();
+    /*
+     * Add frame for the browser with identifier browserId.
+     * @return the unguessable token of the frame URL, see columnarFrameURL
+     */
+    std::string set(std::uint64_t version, std::shared_ptr<const std::vector<std::byte>> frame,
+                    int browserId);
+    /*
+     * @return the frame or nullptr if there is no frame with version
+     */
+    std::shared_ptr<const std::vector<std::byte>> find(std::uint64_t version) const;
+    /*
+     * Remove the frame from the store, used when a frame is served since every frame is fetched
+     * once. Requests of other browsers do not remove the frame.
+     * @return the frame or nullptr if there is no frame with token for browserId
+     */
+    std::shared_ptr<const std::vector<std::byte>> take(std::string_view token, int browserId);
+    void erase(std::uint64_t version);
+
+private:
+    ColumnarFrameStore() = default;
+
+    struct Entry {
+        std::shared_ptr<const std::vector<std::byte>> frame;
+        std::string token;
+        int browserId = 0;
+    };
+
+    mutable std::mutex mutex_;
+    std::uint64_t version_ = 0;
+    std::unordered_map<std::uint64_t, Entry> frames_;
+    std::unordered_map<std::string, std::uint64_t> tokens_;
+};
+
+/**
+ * \brief URL of a frame in ColumnarFrameStore, https://visualneuro.data/frame/<token>.
+ */
+IVW_MODULE_VISUALNEURO_API std::string columnarFrameURL(std::string_view token);
+
+/**
+ * \brief Register the CEF scheme handler that serves the frames of ColumnarFrameStore. Frames are
+ * only served to the browser they were published for, with a CORS header for the origin of the
+ * requesting page so that pages loaded from files can fetch them. Must be called after CEF is
+ * initialized.
+ */
+IVW_MODULE_VISUALNEURO_API void registerColumnarFrameScheme();
+
+}  // namespace util
+
+}  // namespace inviwo
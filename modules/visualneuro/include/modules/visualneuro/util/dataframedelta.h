@@ -0,0 +1,113 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+
+#include <inviwo/core/common/inviwo.h>
+#include <inviwo/core/datastructures/bitset.h>
+#include <inviwo/dataframe/datastructures/dataframe.h>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace inviwo {
+
+namespace util {
+
+/**
+ * \brief Changes from one version of a data frame to the next, see diffDataFrames.
+ * Rows can only be appended to or removed from the end, other changes mark columns as changed.
+ */
+struct IVW_MODULE_VISUALNEURO_API DataFrameDelta {
+    // The columns differ in name, type or order and the whole frame has to be sent
+    bool full = false;
+    size_t previousRows = 0;
+    size_t rows = 0;
+    // Columns of the current frame with different values in the first min(previousRows, rows)
+    // rows, these are sent in full
+    std::vector<size_t> changedColumns;
+
+    bool empty() const { return !full && previousRows == rows && changedColumns.empty(); }
+};
+
+/**
+ * \brief Compare the columns of two versions of a data frame.
+ * Numeric columns are compared by their typed values. A categorical column is unchanged if its
+ * codes are unchanged and its categories start with the previous categories, so that the codes
+ * of appended rows are valid together with the previous codes.
+ */
+IVW_MODULE_VISUALNEURO_API DataFrameDelta diffDataFrames(const DataFrame& previous,
+                                                         const DataFrame& current);
+
+/**
+ * \brief Half-open index ranges [first, last) covering the indices of a BitSet, in order.
+ */
+IVW_MODULE_VISUALNEURO_API std::vector<std::pair<std::uint32_t, std::uint32_t>> toRanges(
+    const BitSet& indices);
+
+/**
+ * \brief Changes of the filtered and selected rows since the previously sent brushing state.
+ */
+struct IVW_MODULE_VISUALNEURO_API BrushingDelta {
+    std::uint64_t version = 0;
+    // Version the delta applies to, 0 if it replaces the state of the page
+    std::uint64_t base = 0;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> filteredAdded;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> filteredRemoved;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> selectedAdded;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> selectedRemoved;
+
+    bool empty() const {
+        return base != 0 && filteredAdded.empty() && filteredRemoved.empty() &&
+               selectedAdded.empty() && selectedRemoved.empty();
+    }
+    /*
+     * Compact JSON with the ranges as [first, last] pairs, the argument of onInviwoBrushingDelta
+     * in data/ui/scripts/columnarData.js.
+     */
+    std::string toJSON() const;
+};
+
+/**
+ * \brief Brushing changes as index ranges. Use base 0 and empty previous sets to send the whole
+ * state, e.g. after the page was reloaded.
+ */
+IVW_MODULE_VISUALNEURO_API BrushingDelta diffBrushing(const BitSet& previousFiltered,
+                                                      const BitSet& filtered,
+                                                      const BitSet& previousSelected,
+                                                      const BitSet& selected,
+                                                      std::uint64_t version, std::uint64_t base);
+
+}  // namespace util
+
+}  // namespace inviwo
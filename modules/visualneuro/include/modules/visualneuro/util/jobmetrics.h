@@ -0,0 +1,216 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+#include <modules/visualneuro/util/tracerecorder.h>
+#include <inviwo/core/util/dispatcher.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace inviwo {
+class Processor;
+
+namespace util {
+
+/**
+ * \brief Phases of a processor job.
+ *   * QueueWait: from dispatching the job until a pool thread starts it
+ *   * Gather: reading voxel values and resampling masks and atlases into the voxel grid
+ *   * Compute: evaluating the statistics of each voxel
+ *   * Threshold: significance filtering and summarizing results, e.g. value ranges and quantiles
+ *   * Publish: setting the result on the outports
+ *
+ * Gather and Compute run on several threads at once and are reported as the sum of the time
+ * spent by all threads.
+ */
+enum class JobPhase { QueueWait, Gather, Compute, Threshold, Publish };
+inline constexpr size_t numberOfJobPhases = 5;
+
+IVW_MODULE_VISUALNEURO_API std::string_view enumToStr(JobPhase phase);
+
+/**
+ * \brief Timings and throughput of one finished or cancelled processor job.
+ */
+struct IVW_MODULE_VISUALNEURO_API JobRecord {
+    std::string processorClass;
+    std::string processor;
+    std::chrono::system_clock::time_point finished;
+    std::array<double, numberOfJobPhases> seconds{};
+    // Wall time from job start until the result was published
+    double elapsed = 0.0;
+    size_t voxels = 0;
+    size_t bytes = 0;
+    bool cancelled = false;
+};
+
+/**
+ * \brief Collects the timings of one processor job.
+ * Create it when dispatching the job and share it with the job and its callback. Phases, voxels
+ * and bytes may be added concurrently from any thread. The job is recorded in the
+ * MetricsRegistry by finish(), or as cancelled when destroyed without calling finish().
+ * While tracing is enabled the job, its phases and cancellation are also added to the
+ * TraceRecorder.
+ */
+class IVW_MODULE_VISUALNEURO_API JobMetrics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    JobMetrics(std::string_view processorClass, std::string_view processor);
+    explicit JobMetrics(const Processor& processor);
+    JobMetrics(const JobMetrics&) = delete;
+    JobMetrics& operator=(const JobMetrics&) = delete;
+    ~JobMetrics();
+
+    /*
+     * Mark the start of the job, the time since construction is added as QueueWait.
+     * @return trace span of the job on the calling thread, keep it until the job returns.
+     */
+    TraceSpan start();
+    void add(JobPhase phase, Clock::duration duration);
+    void addVoxels(size_t voxels);
+    void addBytes(size_t bytes);
+    /*
+     * Record the job in the MetricsRegistry. Later calls have no effect.
+     */
+    void finish();
+
+    const std::string& getProcessor() const { return processor_; }
+
+private:
+    void record(bool cancelled);
+
+    std::string processorClass_;
+    std::string processor_;
+    Clock::time_point dispatched_;
+    std::atomic<Clock::rep> started_{0};
+    std::array<std::atomic<Clock::rep>, numberOfJobPhases> durations_{};
+    std::atomic<size_t> voxels_{0};
+    std::atomic<size_t> bytes_{0};
+    std::atomic<bool> recorded_{false};
+};
+
+/**
+ * \brief Adds the time between construction and destruction, or stop(), to a phase of a job.
+ * Does nothing if metrics is nullptr.
+ */
+class IVW_MODULE_VISUALNEURO_API PhaseTimer {
+public:
+    PhaseTimer(JobMetrics* metrics, JobPhase phase);
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+    ~PhaseTimer();
+
+    void stop();
+
+private:
+    JobMetrics* metrics_;
+    JobPhase phase_;
+    JobMetrics::Clock::time_point start_;
+};
+
+/**
+ * \brief Accumulated metrics of all recorded jobs of one processor.
+ */
+struct IVW_MODULE_VISUALNEURO_API ProcessorMetrics {
+    std::string processorClass;
+    std::string processor;
+    size_t jobs = 0;
+    size_t cancelled = 0;
+    // Sums over the finished jobs
+    std::array<double, numberOfJobPhases> seconds{};
+    double elapsed = 0.0;
+    double maxElapsed = 0.0;
+    size_t voxels = 0;
+    size_t bytes = 0;
+
+    size_t finished() const { return jobs - cancelled; }
+    /*
+     * Voxels per second of wall time over all finished jobs, 0 if there are none.
+     */
+    double voxelsPerSecond() const;
+};
+
+/**
+ * \brief Application wide store of the most recent processor job metrics.
+ * Holds up to getCapacity() jobs, older jobs are dropped first. All functions are thread safe.
+ * Callbacks registered with onRecord are invoked on the main thread after new jobs have been
+ * recorded.
+ */
+class IVW_MODULE_VISUALNEURO_API MetricsRegistry {
+public:
+    static MetricsRegistry& get();
+
+    void record(JobRecord job);
+    std::vector<JobRecord> getJobs() const;
+    /*
+     * Metrics of all recorded jobs grouped by processor, in order of first appearance.
+     */
+    std::vector<ProcessorMetrics> summarize() const;
+    void clear();
+
+    size_t getCapacity() const;
+    void setCapacity(size_t capacity);
+
+    std::shared_ptr<std::function<void()>> onRecord(std::function<void()> callback);
+
+    /*
+     * Write the summary and all recorded jobs as JSON.
+     * @throws Exception if file could not be opened
+     */
+    void writeJSON(std::ostream& os) const;
+    void writeJSON(const std::filesystem::path& file) const;
+
+private:
+    MetricsRegistry() = default;
+    void notify();
+
+    mutable std::mutex mutex_;
+    std::deque<JobRecord> jobs_;
+    size_t capacity_ = 10000;
+    std::atomic<bool> notifyPending_{false};
+    Dispatcher<void()> onRecord_;
+};
+
+}  // namespace util
+
+}  // namespace inviwo
@@ -0,0 +1,71 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+#include <modules/visualneuro/util/tracerecorder.h>
+#include <inviwo/core/network/processornetworkobserver.h>
+#include <inviwo/core/processors/processorobserver.h>
+
+#include <unordered_map>
+
+namespace inviwo {
+class ProcessorNetwork;
+
+namespace util {
+
+/**
+ * \brief Adds the process() calls and the number of running background jobs of all processors in
+ * a network to the TraceRecorder. Processors added to the network later are observed as well.
+ * Nothing is recorded while tracing is disabled.
+ */
+class IVW_MODULE_VISUALNEURO_API NetworkTracer : public ProcessorNetworkObserver,
+                                                 public ProcessorObserver {
+public:
+    explicit NetworkTracer(ProcessorNetwork& network);
+    virtual ~NetworkTracer() = default;
+
+    virtual void onProcessorNetworkDidAddProcessor(Processor* processor) override;
+    virtual void onProcessorNetworkWillRemoveProcessor(Processor* processor) override;
+
+    virtual void onProcessorAboutToProcess(Processor* processor) override;
+    virtual void onProcessorFinishedProcess(Processor* processor) override;
+    virtual void onProcessorStartBackgroundWork(Processor* processor, size_t jobs) override;
+    virtual void onProcessorFinishBackgroundWork(Processor* processor, size_t jobs) override;
+
+private:
+    // Only accessed from the main thread, where processors are evaluated
+    std::unordered_map<Processor*, TraceRecorder::Clock::time_point> processing_;
+    std::unordered_map<Processor*, size_t> backgroundJobs_;
+};
+
+}  // namespace util
+
+}  // namespace inviwo
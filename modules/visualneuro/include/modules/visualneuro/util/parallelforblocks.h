@@ -0,0 +1,91 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+
+#include <cstddef>
+#include <functional>
+
+namespace inviwo {
+
+namespace util {
+class JobMetrics;
+
+/**
+ * \brief Cancellation and progress reporting for long running block computations.
+ * Both callbacks are optional. Progress is reported as (processed blocks, total blocks) from the
+ * calling thread. Computations add their phase timings, voxels and bytes to metrics if set.
+ */
+struct IVW_MODULE_VISUALNEURO_API BlockControl {
+    std::function<bool()> stop;
+    std::function<void(size_t, size_t)> progress;
+    JobMetrics* metrics = nullptr;
+
+    bool stopped() const { return stop && stop(); }
+};
+
+/**
+ * \brief Create a BlockControl forwarding to the pool::Stop and pool::Progress of a PoolProcessor
+ * job. The arguments must outlive the returned object.
+ */
+template <typename Stop, typename Progress>
+BlockControl makeBlockControl(const Stop& stop, const Progress& progress,
+                              JobMetrics* metrics = nullptr) {
+    return BlockControl{[&stop]() { return static_cast<bool>(stop); },
+                        [&progress](size_t i, size_t n) { progress(i, n); }, metrics};
+}
+
+/**
+ * \brief Maximum number of workers that can execute blocks concurrently in parallelForBlocks,
+ * i.e. the number of threads in the application thread pool plus the calling thread.
+ * Use it to size per-worker partial results.
+ */
+IVW_MODULE_VISUALNEURO_API size_t parallelForBlocksWorkers();
+
+/**
+ * \brief Split [0, count) into blocks of blockSize elements and call
+ * callback(worker, first, last) for each block using the application thread pool.
+ *
+ * The calling thread takes part in the work and never waits for jobs that have not started, so
+ * it is safe to call from within a PoolProcessor job. worker is in [0, parallelForBlocksWorkers())
+ * and two blocks never run concurrently with the same worker index, which allows lock-free
+ * per-worker accumulation. Exceptions thrown by callback are rethrown in the calling thread.
+ * Runs serially if there is no InviwoApplication.
+ * @return false if control requested a stop before all blocks were processed.
+ */
+IVW_MODULE_VISUALNEURO_API bool parallelForBlocks(
+    size_t count, size_t blockSize,
+    const std::function<void(size_t worker, size_t first, size_t last)>& callback,
+    const BlockControl& control = {});
+
+}  // namespace util
+
+}  // namespace inviwo
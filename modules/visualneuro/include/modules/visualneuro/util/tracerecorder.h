@@ -0,0 +1,146 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace inviwo {
+
+namespace util {
+
+using TraceArgs = std::vector<std::pair<std::string, std::string>>;
+
+/**
+ * \brief One event in the Chrome trace event format.
+ * Phase is 'X' for complete events with a duration, 'i' for instant events and 'C' for counters.
+ * Times are in microseconds since the recorder was created.
+ */
+struct IVW_MODULE_VISUALNEURO_API TraceEvent {
+    std::string name;
+    std::string category;
+    char phase = 'X';
+    std::int64_t timestamp = 0;
+    std::int64_t duration = 0;
+    std::uint32_t thread = 0;
+    TraceArgs args;
+    double value = 0.0;
+};
+
+/**
+ * \brief Application wide, opt-in recorder of trace events.
+ * Nothing is recorded until tracing is enabled, and checking isEnabled() is a single atomic load,
+ * so trace points can stay in the code. The trace is written as JSON that can be opened in
+ * chrome://tracing or https://ui.perfetto.dev. At most getCapacity() events are kept, later
+ * events are counted as dropped. All functions are thread safe.
+ */
+class IVW_MODULE_VISUALNEURO_API TraceRecorder {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static TraceRecorder& get();
+
+    bool isEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+
+    /*
+     * Record a span from begin to end on the calling thread.
+     */
+    void complete(std::string_view name, std::string_view category, Clock::time_point begin,
+                  Clock::time_point end, TraceArgs args = {});
+    void instant(std::string_view name, std::string_view category, TraceArgs args = {});
+    void counter(std::string_view name, double value);
+
+    std::vector<TraceEvent> getEvents() const;
+    size_t getDropped() const;
+    size_t getCapacity() const;
+    void setCapacity(size_t capacity);
+    void clear();
+
+    /*
+     * @throws Exception if file could not be opened
+     */
+    void writeJSON(std::ostream& os) const;
+    void writeJSON(const std::filesystem::path& file) const;
+
+private:
+    TraceRecorder();
+    void add(TraceEvent event);
+    std::int64_t toMicroseconds(Clock::time_point time) const;
+
+    std::atomic<bool> enabled_{false};
+    const Clock::time_point epoch_;
+
+    mutable std::mutex mutex_;
+    std::vector<TraceEvent> events_;
+    size_t capacity_ = size_t{1} << 20;
+    size_t dropped_ = 0;
+    std::unordered_map<std::thread::id, std::uint32_t> threads_;
+};
+
+/**
+ * \brief Records a complete trace event covering the lifetime of the object on the calling
+ * thread. Does nothing unless tracing was enabled when it was constructed.
+ */
+class IVW_MODULE_VISUALNEURO_API TraceSpan {
+public:
+    TraceSpan() = default;
+    TraceSpan(std::string_view name, std::string_view category, TraceArgs args = {});
+    TraceSpan(TraceSpan&& rhs) noexcept;
+    TraceSpan& operator=(TraceSpan&& rhs) noexcept;
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+    ~TraceSpan();
+
+    void end();
+
+private:
+    bool active_ = false;
+    std::string name_;
+    std::string category_;
+    TraceArgs args_;
+    TraceRecorder::Clock::time_point begin_;
+};
+
+}  // namespace util
+
+}  // namespace inviwo
@@ -0,0 +1,169 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+#include <inviwo/core/datastructures/volume/volume.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace inviwo {
+class Outport;
+
+namespace util {
+
+/**
+ * \brief Where the data of a tracked volume comes from.
+ *   * Computed: the RAM representation is the only copy, e.g. a statistics result
+ *   * Disk: the volume was read from a file and its RAM representation can be reloaded from the
+ *     disk representation. Once the data is edited the disk representation is no longer valid
+ *     and the RAM representation is kept.
+ */
+enum class RepresentationSource { Computed, Disk };
+
+/**
+ * \brief Whether volume has a disk representation that still matches its data. Editing another
+ * representation invalidates the disk representation, e.g. after the data of an atlas was changed
+ * in memory its source file no longer describes it.
+ */
+IVW_MODULE_VISUALNEURO_API bool hasValidDiskRepresentation(const Volume& volume);
+
+/**
+ * \brief Memory used by the tracked volumes of one owner, usually an outport.
+ */
+struct IVW_MODULE_VISUALNEURO_API OwnerMemoryUsage {
+    std::string owner;
+    size_t volumes = 0;
+    size_t ramBytes = 0;
+    size_t glBytes = 0;
+    // Bytes of representations that can be evicted and rebuilt
+    size_t evictableBytes = 0;
+};
+
+/**
+ * \brief Keeps track of the RAM and OpenGL representations of volumes created by the VisualNeuro
+ * processors and evicts representations in least recently used order when a budget is exceeded.
+ *
+ * Only representations that can be rebuilt are evicted: RAM representations of volumes read from
+ * disk whose disk representation is still valid, and OpenGL representations of volumes that have
+ * a RAM representation or were read from disk. They are recreated the next time they are
+ * requested. Volumes are held weakly, so tracking does not extend their lifetime. Code that keeps
+ * pointers to representations, e.g. a stats::VoxelSource, must pin the volumes while using them.
+ *
+ * All functions are thread safe. Evictions are performed on the main thread.
+ */
+class IVW_MODULE_VISUALNEURO_API VolumeMemoryAccountant {
+public:
+    /**
+     * \brief Prevents eviction of the representations of a set of volumes during its lifetime.
+     */
+    class IVW_MODULE_VISUALNEURO_API Pin {
+    public:
+        Pin() = default;
+        Pin(Pin&& rhs) noexcept;
+        Pin& operator=(Pin&& rhs) noexcept;
+        Pin(const Pin&) = delete;
+        Pin& operator=(const Pin&) = delete;
+        ~Pin();
+
+    private:
+        friend VolumeMemoryAccountant;
+        explicit Pin(std::vector<const Volume*> volumes);
+        void release();
+
+        std::vector<const Volume*> volumes_;
+    };
+
+    static VolumeMemoryAccountant& get();
+
+    void track(const std::shared_ptr<const Volume>& volume, std::string_view owner,
+               RepresentationSource source);
+    void track(const VolumeSequence& volumes, std::string_view owner,
+               RepresentationSource source);
+    /*
+     * Mark volume as used, making it the last candidate for eviction.
+     */
+    void touch(const Volume& volume);
+    Pin pin(const VolumeSequence& volumes);
+    Pin pin(std::vector<const Volume*> volumes);
+
+    /*
+     * Memory of all tracked volumes that are still alive, grouped by owner.
+     */
+    std::vector<OwnerMemoryUsage> getUsage() const;
+    size_t getTotalBytes() const;
+
+    /*
+     * @param bytes maximum memory of the tracked representations, 0 to disable eviction.
+     */
+    void setBudget(size_t bytes);
+    size_t getBudget() const;
+    /*
+     * Evict representations until the tracked memory is within budget. Called automatically after
+     * volumes were tracked or unpinned. Must be called from the main thread.
+     * @return number of bytes freed
+     */
+    size_t enforceBudget();
+
+    /*
+     * Owner name of volumes set on an outport, "<processor>.<port>".
+     */
+    static std::string ownerName(const Outport& port);
+
+private:
+    struct Entry {
+        std::weak_ptr<const Volume> volume;
+        std::string owner;
+        RepresentationSource source = RepresentationSource::Computed;
+        std::uint64_t lastUse = 0;
+    };
+
+    VolumeMemoryAccountant() = default;
+    void unpin(const std::vector<const Volume*>& volumes);
+    void requestEnforce();
+
+    mutable std::mutex mutex_;
+    std::unordered_map<const Volume*, Entry> entries_;
+    std::unordered_map<const Volume*, size_t> pins_;
+    std::uint64_t clock_ = 0;
+    size_t budget_ = 0;
+    std::atomic<bool> enforcePending_{false};
+};
+
+}  // namespace util
+
+}  // namespace inviwo
@@ -32,13 +32,27 @@
 
 #include <modules/visualneuro/visualneuromoduledefine.h>
 #include <inviwo/core/common/inviwomodule.h>
+#include <inviwo/core/util/commandlineparser.h>
+#include <modules/visualneuro/util/networktracer.h>
+
+#include <memory>
 
 namespace inviwo {
 
 class IVW_MODULE_VISUALNEURO_API VisualNeuroModule : public InviwoModule {
 public:
     VisualNeuroModule(InviwoApplication* app);
-    virtual ~VisualNeuroModule() = default;
+    virtual ~VisualNeuroModule();
+
+private:
+    // Writes the processing metrics as JSON when the module is destroyed
+    TCLAP::ValueArg<std::string> metricsArg_;
+    // Enables tracing when parsed, before the workspace is loaded, and writes the trace as a
+    // Chrome trace when the module is destroyed
+    std::unique_ptr<TCLAP::Visitor> traceVisitor_;
+    TCLAP::ValueArg<std::string> traceArg_;
+    // Records process() calls and background jobs while util::TraceRecorder is enabled
+    std::unique_ptr<util::NetworkTracer> networkTracer_;
 };
 
 }  // namespace inviwo
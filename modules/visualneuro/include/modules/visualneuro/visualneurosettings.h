@@ -0,0 +1,64 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#pragma once
+
+#include <modules/visualneuro/visualneuromoduledefine.h>
+#include <inviwo/core/util/settings/settings.h>
+#include <inviwo/core/properties/boolproperty.h>
+#include <inviwo/core/properties/buttonproperty.h>
+#include <inviwo/core/properties/fileproperty.h>
+#include <inviwo/core/properties/ordinalproperty.h>
+
+namespace inviwo {
+
+class InviwoApplication;
+
+/**
+ * \brief Application wide settings of the VisualNeuro module.
+ *
+ * The volume memory budget is applied to util::VolumeMemoryAccountant, which evicts rebuildable
+ * volume representations when the tracked volumes exceed it. The profiling properties record
+ * util::TraceRecorder events and save them or util::MetricsRegistry as JSON. The application
+ * uses them for its File menu, it does not link the module and finds them by identifier.
+ */
+class IVW_MODULE_VISUALNEURO_API VisualNeuroSettings : public Settings {
+public:
+    VisualNeuroSettings(InviwoApplication* app);
+    virtual ~VisualNeuroSettings() = default;
+
+    IntProperty volumeMemoryBudget_;  //!< Megabytes, 0 means unlimited
+    BoolProperty recordTrace_;        //!< Enables util::TraceRecorder, not saved between sessions
+    FileProperty traceFile_;
+    ButtonProperty saveTrace_;  //!< Writes the recorded trace to traceFile_
+    FileProperty metricsFile_;
+    ButtonProperty saveMetrics_;  //!< Writes util::MetricsRegistry to metricsFile_
+};
+
+}  // namespace inviwo
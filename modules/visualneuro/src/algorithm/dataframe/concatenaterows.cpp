@@ -0,0 +1,131 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/algorithm/dataframe/concatenaterows.h>
+#include <modules/visualneuro/util/parallelforblocks.h>
+#include <inviwo/core/datastructures/buffer/bufferramprecision.h>
+#include <inviwo/core/util/exception.h>
+
+#include <algorithm>
+#include <type_traits>
+
+namespace inviwo {
+
+namespace dataframe {
+
+namespace {
+
+bool sameType(const Column& a, const Column& b) {
+    return a.getColumnType() == b.getColumnType() &&
+           a.getBuffer()->getDataFormat()->getId() == b.getBuffer()->getDataFormat()->getId();
+}
+
+}  // namespace
+
+std::shared_ptr<DataFrame> concatenateRows(
+    const std::vector<std::shared_ptr<const DataFrame>>& frames) {
+    if (frames.empty()) {
+        throw Exception("Expected at least one data frame", IVW_CONTEXT_CUSTOM("concatenateRows"));
+    }
+    const auto& reference = *frames.front();
+
+    // Columns of the first frame and the matching column of every frame, resolved once
+    std::vector<std::vector<std::shared_ptr<const Column>>> sources;
+    for (size_t i = 0; i < reference.getNumberOfColumns(); ++i) {
+        const auto column = reference.getColumn(i);
+        if (column->getColumnType() == ColumnType::Index) continue;
+        auto& matched = sources.emplace_back();
+        for (const auto& frame : frames) {
+            auto src = frame->getColumn(column->getHeader());
+            if (!src || !sameType(*src, *column)) {
+                throw Exception(fmt::format("Column '{}' is missing or has another type in one of "
+                                            "the data frames",
+                                            column->getHeader()),
+                                IVW_CONTEXT_CUSTOM("concatenateRows"));
+            }
+            matched.push_back(src);
+        }
+    }
+    for (const auto& frame : frames) {
+        if (frame->getNumberOfColumns() != reference.getNumberOfColumns()) {
+            throw Exception(fmt::format("Expected {} columns in all data frames, found {}",
+                                        reference.getNumberOfColumns(), frame->getNumberOfColumns()),
+                            IVW_CONTEXT_CUSTOM("concatenateRows"));
+        }
+    }
+
+    size_t nRows = 0;
+    for (const auto& frame : frames) nRows += frame->getNumberOfRows();
+    auto res = std::make_shared<DataFrame>(static_cast<std::uint32_t>(nRows));
+
+    // Columns are added serially, their contents are filled in parallel
+    std::vector<std::shared_ptr<Column>> targets;
+    for (const auto& matched : sources) {
+        const auto& column = matched.front();
+        if (column->getColumnType() == ColumnType::Categorical) {
+            targets.push_back(res->addCategoricalColumn(column->getHeader(), 0));
+        } else {
+            targets.push_back(column->getBuffer()->getRepresentation<BufferRAM>()->dispatch<
+                              std::shared_ptr<Column>>([&](auto typedBuf) {
+                using ValueType = util::PrecisionValueType<decltype(typedBuf)>;
+                return res->addColumn<ValueType>(column->getHeader(), nRows);
+            }));
+        }
+    }
+
+    util::parallelForBlocks(targets.size(), 1, [&](size_t, size_t first, size_t last) {
+        for (size_t c = first; c < last; ++c) {
+            auto& target = *targets[c];
+            if (target.getColumnType() == ColumnType::Categorical) {
+                // Category ids differ between frames and are remapped by append
+                for (const auto& src : sources[c]) target.append(*src);
+                continue;
+            }
+            target.getBuffer()->getEditableRepresentation<BufferRAM>()->dispatch<void>(
+                [&](auto typedBuf) {
+                    using BufferType = std::remove_pointer_t<decltype(typedBuf)>;
+                    auto out = typedBuf->getDataContainer().begin();
+                    for (const auto& src : sources[c]) {
+                        const auto& values =
+                            static_cast<const BufferType*>(
+                                src->getBuffer()->getRepresentation<BufferRAM>())
+                                ->getDataContainer();
+                        out = std::copy(values.begin(), values.end(), out);
+                    }
+                });
+        }
+    });
+
+    res->updateIndexBuffer();
+    return res;
+}
+
+}  // namespace dataframe
+
+}  // namespace inviwo
@@ -0,0 +1,156 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/algorithm/dataframe/csvwriter.h>
+#include <inviwo/core/datastructures/buffer/bufferramprecision.h>
+#include <inviwo/core/util/glmutils.h>
+
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace inviwo {
+
+namespace dataframe {
+
+namespace {
+
+// Cells of one column, cell i is text[ends[i - 1], ends[i])
+struct ColumnText {
+    std::string text;
+    std::vector<size_t> ends;
+};
+
+void appendField(std::string& text, std::string_view field) {
+    if (field.find_first_of(",\"\r\n") == std::string_view::npos) {
+        text.append(field);
+        return;
+    }
+    text.push_back('"');
+    for (auto c : field) {
+        if (c == '"') text.push_back('"');
+        text.push_back(c);
+    }
+    text.push_back('"');
+}
+
+template <typename T>
+void appendValue(std::string& text, T value) {
+    if constexpr (std::is_integral_v<T> && sizeof(T) == 1) {
+        // Not as characters
+        fmt::format_to(std::back_inserter(text), "{}", static_cast<int>(value));
+    } else if constexpr (std::is_integral_v<T> || std::is_same_v<T, float> ||
+                         std::is_same_v<T, double>) {
+        // Shortest representation that reads back to the same value
+        fmt::format_to(std::back_inserter(text), "{}", value);
+    } else {
+        fmt::format_to(std::back_inserter(text), "{}", static_cast<double>(value));
+    }
+}
+
+ColumnText formatColumn(const Column& column, const std::vector<std::uint32_t>& rows) {
+    ColumnText res;
+    res.ends.reserve(rows.size());
+
+    if (const auto* categorical = dynamic_cast<const CategoricalColumn*>(&column)) {
+        std::vector<std::string> categories;
+        for (const auto& category : categorical->getCategories()) {
+            appendField(categories.emplace_back(), category);
+        }
+        const auto* codes = static_cast<const std::uint32_t*>(
+            column.getBuffer()->getRepresentation<BufferRAM>()->getData());
+        for (auto row : rows) {
+            res.text.append(categories[codes[row]]);
+            res.ends.push_back(res.text.size());
+        }
+        return res;
+    }
+
+    column.getBuffer()->getRepresentation<BufferRAM>()->dispatch<void>([&](auto typedBuf) {
+        using ValueType = util::PrecisionValueType<decltype(typedBuf)>;
+        const auto& values = typedBuf->getDataContainer();
+        for (auto row : rows) {
+            for (size_t c = 0; c < util::extent<ValueType>::value; ++c) {
+                if (c > 0) res.text.push_back(' ');
+                appendValue(res.text, util::glmcomp(values[row], c));
+            }
+            res.ends.push_back(res.text.size());
+        }
+    });
+    return res;
+}
+
+}  // namespace
+
+bool writeCSV(std::ostream& os, const DataFrame& frame, const std::vector<std::uint32_t>& rows,
+              const util::BlockControl& control) {
+    std::vector<std::shared_ptr<const Column>> columns;
+    for (size_t i = 0; i < frame.getNumberOfColumns(); ++i) {
+        auto column = frame.getColumn(i);
+        if (column->getColumnType() != ColumnType::Index) columns.push_back(column);
+    }
+
+    std::vector<ColumnText> texts(columns.size());
+    const auto done = util::parallelForBlocks(
+        columns.size(), 1,
+        [&](size_t, size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) texts[i] = formatColumn(*columns[i], rows);
+        },
+        control);
+    if (!done) return false;
+
+    std::string buffer;
+    for (size_t i = 0; i < columns.size(); ++i) {
+        if (i > 0) buffer.push_back(',');
+        appendField(buffer, columns[i]->getHeader());
+    }
+    buffer.push_back('\n');
+
+    // Written in chunks to bound the size of the line buffer
+    constexpr size_t chunkSize = size_t{1} << 20;
+    for (size_t r = 0; r < rows.size(); ++r) {
+        for (size_t i = 0; i < texts.size(); ++i) {
+            const auto begin = r == 0 ? 0 : texts[i].ends[r - 1];
+            if (i > 0) buffer.push_back(',');
+            buffer.append(texts[i].text, begin, texts[i].ends[r] - begin);
+        }
+        buffer.push_back('\n');
+        if (buffer.size() >= chunkSize) {
+            os.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            buffer.clear();
+        }
+    }
+    os.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    return true;
+}
+
+}  // namespace dataframe
+
+}  // namespace inviwo
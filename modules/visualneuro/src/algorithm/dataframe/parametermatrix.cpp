@@ -0,0 +1,220 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/algorithm/dataframe/parametermatrix.h>
+#include <modules/visualneuro/util/parallelforblocks.h>
+#include <inviwo/core/datastructures/buffer/bufferramprecision.h>
+#include <inviwo/core/util/exception.h>
+#include <inviwo/core/util/glmutils.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <new>
+#include <unordered_map>
+
+namespace inviwo {
+
+namespace dataframe {
+
+namespace {
+
+constexpr size_t alignment = 64;
+constexpr size_t valuesPerAlignment = alignment / sizeof(double);
+
+}  // namespace
+
+void ParameterMatrix::AlignedDelete::operator()(double* data) const {
+    ::operator delete[](data, std::align_val_t{alignment});
+}
+
+void ParameterMatrix::allocate(size_t parameters, size_t subjects) {
+    subjects_ = subjects;
+    stride_ = (subjects + valuesPerAlignment - 1) / valuesPerAlignment * valuesPerAlignment;
+    words_ = (subjects + 63) / 64;
+    const auto size = std::max<size_t>(parameters * stride_, 1);
+    data_.reset(static_cast<double*>(
+        ::operator new[](size * sizeof(double), std::align_val_t{alignment})));
+    std::fill_n(data_.get(), size, 0.0);
+    validity_.assign(parameters * words_, 0);
+    stats_.assign(parameters, ColumnStats{});
+}
+
+void ParameterMatrix::finish(size_t parameter) {
+    const auto values = getValues(parameter);
+    auto validity = validity_.data() + parameter * words_;
+    auto& stats = stats_[parameter];
+    double sum = 0.0;
+    for (size_t subject = 0; subject < subjects_; ++subject) {
+        if (std::isnan(values[subject])) continue;
+        validity[subject / 64] |= std::uint64_t{1} << (subject % 64);
+        sum += values[subject];
+        ++stats.valid;
+    }
+    if (stats.valid == 0) return;
+
+    stats.mean = sum / static_cast<double>(stats.valid);
+    double squares = 0.0;
+    for (size_t subject = 0; subject < subjects_; ++subject) {
+        if (std::isnan(values[subject])) continue;
+        const auto diff = values[subject] - stats.mean;
+        squares += diff * diff;
+    }
+    stats.standardDeviation = std::sqrt(squares / static_cast<double>(stats.valid));
+}
+
+ParameterMatrix::ParameterMatrix(const DataFrame& frame, const std::vector<size_t>& columns,
+                                 const std::vector<std::uint32_t>& rows) {
+    const auto nRows = frame.getNumberOfRows();
+    for (auto row : rows) {
+        if (row != noRow && row >= nRows) {
+            throw Exception(fmt::format("Row {} is out of range, the data frame has {} rows", row,
+                                        nRows),
+                            IVW_CONTEXT_CUSTOM("ParameterMatrix"));
+        }
+    }
+    for (auto column : columns) {
+        if (column >= frame.getNumberOfColumns()) {
+            throw Exception(fmt::format("Column {} is out of range, the data frame has {} columns",
+                                        column, frame.getNumberOfColumns()),
+                            IVW_CONTEXT_CUSTOM("ParameterMatrix"));
+        }
+    }
+
+    allocate(columns.size(), rows.size());
+    util::parallelForBlocks(columns.size(), 1, [&](size_t, size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            const auto column = frame.getColumn(columns[i]);
+            stats_[i].name = column->getHeader();
+            auto out = data_.get() + i * stride_;
+            column->getBuffer()->getRepresentation<BufferRAM>()->dispatch<void>(
+                [&](auto typedBuf) {
+                    const auto& values = typedBuf->getDataContainer();
+                    for (size_t subject = 0; subject < rows.size(); ++subject) {
+                        const auto row = rows[subject];
+                        out[subject] =
+                            row == noRow || row >= values.size()
+                                ? std::numeric_limits<double>::quiet_NaN()
+                                : static_cast<double>(util::glmcomp(values[row], 0));
+                    }
+                });
+            finish(i);
+        }
+    });
+}
+
+ParameterMatrix::ParameterMatrix(const std::vector<std::vector<double>>& columns,
+                                 std::vector<std::string> names) {
+    const auto subjects = columns.empty() ? 0 : columns.front().size();
+    for (const auto& column : columns) {
+        if (column.size() != subjects) {
+            throw Exception(fmt::format("Expected {} values in every parameter, got {}", subjects,
+                                        column.size()),
+                            IVW_CONTEXT_CUSTOM("ParameterMatrix"));
+        }
+    }
+    allocate(columns.size(), subjects);
+    for (size_t i = 0; i < columns.size(); ++i) {
+        if (i < names.size()) stats_[i].name = std::move(names[i]);
+        std::copy(columns[i].begin(), columns[i].end(), data_.get() + i * stride_);
+        finish(i);
+    }
+}
+
+std::vector<std::uint32_t> ParameterMatrix::getValidSubjects(size_t parameter) const {
+    std::vector<std::uint32_t> res;
+    res.reserve(getNumberOfValid(parameter));
+    const auto validity = getValidity(parameter);
+    for (size_t word = 0; word < words_; ++word) {
+        for (auto bits = validity[word]; bits != 0; bits &= bits - 1) {
+            auto bit = 0u;
+            while (((bits >> bit) & 1) == 0) ++bit;
+            res.push_back(static_cast<std::uint32_t>(word * 64 + bit));
+        }
+    }
+    return res;
+}
+
+std::vector<double> ParameterMatrix::getValidValues(size_t parameter) const {
+    std::vector<double> res;
+    res.reserve(getNumberOfValid(parameter));
+    const auto values = getValues(parameter);
+    for (auto subject : getValidSubjects(parameter)) res.push_back(values[subject]);
+    return res;
+}
+
+std::vector<double> ParameterMatrix::getStandardizedValues(size_t parameter) const {
+    auto res = getValidValues(parameter);
+    const auto mean = getMean(parameter);
+    const auto standardDeviation = getStandardDeviation(parameter);
+    for (auto& value : res) value = (value - mean) / standardDeviation;
+    return res;
+}
+
+std::vector<std::vector<size_t>> ParameterMatrix::groupByValidity() const {
+    std::vector<std::vector<size_t>> groups;
+    // Groups with the same hash of their validity bits
+    std::unordered_map<size_t, std::vector<size_t>> candidates;
+    for (size_t parameter = 0; parameter < getNumberOfParameters(); ++parameter) {
+        const auto validity = getValidity(parameter);
+        size_t hash = 0;
+        for (size_t word = 0; word < words_; ++word) {
+            hash ^= std::hash<std::uint64_t>{}(validity[word]) + 0x9e3779b9 + (hash << 6) +
+                    (hash >> 2);
+        }
+        auto& sameHash = candidates[hash];
+        const auto it = std::find_if(sameHash.begin(), sameHash.end(), [&](size_t group) {
+            return std::equal(validity, validity + words_, getValidity(groups[group].front()));
+        });
+        if (it != sameHash.end()) {
+            groups[*it].push_back(parameter);
+        } else {
+            sameHash.push_back(groups.size());
+            groups.push_back({parameter});
+        }
+    }
+    return groups;
+}
+
+std::shared_ptr<const ParameterMatrix> ParameterMatrixCache::get(
+    const std::shared_ptr<const DataFrame>& frame, const std::vector<std::uint32_t>& rows) {
+    std::scoped_lock lock{mutex_};
+    if (!matrix_ || frame_.lock() != frame || rows_ != rows) {
+        std::vector<size_t> columns(frame->getNumberOfColumns());
+        for (size_t i = 0; i < columns.size(); ++i) columns[i] = i;
+        matrix_ = std::make_shared<const ParameterMatrix>(*frame, columns, rows);
+        frame_ = frame;
+        rows_ = rows;
+    }
+    return matrix_;
+}
+
+}  // namespace dataframe
+
+}  // namespace inviwo
@@ -0,0 +1,313 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/algorithm/dataframe/patientdatasync.h>
+#include <inviwo/core/util/exception.h>
+#include <inviwo/core/util/logcentral.h>
+
+#include <algorithm>
+#include <atomic>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace inviwo {
+
+namespace dataframe {
+
+namespace {
+
+std::string escapeRegex(std::string_view text) {
+    std::string res;
+    for (auto c : text) {
+        if (std::string_view{"\\^$.|?*+()[]{}"}.find(c) != std::string_view::npos) {
+            res.push_back('\\');
+        }
+        res.push_back(c);
+    }
+    return res;
+}
+
+// Columns other than the index column
+std::vector<std::shared_ptr<const Column>> dataColumns(const DataFrame& frame) {
+    std::vector<std::shared_ptr<const Column>> res;
+    for (size_t i = 0; i < frame.getNumberOfColumns(); ++i) {
+        auto column = frame.getColumn(i);
+        if (column->getColumnType() != ColumnType::Index) res.push_back(column);
+    }
+    return res;
+}
+
+// Entries of directory, empty if it does not exist. Only the enumeration is serial, the entries
+// are filtered in scanVolumes
+std::vector<std::filesystem::directory_entry> listEntries(const std::filesystem::path& directory) {
+    std::vector<std::filesystem::directory_entry> res;
+    std::error_code ec;
+    if (!std::filesystem::exists(directory, ec)) return res;
+    for (std::filesystem::directory_iterator it(directory, ec), end; !ec && it != end;
+         it.increment(ec)) {
+        res.push_back(*it);
+    }
+    if (ec) {
+        throw Exception(fmt::format("Could not list {}: {}", directory.string(), ec.message()),
+                        IVW_CONTEXT_CUSTOM("planPatientDataSync"));
+    }
+    return res;
+}
+
+enum class EntryKind : char { Other, Volume, VolumeWithId };
+
+// The .nii and .nii.gz files among the entries and their patient ids, files without an id in
+// their name are marked as Volume
+struct ScannedVolumes {
+    std::vector<PatientVolumeFile> files;
+    std::vector<EntryKind> kinds;
+};
+
+std::optional<ScannedVolumes> scanVolumes(
+    std::vector<std::filesystem::directory_entry> entries, const PatientIdPattern& pattern,
+    const std::unordered_map<std::string, std::string>& fileIdToPatientId,
+    const util::BlockControl& control) {
+    ScannedVolumes res;
+    res.files.resize(entries.size());
+    res.kinds.resize(entries.size(), EntryKind::Other);
+    const auto done = util::parallelForBlocks(
+        entries.size(), 256,
+        [&](size_t, size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                std::error_code ec;
+                if (!entries[i].is_regular_file(ec)) continue;
+                auto& file = res.files[i];
+                file.path = entries[i].path();
+                const auto filename = file.path.filename().string();
+                if (filename.find(".nii") == std::string::npos) continue;
+                res.kinds[i] = EntryKind::Volume;
+                const auto fileId = pattern.extract(filename);
+                if (fileId.empty()) continue;
+                res.kinds[i] = EntryKind::VolumeWithId;
+                if (auto it = fileIdToPatientId.find(std::string(fileId));
+                    it != fileIdToPatientId.end()) {
+                    file.id = it->second;
+                }
+            }
+        },
+        control);
+    if (!done) return std::nullopt;
+    return res;
+}
+
+}  // namespace
+
+PatientIdPattern::PatientIdPattern(std::string_view keyword) {
+    if (keyword.empty()) {
+        throw Exception("The volume file id keyword is empty",
+                        IVW_CONTEXT_CUSTOM("PatientIdPattern"));
+    }
+    regex_ = std::regex(escapeRegex(keyword) + "[-_]?([A-Za-z0-9]+)",
+                        std::regex::ECMAScript | std::regex::optimize);
+}
+
+std::string_view PatientIdPattern::extract(std::string_view filename) const {
+    std::cmatch match;
+    if (!std::regex_search(filename.data(), filename.data() + filename.size(), match, regex_)) {
+        return {};
+    }
+    return std::string_view(match[1].first, static_cast<size_t>(match[1].length()));
+}
+
+std::optional<PatientDataSyncPlan> planPatientDataSync(const DataFrame& mapping,
+                                                       const DataFrame& patientData,
+                                                       const std::filesystem::path& folder,
+                                                       const PatientIdPattern& pattern,
+                                                       const util::BlockControl& control) {
+    const auto mappingColumns = dataColumns(mapping);
+    const auto patientColumns = dataColumns(patientData);
+    if (mappingColumns.size() < 2) {
+        throw Exception("The mapping needs two id columns",
+                        IVW_CONTEXT_CUSTOM("planPatientDataSync"));
+    }
+    if (patientColumns.empty()) {
+        throw Exception("The patient data has no id column",
+                        IVW_CONTEXT_CUSTOM("planPatientDataSync"));
+    }
+    std::error_code ec;
+    if (!std::filesystem::is_directory(folder, ec)) {
+        throw Exception(fmt::format("Volume folder {} does not exist", folder.string()),
+                        IVW_CONTEXT_CUSTOM("planPatientDataSync"));
+    }
+
+    PatientDataSyncPlan plan;
+    plan.folder = folder;
+    plan.unmatchedFolder = folder / "non_matching_scans";
+
+    std::unordered_map<std::string, std::string> fileIdToPatientId;
+    fileIdToPatientId.reserve(mapping.getNumberOfRows());
+    for (size_t i = 0; i < mapping.getNumberOfRows(); ++i) {
+        fileIdToPatientId.insert_or_assign(mappingColumns[1]->getAsString(i),
+                                           mappingColumns[0]->getAsString(i));
+    }
+
+    const auto rows = patientData.getNumberOfRows();
+    std::vector<std::string> patientIds(rows);
+    if (!util::parallelForBlocks(
+            rows, 1024,
+            [&](size_t, size_t first, size_t last) {
+                for (size_t i = first; i < last; ++i) {
+                    patientIds[i] = patientColumns[0]->getAsString(i);
+                }
+            },
+            control)) {
+        return std::nullopt;
+    }
+    const std::unordered_set<std::string_view> withData(patientIds.begin(), patientIds.end());
+
+    auto volumes = scanVolumes(listEntries(folder), pattern, fileIdToPatientId, control);
+    if (!volumes) return std::nullopt;
+    auto moved = scanVolumes(listEntries(plan.unmatchedFolder), pattern, fileIdToPatientId,
+                             control);
+    if (!moved) return std::nullopt;
+
+    std::unordered_set<std::string_view> withVolume;
+    withVolume.reserve(volumes->files.size());
+    for (size_t i = 0; i < volumes->files.size(); ++i) {
+        auto& file = volumes->files[i];
+        const auto kind = volumes->kinds[i];
+        if (kind == EntryKind::Other) continue;
+        ++plan.volumes;
+        if (kind == EntryKind::Volume) {
+            plan.skipped.push_back(std::move(file.path));
+        } else if (!file.id.empty() && withData.count(file.id) != 0) {
+            withVolume.insert(file.id);
+        } else {
+            plan.moves.push_back(std::move(file));
+        }
+    }
+    for (size_t i = 0; i < moved->files.size(); ++i) {
+        auto& file = moved->files[i];
+        if (moved->kinds[i] == EntryKind::Other) continue;
+        if (file.id.empty() || withData.count(file.id) == 0) {
+            plan.unmatchedVolumes.push_back(std::move(file));
+        }
+    }
+
+    for (std::uint32_t row = 0; row < rows; ++row) {
+        if (withVolume.count(patientIds[row]) != 0) {
+            plan.matchedRows.push_back(row);
+        } else {
+            plan.unmatchedRows.push_back(row);
+        }
+    }
+    return plan;
+}
+
+size_t applyPatientDataSync(const PatientDataSyncPlan& plan, const util::BlockControl& control) {
+    if (plan.moves.empty()) return 0;
+    std::error_code ec;
+    std::filesystem::create_directories(plan.unmatchedFolder, ec);
+    if (ec) {
+        LogErrorCustom("applyPatientDataSync", "Could not create " << plan.unmatchedFolder
+                                                                   << ": " << ec.message());
+        return 0;
+    }
+
+    std::atomic<size_t> moved{0};
+    util::parallelForBlocks(
+        plan.moves.size(), 64,
+        [&](size_t, size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                const auto& from = plan.moves[i].path;
+                std::error_code error;
+                std::filesystem::rename(from, plan.unmatchedFolder / from.filename(), error);
+                if (error) {
+                    LogWarnCustom("applyPatientDataSync",
+                                  "Could not move " << from << ": " << error.message());
+                } else {
+                    ++moved;
+                }
+            }
+        },
+        control);
+    return moved.load();
+}
+
+void writePatientDataSyncLog(std::ostream& os, const PatientDataSyncPlan& plan,
+                             const DataFrame& patientData) {
+    const auto idColumn = dataColumns(patientData).front();
+    const std::string spacing = ",,,,,,";
+    os << "fMRI-scans that lack data in the .csv-file,," << spacing;
+    os << "Patients in the .csv-file that cannot be coupled with a fMRI-scan\n";
+    os << "ID,,Filename" << spacing << "ID\n";
+
+    const auto volumes = plan.moves.size() + plan.unmatchedVolumes.size();
+    const auto lines = std::max(volumes, plan.unmatchedRows.size());
+    for (size_t i = 0; i < lines; ++i) {
+        if (i < volumes) {
+            const auto& file = i < plan.moves.size()
+                                   ? plan.moves[i]
+                                   : plan.unmatchedVolumes[i - plan.moves.size()];
+            os << file.id << ",," << file.path.filename().string();
+        } else {
+            os << ",,";
+        }
+        os << spacing;
+        if (i < plan.unmatchedRows.size()) os << idColumn->getAsString(plan.unmatchedRows[i]);
+        os << "\n";
+    }
+}
+
+std::shared_ptr<DataFrame> patientDataSyncActions(const PatientDataSyncPlan& plan,
+                                                  const DataFrame& patientData) {
+    const auto idColumn = dataColumns(patientData).front();
+    std::vector<std::string> actions, ids, files;
+    const auto size = plan.moves.size() + plan.unmatchedRows.size();
+    actions.reserve(size);
+    ids.reserve(size);
+    files.reserve(size);
+    for (const auto& file : plan.moves) {
+        actions.emplace_back("Move volume");
+        ids.push_back(file.id);
+        files.push_back(file.path.filename().string());
+    }
+    for (auto row : plan.unmatchedRows) {
+        actions.emplace_back("Drop row");
+        ids.push_back(idColumn->getAsString(row));
+        files.push_back(fmt::format("Row {}", row));
+    }
+
+    auto dataFrame = std::make_shared<DataFrame>();
+    dataFrame->addCategoricalColumn("Action", actions);
+    dataFrame->addCategoricalColumn("ID", ids);
+    dataFrame->addCategoricalColumn("File", files);
+    dataFrame->updateIndexBuffer();
+    return dataFrame;
+}
+
+}  // namespace dataframe
+
+}  // namespace inviwo
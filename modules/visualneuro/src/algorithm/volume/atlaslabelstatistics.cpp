@@ -0,0 +1,235 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/algorithm/volume/atlaslabelstatistics.h>
+#include <modules/visualneuro/util/jobmetrics.h>
+#include <inviwo/core/datastructures/volume/volumeramprecision.h>
+#include <inviwo/core/util/exception.h>
+
+#include <algorithm>
+
+namespace inviwo {
+
+namespace stats {
+
+namespace {
+
+constexpr size_t blockSize = size_t{1} << 15;
+constexpr size_t nPasses = 3;
+
+struct PartialLabel {
+    size_t voxels = 0;
+    size3_t lower{std::numeric_limits<size_t>::max()};
+    size3_t upper{0};
+    dvec3 sum{0.0};
+};
+
+struct NearestVoxel {
+    double distance2 = std::numeric_limits<double>::infinity();
+    size_t index = std::numeric_limits<size_t>::max();
+};
+
+// Forward to control, reporting the progress of pass as part of all passes
+util::BlockControl passControl(const util::BlockControl& control, size_t pass) {
+    util::BlockControl res{control.stop, {}, control.metrics};
+    if (control.progress) {
+        res.progress = [&control, pass](size_t done, size_t total) {
+            control.progress(pass * total + done, nPasses * total);
+        };
+    }
+    return res;
+}
+
+size3_t voxelPosition(size_t index, size3_t dims) {
+    return {index % dims.x, (index / dims.x) % dims.y, index / (dims.x * dims.y)};
+}
+
+// Call f(worker, position, label) for all voxels in parallel, with position in index coordinates
+template <typename F>
+bool forEachLabel(const Volume& atlas, const util::BlockControl& control, F&& f) {
+    const auto dims = atlas.getDimensions();
+    const auto nVoxels = glm::compMul(dims);
+    const auto bytesPerVoxel = atlas.getDataFormat()->getSize();
+    return atlas.getRepresentation<VolumeRAM>()->dispatch<bool, dispatching::filter::Scalars>(
+        [&](auto vr) {
+            const auto data = vr->getDataTyped();
+            return util::parallelForBlocks(
+                nVoxels, blockSize,
+                [&](size_t worker, size_t first, size_t last) {
+                    const util::PhaseTimer timer(control.metrics, util::JobPhase::Compute);
+                    if (control.metrics) {
+                        control.metrics->addVoxels(last - first);
+                        control.metrics->addBytes((last - first) * bytesPerVoxel);
+                    }
+                    auto pos = voxelPosition(first, dims);
+                    for (size_t i = first; i < last; ++i) {
+                        f(worker, i, pos, static_cast<int>(data[i]));
+                        if (++pos.x == dims.x) {
+                            pos.x = 0;
+                            if (++pos.y == dims.y) {
+                                pos.y = 0;
+                                ++pos.z;
+                            }
+                        }
+                    }
+                },
+                control);
+        });
+}
+
+}  // namespace
+
+AtlasLabelStatistics::AtlasLabelStatistics(size3_t dims, int firstLabel,
+                                           std::vector<LabelStatistics> table)
+    : dims_{dims}, firstLabel_{firstLabel}, table_{std::move(table)} {}
+
+const LabelStatistics* AtlasLabelStatistics::find(int label) const {
+    const auto i = static_cast<long long>(label) - firstLabel_;
+    if (i < 0 || i >= static_cast<long long>(table_.size())) return nullptr;
+    const auto& stats = table_[static_cast<size_t>(i)];
+    return stats.voxels > 0 ? &stats : nullptr;
+}
+
+std::vector<int> AtlasLabelStatistics::getLabels() const {
+    std::vector<int> labels;
+    for (const auto& stats : table_) {
+        if (stats.voxels > 0) labels.push_back(stats.label);
+    }
+    return labels;
+}
+
+const std::vector<LabelStatistics>& AtlasLabelStatistics::getTable() const { return table_; }
+
+size3_t AtlasLabelStatistics::getDimensions() const { return dims_; }
+
+std::optional<AtlasLabelStatistics> computeLabelStatistics(const Volume& atlas,
+                                                           const util::BlockControl& control) {
+    const auto dims = atlas.getDimensions();
+    if (glm::compMul(dims) == 0) return AtlasLabelStatistics{dims, 0, {}};
+    const auto nWorkers = util::parallelForBlocksWorkers();
+
+    // Pass 1: label range, which determines the size of the dense tables
+    std::vector<ivec2> ranges(nWorkers, ivec2{std::numeric_limits<int>::max(),
+                                              std::numeric_limits<int>::lowest()});
+    if (!forEachLabel(atlas, passControl(control, 0),
+                      [&](size_t worker, size_t, const size3_t&, int label) {
+                          auto& range = ranges[worker];
+                          range.x = std::min(range.x, label);
+                          range.y = std::max(range.y, label);
+                      })) {
+        return std::nullopt;
+    }
+    auto range = ranges.front();
+    for (const auto& r : ranges) range = ivec2{std::min(range.x, r.x), std::max(range.y, r.y)};
+    const auto nLabels = static_cast<size_t>(static_cast<long long>(range.y) - range.x + 1);
+    if (nLabels > maxDenseLabelRange) {
+        throw Exception(fmt::format("Atlas labels span {} values ({} to {}), at most {} are "
+                                    "supported",
+                                    nLabels, range.x, range.y, maxDenseLabelRange),
+                        IVW_CONTEXT_CUSTOM("computeLabelStatistics"));
+    }
+
+    // Pass 2: count, bounding box and position sum. Tables are allocated by the workers that run
+    std::vector<std::vector<PartialLabel>> partials(nWorkers);
+    if (!forEachLabel(atlas, passControl(control, 1),
+                      [&](size_t worker, size_t, const size3_t& pos, int label) {
+                          auto& table = partials[worker];
+                          if (table.empty()) table.resize(nLabels);
+                          auto& p = table[static_cast<size_t>(label - range.x)];
+                          ++p.voxels;
+                          p.lower = glm::min(p.lower, pos);
+                          p.upper = glm::max(p.upper, pos);
+                          p.sum += dvec3(pos);
+                      })) {
+        return std::nullopt;
+    }
+
+    std::vector<LabelStatistics> table(nLabels);
+    std::vector<dvec3> centroids(nLabels);
+    for (size_t i = 0; i < nLabels; ++i) {
+        auto& stats = table[i];
+        stats.label = range.x + static_cast<int>(i);
+        dvec3 sum{0.0};
+        for (const auto& partial : partials) {
+            if (partial.empty()) continue;
+            const auto& p = partial[i];
+            stats.voxels += p.voxels;
+            stats.lower = glm::min(stats.lower, p.lower);
+            stats.upper = glm::max(stats.upper, p.upper);
+            sum += p.sum;
+        }
+        if (stats.voxels > 0) {
+            stats.centroid = sum / static_cast<double>(stats.voxels);
+        } else {
+            stats.lower = size3_t{0};
+        }
+        centroids[i] = stats.centroid;
+    }
+    partials.clear();
+    partials.shrink_to_fit();
+
+    // Pass 3: voxel closest to the centroid. Distances are measured in world space, since voxels
+    // need not be isotropic.
+    const auto indexToWorld = dmat3(atlas.getCoordinateTransformer().getIndexToWorldMatrix());
+    std::vector<std::vector<NearestVoxel>> nearest(nWorkers);
+    if (!forEachLabel(atlas, passControl(control, 2),
+                      [&](size_t worker, size_t index, const size3_t& pos, int label) {
+                          auto& table = nearest[worker];
+                          if (table.empty()) table.resize(nLabels);
+                          const auto i = static_cast<size_t>(label - range.x);
+                          const auto d = indexToWorld * (dvec3(pos) - centroids[i]);
+                          const auto distance2 = glm::dot(d, d);
+                          auto& n = table[i];
+                          // Blocks are visited in increasing index order per worker, so the
+                          // first voxel wins ties within a worker
+                          if (distance2 < n.distance2) n = NearestVoxel{distance2, index};
+                      })) {
+        return std::nullopt;
+    }
+    for (size_t i = 0; i < nLabels; ++i) {
+        NearestVoxel best;
+        for (const auto& worker : nearest) {
+            if (worker.empty()) continue;
+            const auto& n = worker[i];
+            if (n.distance2 < best.distance2 ||
+                (n.distance2 == best.distance2 && n.index < best.index)) {
+                best = n;
+            }
+        }
+        if (best.index != std::numeric_limits<size_t>::max()) {
+            table[i].center = voxelPosition(best.index, dims);
+        }
+    }
+
+    return AtlasLabelStatistics{dims, range.x, std::move(table)};
+}
+
+}  // namespace stats
+
+}  // namespace inviwo
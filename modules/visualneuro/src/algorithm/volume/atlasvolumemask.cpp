@@ -28,55 +28,185 @@
  *********************************************************************************/
 
 #include <modules/visualneuro/algorithm/volume/atlasvolumemask.h>
+#include <modules/visualneuro/util/jobmetrics.h>
+#include <modules/visualneuro/util/volumememoryaccountant.h>
 #include <inviwo/core/datastructures/volume/volumeramprecision.h>
 #include <inviwo/core/util/volumeramutils.h>
 #include <inviwo/core/util/indexmapper.h>
+#include <inviwo/core/util/exception.h>
 
 namespace inviwo {
 
+namespace {
+
+constexpr unsigned char maskSelection{1 << 6};  // 0100 0000
+constexpr unsigned char maskBrain{1 << 7};      // 1000 0000
+
+}  // namespace
+
 void atlasVolumeMask(Volume* mask, const Volume& volume, const Volume& atlas,
                      const std::unordered_set<size_t>& indexFilter) {
     auto resMask =
         dynamic_cast<VolumeRAMPrecision<uint8_t>*>(mask->getEditableRepresentation<VolumeRAM>());
-    auto dim = volume.getDimensions();
-
-    mat4 indexToWorld = volume.getCoordinateTransformer().getIndexToWorldMatrix();
-    mat4 worldToIndex = atlas.getCoordinateTransformer().getWorldToIndexMatrix();
-    auto volRamIndexed = atlas.getRepresentation<VolumeRAM>();
+    const auto dim = volume.getDimensions();
+    const ivec3 atlasDim(atlas.getDimensions());
 
+    const mat4 toAtlasIndex = atlas.getCoordinateTransformer().getWorldToIndexMatrix() *
+                              volume.getCoordinateTransformer().getIndexToWorldMatrix();
     auto maskData = resMask->getDataTyped();
+    const util::IndexMapper3D im(dim);
+    const util::IndexMapper3D atlasIm(atlas.getDimensions());
+
+    // Dispatch once on the atlas and volume types instead of for every voxel
+    atlas.getRepresentation<VolumeRAM>()->dispatch<void, dispatching::filter::Scalars>(
+        [&](auto atlasRAM) {
+            const auto atlasData = atlasRAM->getDataTyped();
+            volume.getRepresentation<VolumeRAM>()->dispatch<void, dispatching::filter::Scalars>(
+                [&](auto brainRAM) {
+                    using ValueType = util::PrecisionValueType<decltype(brainRAM)>;
+                    const auto brainData = brainRAM->getDataTyped();
+                    util::forEachVoxelParallel(*resMask, [&](const size3_t& ind) {
+                        const auto i = im(ind);
+                        uint8_t maskVal = 0;
+                        if (!indexFilter.empty()) {
+                            // Convert position in correlation volume to position in atlas
+                            const ivec3 pos(toAtlasIndex * vec4(vec3(ind), 1.0f));
+                            if (glm::all(glm::greaterThanEqual(pos, ivec3(0))) &&
+                                glm::all(glm::lessThan(pos, atlasDim))) {
+                                const auto label =
+                                    static_cast<int>(atlasData[atlasIm(size3_t(pos))]);
+                                if (indexFilter.count(static_cast<size_t>(label)) != 0) {
+                                    maskVal |= maskSelection;
+                                }
+                            }
+                        }
+                        if (brainData[i] != ValueType{0}) maskVal |= maskBrain;
+                        maskData[i] = maskVal;
+                    });
+                });
+        });
+}
 
-    auto brainRAM = volume.getRepresentation<VolumeRAM>();
+AtlasVolumeMaskBuilder::AtlasVolumeMaskBuilder(const Volume& volume, const Volume& atlas)
+    : index_{AtlasVoxelIndex::resampled(atlas, volume)} {
+    const auto dims = volume.getDimensions();
+    auto ram = std::make_shared<VolumeRAMPrecision<uint8_t>>(dims);
+    const auto maskData = ram->getDataTyped();
 
-    constexpr unsigned char maskSelection{1 << 6};  // 0100 0000
-    constexpr unsigned char maskBrain{1 << 7};      // 1000 0000
-    util::IndexMapper3D im(dim);
+    volume.getRepresentation<VolumeRAM>()->dispatch<void, dispatching::filter::Scalars>(
+        [&](auto vr) {
+            using ValueType = util::PrecisionValueType<decltype(vr)>;
+            const auto data = vr->getDataTyped();
+            util::parallelForBlocks(glm::compMul(dims), size_t{1} << 16,
+                                    [&](size_t, size_t first, size_t last) {
+                                        for (size_t i = first; i < last; ++i) {
+                                            maskData[i] =
+                                                data[i] != ValueType{0} ? maskBrain : uint8_t{0};
+                                        }
+                                    });
+        });
 
-    util::forEachVoxelParallel(*resMask, [&](const size3_t& ind) {
-        uint8_t maskVal = 0;
-        if (!indexFilter.empty()) {
-            // Convert position in correlation volume to position in indexed volume
-            vec3 worldCoordinates(vec3(indexToWorld * ivec4(ind, 1)));
-            auto indexCoordinates(size3_t(worldToIndex * vec4(worldCoordinates, 1.0f)));
+    mask_ = std::make_shared<Volume>(ram);
+    mask_->setModelMatrix(volume.getModelMatrix());
+    mask_->setWorldMatrix(volume.getWorldMatrix());
+}
 
-            // Calculate a value for the voxel only if it's part of a selected region
-            auto voxelValue = volRamIndexed->dispatch<int, dispatching::filter::Scalars>(
-                [indexCoordinates](auto vr) {
-                    return static_cast<int>(
-                        vr->getDataTyped()[vr->posToIndex(indexCoordinates, vr->getDimensions())]);
-                });
-            if (indexFilter.find(voxelValue) != indexFilter.end()) {
-                maskVal |= maskSelection;
+void AtlasVolumeMaskBuilder::setSelection(const std::unordered_set<int>& labels) {
+    std::vector<int> removed;
+    for (auto label : selection_) {
+        if (labels.count(label) == 0) removed.push_back(label);
+    }
+    for (auto label : removed) removeRegion(label);
+    for (auto label : labels) addRegion(label);
+}
+
+bool AtlasVolumeMaskBuilder::addRegion(int label) {
+    if (!selection_.insert(label).second) return false;
+    updateRegion(label, true);
+    return true;
+}
+
+bool AtlasVolumeMaskBuilder::removeRegion(int label) {
+    if (selection_.erase(label) == 0) return false;
+    updateRegion(label, false);
+    return true;
+}
+
+void AtlasVolumeMaskBuilder::updateRegion(int label, bool selected) {
+    const auto voxels = index_.getVoxels(label);
+    if (voxels.empty()) return;
+    // Requesting the editable representation invalidates other representations, e.g. on the GPU
+    const auto maskData = static_cast<VolumeRAMPrecision<uint8_t>*>(
+                              mask_->getEditableRepresentation<VolumeRAM>())
+                              ->getDataTyped();
+    const auto first = voxels.begin();
+    util::parallelForBlocks(voxels.size(), size_t{1} << 14, [&](size_t, size_t begin, size_t end) {
+        for (auto it = first + begin; it != first + end; ++it) {
+            if (selected) {
+                maskData[*it] |= maskSelection;
+            } else {
+                maskData[*it] &= static_cast<uint8_t>(~maskSelection);
             }
         }
-        auto notZero = brainRAM->dispatch<bool, dispatching::filter::Scalars>([ind](auto vr) {
-            return vr->getDataTyped()[vr->posToIndex(ind, vr->getDimensions())] != 0;
-        });
-        if (notZero) {
-            maskVal |= maskBrain;
+    });
+    updatedVoxels_ += voxels.size();
+}
+
+const std::unordered_set<int>& AtlasVolumeMaskBuilder::getSelection() const {
+    return selection_;
+}
+
+std::shared_ptr<const Volume> AtlasVolumeMaskBuilder::getMask() const { return mask_; }
+
+size_t AtlasVolumeMaskBuilder::getNumberOfUpdatedVoxels() const { return updatedVoxels_; }
+
+std::shared_ptr<Volume> brainMask(const VolumeSequence& volumes,
+                                  const util::BlockControl& control) {
+    if (volumes.empty()) return nullptr;
+
+    const auto& first = volumes.front();
+    const auto dims = first->getDimensions();
+    const auto pin = util::VolumeMemoryAccountant::get().pin(volumes);
+    std::vector<const VolumeRAM*> volumeRAMs;
+    size_t bytesPerVoxel = 0;
+    for (const auto& volume : volumes) {
+        if (glm::any(volume->getDimensions() != dims)) {
+            throw Exception("Expected all volumes to have same resolution",
+                            IVW_CONTEXT_CUSTOM("BrainMask"));
         }
+        volumeRAMs.push_back(volume->getRepresentation<VolumeRAM>());
+        bytesPerVoxel += volume->getDataFormat()->getSize();
+    }
 
-        maskData[im(ind)] = maskVal;
-    });
+    auto ram = std::make_shared<VolumeRAMPrecision<uint8_t>>(dims);
+    auto maskData = ram->getDataTyped();
+    // Each block visits all volumes so that the mask stays in cache
+    const bool completed = util::parallelForBlocks(
+        glm::compMul(dims), size_t{1} << 14,
+        [&](size_t, size_t begin, size_t end) {
+            const util::PhaseTimer timer(control.metrics, util::JobPhase::Compute);
+            if (control.metrics) {
+                control.metrics->addVoxels(end - begin);
+                control.metrics->addBytes((end - begin) * bytesPerVoxel);
+            }
+            std::fill(maskData + begin, maskData + end, uint8_t{0});
+            for (auto volumeRAM : volumeRAMs) {
+                volumeRAM->dispatch<void, dispatching::filter::Scalars>([&](auto vr) {
+                    using ValueType = util::PrecisionValueType<decltype(vr)>;
+                    const auto data = vr->getDataTyped();
+                    for (size_t i = begin; i < end; ++i) {
+                        if (data[i] != ValueType{0}) maskData[i] = maskBrain;
+                    }
+                });
+            }
+        },
+        control);
+    if (!completed) return nullptr;
+
+    auto mask = std::make_shared<Volume>(ram);
+    mask->setModelMatrix(first->getModelMatrix());
+    mask->setWorldMatrix(first->getWorldMatrix());
+    return mask;
 }
+
 }  // namespace inviwo
@@ -0,0 +1,265 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/algorithm/volume/cohortfile.h>
+#include <inviwo/core/util/exception.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+namespace inviwo {
+
+namespace stats {
+
+namespace {
+
+constexpr char cohortMagic[8] = {'V', 'N', 'C', 'O', 'H', 'O', 'R', 'T'};
+constexpr std::uint32_t cohortVersion = 1;
+
+// Values start directly after the header, which is padded to keep them cache line aligned
+struct CohortFileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t headerSize;
+    std::uint64_t dims[3];
+    std::uint64_t subjects;
+    std::uint64_t namesOffset;
+    // Offset of the source stamps after the names, 0 if there are none
+    std::uint64_t stampsOffset;
+};
+static_assert(sizeof(CohortFileHeader) == 64);
+
+}  // namespace
+
+CohortSourceStamp CohortSourceStamp::of(const std::filesystem::path& file) {
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(file, ec);
+    const auto modified = ec ? std::filesystem::file_time_type{}
+                             : std::filesystem::last_write_time(file, ec);
+    if (ec) {
+        throw Exception(fmt::format("Could not read the size and time of {}: {}", file,
+                                    ec.message()),
+                        IVW_CONTEXT_CUSTOM("CohortFile"));
+    }
+    return {static_cast<std::uint64_t>(size),
+            static_cast<std::int64_t>(modified.time_since_epoch().count())};
+}
+
+bool writeCohortFile(const VoxelSource& source, const std::vector<std::string>& subjectNames,
+                     const std::filesystem::path& file, const util::BlockControl& control,
+                     const std::vector<CohortSourceStamp>& sourceStamps) {
+    const auto nSubjects = source.getNumberOfSubjects();
+    const auto nVoxels = source.getNumberOfVoxels();
+    if (subjectNames.size() != nSubjects) {
+        throw Exception(fmt::format("Expected {} subject names, got {}", nSubjects,
+                                    subjectNames.size()),
+                        IVW_CONTEXT_CUSTOM("CohortFile"));
+    }
+    if (!sourceStamps.empty() && sourceStamps.size() != nSubjects) {
+        throw Exception(fmt::format("Expected {} source stamps, got {}", nSubjects,
+                                    sourceStamps.size()),
+                        IVW_CONTEXT_CUSTOM("CohortFile"));
+    }
+    std::ofstream out(file, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw Exception(fmt::format("Could not write {}", file), IVW_CONTEXT_CUSTOM("CohortFile"));
+    }
+
+    const auto dims = source.getDimensions();
+    CohortFileHeader header{};
+    std::memcpy(header.magic, cohortMagic, sizeof(cohortMagic));
+    header.version = cohortVersion;
+    header.headerSize = sizeof(CohortFileHeader);
+    header.dims[0] = dims.x;
+    header.dims[1] = dims.y;
+    header.dims[2] = dims.z;
+    header.subjects = nSubjects;
+    header.namesOffset = sizeof(CohortFileHeader) + nVoxels * nSubjects * sizeof(float);
+    if (!sourceStamps.empty()) {
+        header.stampsOffset = header.namesOffset;
+        for (const auto& name : subjectNames) {
+            header.stampsOffset += sizeof(std::uint32_t) + name.size();
+        }
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // Gather chunks in parallel and write them in order, around 64 MB per chunk
+    const size_t chunkVoxels =
+        std::max<size_t>((size_t{1} << 24) / std::max<size_t>(nSubjects, 1), 1);
+    std::vector<float> chunk;
+    std::vector<VoxelBlock> blocks(util::parallelForBlocksWorkers());
+    for (size_t chunkStart = 0; chunkStart < nVoxels; chunkStart += chunkVoxels) {
+        const auto n = std::min(chunkVoxels, nVoxels - chunkStart);
+        chunk.resize(n * nSubjects);
+        const bool completed = util::parallelForBlocks(
+            n, 1024,
+            [&](size_t worker, size_t first, size_t last) {
+                auto& block = blocks[worker];
+                source.gather(chunkStart + first, last - first, block);
+                std::transform(block.voxel(0), block.voxel(last - first),
+                               chunk.begin() + first * nSubjects,
+                               [](double v) { return static_cast<float>(v); });
+            },
+            {control.stop, {}});
+        if (!completed) return false;
+        out.write(reinterpret_cast<const char*>(chunk.data()), chunk.size() * sizeof(float));
+        if (control.progress) control.progress(chunkStart + n, nVoxels);
+    }
+
+    for (const auto& name : subjectNames) {
+        const auto length = static_cast<std::uint32_t>(name.size());
+        out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        out.write(name.data(), length);
+    }
+    for (const auto& stamp : sourceStamps) {
+        out.write(reinterpret_cast<const char*>(&stamp.size), sizeof(stamp.size));
+        out.write(reinterpret_cast<const char*>(&stamp.modified), sizeof(stamp.modified));
+    }
+    if (!out) {
+        throw Exception(fmt::format("Could not write {}", file), IVW_CONTEXT_CUSTOM("CohortFile"));
+    }
+    return true;
+}
+
+CohortFileVoxelSource::CohortFileVoxelSource(const std::filesystem::path& file) : file_{file} {
+    CohortFileHeader header;
+    if (file_.size() < sizeof(header)) {
+        throw Exception(fmt::format("{} is not a cohort file", file),
+                        IVW_CONTEXT_CUSTOM("CohortFileVoxelSource"));
+    }
+    std::memcpy(&header, file_.data(), sizeof(header));
+    if (std::memcmp(header.magic, cohortMagic, sizeof(cohortMagic)) != 0) {
+        throw Exception(fmt::format("{} is not a cohort file", file),
+                        IVW_CONTEXT_CUSTOM("CohortFileVoxelSource"));
+    }
+    if (header.version != cohortVersion) {
+        throw Exception(fmt::format("Unsupported cohort file version {} in {}, expected {}",
+                                    header.version, file, cohortVersion),
+                        IVW_CONTEXT_CUSTOM("CohortFileVoxelSource"));
+    }
+    dims_ = size3_t(header.dims[0], header.dims[1], header.dims[2]);
+    nSubjects_ = header.subjects;
+    const auto valuesEnd = header.headerSize + glm::compMul(dims_) * nSubjects_ * sizeof(float);
+    if (header.namesOffset != valuesEnd || file_.size() < valuesEnd) {
+        throw Exception(fmt::format("Cohort file {} is truncated", file),
+                        IVW_CONTEXT_CUSTOM("CohortFileVoxelSource"));
+    }
+    values_ = reinterpret_cast<const float*>(file_.data() + header.headerSize);
+
+    const auto end = file_.data() + file_.size();
+    auto it = file_.data() + header.namesOffset;
+    for (size_t i = 0; i < nSubjects_; ++i) {
+        std::uint32_t length = 0;
+        if (end - it < static_cast<std::ptrdiff_t>(sizeof(length))) break;
+        std::memcpy(&length, it, sizeof(length));
+        it += sizeof(length);
+        if (end - it < static_cast<std::ptrdiff_t>(length)) break;
+        subjectNames_.emplace_back(reinterpret_cast<const char*>(it), length);
+        it += length;
+    }
+    if (subjectNames_.size() != nSubjects_) {
+        throw Exception(fmt::format("Cohort file {} is truncated", file),
+                        IVW_CONTEXT_CUSTOM("CohortFileVoxelSource"));
+    }
+
+    if (header.stampsOffset != 0) {
+        constexpr auto stampBytes = sizeof(std::uint64_t) + sizeof(std::int64_t);
+        if (header.stampsOffset != static_cast<std::uint64_t>(it - file_.data()) ||
+            static_cast<size_t>(end - it) < nSubjects_ * stampBytes) {
+            throw Exception(fmt::format("Cohort file {} is truncated", file),
+                            IVW_CONTEXT_CUSTOM("CohortFileVoxelSource"));
+        }
+        sourceStamps_.resize(nSubjects_);
+        for (auto& stamp : sourceStamps_) {
+            std::memcpy(&stamp.size, it, sizeof(stamp.size));
+            std::memcpy(&stamp.modified, it + sizeof(stamp.size), sizeof(stamp.modified));
+            it += stampBytes;
+        }
+    }
+}
+
+size_t CohortFileVoxelSource::getNumberOfSubjects() const { return nSubjects_; }
+
+size3_t CohortFileVoxelSource::getDimensions() const { return dims_; }
+
+size_t CohortFileVoxelSource::getBytesPerVoxel() const { return nSubjects_ * sizeof(float); }
+
+void CohortFileVoxelSource::gather(size_t firstVoxel, size_t nVoxels, VoxelBlock& block) const {
+    block.resize(firstVoxel, nVoxels, nSubjects_);
+    const auto src = values_ + firstVoxel * nSubjects_;
+    std::copy(src, src + nVoxels * nSubjects_, block.voxel(0));
+}
+
+const std::vector<std::string>& CohortFileVoxelSource::getSubjectNames() const {
+    return subjectNames_;
+}
+
+const std::vector<CohortSourceStamp>& CohortFileVoxelSource::getSourceStamps() const {
+    return sourceStamps_;
+}
+
+const std::filesystem::path& CohortFileVoxelSource::getPath() const { return file_.path(); }
+
+SubjectSubsetVoxelSource::SubjectSubsetVoxelSource(const VoxelSource& source,
+                                                   std::vector<size_t> subjects)
+    : source_{source}, subjects_{std::move(subjects)} {
+    const auto n = source_.getNumberOfSubjects();
+    if (std::any_of(subjects_.begin(), subjects_.end(), [n](size_t s) { return s >= n; })) {
+        throw Exception(fmt::format("Subject index outside of source with {} subjects", n),
+                        IVW_CONTEXT_CUSTOM("SubjectSubsetVoxelSource"));
+    }
+}
+
+size_t SubjectSubsetVoxelSource::getNumberOfSubjects() const { return subjects_.size(); }
+
+size3_t SubjectSubsetVoxelSource::getDimensions() const { return source_.getDimensions(); }
+
+// All subjects of the underlying source are gathered before the subset is extracted
+size_t SubjectSubsetVoxelSource::getBytesPerVoxel() const { return source_.getBytesPerVoxel(); }
+
+void SubjectSubsetVoxelSource::gather(size_t firstVoxel, size_t nVoxels,
+                                      VoxelBlock& block) const {
+    // gather is called concurrently from several workers, keep one scratch block per thread
+    thread_local VoxelBlock all;
+    source_.gather(firstVoxel, nVoxels, all);
+    const auto nAll = all.getNumberOfSubjects();
+    const auto nSubset = subjects_.size();
+    block.resize(firstVoxel, nVoxels, nSubset);
+    const double* src = all.voxel(0);
+    double* dst = block.voxel(0);
+    for (size_t i = 0; i < nVoxels; ++i, src += nAll, dst += nSubset) {
+        for (size_t j = 0; j < nSubset; ++j) dst[j] = src[subjects_[j]];
+    }
+}
+
+}  // namespace stats
+
+}  // namespace inviwo
@@ -0,0 +1,273 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/algorithm/volume/regionaggregation.h>
+#include <modules/visualneuro/datastructures/atlasvoxelindex.h>
+#include <modules/visualneuro/util/jobmetrics.h>
+#include <inviwo/core/datastructures/volume/volumeram.h>
+#include <inviwo/core/util/exception.h>
+#include <inviwo/core/util/indexmapper.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace inviwo {
+
+namespace stats {
+
+RegionLookup regionLookup(const AtlasVoxelIndex& index) {
+    RegionLookup lookup;
+    lookup.dims = index.getDimensions();
+    const auto nVoxels = glm::compMul(lookup.dims);
+    for (auto label : index.getLabels()) {
+        if (label == 0) continue;
+        lookup.labels.push_back(label);
+        lookup.voxels.push_back(index.getNumberOfVoxels(label));
+    }
+
+    lookup.voxelRegion.assign(nVoxels, -1);
+    lookup.voxelRank.assign(nVoxels, 0);
+    // The voxels of each label are sorted, so their position is their rank within the region
+    util::parallelForBlocks(lookup.labels.size(), 1, [&](size_t, size_t first, size_t last) {
+        for (size_t region = first; region < last; ++region) {
+            std::uint32_t rank = 0;
+            for (auto voxel : index.getVoxels(lookup.labels[region])) {
+                lookup.voxelRegion[voxel] = static_cast<std::int32_t>(region);
+                lookup.voxelRank[voxel] = rank++;
+            }
+        }
+    });
+    return lookup;
+}
+
+RegionLookup atlasRegionLookup(const Volume& atlas, const Volume& reference) {
+    return regionLookup(AtlasVoxelIndex::resampled(atlas, reference));
+}
+
+std::optional<RegionAggregates> aggregateRegions(const VoxelSource& source,
+                                                 const RegionLookup& lookup, bool medians,
+                                                 const util::BlockControl& control) {
+    const auto nSubjects = source.getNumberOfSubjects();
+    const auto nVoxels = source.getNumberOfVoxels();
+    const auto nRegions = lookup.labels.size();
+    if (glm::any(source.getDimensions() != lookup.dims) || lookup.voxelRegion.size() != nVoxels) {
+        throw Exception("Expected the region lookup to have the dimensions of the volumes",
+                        IVW_CONTEXT_CUSTOM("RegionAggregation"));
+    }
+
+    RegionAggregates res;
+    res.labels = lookup.labels;
+    res.voxels = lookup.voxels;
+    res.subjects = nSubjects;
+
+    // The values of region r for subject s are stored contiguously at
+    // (offsets[r] * nSubjects + s * voxels[r]), each voxel at its rank within the region, so
+    // that the workers write to disjoint locations
+    std::vector<size_t> offsets(nRegions + 1, 0);
+    for (size_t r = 0; r < nRegions; ++r) offsets[r + 1] = offsets[r] + lookup.voxels[r];
+    std::vector<float> values(medians ? offsets.back() * nSubjects : 0);
+
+    struct WorkerState {
+        VoxelBlock block;
+        std::vector<double> sums;
+    };
+    std::vector<WorkerState> states(util::parallelForBlocksWorkers());
+
+    const auto blockSize =
+        std::clamp<size_t>((size_t{1} << 20) / std::max<size_t>(nSubjects, 1), 64, 16384);
+    const bool completed = util::parallelForBlocks(
+        nVoxels, blockSize,
+        [&](size_t worker, size_t first, size_t last) {
+            const auto regionBegin = lookup.voxelRegion.begin() + first;
+            if (std::all_of(regionBegin, regionBegin + (last - first),
+                            [](std::int32_t r) { return r < 0; })) {
+                return;
+            }
+            auto& state = states[worker];
+            if (state.sums.empty()) state.sums.assign(nRegions * nSubjects, 0.0);
+            gatherBlock(source, first, last - first, state.block, control);
+
+            const util::PhaseTimer timer(control.metrics, util::JobPhase::Compute);
+            for (size_t i = 0; i < last - first; ++i) {
+                const auto region = lookup.voxelRegion[first + i];
+                if (region < 0) continue;
+                const auto r = static_cast<size_t>(region);
+                const auto voxel = state.block.voxel(i);
+                auto sums = state.sums.data() + r * nSubjects;
+                for (size_t s = 0; s < nSubjects; ++s) sums[s] += voxel[s];
+                if (medians) {
+                    auto dst = values.data() + offsets[r] * nSubjects + lookup.voxelRank[first + i];
+                    for (size_t s = 0; s < nSubjects; ++s) {
+                        dst[s * lookup.voxels[r]] = static_cast<float>(voxel[s]);
+                    }
+                }
+            }
+        },
+        control);
+    if (!completed) return std::nullopt;
+
+    const auto nan = std::numeric_limits<double>::quiet_NaN();
+    res.means.assign(nSubjects * nRegions, nan);
+    for (size_t r = 0; r < nRegions; ++r) {
+        if (lookup.voxels[r] == 0) continue;
+        for (size_t s = 0; s < nSubjects; ++s) {
+            double sum = 0.0;
+            for (const auto& state : states) {
+                if (!state.sums.empty()) sum += state.sums[r * nSubjects + s];
+            }
+            res.means[s * nRegions + r] = sum / static_cast<double>(lookup.voxels[r]);
+        }
+    }
+
+    if (medians) {
+        res.medians.assign(nSubjects * nRegions, nan);
+        const util::PhaseTimer timer(control.metrics, util::JobPhase::Threshold);
+        util::parallelForBlocks(nRegions * nSubjects, 4, [&](size_t, size_t first, size_t last) {
+            for (size_t item = first; item < last; ++item) {
+                const auto r = item / nSubjects;
+                const auto s = item % nSubjects;
+                const auto n = lookup.voxels[r];
+                if (n == 0) continue;
+                const auto begin = values.begin() + offsets[r] * nSubjects + s * n;
+                const auto mid = begin + n / 2;
+                std::nth_element(begin, mid, begin + n);
+                double median = *mid;
+                if (n % 2 == 0) median = 0.5 * (median + *std::max_element(begin, mid));
+                res.medians[s * nRegions + r] = median;
+            }
+        });
+    }
+    return res;
+}
+
+std::optional<ZonalStatistics> zonalStatistics(const Volume& map, const RegionLookup& lookup,
+                                               double significanceThreshold,
+                                               const util::BlockControl& control) {
+    const auto nVoxels = glm::compMul(lookup.dims);
+    const auto nRegions = lookup.labels.size();
+    if (glm::any(map.getDimensions() != lookup.dims) || lookup.voxelRegion.size() != nVoxels) {
+        throw Exception("Expected the region lookup to have the dimensions of the map",
+                        IVW_CONTEXT_CUSTOM("ZonalStatistics"));
+    }
+
+    struct Accumulator {
+        double sum = 0.0;
+        size_t finite = 0;
+        size_t significant = 0;
+        double max = std::numeric_limits<double>::lowest();
+        double peakValue = 0.0;
+        size_t peak = std::numeric_limits<size_t>::max();
+    };
+    // Per worker accumulators, allocated by the first block a worker processes
+    std::vector<std::vector<Accumulator>> states(util::parallelForBlocksWorkers());
+
+    // Statistics are computed in the value domain, as VolumeSequenceVoxelSource
+    const auto offset = map.dataMap.mapFromDataToValue(0.0);
+    const auto scale = map.dataMap.mapFromDataToValue(1.0) - offset;
+
+    const util::PhaseTimer timer(control.metrics, util::JobPhase::Compute);
+    const bool completed =
+        map.getRepresentation<VolumeRAM>()->dispatch<bool, dispatching::filter::Scalars>(
+            [&](auto vr) {
+                const auto data = vr->getDataTyped();
+                return util::parallelForBlocks(
+                    nVoxels, size_t{1} << 16,
+                    [&](size_t worker, size_t first, size_t last) {
+                        auto& acc = states[worker];
+                        if (acc.empty()) acc.resize(nRegions);
+                        for (size_t i = first; i < last; ++i) {
+                            const auto region = lookup.voxelRegion[i];
+                            if (region < 0) continue;
+                            const auto value = scale * static_cast<double>(data[i]) + offset;
+                            if (std::isnan(value)) continue;
+                            auto& a = acc[static_cast<size_t>(region)];
+                            a.sum += value;
+                            ++a.finite;
+                            a.max = std::max(a.max, value);
+                            if (std::abs(value) > significanceThreshold) ++a.significant;
+                            // Blocks can be visited in any order, prefer the lowest index
+                            const auto absValue = std::abs(value);
+                            const auto absPeak = std::abs(a.peakValue);
+                            if (a.peak == std::numeric_limits<size_t>::max() ||
+                                absValue > absPeak || (absValue == absPeak && i < a.peak)) {
+                                a.peakValue = value;
+                                a.peak = i;
+                            }
+                        }
+                        if (control.metrics) control.metrics->addVoxels(last - first);
+                    },
+                    control);
+            });
+    if (!completed) return std::nullopt;
+
+    const auto nan = std::numeric_limits<double>::quiet_NaN();
+    ZonalStatistics res;
+    res.labels = lookup.labels;
+    res.voxels = lookup.voxels;
+    res.means.assign(nRegions, nan);
+    res.maxima.assign(nRegions, nan);
+    res.significantFractions.assign(nRegions, 0.0);
+    res.peakValues.assign(nRegions, nan);
+    res.peaks.assign(nRegions, size3_t{0});
+    const util::IndexMapper3D im(lookup.dims);
+    for (size_t r = 0; r < nRegions; ++r) {
+        Accumulator total;
+        for (const auto& acc : states) {
+            if (acc.empty()) continue;
+            const auto& a = acc[r];
+            total.sum += a.sum;
+            total.finite += a.finite;
+            total.significant += a.significant;
+            total.max = std::max(total.max, a.max);
+            if (a.peak == std::numeric_limits<size_t>::max()) continue;
+            const auto absValue = std::abs(a.peakValue);
+            const auto absTotal = std::abs(total.peakValue);
+            if (total.peak == std::numeric_limits<size_t>::max() || absValue > absTotal ||
+                (absValue == absTotal && a.peak < total.peak)) {
+                total.peakValue = a.peakValue;
+                total.peak = a.peak;
+            }
+        }
+        if (lookup.voxels[r] > 0) {
+            res.significantFractions[r] = static_cast<double>(total.significant) /
+                                          static_cast<double>(lookup.voxels[r]);
+        }
+        if (total.finite == 0) continue;
+        res.means[r] = total.sum / static_cast<double>(total.finite);
+        res.maxima[r] = total.max;
+        res.peakValues[r] = total.peakValue;
+        res.peaks[r] = im(total.peak);
+    }
+    return res;
+}
+
+}  // namespace stats
+
+}  // namespace inviwo
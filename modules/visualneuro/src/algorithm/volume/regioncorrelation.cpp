@@ -0,0 +1,405 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/algorithm/volume/regioncorrelation.h>
+#include <modules/visualneuro/algorithm/volume/gridresampling.h>
+#include <modules/visualneuro/statistics/spearmancorrelation.h>
+#include <modules/visualneuro/util/jobmetrics.h>
+#include <inviwo/core/util/exception.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace inviwo {
+
+namespace stats {
+
+namespace {
+
+// Subjects missing a parameter are excluded from the correlations with that parameter.
+// Parameters missing the same subjects share a group, so that the voxel values of the included
+// subjects are gathered and standardized, or ranked, once per group and voxel. The parameter
+// values are stored standardized for Pearson and ranked for Spearman correlations, one row of
+// included.size() values per parameter.
+struct ParameterGroup {
+    std::vector<std::uint32_t> included;
+    std::vector<size_t> parameters;
+    std::vector<double> values;
+    // Position of the first parameter of the group when all groups are concatenated
+    size_t offset = 0;
+};
+
+std::vector<ParameterGroup> groupParameters(const dataframe::ParameterMatrix& parameters,
+                                            size_t nSubjects,
+                                            const CorrelationSettings& settings) {
+    if (parameters.getNumberOfSubjects() != nSubjects) {
+        throw Exception(fmt::format("Expected one parameter value per subject, got {} values "
+                                    "for {} subjects",
+                                    parameters.getNumberOfSubjects(), nSubjects),
+                        IVW_CONTEXT_CUSTOM("RegionCorrelation"));
+    }
+    std::vector<ParameterGroup> groups;
+    size_t offset = 0;
+    for (auto& members : parameters.groupByValidity()) {
+        auto& group = groups.emplace_back();
+        group.included = parameters.getValidSubjects(members.front());
+        group.values.reserve(members.size() * group.included.size());
+        for (auto i : members) {
+            const auto values = settings.method == CorrelationMethod::Pearson
+                                    ? parameters.getStandardizedValues(i)
+                                    : rank(parameters.getValidValues(i));
+            group.values.insert(group.values.end(), values.begin(), values.end());
+        }
+        group.offset = offset;
+        offset += members.size();
+        group.parameters = std::move(members);
+    }
+    return groups;
+}
+
+size_t voxelsPerBlock(size_t nSubjects) {
+    return std::clamp<size_t>((size_t{1} << 20) / std::max<size_t>(nSubjects, 1), 64, 16384);
+}
+
+// Append the significant correlations of the parameters at positions [first, last) of the
+// concatenated groups with voxel. Equal to corrTest of each parameter and the voxel values of its
+// included subjects.
+void correlateVoxel(const double* voxel, const std::vector<ParameterGroup>& groups, size_t first,
+                    size_t last, const CorrelationSettings& settings, std::vector<double>& values,
+                    std::vector<std::vector<double>>& correlations) {
+    const bool pearson = settings.method == CorrelationMethod::Pearson;
+    for (const auto& group : groups) {
+        const auto begin = std::max(first, group.offset);
+        const auto end = std::min(last, group.offset + group.parameters.size());
+        const auto n = group.included.size();
+        if (begin >= end || n < 3) continue;
+
+        values.resize(n);
+        for (size_t j = 0; j < n; ++j) values[j] = voxel[group.included[j]];
+        const auto size = static_cast<double>(n);
+        double denominator = 0.0;
+        if (pearson) {
+            // Center the voxel values, see standardizedPearsonTest
+            const auto mean = std::accumulate(values.begin(), values.end(), 0.0) / size;
+            double squares = 0.0;
+            for (auto& value : values) {
+                value -= mean;
+                squares += value * value;
+            }
+            denominator = std::sqrt(size * squares);
+        } else {
+            values = rank(values.begin(), values.end());
+            denominator = size * (size * size - 1.0);
+        }
+
+        for (auto k = begin; k < end; ++k) {
+            const auto param = group.values.data() + (k - group.offset) * n;
+            double sum = 0.0;
+            if (pearson) {
+                for (size_t j = 0; j < n; ++j) sum += param[j] * values[j];
+            } else {
+                for (size_t j = 0; j < n; ++j) {
+                    const auto diff = param[j] - values[j];
+                    sum += diff * diff;
+                }
+            }
+            const auto corr = pearson ? sum / denominator : 1.0 - 6.0 * sum / denominator;
+            if (correlationPValue(corr, n, settings.tail) < settings.pValue) {
+                correlations[group.parameters[k - group.offset]].push_back(corr);
+            }
+        }
+    }
+}
+
+// Concatenate and sort the correlations of each parameter over all workers
+template <typename WorkerState>
+std::vector<std::vector<double>> mergeCorrelations(const std::vector<WorkerState>& states,
+                                                   size_t nParameters,
+                                                   const util::BlockControl& control) {
+    const util::PhaseTimer timer(control.metrics, util::JobPhase::Threshold);
+    std::vector<std::vector<double>> res(nParameters);
+    for (size_t i = 0; i < res.size(); ++i) {
+        for (auto& s : states) {
+            res[i].insert(res[i].end(), s.correlations[i].begin(), s.correlations[i].end());
+        }
+        std::sort(res[i].begin(), res[i].end());
+    }
+    return res;
+}
+
+// Voxels closer than this are read with one gather call, reading the voxels in between as well
+constexpr std::uint32_t maxGatherGap = 32;
+
+// Gather the values of the sorted voxels [first, last) into values, nSubjects values per voxel
+void gatherVoxels(const VoxelSource& source, const std::uint32_t* first,
+                  const std::uint32_t* last, size_t maxSpan, VoxelBlock& block,
+                  std::vector<double>& values, const util::BlockControl& control) {
+    const auto nSubjects = source.getNumberOfSubjects();
+    values.resize(static_cast<size_t>(last - first) * nSubjects);
+    auto out = values.data();
+    for (auto it = first; it != last;) {
+        const size_t begin = *it;
+        auto runEnd = it + 1;
+        while (runEnd != last && *runEnd - *(runEnd - 1) <= maxGatherGap &&
+               *runEnd - begin < maxSpan) {
+            ++runEnd;
+        }
+        gatherBlock(source, begin, *(runEnd - 1) - begin + 1, block, control);
+        for (; it != runEnd; ++it) {
+            out = std::copy_n(block.voxel(*it - begin), nSubjects, out);
+        }
+    }
+}
+
+}  // namespace
+
+std::vector<unsigned char> atlasRegionsToGrid(const Volume& atlas, const Volume& reference,
+                                              const std::function<bool(int)>& isSelected) {
+    std::vector<unsigned char> res(glm::compMul(reference.getDimensions()), 0);
+    util::forEachResampledVoxel(atlas, reference, [&](size_t i, auto label) {
+        res[i] = isSelected(static_cast<int>(label));
+    });
+    return res;
+}
+
+std::optional<std::vector<std::vector<double>>> regionParameterCorrelations(
+    const VoxelSource& source, const std::vector<std::vector<double>>& parameters,
+    const std::vector<unsigned char>& regionMask, const CorrelationSettings& settings,
+    const util::BlockControl& control) {
+    // Without parameters the matrix would have no subjects to match source
+    if (parameters.empty()) return std::vector<std::vector<double>>{};
+    return regionParameterCorrelations(source, dataframe::ParameterMatrix(parameters), regionMask,
+                                       settings, control);
+}
+
+std::optional<std::vector<std::vector<double>>> regionParameterCorrelations(
+    const VoxelSource& source, const dataframe::ParameterMatrix& parameters,
+    const std::vector<unsigned char>& regionMask, const CorrelationSettings& settings,
+    const util::BlockControl& control) {
+    const auto nSubjects = source.getNumberOfSubjects();
+    const auto nVoxels = source.getNumberOfVoxels();
+    if (regionMask.size() != nVoxels) {
+        throw Exception("Expected one region mask value per voxel",
+                        IVW_CONTEXT_CUSTOM("RegionCorrelation"));
+    }
+
+    const auto nParameters = parameters.getNumberOfParameters();
+    const auto groups = groupParameters(parameters, nSubjects, settings);
+
+    struct WorkerState {
+        VoxelBlock block;
+        std::vector<double> values;
+        std::vector<std::vector<double>> correlations;
+    };
+    std::vector<WorkerState> states(util::parallelForBlocksWorkers());
+    for (auto& s : states) s.correlations.resize(nParameters);
+
+    const bool completed = util::parallelForBlocks(
+        nVoxels, voxelsPerBlock(nSubjects),
+        [&](size_t worker, size_t first, size_t last) {
+            // Regions usually cover a small part of the volume, skip blocks outside of them
+            const auto maskBegin = regionMask.begin() + first;
+            if (std::all_of(maskBegin, maskBegin + (last - first),
+                            [](unsigned char m) { return m == 0; })) {
+                return;
+            }
+            auto& s = states[worker];
+            gatherBlock(source, first, last - first, s.block, control);
+            const util::PhaseTimer timer(control.metrics, util::JobPhase::Compute);
+            if (control.metrics) control.metrics->addVoxels(last - first);
+            for (size_t i = 0; i < last - first; ++i) {
+                if (regionMask[first + i] == 0) continue;
+                correlateVoxel(s.block.voxel(i), groups, 0, nParameters, settings, s.values,
+                               s.correlations);
+            }
+        },
+        control);
+    if (!completed) return std::nullopt;
+
+    return mergeCorrelations(states, nParameters, control);
+}
+
+std::optional<std::vector<std::vector<double>>> regionParameterCorrelations(
+    const VoxelSource& source, const std::vector<std::vector<double>>& parameters,
+    const std::vector<std::uint32_t>& voxels, const CorrelationSettings& settings,
+    const util::BlockControl& control) {
+    // Without parameters the matrix would have no subjects to match source
+    if (parameters.empty()) return std::vector<std::vector<double>>{};
+    return regionParameterCorrelations(source, dataframe::ParameterMatrix(parameters), voxels,
+                                       settings, control);
+}
+
+std::optional<std::vector<std::vector<double>>> regionParameterCorrelations(
+    const VoxelSource& source, const dataframe::ParameterMatrix& parameters,
+    const std::vector<std::uint32_t>& voxels, const CorrelationSettings& settings,
+    const util::BlockControl& control) {
+    const auto nSubjects = source.getNumberOfSubjects();
+    if (!std::is_sorted(voxels.begin(), voxels.end()) ||
+        (!voxels.empty() && voxels.back() >= source.getNumberOfVoxels())) {
+        throw Exception("Expected sorted voxel indices inside the volumes",
+                        IVW_CONTEXT_CUSTOM("RegionCorrelation"));
+    }
+    const auto nParameters = parameters.getNumberOfParameters();
+    const auto groups = groupParameters(parameters, nSubjects, settings);
+
+    // A small region gives fewer voxel chunks than workers, in which case the parameters of each
+    // chunk are split between workers as well. Workers keep the last gathered chunk, so that
+    // parameter splits of the same chunk do not gather it again.
+    const auto chunkSize = voxelsPerBlock(nSubjects);
+    const auto nChunks = (voxels.size() + chunkSize - 1) / chunkSize;
+    const auto nWorkers = util::parallelForBlocksWorkers();
+    const auto nSplits =
+        nChunks == 0 || nChunks >= nWorkers || nParameters < 2
+            ? size_t{1}
+            : std::clamp<size_t>((nWorkers + nChunks - 1) / nChunks, 1, nParameters);
+    const auto paramsPerSplit = (nParameters + nSplits - 1) / nSplits;
+
+    struct WorkerState {
+        VoxelBlock block;
+        size_t chunk = std::numeric_limits<size_t>::max();
+        std::vector<double> chunkValues;
+        std::vector<double> values;
+        std::vector<std::vector<double>> correlations;
+    };
+    std::vector<WorkerState> states(nWorkers);
+    for (auto& s : states) s.correlations.resize(nParameters);
+
+    const bool completed = util::parallelForBlocks(
+        nChunks * nSplits, 1,
+        [&](size_t worker, size_t item, size_t) {
+            const auto chunk = item / nSplits;
+            const auto split = item % nSplits;
+            const auto first = voxels.data() + chunk * chunkSize;
+            const auto last = voxels.data() + std::min(voxels.size(), (chunk + 1) * chunkSize);
+            const auto nChunkVoxels = static_cast<size_t>(last - first);
+
+            auto& s = states[worker];
+            if (s.chunk != chunk) {
+                gatherVoxels(source, first, last, chunkSize, s.block, s.chunkValues, control);
+                s.chunk = chunk;
+            }
+            const util::PhaseTimer timer(control.metrics, util::JobPhase::Compute);
+            if (control.metrics && split == 0) control.metrics->addVoxels(nChunkVoxels);
+            const auto firstParam = std::min(nParameters, split * paramsPerSplit);
+            const auto lastParam = std::min(nParameters, firstParam + paramsPerSplit);
+            for (size_t i = 0; i < nChunkVoxels; ++i) {
+                correlateVoxel(s.chunkValues.data() + i * nSubjects, groups, firstParam,
+                               lastParam, settings, s.values, s.correlations);
+            }
+        },
+        control);
+    if (!completed) return std::nullopt;
+
+    return mergeCorrelations(states, nParameters, control);
+}
+
+CorrelationQuantiles correlationQuantiles(const std::vector<double>& sorted) {
+    if (sorted.empty()) {
+        const auto nan = std::numeric_limits<double>::quiet_NaN();
+        return {nan, nan, nan, nan, nan};
+    }
+    const auto n = sorted.size();
+    return {sorted.front(), sorted[static_cast<size_t>(n * 0.25)],
+            sorted[static_cast<size_t>(n / 2.0)], sorted[static_cast<size_t>(n * 0.75)],
+            sorted.back()};
+}
+
+namespace {
+
+// The k-th smallest value in the union of the sorted runs, k < total number of values. Each step
+// takes the middle value of the longest remaining run as pivot and keeps the values below or
+// above it in every run, so the longest run is at least halved.
+double orderStatistic(const std::vector<const std::vector<double>*>& runs, size_t k) {
+    std::vector<std::pair<size_t, size_t>> ranges;
+    for (auto run : runs) ranges.emplace_back(0, run->size());
+    std::vector<std::pair<size_t, size_t>> split(runs.size());
+    while (true) {
+        size_t longest = 0;
+        for (size_t i = 1; i < ranges.size(); ++i) {
+            if (ranges[i].second - ranges[i].first >
+                ranges[longest].second - ranges[longest].first) {
+                longest = i;
+            }
+        }
+        const auto& run = *runs[longest];
+        const auto pivot = run[(ranges[longest].first + ranges[longest].second) / 2];
+
+        size_t below = 0;
+        size_t equal = 0;
+        for (size_t i = 0; i < runs.size(); ++i) {
+            const auto first = runs[i]->begin() + ranges[i].first;
+            const auto last = runs[i]->begin() + ranges[i].second;
+            const auto [lower, upper] = std::equal_range(first, last, pivot);
+            split[i] = {static_cast<size_t>(lower - runs[i]->begin()),
+                        static_cast<size_t>(upper - runs[i]->begin())};
+            below += static_cast<size_t>(lower - first);
+            equal += static_cast<size_t>(upper - lower);
+        }
+        if (k < below) {
+            for (size_t i = 0; i < runs.size(); ++i) ranges[i].second = split[i].first;
+        } else if (k < below + equal) {
+            return pivot;
+        } else {
+            k -= below + equal;
+            for (size_t i = 0; i < runs.size(); ++i) ranges[i].first = split[i].second;
+        }
+    }
+}
+
+}  // namespace
+
+CorrelationQuantiles correlationQuantiles(
+    const std::vector<const std::vector<double>*>& sortedRuns) {
+    std::vector<const std::vector<double>*> runs;
+    size_t n = 0;
+    for (auto run : sortedRuns) {
+        if (!run || run->empty()) continue;
+        runs.push_back(run);
+        n += run->size();
+    }
+    if (n == 0) {
+        const auto nan = std::numeric_limits<double>::quiet_NaN();
+        return {nan, nan, nan, nan, nan};
+    }
+    auto minValue = runs.front()->front();
+    auto maxValue = runs.front()->back();
+    for (auto run : runs) {
+        minValue = std::min(minValue, run->front());
+        maxValue = std::max(maxValue, run->back());
+    }
+    return {minValue, orderStatistic(runs, static_cast<size_t>(n * 0.25)),
+            orderStatistic(runs, static_cast<size_t>(n / 2.0)),
+            orderStatistic(runs, static_cast<size_t>(n * 0.75)), maxValue};
+}
+
+}  // namespace stats
+
+}  // namespace inviwo
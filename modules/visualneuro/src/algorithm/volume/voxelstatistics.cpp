@@ -0,0 +1,468 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/algorithm/volume/voxelstatistics.h>
+#include <modules/visualneuro/algorithm/volume/gridresampling.h>
+#include <modules/visualneuro/util/jobmetrics.h>
+#include <modules/visualneuro/util/tracerecorder.h>
+#include <inviwo/core/datastructures/volume/volumeramprecision.h>
+#include <inviwo/core/util/exception.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <optional>
+#include <utility>
+
+namespace inviwo {
+
+namespace stats {
+
+namespace {
+
+// Keep each gathered block around 8 MB regardless of cohort size
+size_t voxelsPerBlock(size_t nSubjects) {
+    return std::clamp<size_t>((size_t{1} << 20) / std::max<size_t>(nSubjects, 1), 64, 16384);
+}
+
+void checkRange(const VoxelSource& source, size_t firstVoxel, size_t nVoxels) {
+    if (firstVoxel + nVoxels > source.getNumberOfVoxels()) {
+        throw Exception(fmt::format("Voxel range [{}, {}) is outside of volume with {} voxels",
+                                    firstVoxel, firstVoxel + nVoxels, source.getNumberOfVoxels()),
+                        IVW_CONTEXT_CUSTOM("VoxelStatistics"));
+    }
+}
+
+dvec2 minMax(const float* data, size_t n) {
+    dvec2 range(std::numeric_limits<double>::max(), std::numeric_limits<double>::lowest());
+    for (size_t i = 0; i < n; ++i) {
+        range.x = std::min(range.x, static_cast<double>(data[i]));
+        range.y = std::max(range.y, static_cast<double>(data[i]));
+    }
+    if (std::abs(range.y - range.x) < std::numeric_limits<double>::denorm_min()) {
+        // Prevent division by zero errors
+        range.y += std::numeric_limits<double>::denorm_min();
+    }
+    return range;
+}
+
+std::shared_ptr<Volume> makeResultVolume(const Volume& reference,
+                                         std::shared_ptr<VolumeRAMPrecision<float>> ram,
+                                         dvec2 range) {
+    auto resVol = std::make_shared<Volume>(ram);
+    resVol->dataMap.dataRange = range;
+    resVol->dataMap.valueRange = range;
+    resVol->setModelMatrix(reference.getModelMatrix());
+    resVol->setWorldMatrix(reference.getWorldMatrix());
+    return resVol;
+}
+
+}  // namespace
+
+void VoxelBlock::resize(size_t firstVoxel, size_t nVoxels, size_t nSubjects) {
+    firstVoxel_ = firstVoxel;
+    nVoxels_ = nVoxels;
+    nSubjects_ = nSubjects;
+    values_.resize(nVoxels * nSubjects);
+}
+
+size_t VoxelSource::getNumberOfVoxels() const { return glm::compMul(getDimensions()); }
+
+VolumeSequenceVoxelSource::VolumeSequenceVoxelSource(const VolumeSequence& volumes) {
+    if (volumes.empty()) return;
+
+    dims_ = volumes.front()->getDimensions();
+    pin_ = util::VolumeMemoryAccountant::get().pin(volumes);
+    for (const auto& volume : volumes) {
+        if (glm::any(volume->getDimensions() != dims_)) {
+            throw Exception("Expected all volumes to have same resolution",
+                            IVW_CONTEXT_CUSTOM("VolumeSequenceVoxelSource"));
+        }
+        volumes_.push_back(volume);
+        // Volumes from readers are loaded from disk by the first request of a RAM representation
+        util::TraceSpan span;
+        if (!volume->hasRepresentation<VolumeRAM>()) span = util::TraceSpan("Load", "io");
+        volumeRAMs_.push_back(volume->getRepresentation<VolumeRAM>());
+        bytesPerVoxel_ += volume->getDataFormat()->getSize();
+        const auto offset = volume->dataMap.mapFromDataToValue(0.0);
+        scaleOffset_.emplace_back(volume->dataMap.mapFromDataToValue(1.0) - offset, offset);
+    }
+}
+
+size_t VolumeSequenceVoxelSource::getNumberOfSubjects() const { return volumeRAMs_.size(); }
+
+size3_t VolumeSequenceVoxelSource::getDimensions() const { return dims_; }
+
+size_t VolumeSequenceVoxelSource::getBytesPerVoxel() const { return bytesPerVoxel_; }
+
+void VolumeSequenceVoxelSource::gather(size_t firstVoxel, size_t nVoxels,
+                                       VoxelBlock& block) const {
+    const auto nSubjects = volumeRAMs_.size();
+    block.resize(firstVoxel, nVoxels, nSubjects);
+    for (size_t subject = 0; subject < nSubjects; ++subject) {
+        const auto scale = scaleOffset_[subject].x;
+        const auto offset = scaleOffset_[subject].y;
+        double* dst = block.voxel(0) + subject;
+        volumeRAMs_[subject]->dispatch<void, dispatching::filter::Scalars>([&](auto vr) {
+            const auto src = vr->getDataTyped() + firstVoxel;
+            for (size_t i = 0; i < nVoxels; ++i) {
+                dst[i * nSubjects] = scale * static_cast<double>(src[i]) + offset;
+            }
+        });
+    }
+}
+
+void gatherBlock(const VoxelSource& source, size_t firstVoxel, size_t nVoxels, VoxelBlock& block,
+                 const util::BlockControl& control) {
+    const util::PhaseTimer timer(control.metrics, util::JobPhase::Gather);
+    source.gather(firstVoxel, nVoxels, block);
+    if (control.metrics) control.metrics->addBytes(nVoxels * source.getBytesPerVoxel());
+}
+
+bool computeMean(const VoxelSource& source, size_t firstVoxel, size_t nVoxels, float* out,
+                 const util::BlockControl& control) {
+    checkRange(source, firstVoxel, nVoxels);
+    const auto nSubjects = source.getNumberOfSubjects();
+
+    std::vector<VoxelBlock> blocks(util::parallelForBlocksWorkers());
+    return util::parallelForBlocks(
+        nVoxels, voxelsPerBlock(nSubjects),
+        [&](size_t worker, size_t first, size_t last) {
+            auto& block = blocks[worker];
+            gatherBlock(source, firstVoxel + first, last - first, block, control);
+            const util::PhaseTimer timer(control.metrics, util::JobPhase::Compute);
+            if (control.metrics) control.metrics->addVoxels(last - first);
+            for (size_t i = 0; i < last - first; ++i) {
+                const auto values = block.voxel(i);
+                out[first + i] = static_cast<float>(
+                    std::accumulate(values, values + nSubjects, 0.0) / nSubjects);
+            }
+        },
+        control);
+}
+
+bool computeTTest(const VoxelSource& groupA, const VoxelSource& groupB,
+                  const TTestSettings& settings, size_t firstVoxel, size_t nVoxels, float* out,
+                  const util::BlockControl& control) {
+    checkRange(groupA, firstVoxel, nVoxels);
+    checkRange(groupB, firstVoxel, nVoxels);
+    const auto nA = groupA.getNumberOfSubjects();
+    const auto nB = groupB.getNumberOfSubjects();
+
+    struct WorkerState {
+        VoxelBlock blockA;
+        VoxelBlock blockB;
+        std::vector<double> valuesA;
+        std::vector<double> valuesB;
+    };
+    std::vector<WorkerState> states(util::parallelForBlocksWorkers());
+
+    return util::parallelForBlocks(
+        nVoxels, voxelsPerBlock(nA + nB),
+        [&](size_t worker, size_t first, size_t last) {
+            auto& s = states[worker];
+            gatherBlock(groupA, firstVoxel + first, last - first, s.blockA, control);
+            gatherBlock(groupB, firstVoxel + first, last - first, s.blockB, control);
+            const util::PhaseTimer timer(control.metrics, util::JobPhase::Compute);
+            if (control.metrics) control.metrics->addVoxels(last - first);
+            for (size_t i = 0; i < last - first; ++i) {
+                s.valuesA.assign(s.blockA.voxel(i), s.blockA.voxel(i) + nA);
+                s.valuesB.assign(s.blockB.voxel(i), s.blockB.voxel(i) + nB);
+                auto [t, p] =
+                    stats::tTest(s.valuesA, s.valuesB, settings.equalVariance, settings.tail);
+                // The sign indicates the direction of the difference, e.g. A is greater than B.
+                out[first + i] = p < settings.pValue ? static_cast<float>(t) : 0.f;
+            }
+        },
+        control);
+}
+
+bool computeCorrelation(const VoxelSource& source, const std::vector<double>& parameter,
+                        const CorrelationSettings& settings,
+                        const std::vector<unsigned char>* mask, size_t firstVoxel, size_t nVoxels,
+                        float* out, const util::BlockControl& control) {
+    const auto nSubjects = source.getNumberOfSubjects();
+    if (parameter.size() != nSubjects) {
+        throw Exception(fmt::format("Expected one parameter value per subject, got {} values for "
+                                    "{} subjects",
+                                    parameter.size(), nSubjects),
+                        IVW_CONTEXT_CUSTOM("VoxelStatistics"));
+    }
+    return computeCorrelation(source, dataframe::ParameterMatrix({parameter}), 0, settings, mask,
+                              firstVoxel, nVoxels, out, control);
+}
+
+bool computeCorrelation(const VoxelSource& source, const dataframe::ParameterMatrix& parameters,
+                        size_t parameter, const CorrelationSettings& settings,
+                        const std::vector<unsigned char>* mask, size_t firstVoxel, size_t nVoxels,
+                        float* out, const util::BlockControl& control) {
+    checkRange(source, firstVoxel, nVoxels);
+    const auto nSubjects = source.getNumberOfSubjects();
+    if (parameters.getNumberOfSubjects() != nSubjects) {
+        throw Exception(fmt::format("Expected one parameter value per subject, got {} values for "
+                                    "{} subjects",
+                                    parameters.getNumberOfSubjects(), nSubjects),
+                        IVW_CONTEXT_CUSTOM("VoxelStatistics"));
+    }
+    if (parameter >= parameters.getNumberOfParameters()) {
+        throw Exception(fmt::format("Parameter {} is out of range, there are {} parameters",
+                                    parameter, parameters.getNumberOfParameters()),
+                        IVW_CONTEXT_CUSTOM("VoxelStatistics"));
+    }
+    if (mask && mask->size() != source.getNumberOfVoxels()) {
+        throw Exception("Expected one mask value per voxel", IVW_CONTEXT_CUSTOM("VoxelStatistics"));
+    }
+
+    // Subjects missing the parameter are excluded from the correlation. Pearson correlations use
+    // the standardized parameter, see standardizedPearsonTest.
+    const auto pearson = settings.method == CorrelationMethod::Pearson;
+    const auto included = parameters.getValidSubjects(parameter);
+    const auto parameterValues = pearson ? parameters.getStandardizedValues(parameter)
+                                         : parameters.getValidValues(parameter);
+    if (included.size() < 3) {
+        // Correlation is not defined
+        std::fill(out, out + nVoxels, 0.f);
+        return !control.stopped();
+    }
+
+    struct WorkerState {
+        VoxelBlock block;
+        std::vector<double> values;
+    };
+    std::vector<WorkerState> states(util::parallelForBlocksWorkers());
+
+    return util::parallelForBlocks(
+        nVoxels, voxelsPerBlock(nSubjects),
+        [&](size_t worker, size_t first, size_t last) {
+            auto& s = states[worker];
+            gatherBlock(source, firstVoxel + first, last - first, s.block, control);
+            const util::PhaseTimer timer(control.metrics, util::JobPhase::Compute);
+            if (control.metrics) control.metrics->addVoxels(last - first);
+            for (size_t i = 0; i < last - first; ++i) {
+                if (mask && (*mask)[firstVoxel + first + i] == 0) {
+                    out[first + i] = 0.f;
+                    continue;
+                }
+                const auto values = s.block.voxel(i);
+                s.values.clear();
+                for (auto subject : included) s.values.push_back(values[subject]);
+
+                auto [corr, p] =
+                    pearson ? stats::standardizedPearsonTest(parameterValues.data(),
+                                                             s.values.data(), s.values.size(),
+                                                             settings.tail)
+                            : stats::corrTest(parameterValues, s.values, settings.method,
+                                              settings.tail);
+                out[first + i] = p < settings.pValue ? static_cast<float>(corr) : 0.f;
+            }
+        },
+        control);
+}
+
+std::vector<unsigned char> maskToGrid(const Volume& mask, const Volume& reference) {
+    std::vector<unsigned char> res(glm::compMul(reference.getDimensions()), 0);
+    util::forEachResampledVoxel(mask, reference, [&](size_t i, auto value) {
+        res[i] = value != decltype(value){0};
+    });
+    return res;
+}
+
+dvec2 meanValueRange(const VolumeSequence& volumes) {
+    dvec2 valueRange(0);
+    for (const auto& volume : volumes) {
+        valueRange += volume->dataMap.valueRange / static_cast<double>(volumes.size());
+    }
+    return valueRange;
+}
+
+std::shared_ptr<Volume> volumeSequenceMean(const VolumeSequence& volumes,
+                                           const util::BlockControl& control) {
+    if (volumes.empty()) {
+        throw Exception("Expected at least one volume", IVW_CONTEXT_CUSTOM("VoxelStatistics"));
+    }
+    const VolumeSequenceVoxelSource source(volumes);
+    auto ram = std::make_shared<VolumeRAMPrecision<float>>(source.getDimensions());
+    if (!computeMean(source, 0, source.getNumberOfVoxels(), ram->getDataTyped(), control)) {
+        return nullptr;
+    }
+    // Data is stored in value domain
+    return makeResultVolume(*volumes.front(), ram, meanValueRange(volumes));
+}
+
+bool VoxelSum::update(const VolumeSequence& added, const VolumeSequence& removed,
+                      const util::BlockControl& control) {
+    if (removed.size() > nSubjects_ + added.size()) {
+        throw Exception(fmt::format("Cannot remove {} of {} volumes", removed.size(),
+                                    nSubjects_ + added.size()),
+                        IVW_CONTEXT_CUSTOM("VoxelStatistics"));
+    }
+    std::optional<VolumeSequenceVoxelSource> addedSource;
+    std::optional<VolumeSequenceVoxelSource> removedSource;
+    if (!added.empty()) addedSource.emplace(added);
+    if (!removed.empty()) removedSource.emplace(removed);
+    if (!addedSource && !removedSource) return true;
+
+    const auto dims = addedSource ? addedSource->getDimensions() : removedSource->getDimensions();
+    if ((addedSource && removedSource && removedSource->getDimensions() != dims) ||
+        (reference_ && dims != dims_)) {
+        throw Exception("Expected all volumes to have same resolution",
+                        IVW_CONTEXT_CUSTOM("VoxelStatistics"));
+    }
+    if (!reference_) {
+        if (!addedSource) {
+            throw Exception("Cannot remove volumes from an empty sum",
+                            IVW_CONTEXT_CUSTOM("VoxelStatistics"));
+        }
+        dims_ = dims;
+        sums_.assign(glm::compMul(dims), 0.0);
+        reference_ = added.front();
+    }
+
+    // Each block reads the changed volumes once and adds the difference of their sums
+    std::vector<VoxelBlock> blocks(util::parallelForBlocksWorkers());
+    const auto completed = util::parallelForBlocks(
+        sums_.size(), voxelsPerBlock(added.size() + removed.size()),
+        [&](size_t worker, size_t first, size_t last) {
+            auto& block = blocks[worker];
+            for (auto [source, sign] :
+                 {std::pair{&addedSource, 1.0}, std::pair{&removedSource, -1.0}}) {
+                if (!*source) continue;
+                gatherBlock(**source, first, last - first, block, control);
+                const util::PhaseTimer timer(control.metrics, util::JobPhase::Compute);
+                const auto nSubjects = block.getNumberOfSubjects();
+                for (size_t i = 0; i < last - first; ++i) {
+                    const auto values = block.voxel(i);
+                    sums_[first + i] += sign * std::accumulate(values, values + nSubjects, 0.0);
+                }
+            }
+            if (control.metrics) control.metrics->addVoxels(last - first);
+        },
+        control);
+    if (!completed) {
+        clear();
+        return false;
+    }
+
+    nSubjects_ = nSubjects_ + added.size() - removed.size();
+    for (const auto& volume : added) valueRangeSum_ += volume->dataMap.valueRange;
+    for (const auto& volume : removed) valueRangeSum_ -= volume->dataMap.valueRange;
+    return true;
+}
+
+void VoxelSum::clear() {
+    dims_ = size3_t{0};
+    sums_.clear();
+    nSubjects_ = 0;
+    valueRangeSum_ = dvec2{0.0};
+    reference_.reset();
+}
+
+size_t VoxelSum::getNumberOfSubjects() const { return nSubjects_; }
+
+size3_t VoxelSum::getDimensions() const { return dims_; }
+
+std::shared_ptr<Volume> VoxelSum::mean() const {
+    if (!reference_) return nullptr;
+    auto ram = std::make_shared<VolumeRAMPrecision<float>>(dims_);
+    auto data = ram->getDataTyped();
+    if (nSubjects_ == 0) {
+        std::fill(data, data + sums_.size(), 0.0f);
+        return makeResultVolume(*reference_, ram, dvec2(0, 1));
+    }
+    const auto n = static_cast<double>(nSubjects_);
+    std::transform(sums_.begin(), sums_.end(), data,
+                   [n](double sum) { return static_cast<float>(sum / n); });
+    return makeResultVolume(*reference_, ram, valueRangeSum_ / n);
+}
+
+std::shared_ptr<Volume> volumeTTest(const VolumeSequence& groupA, const VolumeSequence& groupB,
+                                    const TTestSettings& settings,
+                                    const util::BlockControl& control) {
+    if (groupA.empty() || groupB.empty()) {
+        throw Exception("Expected at least one volume in each group",
+                        IVW_CONTEXT_CUSTOM("VoxelStatistics"));
+    }
+    const VolumeSequenceVoxelSource sourceA(groupA);
+    const VolumeSequenceVoxelSource sourceB(groupB);
+    if (sourceA.getDimensions() != sourceB.getDimensions()) {
+        throw Exception("Expected both groups to have same resolution",
+                        IVW_CONTEXT_CUSTOM("VoxelStatistics"));
+    }
+    const auto nVoxels = sourceA.getNumberOfVoxels();
+    auto ram = std::make_shared<VolumeRAMPrecision<float>>(sourceA.getDimensions());
+    if (!computeTTest(sourceA, sourceB, settings, 0, nVoxels, ram->getDataTyped(), control)) {
+        return nullptr;
+    }
+    const util::PhaseTimer timer(control.metrics, util::JobPhase::Threshold);
+    return makeResultVolume(*groupA.front(), ram, minMax(ram->getDataTyped(), nVoxels));
+}
+
+std::shared_ptr<Volume> parameterVolumeCorrelation(const VolumeSequence& volumes,
+                                                   const std::vector<double>& parameter,
+                                                   const CorrelationSettings& settings,
+                                                   const Volume* mask,
+                                                   const util::BlockControl& control) {
+    if (parameter.size() != volumes.size()) {
+        throw Exception(fmt::format("Expected one parameter value per subject, got {} values for "
+                                    "{} subjects",
+                                    parameter.size(), volumes.size()),
+                        IVW_CONTEXT_CUSTOM("VoxelStatistics"));
+    }
+    return parameterVolumeCorrelation(volumes, dataframe::ParameterMatrix({parameter}), 0,
+                                      settings, mask, control);
+}
+
+std::shared_ptr<Volume> parameterVolumeCorrelation(const VolumeSequence& volumes,
+                                                   const dataframe::ParameterMatrix& parameters,
+                                                   size_t parameter,
+                                                   const CorrelationSettings& settings,
+                                                   const Volume* mask,
+                                                   const util::BlockControl& control) {
+    if (volumes.empty()) {
+        throw Exception("Expected at least one volume", IVW_CONTEXT_CUSTOM("VoxelStatistics"));
+    }
+    const VolumeSequenceVoxelSource source(volumes);
+    std::vector<unsigned char> gridMask;
+    if (mask) {
+        const util::PhaseTimer timer(control.metrics, util::JobPhase::Gather);
+        gridMask = maskToGrid(*mask, *volumes.front());
+    }
+
+    auto ram = std::make_shared<VolumeRAMPrecision<float>>(source.getDimensions());
+    if (!computeCorrelation(source, parameters, parameter, settings, mask ? &gridMask : nullptr,
+                            0, source.getNumberOfVoxels(), ram->getDataTyped(), control)) {
+        return nullptr;
+    }
+    // Range of the Pearson/Spearman correlation
+    return makeResultVolume(*volumes.front(), ram, dvec2(-1.0, 1.0));
+}
+
+}  // namespace stats
+
+}  // namespace inviwo
@@ -0,0 +1,389 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/datastructures/atlasindexfile.h>
+#include <modules/visualneuro/util/mappedfile.h>
+#include <modules/visualneuro/util/volumememoryaccountant.h>
+#include <inviwo/core/datastructures/volume/volumedisk.h>
+#include <inviwo/core/util/exception.h>
+#include <inviwo/core/util/logcentral.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace inviwo {
+
+namespace util {
+
+namespace {
+
+constexpr char indexMagic[8] = {'V', 'N', 'A', 'T', 'L', 'I', 'D', 'X'};
+constexpr std::uint32_t indexVersion = 1;
+
+// Sections follow the header in this order, each starting at a multiple of 8 bytes
+struct AtlasIndexHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t headerSize;
+    std::uint64_t sourceHash;
+    std::uint64_t dims[3];
+    // LabelRecord for each label between the smallest and largest label
+    std::uint64_t tableSize;
+    std::uint64_t tableOffset;
+    // int32 label and uint64 offset per label of the voxel index, plus a final offset
+    std::uint64_t labels;
+    std::uint64_t labelsOffset;
+    std::uint64_t offsetsOffset;
+    // uint32 linear voxel index per indexed voxel
+    std::uint64_t voxels;
+    std::uint64_t voxelsOffset;
+    std::uint64_t fileSize;
+    std::uint64_t reserved[2];
+};
+static_assert(sizeof(AtlasIndexHeader) == 128);
+
+struct LabelRecord {
+    std::int32_t label;
+    std::uint32_t reserved;
+    std::uint64_t voxels;
+    std::uint64_t lower[3];
+    std::uint64_t upper[3];
+    double centroid[3];
+    std::uint64_t center[3];
+};
+static_assert(sizeof(LabelRecord) == 112);
+
+constexpr std::uint64_t align8(std::uint64_t offset) { return (offset + 7) & ~std::uint64_t{7}; }
+
+AtlasIndexHeader layout(std::uint64_t sourceHash, const PrecomputedAtlas& atlas) {
+    AtlasIndexHeader header{};
+    std::memcpy(header.magic, indexMagic, sizeof(indexMagic));
+    header.version = indexVersion;
+    header.headerSize = sizeof(AtlasIndexHeader);
+    header.sourceHash = sourceHash;
+    const auto dims = atlas.statistics.getDimensions();
+    header.dims[0] = dims.x;
+    header.dims[1] = dims.y;
+    header.dims[2] = dims.z;
+    header.tableSize = atlas.statistics.getTable().size();
+    header.tableOffset = sizeof(AtlasIndexHeader);
+    header.labels = atlas.voxelIndex.getLabels().size();
+    header.labelsOffset = header.tableOffset + header.tableSize * sizeof(LabelRecord);
+    header.offsetsOffset = align8(header.labelsOffset + header.labels * sizeof(std::int32_t));
+    const auto nOffsets = header.labels == 0 ? 0 : header.labels + 1;
+    header.voxels = header.labels == 0 ? 0 : atlas.voxelIndex.getOffsets().back();
+    header.voxelsOffset = header.offsetsOffset + nOffsets * sizeof(std::uint64_t);
+    header.fileSize = header.voxelsOffset + header.voxels * sizeof(std::uint32_t);
+    return header;
+}
+
+template <typename T>
+void writeValues(std::ofstream& out, const T* values, size_t count) {
+    out.write(reinterpret_cast<const char*>(values),
+              static_cast<std::streamsize>(count * sizeof(T)));
+}
+
+// 64 random bits as hex
+std::string randomSuffix() {
+    static std::random_device device;
+    return fmt::format("{:08x}{:08x}", static_cast<std::uint32_t>(device()),
+                       static_cast<std::uint32_t>(device()));
+}
+
+void pad(std::ofstream& out, std::uint64_t offset) {
+    constexpr char zeros[8] = {};
+    const auto position = static_cast<std::uint64_t>(out.tellp());
+    if (offset > position) out.write(zeros, static_cast<std::streamsize>(offset - position));
+}
+
+// Size and modification time of a file, checked before hashing its contents
+struct FileStamp {
+    std::uintmax_t size = 0;
+    std::filesystem::file_time_type modified;
+
+    bool operator==(const FileStamp& rhs) const {
+        return size == rhs.size && modified == rhs.modified;
+    }
+};
+
+std::optional<FileStamp> fileStamp(const std::filesystem::path& file) {
+    std::error_code ec;
+    FileStamp stamp;
+    stamp.size = std::filesystem::file_size(file, ec);
+    if (ec) return std::nullopt;
+    stamp.modified = std::filesystem::last_write_time(file, ec);
+    if (ec) return std::nullopt;
+    return stamp;
+}
+
+// Hash of file, only computed again when its size or modification time changed
+std::uint64_t cachedHash(const std::filesystem::path& file) {
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::pair<FileStamp, std::uint64_t>> hashes;
+    const auto stamp = fileStamp(file);
+    const auto key = file.string();
+    if (stamp) {
+        std::scoped_lock lock{mutex};
+        if (auto it = hashes.find(key); it != hashes.end() && it->second.first == *stamp) {
+            return it->second.second;
+        }
+    }
+    const auto hash = hashFile(file);
+    if (stamp) {
+        std::scoped_lock lock{mutex};
+        hashes[key] = {*stamp, hash};
+    }
+    return hash;
+}
+
+}  // namespace
+
+std::filesystem::path atlasIndexPath(const std::filesystem::path& atlasFile) {
+    auto path = atlasFile;
+    path += ".vnidx";
+    return path;
+}
+
+std::uint64_t hashFile(const std::filesystem::path& file) {
+    const MappedFile mapped(file);
+    std::uint64_t hash = 14695981039346656037ull;
+    const auto data = reinterpret_cast<const unsigned char*>(mapped.data());
+    for (size_t i = 0; i < mapped.size(); ++i) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+void writeAtlasIndexFile(const std::filesystem::path& file, std::uint64_t sourceHash,
+                         const PrecomputedAtlas& atlas) {
+    const auto header = layout(sourceHash, atlas);
+    // Concurrent writers, e.g. two processes loading the same atlas, each use their own file
+    auto tmp = file;
+    tmp += fmt::format(".{}.tmp", randomSuffix());
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw Exception(fmt::format("Could not write {}", tmp),
+                            IVW_CONTEXT_CUSTOM("AtlasIndexFile"));
+        }
+        writeValues(out, &header, 1);
+
+        for (const auto& stats : atlas.statistics.getTable()) {
+            LabelRecord record{};
+            record.label = stats.label;
+            record.voxels = stats.voxels;
+            for (int i = 0; i < 3; ++i) {
+                record.lower[i] = stats.lower[i];
+                record.upper[i] = stats.upper[i];
+                record.centroid[i] = stats.centroid[i];
+                record.center[i] = stats.center[i];
+            }
+            writeValues(out, &record, 1);
+        }
+
+        const auto& index = atlas.voxelIndex;
+        writeValues(out, index.getLabels().data(), index.getLabels().size());
+        pad(out, header.offsetsOffset);
+        if (header.labels > 0) {
+            const std::vector<std::uint64_t> offsets(index.getOffsets().begin(),
+                                                     index.getOffsets().end());
+            writeValues(out, offsets.data(), offsets.size());
+            writeValues(out, index.getVoxelData(), header.voxels);
+        }
+        if (!out || static_cast<std::uint64_t>(out.tellp()) != header.fileSize) {
+            out.close();
+            std::error_code ec;
+            std::filesystem::remove(tmp, ec);
+            throw Exception(fmt::format("Could not write {}", tmp),
+                            IVW_CONTEXT_CUSTOM("AtlasIndexFile"));
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, file, ec);
+    if (ec) {
+        std::filesystem::remove(tmp, ec);
+        throw Exception(fmt::format("Could not write {}", file),
+                        IVW_CONTEXT_CUSTOM("AtlasIndexFile"));
+    }
+}
+
+std::optional<PrecomputedAtlas> readAtlasIndexFile(const std::filesystem::path& file,
+                                                   std::uint64_t sourceHash) {
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(file, ec)) return std::nullopt;
+
+    try {
+        auto mapped = std::make_shared<const MappedFile>(file);
+        AtlasIndexHeader header;
+        if (mapped->size() < sizeof(header)) return std::nullopt;
+        std::memcpy(&header, mapped->data(), sizeof(header));
+        if (std::memcmp(header.magic, indexMagic, sizeof(indexMagic)) != 0 ||
+            header.version != indexVersion || header.headerSize != sizeof(AtlasIndexHeader) ||
+            header.sourceHash != sourceHash || header.fileSize != mapped->size()) {
+            return std::nullopt;
+        }
+        const size3_t dims(header.dims[0], header.dims[1], header.dims[2]);
+        if (header.tableSize > stats::maxDenseLabelRange ||
+            header.labels > stats::maxDenseLabelRange || header.voxels > glm::compMul(dims)) {
+            return std::nullopt;
+        }
+        // The sections must be where the writer puts them for the sizes in the header, which
+        // together with the file size check keeps them inside the file
+        const auto tableEnd = header.tableOffset + header.tableSize * sizeof(LabelRecord);
+        const auto nOffsets = header.labels == 0 ? 0 : header.labels + 1;
+        if (header.tableOffset != sizeof(AtlasIndexHeader) || header.labelsOffset != tableEnd ||
+            header.offsetsOffset !=
+                align8(header.labelsOffset + header.labels * sizeof(std::int32_t)) ||
+            header.voxelsOffset != header.offsetsOffset + nOffsets * sizeof(std::uint64_t) ||
+            header.fileSize != header.voxelsOffset + header.voxels * sizeof(std::uint32_t)) {
+            return std::nullopt;
+        }
+
+        std::vector<stats::LabelStatistics> table(header.tableSize);
+        for (size_t i = 0; i < table.size(); ++i) {
+            LabelRecord record;
+            std::memcpy(&record, mapped->data() + header.tableOffset + i * sizeof(LabelRecord),
+                        sizeof(record));
+            auto& stats = table[i];
+            stats.label = record.label;
+            stats.voxels = record.voxels;
+            for (int c = 0; c < 3; ++c) {
+                stats.lower[c] = record.lower[c];
+                stats.upper[c] = record.upper[c];
+                stats.centroid[c] = record.centroid[c];
+                stats.center[c] = record.center[c];
+            }
+        }
+
+        std::vector<int> labels(header.labels);
+        std::memcpy(labels.data(), mapped->data() + header.labelsOffset,
+                    labels.size() * sizeof(std::int32_t));
+        std::vector<size_t> offsets;
+        if (header.labels > 0) {
+            std::vector<std::uint64_t> stored(header.labels + 1);
+            std::memcpy(stored.data(), mapped->data() + header.offsetsOffset,
+                        stored.size() * sizeof(std::uint64_t));
+            offsets.assign(stored.begin(), stored.end());
+            if (offsets.front() != 0 || offsets.back() != header.voxels ||
+                !std::is_sorted(offsets.begin(), offsets.end())) {
+                return std::nullopt;
+            }
+        }
+        // The voxels stay in the mapped file, which lives as long as any copy of the index
+        std::shared_ptr<const std::uint32_t> voxels(
+            mapped, reinterpret_cast<const std::uint32_t*>(mapped->data() + header.voxelsOffset));
+        // Voxel indices are used without checks, an index outside the volume makes the file invalid
+        const auto nVoxels = glm::compMul(dims);
+        if (std::any_of(voxels.get(), voxels.get() + header.voxels,
+                        [&](std::uint32_t voxel) { return voxel >= nVoxels; })) {
+            return std::nullopt;
+        }
+
+        const auto firstLabel = table.empty() ? 0 : table.front().label;
+        PrecomputedAtlas res;
+        res.statistics = stats::AtlasLabelStatistics(dims, firstLabel, std::move(table));
+        res.voxelIndex =
+            AtlasVoxelIndex(dims, std::move(labels), std::move(offsets), std::move(voxels));
+        return res;
+    } catch (const Exception&) {
+        return std::nullopt;
+    }
+}
+
+std::shared_ptr<const PrecomputedAtlas> precomputedAtlas(const Volume& atlas,
+                                                         const BlockControl& control) {
+    // Atlases edited in memory no longer match their file and are computed in memory
+    std::filesystem::path source;
+    if (hasValidDiskRepresentation(atlas)) {
+        source = std::filesystem::path{atlas.getRepresentation<VolumeDisk>()->getSourceFile()};
+    }
+    std::error_code ec;
+    if (!source.empty() && !std::filesystem::is_regular_file(source, ec)) source.clear();
+
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::weak_ptr<const PrecomputedAtlas>> cache;
+    // Sidecars that could not be written, e.g. in a read-only install directory
+    static std::unordered_set<std::string> unsaved;
+    std::string key;
+    std::uint64_t hash = 0;
+    if (!source.empty()) {
+        hash = cachedHash(source);
+        key = fmt::format("{}#{}", source.string(), hash);
+        std::scoped_lock lock{mutex};
+        if (auto existing = cache[key].lock();
+            existing && existing->statistics.getDimensions() == atlas.getDimensions()) {
+            return existing;
+        }
+    }
+
+    std::shared_ptr<const PrecomputedAtlas> res;
+    const auto sidecar = atlasIndexPath(source);
+    if (!source.empty()) {
+        if (auto stored = readAtlasIndexFile(sidecar, hash);
+            stored && stored->statistics.getDimensions() == atlas.getDimensions()) {
+            res = std::make_shared<const PrecomputedAtlas>(std::move(*stored));
+        }
+    }
+    if (!res) {
+        auto statistics = stats::computeLabelStatistics(atlas, control);
+        if (!statistics) return nullptr;
+        res = std::make_shared<const PrecomputedAtlas>(
+            PrecomputedAtlas{std::move(*statistics), AtlasVoxelIndex(atlas)});
+        if (!source.empty()) {
+            try {
+                writeAtlasIndexFile(sidecar, hash, *res);
+            } catch (const Exception& e) {
+                std::unique_lock lock{mutex};
+                if (unsaved.insert(sidecar.string()).second) {
+                    lock.unlock();
+                    LogWarnCustom("AtlasIndexFile", "Atlas index not saved: " << e.getMessage());
+                }
+            }
+        }
+    }
+    if (!key.empty()) {
+        std::scoped_lock lock{mutex};
+        cache[key] = res;
+    }
+    return res;
+}
+
+}  // namespace util
+
+}  // namespace inviwo
@@ -0,0 +1,234 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/datastructures/atlasvoxelindex.h>
+#include <modules/visualneuro/algorithm/volume/atlaslabelstatistics.h>
+#include <modules/visualneuro/algorithm/volume/gridresampling.h>
+#include <modules/visualneuro/util/parallelforblocks.h>
+#include <inviwo/core/datastructures/volume/volumeram.h>
+#include <inviwo/core/util/exception.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace inviwo {
+
+namespace {
+
+// Label of voxels outside of the atlas
+constexpr std::int32_t outside = std::numeric_limits<std::int32_t>::min();
+constexpr size_t blockSize = size_t{1} << 18;
+
+std::vector<std::int32_t> atlasLabels(const Volume& atlas) {
+    std::vector<std::int32_t> labels(glm::compMul(atlas.getDimensions()));
+    atlas.getRepresentation<VolumeRAM>()->dispatch<void, dispatching::filter::Scalars>(
+        [&](auto vr) {
+            const auto data = vr->getDataTyped();
+            util::parallelForBlocks(labels.size(), blockSize,
+                                    [&](size_t, size_t first, size_t last) {
+                                        for (size_t i = first; i < last; ++i) {
+                                            labels[i] = static_cast<std::int32_t>(data[i]);
+                                        }
+                                    });
+        });
+    return labels;
+}
+
+std::vector<std::int32_t> resampledLabels(const Volume& atlas, const Volume& reference) {
+    std::vector<std::int32_t> labels(glm::compMul(reference.getDimensions()), outside);
+    util::forEachResampledVoxel(atlas, reference, [&](size_t i, auto label) {
+        labels[i] = static_cast<std::int32_t>(label);
+    });
+    return labels;
+}
+
+}  // namespace
+
+AtlasVoxelIndex::AtlasVoxelIndex(const Volume& atlas)
+    : AtlasVoxelIndex(atlas.getDimensions(), atlasLabels(atlas)) {}
+
+AtlasVoxelIndex AtlasVoxelIndex::resampled(const Volume& atlas, const Volume& reference) {
+    return AtlasVoxelIndex(reference.getDimensions(), resampledLabels(atlas, reference));
+}
+
+AtlasVoxelIndex::AtlasVoxelIndex(size3_t dims, const std::vector<std::int32_t>& voxelLabels)
+    : dims_{dims} {
+    const auto nVoxels = voxelLabels.size();
+    if (nVoxels > std::numeric_limits<std::uint32_t>::max()) {
+        throw Exception(fmt::format("Cannot index {} voxels, at most 2^32 are supported", nVoxels),
+                        IVW_CONTEXT_CUSTOM("AtlasVoxelIndex"));
+    }
+
+    std::vector<ivec2> ranges(util::parallelForBlocksWorkers(),
+                              ivec2{std::numeric_limits<int>::max(), outside});
+    util::parallelForBlocks(nVoxels, blockSize, [&](size_t worker, size_t first, size_t last) {
+        auto& range = ranges[worker];
+        for (size_t i = first; i < last; ++i) {
+            if (voxelLabels[i] == outside) continue;
+            range.x = std::min(range.x, voxelLabels[i]);
+            range.y = std::max(range.y, voxelLabels[i]);
+        }
+    });
+    auto range = ranges.front();
+    for (const auto& r : ranges) range = ivec2{std::min(range.x, r.x), std::max(range.y, r.y)};
+    if (range.y == outside) return;
+
+    const auto nLabels = static_cast<size_t>(static_cast<long long>(range.y) - range.x + 1);
+    if (nLabels > stats::maxDenseLabelRange) {
+        throw Exception(fmt::format("Atlas labels span {} values ({} to {}), at most {} are "
+                                    "supported",
+                                    nLabels, range.x, range.y, stats::maxDenseLabelRange),
+                        IVW_CONTEXT_CUSTOM("AtlasVoxelIndex"));
+    }
+
+    // Count the voxels of each label per block, then turn the counts into the position of the
+    // first voxel of each label and block. Writing the blocks in parallel then keeps the voxels
+    // of each label sorted.
+    const auto nBlocks = (nVoxels + blockSize - 1) / blockSize;
+    std::vector<std::uint32_t> blockCounts(nBlocks * nLabels, 0);
+    util::parallelForBlocks(nVoxels, blockSize, [&](size_t, size_t first, size_t last) {
+        auto counts = blockCounts.data() + (first / blockSize) * nLabels;
+        for (size_t i = first; i < last; ++i) {
+            if (voxelLabels[i] != outside) ++counts[voxelLabels[i] - range.x];
+        }
+    });
+
+    firstLabel_ = range.x;
+    labelPosition_.assign(nLabels, -1);
+    offsets_.push_back(0);
+    for (size_t label = 0; label < nLabels; ++label) {
+        size_t position = offsets_.back();
+        for (size_t block = 0; block < nBlocks; ++block) {
+            auto& count = blockCounts[block * nLabels + label];
+            const auto n = count;
+            count = static_cast<std::uint32_t>(position);
+            position += n;
+        }
+        if (position == offsets_.back()) continue;
+        labelPosition_[label] = static_cast<std::int32_t>(labels_.size());
+        labels_.push_back(range.x + static_cast<int>(label));
+        offsets_.push_back(position);
+    }
+
+    auto voxels = std::make_shared<std::vector<std::uint32_t>>(offsets_.back());
+    util::parallelForBlocks(nVoxels, blockSize, [&](size_t, size_t first, size_t last) {
+        auto positions = blockCounts.data() + (first / blockSize) * nLabels;
+        for (size_t i = first; i < last; ++i) {
+            if (voxelLabels[i] == outside) continue;
+            (*voxels)[positions[voxelLabels[i] - range.x]++] = static_cast<std::uint32_t>(i);
+        }
+    });
+    voxels_ = std::shared_ptr<const std::uint32_t>(voxels, voxels->data());
+}
+
+AtlasVoxelIndex::AtlasVoxelIndex(size3_t dims, std::vector<int> labels,
+                                 std::vector<size_t> offsets,
+                                 std::shared_ptr<const std::uint32_t> voxels)
+    : dims_{dims}, labels_{std::move(labels)}, offsets_{std::move(offsets)}, voxels_{voxels} {
+    if (!std::is_sorted(labels_.begin(), labels_.end()) ||
+        std::adjacent_find(labels_.begin(), labels_.end()) != labels_.end()) {
+        throw Exception("Expected ascending atlas labels", IVW_CONTEXT_CUSTOM("AtlasVoxelIndex"));
+    }
+    if (labels_.empty()) {
+        if (!offsets_.empty() && offsets_ != std::vector<size_t>{0}) {
+            throw Exception("Expected no voxels without labels",
+                            IVW_CONTEXT_CUSTOM("AtlasVoxelIndex"));
+        }
+        offsets_.clear();
+        return;
+    }
+    if (offsets_.size() != labels_.size() + 1 || offsets_.front() != 0 ||
+        !std::is_sorted(offsets_.begin(), offsets_.end()) ||
+        offsets_.back() > glm::compMul(dims_) || (offsets_.back() > 0 && !voxels_)) {
+        throw Exception(fmt::format("Inconsistent offsets for {} atlas labels", labels_.size()),
+                        IVW_CONTEXT_CUSTOM("AtlasVoxelIndex"));
+    }
+    const auto range = static_cast<long long>(labels_.back()) - labels_.front() + 1;
+    if (range > static_cast<long long>(stats::maxDenseLabelRange)) {
+        throw Exception(fmt::format("Atlas labels span {} values ({} to {}), at most {} are "
+                                    "supported",
+                                    range, labels_.front(), labels_.back(),
+                                    stats::maxDenseLabelRange),
+                        IVW_CONTEXT_CUSTOM("AtlasVoxelIndex"));
+    }
+    updateLabelPositions();
+}
+
+void AtlasVoxelIndex::updateLabelPositions() {
+    firstLabel_ = labels_.front();
+    labelPosition_.assign(static_cast<size_t>(labels_.back() - firstLabel_) + 1, -1);
+    for (size_t i = 0; i < labels_.size(); ++i) {
+        labelPosition_[static_cast<size_t>(labels_[i] - firstLabel_)] =
+            static_cast<std::int32_t>(i);
+    }
+}
+
+std::int32_t AtlasVoxelIndex::findLabel(int label) const {
+    const auto i = static_cast<long long>(label) - firstLabel_;
+    if (i < 0 || i >= static_cast<long long>(labelPosition_.size())) return -1;
+    return labelPosition_[static_cast<size_t>(i)];
+}
+
+size3_t AtlasVoxelIndex::getDimensions() const { return dims_; }
+
+const std::vector<int>& AtlasVoxelIndex::getLabels() const { return labels_; }
+
+size_t AtlasVoxelIndex::getNumberOfVoxels(int label) const { return getVoxels(label).size(); }
+
+AtlasVoxelIndex::VoxelRange AtlasVoxelIndex::getVoxels(int label) const {
+    const auto position = findLabel(label);
+    if (position < 0) return {};
+    const auto p = static_cast<size_t>(position);
+    return {voxels_.get() + offsets_[p], voxels_.get() + offsets_[p + 1]};
+}
+
+void AtlasVoxelIndex::forEachVoxel(const std::vector<int>& labels,
+                                   const std::function<void(int, size_t)>& callback) const {
+    for (auto label : labels) {
+        for (auto voxel : getVoxels(label)) callback(label, voxel);
+    }
+}
+
+std::vector<std::uint32_t> AtlasVoxelIndex::selectVoxels(
+    const std::function<bool(int)>& isSelected) const {
+    std::vector<std::uint32_t> res;
+    for (auto label : labels_) {
+        if (!isSelected(label)) continue;
+        const auto voxels = getVoxels(label);
+        res.insert(res.end(), voxels.begin(), voxels.end());
+    }
+    std::sort(res.begin(), res.end());
+    return res;
+}
+
+const std::vector<size_t>& AtlasVoxelIndex::getOffsets() const { return offsets_; }
+
+const std::uint32_t* AtlasVoxelIndex::getVoxelData() const { return voxels_.get(); }
+
+}  // namespace inviwo
@@ -0,0 +1,135 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/datastructures/labelcolorlut.h>
+#include <modules/visualneuro/algorithm/volume/atlaslabelstatistics.h>
+#include <inviwo/core/datastructures/image/layerramprecision.h>
+#include <inviwo/core/util/exception.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace inviwo {
+
+namespace {
+
+const vec4 transparent{0.0f};
+
+}  // namespace
+
+LabelColorLUT::LabelColorLUT(int maxLabel) {
+    if (maxLabel < 0 || static_cast<size_t>(maxLabel) >= stats::maxDenseLabelRange) {
+        throw Exception(fmt::format("Cannot create a color table for labels 0 to {}, at most {} "
+                                    "labels are supported",
+                                    maxLabel, stats::maxDenseLabelRange),
+                        IVW_CONTEXT_CUSTOM("LabelColorLUT"));
+    }
+    colors_.assign(static_cast<size_t>(maxLabel) + 1, transparent);
+    markDirty(0, colors_.size());
+}
+
+size_t LabelColorLUT::size() const { return colors_.size(); }
+
+bool LabelColorLUT::contains(int label) const {
+    return label >= 0 && static_cast<size_t>(label) < colors_.size();
+}
+
+const vec4& LabelColorLUT::getColor(int label) const {
+    return contains(label) ? colors_[static_cast<size_t>(label)] : transparent;
+}
+
+bool LabelColorLUT::setColor(int label, const vec4& color) {
+    if (!contains(label)) return false;
+    const auto i = static_cast<size_t>(label);
+    if (colors_[i] == color) return false;
+    colors_[i] = color;
+    markDirty(i, i + 1);
+    return true;
+}
+
+const std::vector<vec4>& LabelColorLUT::getColors() const { return colors_; }
+
+const vec4& LabelColorLUT::sample(double value) const {
+    if (!std::isfinite(value)) return transparent;
+    // Same rounding as the shader, which uses floor(value + 0.5)
+    return getColor(static_cast<int>(std::floor(value + 0.5)));
+}
+
+const std::vector<LabelColorLUT::Range>& LabelColorLUT::getDirtyRanges() const { return dirty_; }
+
+bool LabelColorLUT::isDirty() const { return !dirty_.empty(); }
+
+void LabelColorLUT::clearDirty() { dirty_.clear(); }
+
+void LabelColorLUT::forEachDirtyRow(
+    const std::function<void(size2_t pos, size_t count, const vec4* colors)>& callback) const {
+    for (const auto& range : dirty_) {
+        for (auto first = range.first; first < range.last;) {
+            const auto rowEnd = (first / layerWidth + 1) * layerWidth;
+            const auto last = std::min(range.last, rowEnd);
+            callback(size2_t{first % layerWidth, first / layerWidth}, last - first,
+                     colors_.data() + first);
+            first = last;
+        }
+    }
+}
+
+size2_t LabelColorLUT::getLayerDimensions() const {
+    if (colors_.empty()) return size2_t{1};
+    return {std::min(colors_.size(), layerWidth), (colors_.size() + layerWidth - 1) / layerWidth};
+}
+
+std::shared_ptr<Layer> LabelColorLUT::createLayer() const {
+    const auto dims = getLayerDimensions();
+    auto ram = std::make_shared<LayerRAMPrecision<vec4>>(dims);
+    auto data = ram->getDataTyped();
+    std::fill(data, data + glm::compMul(dims), transparent);
+    std::copy(colors_.begin(), colors_.end(), data);
+    return std::make_shared<Layer>(ram);
+}
+
+void LabelColorLUT::markDirty(size_t first, size_t last) {
+    // Find the ranges that overlap or touch [first, last) and merge them into one
+    auto begin = std::lower_bound(dirty_.begin(), dirty_.end(), first,
+                                  [](const Range& r, size_t pos) { return r.last < pos; });
+    auto end = begin;
+    while (end != dirty_.end() && end->first <= last) {
+        first = std::min(first, end->first);
+        last = std::max(last, end->last);
+        ++end;
+    }
+    if (begin == end) {
+        dirty_.insert(begin, Range{first, last});
+    } else {
+        *begin = Range{first, last};
+        dirty_.erase(begin + 1, end);
+    }
+}
+
+}  // namespace inviwo
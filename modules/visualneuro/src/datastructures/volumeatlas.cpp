@@ -28,6 +28,10 @@
  *********************************************************************************/
 
 #include <modules/visualneuro/datastructures/volumeatlas.h>
+#include <modules/visualneuro/datastructures/atlasindexfile.h>
+
+#include <algorithm>
+#include <map>
 
 namespace inviwo {
 
@@ -64,9 +68,10 @@ VolumeAtlas::VolumeAtlas(std::shared_ptr<const Volume> atlas,
             "Could not find Index column for atlas labels. Add Index column with id of each "
             "region");
     }
+    std::map<int, Label> labels;
     if (!labelCol) {
         for (auto i = 0u; i < idCol->getSize(); ++i) {
-            labels_[static_cast<int>(idCol->getAsDouble(i))] = Label{};
+            labels[static_cast<int>(idCol->getAsDouble(i))] = Label{};
         }
     } else {
         for (auto i = 0u; i < idCol->getSize(); ++i) {
@@ -87,10 +92,51 @@ VolumeAtlas::VolumeAtlas(std::shared_ptr<const Volume> atlas,
                 }
             }
 
-            labels_[static_cast<int>(idCol->getAsDouble(i))] = Label{
+            labels[static_cast<int>(idCol->getAsDouble(i))] = Label{
                 labelCol->getAsString(i), color};
         }
     }
+
+    labels_.assign(std::make_move_iterator(labels.begin()), std::make_move_iterator(labels.end()));
+    if (!labels_.empty()) {
+        firstLabelId_ = labels_.front().first;
+        const auto range =
+            static_cast<long long>(labels_.back().first) - static_cast<long long>(firstLabelId_);
+        if (range < static_cast<long long>(stats::maxDenseLabelRange)) {
+            labelIndex_.assign(static_cast<size_t>(range) + 1, -1);
+            for (size_t i = 0; i < labels_.size(); ++i) {
+                labelIndex_[static_cast<size_t>(labels_[i].first - firstLabelId_)] =
+                    static_cast<int>(i);
+            }
+        }
+    }
+    for (const auto& [id, label] : labels_) nameToId_.emplace(label.name, id);
+
+    if (atlas_) {
+        // Loaded from the sidecar index of the atlas file when available, the voxels of the
+        // index are shared with other atlases of the same file
+        if (const auto precomputed = util::precomputedAtlas(*atlas_)) {
+            statistics_ = precomputed->statistics;
+            voxelIndex_ = precomputed->voxelIndex;
+        }
+    }
+}
+
+const VolumeAtlas::Label* VolumeAtlas::findLabel(int id) const {
+    if (!labelIndex_.empty()) {
+        const auto i = static_cast<long long>(id) - firstLabelId_;
+        if (i < 0 || i >= static_cast<long long>(labelIndex_.size())) return nullptr;
+        const auto index = labelIndex_[static_cast<size_t>(i)];
+        return index < 0 ? nullptr : &labels_[static_cast<size_t>(index)].second;
+    }
+    auto it = std::lower_bound(labels_.begin(), labels_.end(), id,
+                               [](const auto& elem, int value) { return elem.first < value; });
+    return it != labels_.end() && it->first == id ? &it->second : nullptr;
+}
+
+vec3 VolumeAtlas::indexToWorld(const dvec3& indexPos) const {
+    const mat4 trans = atlas_->getCoordinateTransformer().getIndexToWorldMatrix();
+    return vec3(trans * vec4(vec3(indexPos), 1.0f));
 }
 
 int VolumeAtlas::getLabelId(const ivec3 indexPos) const {
@@ -104,12 +150,11 @@ int VolumeAtlas::getLabelId(const ivec3 indexPos) const {
 }
 
 int VolumeAtlas::getLabelId(std::string label) const {
-    auto elemIt = std::find_if(labels_.begin(), labels_.end(),
-                               [label](auto elem) { return elem.second == label; });
-    if (elemIt == labels_.end()) {
+    auto elemIt = nameToId_.find(label);
+    if (elemIt == nameToId_.end()) {
         return -1;
     } else {
-        return elemIt->first;
+        return elemIt->second;
     }
 }
 
@@ -124,30 +169,27 @@ double VolumeAtlas::getLabelIdNormalized(int labelId) const {
 }
 
 std::optional<VolumeAtlas::Label> VolumeAtlas::getLabel(int id) const {
-    auto elemIt = labels_.find(id);
-    if (elemIt == labels_.end()) {
-        return std::nullopt;
+    if (auto label = findLabel(id)) {
+        return *label;
     } else {
-        return elemIt->second;
+        return std::nullopt;
     }
 }
 
 
 std::string VolumeAtlas::getLabelName(int id) const {
-    auto elemIt = labels_.find(id);
-    if (elemIt == labels_.end()) {
-        return "";
+    if (auto label = findLabel(id)) {
+        return label->name;
     } else {
-        return elemIt->second.name;
+        return "";
     }
 }
 
 std::optional<vec4> VolumeAtlas::getLabelColor(int id) const {
-    auto elemIt = labels_.find(id);
-    if (elemIt == labels_.end()) {
-        return std::nullopt;
+    if (auto label = findLabel(id)) {
+        return label->color;
     } else {
-        return elemIt->second.color;
+        return std::nullopt;
     }
 }
 
@@ -156,7 +198,38 @@ bool VolumeAtlas::hasColors() const {
                        [](const auto l) { return l.second.color != std::nullopt; });
 }
 
-vec3 VolumeAtlas::getCenterPoint(int label) const { return vec3(); }
+vec3 VolumeAtlas::getCenterPoint(int label) const {
+    if (auto stats = statistics_.find(label)) {
+        return indexToWorld(dvec3(stats->center));
+    } else {
+        return vec3();
+    }
+}
+
+vec3 VolumeAtlas::getCentroid(int label) const {
+    if (auto stats = statistics_.find(label)) {
+        return indexToWorld(stats->centroid);
+    } else {
+        return vec3();
+    }
+}
+
+size_t VolumeAtlas::getVoxelCount(int label) const {
+    auto stats = statistics_.find(label);
+    return stats ? stats->voxels : 0;
+}
+
+float VolumeAtlas::getCoverage(int label) const {
+    const auto nVoxels = glm::compMul(statistics_.getDimensions());
+    if (nVoxels == 0) return 0.0f;
+    return static_cast<float>(getVoxelCount(label)) / static_cast<float>(nVoxels);
+}
+
+const stats::AtlasLabelStatistics& VolumeAtlas::getLabelStatistics() const {
+    return statistics_;
+}
+
+const AtlasVoxelIndex& VolumeAtlas::getVoxelIndex() const { return voxelIndex_; }
 
 VolumeAtlas::const_iterator VolumeAtlas::begin() const { return labels_.begin(); }
 
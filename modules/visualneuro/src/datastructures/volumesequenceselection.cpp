@@ -0,0 +1,96 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/datastructures/volumesequenceselection.h>
+#include <inviwo/core/util/exception.h>
+
+#include <atomic>
+
+namespace inviwo {
+
+namespace {
+
+std::uint64_t nextVersion() {
+    static std::atomic<std::uint64_t> version{0};
+    return ++version;
+}
+
+}  // namespace
+
+VolumeSequenceSelection::VolumeSequenceSelection(std::shared_ptr<const VolumeSequence> parent,
+                                                 BitSet selected,
+                                                 const VolumeSequenceSelection* previous)
+    : parent_{std::move(parent)}, selected_{std::move(selected)}, version_{nextVersion()} {
+    const auto nVolumes = parent_ ? parent_->size() : size_t{0};
+    if (!selected_.empty() && selected_.max() >= nVolumes) {
+        throw Exception(fmt::format("Selected volume {} is outside of the {} volumes of the "
+                                    "sequence",
+                                    selected_.max(), nVolumes),
+                        IVW_CONTEXT_CUSTOM("VolumeSequenceSelection"));
+    }
+
+    if (previous && previous->parent_ == parent_) {
+        previousVersion_ = previous->version_;
+        added_ = selected_;
+        added_ -= previous->selected_;
+        removed_ = previous->selected_;
+        removed_ -= selected_;
+    } else {
+        added_ = selected_;
+    }
+}
+
+const std::shared_ptr<const VolumeSequence>& VolumeSequenceSelection::getParent() const {
+    return parent_;
+}
+
+const BitSet& VolumeSequenceSelection::getSelected() const { return selected_; }
+
+size_t VolumeSequenceSelection::size() const { return selected_.size(); }
+
+bool VolumeSequenceSelection::empty() const { return selected_.empty(); }
+
+std::uint64_t VolumeSequenceSelection::getVersion() const { return version_; }
+
+std::uint64_t VolumeSequenceSelection::getPreviousVersion() const { return previousVersion_; }
+
+const BitSet& VolumeSequenceSelection::getAdded() const { return added_; }
+
+const BitSet& VolumeSequenceSelection::getRemoved() const { return removed_; }
+
+VolumeSequence VolumeSequenceSelection::getVolumes(const BitSet& indices) const {
+    VolumeSequence volumes;
+    volumes.reserve(indices.size());
+    for (auto i : indices) volumes.push_back((*parent_)[i]);
+    return volumes;
+}
+
+VolumeSequence VolumeSequenceSelection::getVolumes() const { return getVolumes(selected_); }
+
+}  // namespace inviwo
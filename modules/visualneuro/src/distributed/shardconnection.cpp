@@ -0,0 +1,260 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/distributed/shardconnection.h>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace inviwo {
+
+namespace stats {
+
+namespace {
+
+constexpr std::uint32_t shardMagic = 0x56534e48;  // "VNSH"
+
+struct FrameHeader {
+    std::uint32_t magic;
+    std::uint32_t type;
+    std::uint64_t size;
+};
+static_assert(sizeof(FrameHeader) == 16);
+
+#ifdef _WIN32
+
+[[noreturn]] void notSupported() {
+    throw Exception("Sharded execution requires POSIX sockets and is not supported on Windows",
+                    IVW_CONTEXT_CUSTOM("ShardConnection"));
+}
+
+#else
+
+void sendAll(int socket, const void* data, size_t size) {
+#ifdef MSG_NOSIGNAL
+    constexpr int flags = MSG_NOSIGNAL;
+#else
+    constexpr int flags = 0;
+#endif
+    auto ptr = static_cast<const char*>(data);
+    while (size > 0) {
+        const auto sent = ::send(socket, ptr, size, flags);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) {
+            throw Exception("Shard connection closed while sending",
+                            IVW_CONTEXT_CUSTOM("ShardConnection"));
+        }
+        ptr += sent;
+        size -= static_cast<size_t>(sent);
+    }
+}
+
+void receiveAll(int socket, void* data, size_t size) {
+    auto ptr = static_cast<char*>(data);
+    while (size > 0) {
+        const auto received = ::recv(socket, ptr, size, 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) {
+            throw Exception("Shard connection closed while receiving",
+                            IVW_CONTEXT_CUSTOM("ShardConnection"));
+        }
+        ptr += received;
+        size -= static_cast<size_t>(received);
+    }
+}
+
+void configure(int socket) {
+    int one = 1;
+    // Results are sent as one large write, do not delay the small job messages
+    ::setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+    ::setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+}
+
+#endif
+
+}  // namespace
+
+#ifdef _WIN32
+
+ShardConnection ShardConnection::connect(const std::string&, std::uint16_t) { notSupported(); }
+ShardConnection::ShardConnection(int socket) : socket_{socket} { notSupported(); }
+ShardConnection::ShardConnection(ShardConnection&& rhs) noexcept : socket_{rhs.socket_} {
+    rhs.socket_ = -1;
+}
+ShardConnection& ShardConnection::operator=(ShardConnection&& rhs) noexcept {
+    std::swap(socket_, rhs.socket_);
+    return *this;
+}
+ShardConnection::~ShardConnection() = default;
+void ShardConnection::send(ShardMessageType, const std::vector<std::byte>&) { notSupported(); }
+std::pair<ShardMessageType, std::vector<std::byte>> ShardConnection::receive() { notSupported(); }
+
+std::vector<size_t> waitForMessages(const std::vector<const ShardConnection*>&,
+                                    std::chrono::milliseconds) {
+    notSupported();
+}
+
+ShardListener::ShardListener(const std::string&, std::uint16_t) { notSupported(); }
+ShardListener::~ShardListener() = default;
+std::optional<ShardConnection> ShardListener::accept(std::chrono::milliseconds) {
+    notSupported();
+}
+
+#else
+
+ShardConnection ShardConnection::connect(const std::string& address, std::uint16_t port) {
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* info = nullptr;
+    const auto service = std::to_string(port);
+    if (::getaddrinfo(address.c_str(), service.c_str(), &hints, &info) != 0 || !info) {
+        throw Exception(fmt::format("Could not resolve shard coordinator {}", address),
+                        IVW_CONTEXT_CUSTOM("ShardConnection"));
+    }
+    const int socket = ::socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+    const bool connected =
+        socket >= 0 && ::connect(socket, info->ai_addr, info->ai_addrlen) == 0;
+    ::freeaddrinfo(info);
+    if (!connected) {
+        if (socket >= 0) ::close(socket);
+        throw Exception(fmt::format("Could not connect to shard coordinator {}:{}", address, port),
+                        IVW_CONTEXT_CUSTOM("ShardConnection"));
+    }
+    configure(socket);
+    return ShardConnection{socket};
+}
+
+ShardConnection::ShardConnection(int socket) : socket_{socket} {}
+
+ShardConnection::ShardConnection(ShardConnection&& rhs) noexcept : socket_{rhs.socket_} {
+    rhs.socket_ = -1;
+}
+
+ShardConnection& ShardConnection::operator=(ShardConnection&& rhs) noexcept {
+    std::swap(socket_, rhs.socket_);
+    return *this;
+}
+
+ShardConnection::~ShardConnection() {
+    if (socket_ >= 0) ::close(socket_);
+}
+
+void ShardConnection::send(ShardMessageType type, const std::vector<std::byte>& payload) {
+    if (payload.size() > maxShardMessageSize) {
+        throw Exception(fmt::format("Shard message of {} bytes exceeds the limit of {} bytes",
+                                    payload.size(), maxShardMessageSize),
+                        IVW_CONTEXT_CUSTOM("ShardConnection"));
+    }
+    const FrameHeader header{shardMagic, static_cast<std::uint32_t>(type), payload.size()};
+    sendAll(socket_, &header, sizeof(header));
+    if (!payload.empty()) sendAll(socket_, payload.data(), payload.size());
+}
+
+std::pair<ShardMessageType, std::vector<std::byte>> ShardConnection::receive() {
+    FrameHeader header;
+    receiveAll(socket_, &header, sizeof(header));
+    if (header.magic != shardMagic) {
+        throw Exception("Received data is not a shard message",
+                        IVW_CONTEXT_CUSTOM("ShardConnection"));
+    }
+    // The size comes from the network, check it before allocating
+    if (header.size > maxShardMessageSize) {
+        throw Exception(fmt::format("Received shard message of {} bytes exceeds the limit of {} "
+                                    "bytes",
+                                    header.size, maxShardMessageSize),
+                        IVW_CONTEXT_CUSTOM("ShardConnection"));
+    }
+    std::vector<std::byte> payload(static_cast<size_t>(header.size));
+    if (!payload.empty()) receiveAll(socket_, payload.data(), payload.size());
+    return {static_cast<ShardMessageType>(header.type), std::move(payload)};
+}
+
+std::vector<size_t> waitForMessages(const std::vector<const ShardConnection*>& connections,
+                                    std::chrono::milliseconds timeout) {
+    std::vector<pollfd> pfds;
+    for (auto connection : connections) pfds.push_back({connection->socket(), POLLIN, 0});
+    std::vector<size_t> ready;
+    if (::poll(pfds.data(), pfds.size(), static_cast<int>(timeout.count())) <= 0) return ready;
+    for (size_t i = 0; i < pfds.size(); ++i) {
+        if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) ready.push_back(i);
+    }
+    return ready;
+}
+
+ShardListener::ShardListener(const std::string& address, std::uint16_t port) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (::inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+        throw Exception(fmt::format("Invalid IPv4 address '{}'", address),
+                        IVW_CONTEXT_CUSTOM("ShardListener"));
+    }
+    socket_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    ::setsockopt(socket_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    socklen_t length = sizeof(addr);
+    if (socket_ < 0 || ::bind(socket_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(socket_, SOMAXCONN) != 0 ||
+        ::getsockname(socket_, reinterpret_cast<sockaddr*>(&addr), &length) != 0) {
+        if (socket_ >= 0) ::close(socket_);
+        throw Exception(fmt::format("Could not listen on {}:{}", address, port),
+                        IVW_CONTEXT_CUSTOM("ShardListener"));
+    }
+    port_ = ntohs(addr.sin_port);
+}
+
+ShardListener::~ShardListener() {
+    if (socket_ >= 0) ::close(socket_);
+}
+
+std::optional<ShardConnection> ShardListener::accept(std::chrono::milliseconds timeout) {
+    pollfd pfd{socket_, POLLIN, 0};
+    if (::poll(&pfd, 1, static_cast<int>(timeout.count())) <= 0) return std::nullopt;
+    const int socket = ::accept(socket_, nullptr, nullptr);
+    if (socket < 0) return std::nullopt;
+    configure(socket);
+    return ShardConnection{socket};
+}
+
+#endif
+
+}  // namespace stats
+
+}  // namespace inviwo
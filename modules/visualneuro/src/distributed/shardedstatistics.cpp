@@ -0,0 +1,469 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/distributed/shardedstatistics.h>
+#include <modules/visualneuro/algorithm/volume/cohortfile.h>
+
+#include <inviwo/core/datastructures/volume/volumeramprecision.h>
+#include <inviwo/core/util/exception.h>
+#include <inviwo/core/util/logcentral.h>
+
+#include <algorithm>
+#include <deque>
+#include <numeric>
+#include <thread>
+
+#ifndef _WIN32
+#include <csignal>
+#include <spawn.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
+
+namespace inviwo {
+
+namespace stats {
+
+namespace {
+
+void write(ShardMessageWriter& w, const ShardTask& task) {
+    w.write(static_cast<std::uint32_t>(task.kernel));
+    w.write(task.cohortFile.string());
+    w.write(task.groupA);
+    w.write(task.groupB);
+    w.write(static_cast<std::uint32_t>(task.tTest.equalVariance));
+    w.write(static_cast<std::uint32_t>(task.tTest.tail));
+    w.write(task.tTest.pValue);
+    w.write(task.parameter);
+    w.write(static_cast<std::uint32_t>(task.correlation.method));
+    w.write(static_cast<std::uint32_t>(task.correlation.tail));
+    w.write(task.correlation.pValue);
+    w.write(task.mask);
+}
+
+ShardTask readTask(ShardMessageReader& r) {
+    ShardTask task;
+    task.kernel = static_cast<ShardKernel>(r.read<std::uint32_t>());
+    task.cohortFile = r.readString();
+    task.groupA = r.readVector<std::uint64_t>();
+    task.groupB = r.readVector<std::uint64_t>();
+    task.tTest.equalVariance = static_cast<EqualVariance>(r.read<std::uint32_t>() != 0);
+    task.tTest.tail = static_cast<TailTest>(r.read<std::uint32_t>());
+    task.tTest.pValue = r.read<double>();
+    task.parameter = r.readVector<double>();
+    task.correlation.method = static_cast<CorrelationMethod>(r.read<std::uint32_t>());
+    task.correlation.tail = static_cast<TailTest>(r.read<std::uint32_t>());
+    task.correlation.pValue = r.read<double>();
+    task.mask = r.readVector<unsigned char>();
+    return task;
+}
+
+#ifndef _WIN32
+
+int spawnProcess(const std::filesystem::path& executable, const std::vector<std::string>& args) {
+    const auto exe = executable.string();
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(exe.c_str()));
+    for (const auto& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    pid_t pid;
+    if (::posix_spawn(&pid, exe.c_str(), nullptr, nullptr, argv.data(), environ) != 0) {
+        throw Exception(fmt::format("Could not start shard worker {}", executable),
+                        IVW_CONTEXT_CUSTOM("ShardCoordinator"));
+    }
+    return static_cast<int>(pid);
+}
+
+// Wait for a worker to exit after shutdown, workers stuck in a shard are killed after a while
+void waitForProcess(int pid) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+    int status = 0;
+    while (::waitpid(static_cast<pid_t>(pid), &status, WNOHANG) == 0) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            ::kill(static_cast<pid_t>(pid), SIGKILL);
+            ::waitpid(static_cast<pid_t>(pid), &status, 0);
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds{50});
+    }
+}
+
+#else
+
+int spawnProcess(const std::filesystem::path&, const std::vector<std::string>&) {
+    throw Exception("Spawning shard workers is not supported on Windows",
+                    IVW_CONTEXT_CUSTOM("ShardCoordinator"));
+}
+
+void waitForProcess(int) {}
+
+#endif
+
+}  // namespace
+
+std::vector<std::byte> serialize(const ShardJob& job) {
+    ShardMessageWriter w;
+    w.write(job.id);
+    w.write(job.firstVoxel);
+    w.write(job.nVoxels);
+    write(w, job.task);
+    return std::move(w.buffer());
+}
+
+ShardJob deserializeShardJob(const std::vector<std::byte>& payload) {
+    ShardMessageReader r(payload);
+    ShardJob job;
+    job.id = r.read<std::uint64_t>();
+    job.firstVoxel = r.read<std::uint64_t>();
+    job.nVoxels = r.read<std::uint64_t>();
+    job.task = readTask(r);
+    if (!r.atEnd()) {
+        throw Exception("Unexpected data at end of shard job",
+                        IVW_CONTEXT_CUSTOM("ShardMessageReader"));
+    }
+    return job;
+}
+
+std::vector<float> computeShard(const VoxelSource& cohort, const ShardJob& job) {
+    const auto first = static_cast<size_t>(job.firstVoxel);
+    const auto n = static_cast<size_t>(job.nVoxels);
+    const auto& task = job.task;
+    std::vector<float> result(n);
+    switch (task.kernel) {
+        case ShardKernel::Mean:
+            computeMean(cohort, first, n, result.data());
+            break;
+        case ShardKernel::TTest: {
+            const SubjectSubsetVoxelSource groupA(
+                cohort, std::vector<size_t>(task.groupA.begin(), task.groupA.end()));
+            const SubjectSubsetVoxelSource groupB(
+                cohort, std::vector<size_t>(task.groupB.begin(), task.groupB.end()));
+            computeTTest(groupA, groupB, task.tTest, first, n, result.data());
+            break;
+        }
+        case ShardKernel::Correlation: {
+            if (task.mask.empty()) {
+                computeCorrelation(cohort, task.parameter, task.correlation, nullptr, first, n,
+                                   result.data());
+                break;
+            }
+            if (task.mask.size() != n) {
+                throw Exception("Expected one mask value per voxel of the shard",
+                                IVW_CONTEXT_CUSTOM("ShardWorker"));
+            }
+            // The kernel indexes the mask with the voxel index of the whole volume
+            std::vector<unsigned char> mask(cohort.getNumberOfVoxels(), 0);
+            std::copy(task.mask.begin(), task.mask.end(), mask.begin() + first);
+            computeCorrelation(cohort, task.parameter, task.correlation, &mask, first, n,
+                               result.data());
+            break;
+        }
+        default:
+            throw Exception(fmt::format("Unknown shard kernel {}",
+                                        static_cast<std::uint32_t>(task.kernel)),
+                            IVW_CONTEXT_CUSTOM("ShardWorker"));
+    }
+    return result;
+}
+
+ShardCoordinator::ShardCoordinator(const std::string& address, std::uint16_t port)
+    : address_{address}, listener_{address, port} {}
+
+ShardCoordinator::~ShardCoordinator() {
+    for (auto& worker : workers_) {
+        try {
+            worker.send(ShardMessageType::Shutdown);
+        } catch (const Exception&) {
+            // Worker already disconnected
+        }
+    }
+    workers_.clear();
+    for (auto pid : processes_) waitForProcess(pid);
+}
+
+std::uint16_t ShardCoordinator::getPort() const { return listener_.getPort(); }
+
+void ShardCoordinator::spawnWorkers(const std::filesystem::path& executable,
+                                    const std::vector<std::string>& args, size_t n) {
+    // Workers spawned for a wildcard address connect through the loopback interface
+    const auto host = address_ == "0.0.0.0" ? std::string{"127.0.0.1"} : address_;
+    auto workerArgs = args;
+    workerArgs.push_back("--connect");
+    workerArgs.push_back(fmt::format("{}:{}", host, getPort()));
+    for (size_t i = 0; i < n; ++i) {
+        processes_.push_back(spawnProcess(executable, workerArgs));
+    }
+}
+
+void ShardCoordinator::waitForWorkers(size_t n, std::chrono::milliseconds timeout) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (workers_.size() < n) {
+        const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0) {
+            throw Exception(fmt::format("Only {} of {} shard workers connected within {} s",
+                                        workers_.size(), n,
+                                        std::chrono::duration<double>(timeout).count()),
+                            IVW_CONTEXT_CUSTOM("ShardCoordinator"));
+        }
+        if (auto connection = listener_.accept(remaining)) {
+            workers_.push_back(std::move(*connection));
+        }
+    }
+}
+
+size_t ShardCoordinator::getNumberOfWorkers() const { return workers_.size(); }
+
+void ShardCoordinator::setShardTimeout(std::chrono::milliseconds timeout) {
+    shardTimeout_ = timeout;
+}
+
+std::chrono::milliseconds ShardCoordinator::getShardTimeout() const { return shardTimeout_; }
+
+std::optional<std::vector<float>> ShardCoordinator::run(const ShardTask& task,
+                                                        size_t shardsPerWorker,
+                                                        const util::BlockControl& control) {
+    if (workers_.empty()) {
+        throw Exception("No shard workers connected", IVW_CONTEXT_CUSTOM("ShardCoordinator"));
+    }
+    // Validates the cohort file before any work is sent out
+    const CohortFileVoxelSource cohort(task.cohortFile);
+    const auto nVoxels = cohort.getNumberOfVoxels();
+    if (!task.mask.empty() && task.mask.size() != nVoxels) {
+        throw Exception("Expected one mask value per voxel",
+                        IVW_CONTEXT_CUSTOM("ShardCoordinator"));
+    }
+
+    const auto nShards =
+        std::clamp<size_t>(workers_.size() * std::max<size_t>(shardsPerWorker, 1), 1, nVoxels);
+    const auto shardSize = (nVoxels + nShards - 1) / nShards;
+    // Job ids are unique across runs so that late results of a stopped run are ignored
+    const auto firstJobId = nextJobId_;
+    nextJobId_ += nShards;
+
+    std::deque<size_t> pending(nShards);
+    std::iota(pending.begin(), pending.end(), size_t{0});
+    std::vector<std::optional<size_t>> inFlight(workers_.size());
+    std::vector<std::chrono::steady_clock::time_point> deadlines(workers_.size());
+    std::vector<bool> alive(workers_.size(), true);
+    std::vector<float> result(nVoxels);
+    size_t finished = 0;
+
+    ShardJob job;
+    job.task = task;
+    job.task.mask.clear();
+
+    auto fail = [&](size_t worker, std::string_view reason) {
+        LogWarnCustom("ShardCoordinator", "Shard worker " << worker << " lost: " << reason);
+        alive[worker] = false;
+        if (inFlight[worker]) pending.push_front(*inFlight[worker]);
+        inFlight[worker].reset();
+    };
+    auto dispatch = [&](size_t worker) {
+        if (pending.empty() || control.stopped()) return;
+        const auto shard = pending.front();
+        pending.pop_front();
+        job.id = firstJobId + shard;
+        job.firstVoxel = shard * shardSize;
+        job.nVoxels = std::min<std::uint64_t>(shardSize, nVoxels - job.firstVoxel);
+        if (!task.mask.empty()) {
+            const auto begin = task.mask.begin() + job.firstVoxel;
+            job.task.mask.assign(begin, begin + job.nVoxels);
+        }
+        inFlight[worker] = shard;
+        deadlines[worker] = std::chrono::steady_clock::now() + shardTimeout_;
+        try {
+            workers_[worker].send(ShardMessageType::Job, serialize(job));
+        } catch (const Exception& e) {
+            fail(worker, e.getMessage());
+        }
+    };
+    auto dispatchIdle = [&]() {
+        for (size_t worker = 0; worker < workers_.size(); ++worker) {
+            if (alive[worker] && !inFlight[worker]) dispatch(worker);
+        }
+    };
+
+    dispatchIdle();
+    while (finished < nShards) {
+        if (control.stopped()) return std::nullopt;
+
+        std::vector<const ShardConnection*> busy;
+        std::vector<size_t> busyWorkers;
+        for (size_t worker = 0; worker < workers_.size(); ++worker) {
+            if (alive[worker] && inFlight[worker]) {
+                busy.push_back(&workers_[worker]);
+                busyWorkers.push_back(worker);
+            }
+        }
+        if (busy.empty()) {
+            throw Exception(fmt::format("All shard workers failed, {} of {} shards computed",
+                                        finished, nShards),
+                            IVW_CONTEXT_CUSTOM("ShardCoordinator"));
+        }
+
+        for (auto i : waitForMessages(busy, std::chrono::milliseconds{200})) {
+            const auto worker = busyWorkers[i];
+            std::pair<ShardMessageType, std::vector<std::byte>> message;
+            try {
+                message = workers_[worker].receive();
+            } catch (const Exception& e) {
+                fail(worker, e.getMessage());
+                continue;
+            }
+            ShardMessageReader r(message.second);
+            std::uint64_t id = 0;
+            std::string error;
+            std::vector<float> values;
+            try {
+                id = r.read<std::uint64_t>();
+                if (message.first == ShardMessageType::Error) {
+                    error = r.readString();
+                } else if (message.first == ShardMessageType::Result) {
+                    values = r.readVector<float>();
+                }
+            } catch (const Exception& e) {
+                fail(worker, e.getMessage());
+                continue;
+            }
+            if (id != firstJobId + *inFlight[worker]) {
+                // A worker that could not read the id of its job replies with id 0
+                if (message.first == ShardMessageType::Error && id == 0) {
+                    fail(worker, error);
+                }
+                continue;  // Otherwise a result of an earlier run
+            }
+
+            if (message.first == ShardMessageType::Error) {
+                // Computing a shard fails the same way on every worker, e.g. for a missing file
+                throw Exception(fmt::format("Shard worker {} failed: {}", worker, error),
+                                IVW_CONTEXT_CUSTOM("ShardCoordinator"));
+            } else if (message.first != ShardMessageType::Result) {
+                fail(worker, "unexpected message");
+                continue;
+            }
+            const auto shard = *inFlight[worker];
+            const auto first = shard * shardSize;
+            if (values.size() != std::min(shardSize, nVoxels - first)) {
+                fail(worker, "result has wrong size");
+                continue;
+            }
+            std::copy(values.begin(), values.end(), result.begin() + first);
+            inFlight[worker].reset();
+            ++finished;
+            if (control.progress) control.progress(finished, nShards);
+            dispatch(worker);
+        }
+        const auto now = std::chrono::steady_clock::now();
+        for (auto worker : busyWorkers) {
+            if (inFlight[worker] && now > deadlines[worker]) {
+                fail(worker, fmt::format("no result within {} s",
+                                         std::chrono::duration<double>(shardTimeout_).count()));
+            }
+        }
+        // Shards of failed workers go to workers that are idle
+        dispatchIdle();
+    }
+    return result;
+}
+
+void runShardWorker(const std::string& address, std::uint16_t port) {
+    auto connection = ShardConnection::connect(address, port);
+    std::unique_ptr<CohortFileVoxelSource> cohort;
+
+    while (true) {
+        auto [type, payload] = connection.receive();
+        if (type == ShardMessageType::Shutdown) return;
+        if (type != ShardMessageType::Job) {
+            throw Exception("Unexpected message from shard coordinator",
+                            IVW_CONTEXT_CUSTOM("ShardWorker"));
+        }
+
+        ShardMessageWriter w;
+        std::uint64_t id = 0;
+        try {
+            // The id is read on its own first so that errors in the rest of the job can still be
+            // matched to it by the coordinator
+            id = ShardMessageReader(payload).read<std::uint64_t>();
+            const auto job = deserializeShardJob(payload);
+            if (!cohort || cohort->getPath() != job.task.cohortFile) {
+                cohort.reset();
+                cohort = std::make_unique<CohortFileVoxelSource>(job.task.cohortFile);
+            }
+            const auto values = computeShard(*cohort, job);
+            w.write(id);
+            w.write(values);
+            type = ShardMessageType::Result;
+        } catch (const std::exception& e) {
+            w.buffer().clear();
+            w.write(id);
+            w.write(std::string{e.what()});
+            type = ShardMessageType::Error;
+        }
+        connection.send(type, w.buffer());
+    }
+}
+
+std::shared_ptr<Volume> shardResultToVolume(const ShardTask& task, std::vector<float> result,
+                                            const VolumeSequence& volumes) {
+    if (volumes.empty()) {
+        throw Exception("Expected at least one volume", IVW_CONTEXT_CUSTOM("ShardCoordinator"));
+    }
+    const auto& reference = *volumes.front();
+    const auto dims = reference.getDimensions();
+    if (result.size() != glm::compMul(dims)) {
+        throw Exception("Shard result does not match the reference volume",
+                        IVW_CONTEXT_CUSTOM("ShardCoordinator"));
+    }
+    auto ram = std::make_shared<VolumeRAMPrecision<float>>(dims);
+    std::copy(result.begin(), result.end(), ram->getDataTyped());
+
+    dvec2 range(-1.0, 1.0);
+    if (task.kernel == ShardKernel::Mean) {
+        range = meanValueRange(volumes);
+    } else if (task.kernel == ShardKernel::TTest && !result.empty()) {
+        const auto [min, max] = std::minmax_element(result.begin(), result.end());
+        range = dvec2(*min, *max);
+        if (range.y - range.x < std::numeric_limits<double>::denorm_min()) {
+            // Prevent division by zero errors
+            range.y += std::numeric_limits<double>::denorm_min();
+        }
+    }
+    auto volume = std::make_shared<Volume>(ram);
+    volume->dataMap.dataRange = range;
+    volume->dataMap.valueRange = range;
+    volume->setModelMatrix(reference.getModelMatrix());
+    volume->setWorldMatrix(reference.getWorldMatrix());
+    return volume;
+}
+
+}  // namespace stats
+
+}  // namespace inviwo
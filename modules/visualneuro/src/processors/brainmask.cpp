@@ -29,9 +29,8 @@
 
 #include <modules/visualneuro/processors/brainmask.h>
 #include <modules/visualneuro/algorithm/volume/atlasvolumemask.h>
-#include <inviwo/core/datastructures/volume/volumeramprecision.h>
-#include <inviwo/core/util/volumeramutils.h>
-#include <inviwo/core/util/indexmapper.h>
+#include <modules/visualneuro/util/jobmetrics.h>
+#include <modules/visualneuro/util/volumememoryaccountant.h>
 
 namespace inviwo {
 
@@ -52,49 +51,26 @@ BrainMask::BrainMask() : PoolProcessor(), volumes_("brainVol"), maskPort_("mask"
 }
 
 void BrainMask::process() {
-    const auto calc = [volumes = volumes_.getData()](
+    auto metrics = std::make_shared<util::JobMetrics>(*this);
+    const auto calc = [volumes = volumes_.getData(), metrics](
                           pool::Stop stop, pool::Progress progress) -> std::shared_ptr<Volume> {
-        if (volumes->empty()) {
-            return nullptr;
-        } else {
-            progress(0.f);
-            auto firstVol = *volumes->begin();
-            auto mask = std::make_shared<Volume>(firstVol->getDimensions(), DataUInt8::get());
-            mask->setModelMatrix(firstVol->getModelMatrix());
-            mask->setWorldMatrix(firstVol->getWorldMatrix());
-            auto resMask = dynamic_cast<VolumeRAMPrecision<uint8_t>*>(
-                mask->getEditableRepresentation<VolumeRAM>());
-            auto maskData = resMask->getDataTyped();
-            util::IndexMapper3D im(mask->getDimensions());
-            constexpr unsigned char maskBrain{1 << 7};  // 1000 0000
-            for (const auto& volume : *volumes) {
-                
-                if (stop) return nullptr;
-
-                auto dim = volume->getDimensions();
-                if (glm::any(dim != mask->getDimensions())) {
-                    throw inviwo::Exception("Expected all volumes to have same resolution");
-                }
-                auto brainRAM = volume->getRepresentation<VolumeRAM>();
-                brainRAM->dispatch<void, dispatching::filter::Scalars>([&](auto vr) {
-                    auto data = vr->getDataTyped();
-                    using ValueType = util::PrecisionValueType<decltype(vr)>;
-                    util::forEachVoxelParallel(*resMask, [&](const size3_t& ind) {
-                        if (data[im(ind)] != ValueType{0}) {
-                            maskData[im(ind)] = maskBrain;
-                        }
-                    });
-                });
-            }
-            progress(1.f);
-            return mask;
-        }
+        const auto job = metrics->start();
+        progress(0.f);
+        auto mask = brainMask(*volumes, util::makeBlockControl(stop, progress, metrics.get()));
+        progress(1.f);
+        return mask;
     };
 
     maskPort_.clear();
-    dispatchOne(calc, [this](std::shared_ptr<Volume> result) {
+    dispatchOne(calc, [this, metrics](std::shared_ptr<Volume> result) {
+        util::PhaseTimer timer(metrics.get(), util::JobPhase::Publish);
         maskPort_.setData(result);
+        util::VolumeMemoryAccountant::get().track(
+            result, util::VolumeMemoryAccountant::ownerName(maskPort_),
+            util::RepresentationSource::Computed);
         newResults();
+        timer.stop();
+        metrics->finish();
     });
 }
 
@@ -28,6 +28,8 @@
  *********************************************************************************/
 
 #include <modules/visualneuro/processors/brainraycaster.h>
+#include <modules/visualneuro/util/jobmetrics.h>
+#include <modules/visualneuro/util/volumememoryaccountant.h>
 #include <modules/opengl/image/layergl.h>
 #include <modules/opengl/volume/volumegl.h>
 #include <modules/opengl/texture/texture2d.h>
@@ -59,6 +61,7 @@ BrainRayCaster::BrainRayCaster()
     , entryPort_("entry")
     , exitPort_("exit")
     , atlasPort_("atlas")
+    , atlasColors_("atlasColors")
     , atlasTransferFunction_("atlasTransferFunction")
     , backgroundPort_("bg")
     , outport_("outport")
@@ -81,10 +84,13 @@ BrainRayCaster::BrainRayCaster()
     addPort(exitPort_, "ImagePortGroup1");
     addPort(backgroundPort_, "ImagePortGroup1");
     addPort(atlasPort_);
+    addPort(atlasColors_);
     addPort(atlasTransferFunction_);
     addPort(outport_, "ImagePortGroup1");
 
     backgroundPort_.setOptional(true);
+    atlasColors_.setOptional(true);
+    atlasTransferFunction_.setOptional(true);
 
     channel_.setSerializationMode(PropertySerializationMode::All);
 
@@ -105,6 +111,10 @@ BrainRayCaster::BrainRayCaster()
     });
     backgroundPort_.onConnect([&]() { this->invalidate(InvalidationLevel::InvalidResources); });
     backgroundPort_.onDisconnect([&]() { this->invalidate(InvalidationLevel::InvalidResources); });
+    for (auto port : std::initializer_list<Inport*>{&atlasColors_, &atlasTransferFunction_}) {
+        port->onConnect([&]() { this->invalidate(InvalidationLevel::InvalidResources); });
+        port->onDisconnect([&]() { this->invalidate(InvalidationLevel::InvalidResources); });
+    }
 
     // change the currently selected channel when a pre-computed gradient is selected
     raycasting_.gradientComputation_.onChange([this]() {
@@ -135,30 +145,56 @@ void BrainRayCaster::initializeResources() {
     utilgl::addDefines(shader_, raycasting_, isotfComposite_, camera_, lighting_,
                        positionIndicator_);
     utilgl::addShaderDefinesBGPort(shader_, backgroundPort_);
-    if (enableAtlas_)
+    const bool labelColors = atlasColors_.isConnected();
+    if (enableAtlas_ && (labelColors || atlasTransferFunction_.isConnected()))
         shader_[ShaderType::Fragment]->addShaderDefine("HAS_ATLAS");
     else
         shader_[ShaderType::Fragment]->removeShaderDefine("HAS_ATLAS");
+    if (labelColors)
+        shader_[ShaderType::Fragment]->addShaderDefine("ATLAS_LABEL_COLORS");
+    else
+        shader_[ShaderType::Fragment]->removeShaderDefine("ATLAS_LABEL_COLORS");
 
     shader_.build();
 }
 
 void BrainRayCaster::process() {
     if (volumePort_.isChanged() || activityPort_.isChanged() || atlasPort_.isChanged()) {
+        // Uploading the volumes is reported as Gather and the raycasting as Publish
+        auto metrics = std::make_shared<util::JobMetrics>(*this);
+        // The uploaded representations must not be evicted before they have been rendered
+        auto pin = std::make_shared<util::VolumeMemoryAccountant::Pin>(
+            util::VolumeMemoryAccountant::get().pin(
+                {volumePort_.getData().get(), activityPort_.getData().get(),
+                 atlasPort_.getData().get()}));
         dispatchOne(
             [volume = volumePort_.getData(), activity = activityPort_.getData(),
-             atlas = atlasPort_.getData()]() -> std::array<std::shared_ptr<const Volume>, 3> {
-                volume->getRep<kind::GL>();
-                activity->getRep<kind::GL>();
-                atlas->getRep<kind::GL>();
+             atlas = atlasPort_.getData(), metrics,
+             pin]() -> std::array<std::shared_ptr<const Volume>, 3> {
+                const auto job = metrics->start();
+                const util::PhaseTimer timer(metrics.get(), util::JobPhase::Gather);
+                for (const auto& v : {volume, activity, atlas}) {
+                    v->getRep<kind::GL>();
+                    const auto nVoxels = glm::compMul(v->getDimensions());
+                    metrics->addVoxels(nVoxels);
+                    metrics->addBytes(nVoxels * v->getDataFormat()->getSize());
+                }
                 glFinish();
                 return {volume, activity, atlas};
             },
-            [this](std::array<std::shared_ptr<const Volume>, 3> volumes) {
+            [this, metrics, pin](std::array<std::shared_ptr<const Volume>, 3> volumes) {
+                util::PhaseTimer timer(metrics.get(), util::JobPhase::Publish);
                 raycast(*volumes[0], *volumes[1], *volumes[2]);
+                *pin = util::VolumeMemoryAccountant::Pin{};
                 newResults();
+                timer.stop();
+                metrics->finish();
             });
     } else {
+        for (const auto& volume :
+             {volumePort_.getData(), activityPort_.getData(), atlasPort_.getData()}) {
+            util::VolumeMemoryAccountant::get().touch(*volume);
+        }
         raycast(*volumePort_.getData(), *activityPort_.getData(), *atlasPort_.getData());
     }
 }
@@ -176,10 +212,18 @@ void BrainRayCaster::raycast(const Volume& volume, const Volume& activity, const
     utilgl::bindAndSetUniforms(shader_, units, atlas, "atlas");
     utilgl::bindAndSetUniforms(shader_, units, isotfComposite_);
     utilgl::bindAndSetUniforms(shader_, units, activityTransferFunction_);
-    utilgl::bindAndSetUniforms(
-        shader_, units,
-        *(atlasTransferFunction_.getData()->getData()->getRepresentation<LayerGL>()->getTexture()),
-        "atlasTransferFunction");
+    if (atlasColors_.hasData()) {
+        // Labels are looked up in the color table by their value in data units
+        utilgl::bindAndSetUniforms(
+            shader_, units, *(atlasColors_.getData()->getRepresentation<LayerGL>()->getTexture()),
+            "atlasColors");
+        shader_.setUniform("atlasValueRange", vec2(atlas.dataMap.dataRange));
+    } else if (atlasTransferFunction_.hasData()) {
+        const auto tfLayer = atlasTransferFunction_.getData()->getData();
+        utilgl::bindAndSetUniforms(shader_, units,
+                                   *(tfLayer->getRepresentation<LayerGL>()->getTexture()),
+                                   "atlasTransferFunction");
+    }
 
     utilgl::bindAndSetUniforms(shader_, units, entryPort_, ImageType::ColorDepthPicking);
     utilgl::bindAndSetUniforms(shader_, units, exitPort_, ImageType::ColorDepth);
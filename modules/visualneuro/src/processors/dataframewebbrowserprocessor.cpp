@@ -28,6 +28,10 @@
  *********************************************************************************/
 
 #include <modules/visualneuro/processors/dataframewebbrowserprocessor.h>
+#include <modules/visualneuro/util/columnarframe.h>
+#include <modules/visualneuro/util/columnarframestore.h>
+#include <modules/visualneuro/util/dataframedelta.h>
+#include <modules/visualneuro/visualneuromodule.h>
 #include <modules/webbrowser/interaction/cefinteractionhandler.h>
 #include <modules/webbrowser/webbrowsermodule.h>
 #include <modules/webbrowser/webbrowserutil.h>
@@ -38,7 +42,9 @@
 #include <inviwo/core/util/filesystem.h>
 #include <inviwo/core/util/utilities.h>
 
-#include <inviwo/dataframe/jsondataframeconversion.h>
+#include <inviwo/core/common/inviwoapplication.h>
+#include <inviwo/core/network/processornetwork.h>
+#include <inviwo/core/util/logcentral.h>
 
 #include <warn/push>
 #include <warn/ignore/all>
@@ -46,8 +52,22 @@
 #include <include/cef_app.h>
 #include <warn/pop>
 
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <unordered_set>
+#include <utility>
+
 namespace inviwo {
 
+namespace {
+
+std::string sourceKey(const Outport& source) {
+    return source.getProcessor()->getIdentifier() + "." + source.getIdentifier();
+}
+
+}  // namespace
+
 // The Class Identifier has to be globally unique. Use a reverse DNS naming scheme
 const ProcessorInfo DataFrameWebBrowserProcessor::processorInfo_{
     "org.inviwo.dataframewebbrowser",  // Class identifier
@@ -63,10 +83,34 @@ const ProcessorInfo DataFrameWebBrowserProcessor::getProcessorInfo() const {
 DataFrameWebBrowserProcessor::DataFrameWebBrowserProcessor(InviwoApplication* app)
     : WebBrowserProcessor(app)
     // Output from CEF is 8-bits per channel
-    , dataFramePort_("dataFrames") {
+    , dataFramePort_("dataFrames")
+    , brushing_("brushing", {{{BrushingTarget::Row},
+                              BrushingModification::Filtered | BrushingModification::Selected,
+                              InvalidationLevel::InvalidOutput}})
+    , transfer_{std::make_shared<ColumnarTransfer>()} {
     dataFramePort_.setOptional(true);
     addPort(dataFramePort_);
+    brushing_.setOptional(true);
+    addPort(brushing_);
     isLoading_.set(true);
+
+    const auto dataPath = app->getModuleByType<VisualNeuroModule>()->getPath(ModulePath::Data);
+    const auto script = std::filesystem::path(dataPath) / "ui/scripts/columnarData.js";
+    std::ifstream in(script, std::ios::binary);
+    std::stringstream content;
+    content << in.rdbuf();
+    columnarScript_ = content.str();
+    if (columnarScript_.empty()) {
+        LogWarn("Could not read " << script << ", data frames will not reach the page");
+    }
+}
+
+DataFrameWebBrowserProcessor::~DataFrameWebBrowserProcessor() {
+    std::scoped_lock lock{transfer_->mutex};
+    transfer_->alive = false;
+    for (const auto& [key, source] : transfer_->sources) {
+        for (auto version : source.published) util::ColumnarFrameStore::get().erase(version);
+    }
 }
 
 void DataFrameWebBrowserProcessor::process() {
@@ -78,28 +122,21 @@ void DataFrameWebBrowserProcessor::process() {
     if (js_.isModified() && !js_.get().empty()) {
         browser_->GetMainFrame()->ExecuteJavaScript(js_.get(), "", 1);
     }
+    if (reloaded_) {
+        browser_->GetMainFrame()->ExecuteJavaScript(columnarScript_, "", 1);
+    }
+    pruneSources();
     if (reloaded_ || dataFramePort_.isChanged()) {
         auto changed = dataFramePort_.getChangedOutports();
 
         auto dataFrames = dataFramePort_.getSourceVectorData();
         for (const auto& elem : dataFrames) {
             if (reloaded_ || util::contains(changed, elem.first)) {
-                auto dataFrame = elem.second;
-                json root = *dataFrame;
-
-                std::stringstream data("var data = ", std::ios_base::app | std::ios_base::out);
-                data << root.dump() << ";";
-
-                auto frame = browser_->GetMainFrame();
-                json port = {{"port", elem.first->getIdentifier()},
-                             {"processor", elem.first->getProcessor()->getIdentifier()}};
-
-                data << "onInviwoDataChanged(data," << port.dump() << ");";
-
-                frame->ExecuteJavaScript(data.str(), frame->GetURL(), 0);
+                sendDataFrame(elem.second, *elem.first, reloaded_);
             }
         }
-    } 
+    }
+    sendBrushing();
     // Vertical flip of CEF output image
     cefToInviwoImageConverter_.convert(renderHandler_->getTexture2D(browser_), outport_,
                                        &background_);
@@ -107,4 +144,128 @@ void DataFrameWebBrowserProcessor::process() {
     reloaded_ = false;
 }
 
+void DataFrameWebBrowserProcessor::pruneSources() {
+    std::unordered_set<std::string> connected;
+    for (const auto outport : dataFramePort_.getConnectedOutports()) {
+        connected.insert(sourceKey(*outport));
+    }
+    for (auto it = sent_.begin(); it != sent_.end();) {
+        it = connected.count(it->first) == 0 ? sent_.erase(it) : std::next(it);
+    }
+
+    std::scoped_lock lock{transfer_->mutex};
+    auto& sources = transfer_->sources;
+    for (auto it = sources.begin(); it != sources.end();) {
+        // Sources with frames in flight are kept until a later call, when those are published
+        if (connected.count(it->first) != 0 || !it->second.pending.empty()) {
+            ++it;
+            continue;
+        }
+        for (auto version : it->second.published) util::ColumnarFrameStore::get().erase(version);
+        it = sources.erase(it);
+    }
+}
+
+void DataFrameWebBrowserProcessor::sendBrushing() {
+    if (reloaded_) {
+        // The page starts without brushing state
+        sentFiltered_ = BitSet();
+        sentSelected_ = BitSet();
+    }
+    const auto& filtered = brushing_.getFilteredIndices();
+    const auto& selected = brushing_.getSelectedIndices();
+    const auto base = reloaded_ ? 0 : brushingVersion_;
+    auto delta = util::diffBrushing(sentFiltered_, filtered, sentSelected_, selected,
+                                    brushingVersion_ + 1, base);
+    if (delta.empty()) return;
+
+    brushingVersion_ = delta.version;
+    sentFiltered_ = filtered;
+    sentSelected_ = selected;
+    auto mainFrame = browser_->GetMainFrame();
+    mainFrame->ExecuteJavaScript(fmt::format("onInviwoBrushingDelta({});", delta.toJSON()),
+                                 mainFrame->GetURL(), 0);
+}
+
+void DataFrameWebBrowserProcessor::sendDataFrame(std::shared_ptr<const DataFrame> dataFrame,
+                                                 const Outport& source, bool full) {
+    const auto port = source.getIdentifier();
+    const auto processor = source.getProcessor()->getIdentifier();
+    const auto key = sourceKey(source);
+    const auto version = util::ColumnarFrameStore::get().nextVersion();
+    {
+        std::scoped_lock lock{transfer_->mutex};
+        auto& state = transfer_->sources[key];
+        full |= std::exchange(state.failed, false);
+        state.pending.push_back(version);
+    }
+    auto& sent = sent_[key];
+    auto previous = full ? nullptr : sent.frame;
+    const auto base = sent.version;
+    sent = SentFrame{dataFrame, version};
+
+    getNetwork()->getApplication()->dispatchPool([dataFrame, previous, port, processor, key,
+                                                  version, base, transfer = transfer_,
+                                                  browser = browser_]() {
+        ColumnarTransfer::Frame frame;
+        try {
+            if (previous) {
+                const auto delta = util::diffDataFrames(*previous, *dataFrame);
+                frame.full = delta.full;
+                frame.data = std::make_shared<const std::vector<std::byte>>(
+                    util::serializeColumnarDelta(*dataFrame, delta, port, processor, version,
+                                                 base));
+            } else {
+                frame.full = true;
+                frame.data = std::make_shared<const std::vector<std::byte>>(
+                    util::serializeColumnarFrame(*dataFrame, port, processor, version));
+            }
+        } catch (const Exception& e) {
+            LogErrorCustom("DataFrameWebBrowserProcessor", e.getMessage());
+        }
+
+        InviwoApplication::getPtr()->dispatchFront([frame, port, processor, key, version,
+                                                     transfer, browser]() {
+            std::vector<std::string> publish;
+            {
+                std::scoped_lock lock{transfer->mutex};
+                // Skip frames of removed processors
+                if (!transfer->alive) return;
+                auto& state = transfer->sources[key];
+                state.ready[version] = frame;
+                // Publish in dispatch order, frames finished early wait for their predecessors
+                while (!state.pending.empty()) {
+                    auto it = state.ready.find(state.pending.front());
+                    if (it == state.ready.end()) break;
+                    const auto current = it->first;
+                    const auto ready = it->second;
+                    state.ready.erase(it);
+                    state.pending.pop_front();
+                    if (!ready.data) {
+                        state.failed = true;
+                        continue;
+                    }
+                    if (ready.full) {
+                        // Earlier frames are not needed by the page anymore
+                        for (auto old : state.published) util::ColumnarFrameStore::get().erase(old);
+                        state.published.clear();
+                        publish.clear();
+                    }
+                    state.published.push_back(current);
+                    publish.push_back(util::ColumnarFrameStore::get().set(
+                        current, ready.data, browser->GetIdentifier()));
+                }
+            }
+            const nlohmann::json portInfo = {{"port", port}, {"processor", processor}};
+            auto mainFrame = browser->GetMainFrame();
+            for (const auto& token : publish) {
+                mainFrame->ExecuteJavaScript(
+                    fmt::format("onInviwoColumnarData('{}', {});", util::columnarFrameURL(token),
+                                portInfo.dump()),
+                    mainFrame->GetURL(), 0);
+            }
+        });
+    });
+}
+
 }  // namespace inviwo
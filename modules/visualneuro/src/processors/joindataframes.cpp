@@ -28,8 +28,10 @@
  *********************************************************************************/
 
 #include <modules/visualneuro/processors/joindataframes.h>
+#include <modules/visualneuro/algorithm/dataframe/concatenaterows.h>
 
-#include <inviwo/dataframe/util/dataframeutil.h>
+#include <string>
+#include <vector>
 
 namespace inviwo {
 
@@ -51,19 +53,16 @@ JoinDataFrames::JoinDataFrames()
 }
 
 void JoinDataFrames::process() {
-
-    auto res = std::make_shared<DataFrame>(*(*dataFrames.begin()));
-    for (auto dataFrame = ++dataFrames.begin(); dataFrame != dataFrames.end(); ++dataFrame) {
-        bool matchByName = true;
-        *res = *dataframe::appendRows(*res, *(*dataFrame), matchByName);
-    }
-    auto fromPortColumn = res->addCategoricalColumn("Processor", res->getNumberOfRows());
-    auto idx = 0;
-    for (auto elem : dataFrames.getSourceVectorData()) {
-        for (auto row = 0u; row < elem.second->getNumberOfRows(); row++) {
-            fromPortColumn->set(idx++, elem.first->getProcessor()->getIdentifier());
-        }
+    std::vector<std::shared_ptr<const DataFrame>> frames;
+    std::vector<std::string> processors;
+    for (const auto& [port, dataFrame] : dataFrames.getSourceVectorData()) {
+        frames.push_back(dataFrame);
+        processors.insert(processors.end(), dataFrame->getNumberOfRows(),
+                          port->getProcessor()->getIdentifier());
     }
+
+    auto res = dataframe::concatenateRows(frames);
+    res->addCategoricalColumn("Processor", processors);
     res->updateIndexBuffer();
     joinedFrame.setData(res);
 }
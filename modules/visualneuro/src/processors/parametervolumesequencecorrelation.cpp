@@ -28,13 +28,14 @@
  *********************************************************************************/
 
 #include <modules/visualneuro/processors/parametervolumesequencecorrelation.h>
-#include <modules/visualneuro/statistics/pearsoncorrelation.h>
+#include <modules/visualneuro/algorithm/volume/voxelstatistics.h>
+#include <modules/visualneuro/util/jobmetrics.h>
+#include <modules/visualneuro/util/volumememoryaccountant.h>
 #include <inviwo/core/datastructures/volume/volumeramprecision.h>
 #include <inviwo/core/util/exception.h>
 #include <inviwo/core/network/networklock.h>
 #include <inviwo/core/properties/boolproperty.h>
 #include <inviwo/core/util/utilities.h>
-#include <inviwo/core/util/zip.h>
 
 namespace inviwo {
 
@@ -69,7 +70,8 @@ ParameterVolumeSequenceCorrelation::ParameterVolumeSequenceCorrelation()
                 {{"twoTailedTest", "Two-tailed test", stats::TailTest::Both},
                  {"rightOneTailedTest", "Right one-tailed test", stats::TailTest::Greater},
                  {"leftOneTailedTest", "Left one-tailed test", stats::TailTest::Less}},
-                0) {
+                0)
+    , parameters_{std::make_shared<dataframe::ParameterMatrixCache>()} {
 
     addPort(volumes_);
     addPort(dataFrame_);
@@ -83,145 +85,55 @@ ParameterVolumeSequenceCorrelation::ParameterVolumeSequenceCorrelation()
 }
 
 void ParameterVolumeSequenceCorrelation::process() {
-
-    const auto calc = [volumes = volumes_.getData(), brushing = brushing_.getManager(),
-                       dataFrame = dataFrame_.getData(), mask = mask_.getData(),
-                       tailTest = *tailTest_, correlationMethod = *correlationMethod_,
-                       pVal = *pVal_](pool::Stop stop,
-                                      pool::Progress progress) -> std::shared_ptr<Volume> {
+    auto metrics = std::make_shared<util::JobMetrics>(*this);
+    const auto calc = [metrics, parameterCache = parameters_, volumes = volumes_.getData(),
+                       brushing = brushing_.getManager(), dataFrame = dataFrame_.getData(),
+                       mask = mask_.getData(),
+                       settings = stats::CorrelationSettings{*correlationMethod_, *tailTest_,
+                                                             *pVal_}](
+                          pool::Stop stop, pool::Progress progress) -> std::shared_ptr<Volume> {
+        const auto job = metrics->start();
         progress(0.f);
 
-        auto getVoxelValues = [](const std::vector<const VolumeRAM*>& volumeRAMs,
-                                 std::shared_ptr<const VolumeSequence> volumeSequence,
-                                 size_t vxlNmbr, const std::vector<bool>& filter) {
-            std::vector<double> values;
-            values.reserve(volumeRAMs.size());
-
-            for (size_t index = 0; index < volumeRAMs.size(); index++) {
-                if (filter[index]) continue;
-
-                auto dataMap = (*volumeSequence)[index]->dataMap;
-                volumeRAMs[index]->dispatch<void, dispatching::filter::Scalars>(
-                    [&values, vxlNmbr, &dataMap](auto vr) {
-                        auto ptr_first_vxl = vr->getDataTyped();
-                        values.emplace_back(dataMap.mapFromDataToValue(
-                            static_cast<double>(*(ptr_first_vxl + vxlNmbr))));
-                    });
-            }
-            return values;
-        };
-
-        // Calculate total number of voxels in one volume
-        auto dims = volumes->front()->getDimensions();
-        auto nVoxels = dims[0] * dims[1] * dims[2];
-
-        // Create RAM represenation to be able to read voxels
-        std::vector<const VolumeRAM*> volRam;
-        std::transform(volumes->begin(), volumes->end(), std::back_inserter(volRam),
-                       [](auto vol) { return vol->template getRepresentation<VolumeRAM>(); });
-        // Create matrices for conversion from voxelNmbr -> vec3 index (correlation volume) ->
-        // worldPos -> vec3 index (indexed volume)
-        mat4 indexToWorld = (*volumes->begin())->getCoordinateTransformer().getIndexToWorldMatrix();
-        mat4 worldToIndex = mask->getCoordinateTransformer().getWorldToIndexMatrix();
-        auto volRamIndexed = mask->getRepresentation<VolumeRAM>();
-        // Create volume and dataframe to write values into
-        auto vol = std::make_shared<VolumeRAMPrecision<float>>(dims);
-        auto resVol = std::make_shared<Volume>(vol);
-
-        // Get pointer to volumes first voxel
-        float* res = vol->getDataTyped();
-
-        dvec2 minMax(std::numeric_limits<double>::max(), std::numeric_limits<double>::lowest());
         const auto& selectedColumns = brushing.getSelectedIndices(BrushingTarget::Column);
         if (selectedColumns.empty()) {
-            for (size_t vxlNmbr = 0; vxlNmbr < nVoxels; vxlNmbr++) {
-                *(res + vxlNmbr) = 0;
-            }
-        } else {
-            size_t selectedParameter = *selectedColumns.begin();
-            std::vector<bool> filter(dataFrame->getColumn(selectedParameter)->getSize(), false);
-            const auto& brushed = brushing.getFilteredIndices();
-            for (const auto& brushedId : brushed) {
-                filter[brushedId] = true;
-            }
-            auto paramValues =
-                dataFrame->getColumn(selectedParameter)
-                    ->getBuffer()
-                    ->getRepresentation<BufferRAM>()
-                    ->dispatch<std::vector<double>, dispatching::filter::Scalars>(
-                        [filter](auto brprecision) {
-                            using ValueType = util::PrecisionValueType<decltype(brprecision)>;
-
-                            const std::vector<ValueType>& data = brprecision->getDataContainer();
-                            std::vector<double> values;
-                            values.reserve(data.size());
-                            for (auto&& [filtered, value] : util::zip(filter, data)) {
-                                if (!filtered)
-                                    values.emplace_back(util::glm_convert<double>(value));
-                            }
-                            return values;
-                        });
-            // Deal with NaN by removing the corresponding subjects
-            std::transform(paramValues.begin(), paramValues.end(), filter.begin(),
-                           [](const auto& v) -> bool { return std::isnan(v); });
-            util::erase_remove_if(paramValues, [](const auto& v) { return std::isnan(v); });
-            auto startTime = std::chrono::high_resolution_clock::now();
-            for (size_t vxlNmbr = 0; vxlNmbr < nVoxels; vxlNmbr++) {
-                // Exit function if this is not the latest job
-                if (stop) return resVol;
-                // Convert voxelNmbr to ivec3
-                size_t x = vxlNmbr % dims.x;
-                size_t z = vxlNmbr / (dims.x * dims.y);
-                size_t y = (vxlNmbr / dims.x) - (z * dims.y);
-                const ivec3 index(x, y, z);
-
-                // Convert position in correlation volume to position in indexed volume
-                vec3 worldCoordinates(vec3(indexToWorld * ivec4(index, 1)));
-                ivec3 indexCoordinates(ivec3(worldToIndex * vec4(worldCoordinates, 1.0f)));
-
-                // Calculate a value for the voxel only if it's part of a selected region
-                auto showVoxel = volRamIndexed->getAsDouble(indexCoordinates) != 0.0;
-
-                if (showVoxel) {
-
-                    // Create a vector with all values for current voxel
-                    std::vector<double> voxelValues =
-                        getVoxelValues(volRam, volumes, vxlNmbr, filter);
-                    auto [corr, p] =
-                        stats::corrTest(paramValues, voxelValues, correlationMethod, tailTest);
-                    // Check if p-value is statistically significant
-                    *(res + vxlNmbr) = (p < pVal) ? static_cast<float>(corr) : 0.f;
-
-                } else {
-                    *(res + vxlNmbr) = 0.f;
-                }
-                minMax.x = std::min(minMax.x, static_cast<double>(*(res + vxlNmbr)));
-                minMax.y = std::max(minMax.y, static_cast<double>(*(res + vxlNmbr)));
-                if (std::chrono::high_resolution_clock::now() - startTime >
-                    std::chrono::milliseconds(200)) {
-                    progress(vxlNmbr, nVoxels);
-                    startTime = std::chrono::high_resolution_clock::now();
-                }
-            }
+            auto resVol = std::make_shared<Volume>(
+                std::make_shared<VolumeRAMPrecision<float>>(volumes->front()->getDimensions()));
+            resVol->dataMap.dataRange = dvec2(-1.0, 1.0);
+            resVol->dataMap.valueRange = dvec2(-1.0, 1.0);
+            resVol->setModelMatrix(volumes->front()->getModelMatrix());
+            resVol->setWorldMatrix(volumes->front()->getWorldMatrix());
+            return resVol;
         }
 
-        // Set data range and value range to (-1,1) since that's the range of the Pearson/Spearman
-        // correlation.
-        resVol->dataMap.dataRange = dvec2(-1.0, 1.0);
-        resVol->dataMap.valueRange = dvec2(-1.0, 1.0);
-
-        resVol->setModelMatrix(volumes->front()->getModelMatrix());
-        resVol->setWorldMatrix(volumes->front()->getWorldMatrix());
+        // One subject per volume. Subjects that are brushed away or missing data (NaN) are
+        // excluded from the correlation.
+        util::PhaseTimer extract(metrics.get(), util::JobPhase::Gather);
+        std::vector<std::uint32_t> rows(volumes->size(), dataframe::ParameterMatrix::noRow);
+        const auto nRows = std::min(rows.size(), dataFrame->getNumberOfRows());
+        for (std::uint32_t row = 0; row < nRows; ++row) {
+            if (!brushing.isFiltered(row)) rows[row] = row;
+        }
+        const auto parameters = parameterCache->get(dataFrame, rows);
+        extract.stop();
 
+        auto resVol = stats::parameterVolumeCorrelation(
+            *volumes, *parameters, *selectedColumns.begin(), settings, mask.get(),
+            util::makeBlockControl(stop, progress, metrics.get()));
         progress(1.f);
 
         return resVol;
     };
 
-
-    dispatchOne(calc, [this](std::shared_ptr<Volume> result) {
+    dispatchOne(calc, [this, metrics](std::shared_ptr<Volume> result) {
+        util::PhaseTimer timer(metrics.get(), util::JobPhase::Publish);
         resCorrelationVolume_.setData(result);
+        util::VolumeMemoryAccountant::get().track(
+            result, util::VolumeMemoryAccountant::ownerName(resCorrelationVolume_),
+            util::RepresentationSource::Computed);
         newResults();
+        timer.stop();
+        metrics->finish();
     });
 }
 
@@ -0,0 +1,188 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/processors/processingmetrics.h>
+#include <modules/visualneuro/util/jobmetrics.h>
+#include <modules/visualneuro/util/volumememoryaccountant.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+
+#include <fmt/chrono.h>
+
+namespace inviwo {
+
+namespace {
+
+constexpr double toMilliseconds = 1000.0;
+
+void addPhaseColumns(DataFrame& dataFrame,
+                     const std::vector<std::array<double, util::numberOfJobPhases>>& seconds) {
+    for (size_t phase = 0; phase < util::numberOfJobPhases; ++phase) {
+        std::vector<double> values;
+        for (const auto& s : seconds) values.push_back(s[phase] * toMilliseconds);
+        dataFrame.addColumn<double>(
+            fmt::format("{}_ms", util::enumToStr(static_cast<util::JobPhase>(phase))), values);
+    }
+}
+
+std::shared_ptr<DataFrame> summaryDataFrame(const std::vector<util::ProcessorMetrics>& metrics) {
+    std::vector<std::string> classes, processors;
+    std::vector<int> jobs, cancelled;
+    std::vector<std::array<double, util::numberOfJobPhases>> meanSeconds;
+    std::vector<double> meanElapsed, maxElapsed, voxels, megabytes, voxelsPerSecond;
+    for (const auto& m : metrics) {
+        const auto finished = static_cast<double>(std::max<size_t>(m.finished(), 1));
+        classes.push_back(m.processorClass);
+        processors.push_back(m.processor);
+        jobs.push_back(static_cast<int>(m.jobs));
+        cancelled.push_back(static_cast<int>(m.cancelled));
+        auto& mean = meanSeconds.emplace_back(m.seconds);
+        for (auto& s : mean) s /= finished;
+        meanElapsed.push_back(m.elapsed / finished * toMilliseconds);
+        maxElapsed.push_back(m.maxElapsed * toMilliseconds);
+        voxels.push_back(static_cast<double>(m.voxels));
+        megabytes.push_back(static_cast<double>(m.bytes) / (1 << 20));
+        voxelsPerSecond.push_back(m.voxelsPerSecond());
+    }
+
+    auto dataFrame = std::make_shared<DataFrame>();
+    dataFrame->addCategoricalColumn("Processor", processors);
+    dataFrame->addCategoricalColumn("Class", classes);
+    dataFrame->addColumn<int>("Jobs", jobs);
+    dataFrame->addColumn<int>("Cancelled", cancelled);
+    addPhaseColumns(*dataFrame, meanSeconds);
+    dataFrame->addColumn<double>("Mean_elapsed_ms", meanElapsed);
+    dataFrame->addColumn<double>("Max_elapsed_ms", maxElapsed);
+    dataFrame->addColumn<double>("Voxels", voxels);
+    dataFrame->addColumn<double>("MiB", megabytes);
+    dataFrame->addColumn<double>("Voxels_per_second", voxelsPerSecond);
+    dataFrame->updateIndexBuffer();
+    return dataFrame;
+}
+
+std::shared_ptr<DataFrame> jobsDataFrame(const std::vector<util::JobRecord>& jobs) {
+    std::vector<std::string> classes, processors, finished;
+    std::vector<int> cancelled;
+    std::vector<std::array<double, util::numberOfJobPhases>> seconds;
+    std::vector<double> elapsed, voxels, megabytes;
+    for (const auto& job : jobs) {
+        classes.push_back(job.processorClass);
+        processors.push_back(job.processor);
+        finished.push_back(fmt::format(
+            "{:%H:%M:%S}", std::chrono::time_point_cast<std::chrono::seconds>(job.finished)));
+        cancelled.push_back(job.cancelled ? 1 : 0);
+        seconds.push_back(job.seconds);
+        elapsed.push_back(job.elapsed * toMilliseconds);
+        voxels.push_back(static_cast<double>(job.voxels));
+        megabytes.push_back(static_cast<double>(job.bytes) / (1 << 20));
+    }
+
+    auto dataFrame = std::make_shared<DataFrame>();
+    dataFrame->addCategoricalColumn("Processor", processors);
+    dataFrame->addCategoricalColumn("Class", classes);
+    dataFrame->addCategoricalColumn("Finished", finished);
+    dataFrame->addColumn<int>("Cancelled", cancelled);
+    addPhaseColumns(*dataFrame, seconds);
+    dataFrame->addColumn<double>("Elapsed_ms", elapsed);
+    dataFrame->addColumn<double>("Voxels", voxels);
+    dataFrame->addColumn<double>("MiB", megabytes);
+    dataFrame->updateIndexBuffer();
+    return dataFrame;
+}
+
+std::shared_ptr<DataFrame> memoryDataFrame(const std::vector<util::OwnerMemoryUsage>& usage) {
+    constexpr double toMiB = 1.0 / (1 << 20);
+    std::vector<std::string> owners;
+    std::vector<int> volumes;
+    std::vector<double> ram, gl, evictable;
+    for (const auto& u : usage) {
+        owners.push_back(u.owner);
+        volumes.push_back(static_cast<int>(u.volumes));
+        ram.push_back(static_cast<double>(u.ramBytes) * toMiB);
+        gl.push_back(static_cast<double>(u.glBytes) * toMiB);
+        evictable.push_back(static_cast<double>(u.evictableBytes) * toMiB);
+    }
+
+    auto dataFrame = std::make_shared<DataFrame>();
+    dataFrame->addCategoricalColumn("Port", owners);
+    dataFrame->addColumn<int>("Volumes", volumes);
+    dataFrame->addColumn<double>("RAM_MiB", ram);
+    dataFrame->addColumn<double>("GL_MiB", gl);
+    dataFrame->addColumn<double>("Evictable_MiB", evictable);
+    dataFrame->updateIndexBuffer();
+    return dataFrame;
+}
+
+}  // namespace
+
+// The Class Identifier has to be globally unique. Use a reverse DNS naming scheme
+const ProcessorInfo ProcessingMetrics::processorInfo_{
+    "org.inviwo.ProcessingMetrics",  // Class identifier
+    "Processing Metrics",            // Display name
+    "Information",                   // Category
+    CodeState::Experimental,         // Code state
+    Tags::CPU,                       // Tags
+};
+const ProcessorInfo ProcessingMetrics::getProcessorInfo() const { return processorInfo_; }
+
+ProcessingMetrics::ProcessingMetrics()
+    : Processor()
+    , metrics_("metrics")
+    , output_("output", "Output",
+              {{"summary", "Summary per processor", Output::Summary},
+               {"jobs", "Jobs", Output::Jobs},
+               {"memory", "Volume memory per port", Output::Memory}},
+              0)
+    , clear_("clear", "Clear", [this]() { util::MetricsRegistry::get().clear(); })
+    , onRecord_{util::MetricsRegistry::get().onRecord(
+          [this]() { invalidate(InvalidationLevel::InvalidOutput); })} {
+
+    addPort(metrics_);
+    addProperties(output_, clear_);
+}
+
+void ProcessingMetrics::process() {
+    const auto& registry = util::MetricsRegistry::get();
+    switch (*output_) {
+        case Output::Memory:
+            metrics_.setData(memoryDataFrame(util::VolumeMemoryAccountant::get().getUsage()));
+            break;
+        case Output::Jobs:
+            metrics_.setData(jobsDataFrame(registry.getJobs()));
+            break;
+        case Output::Summary:
+        default:
+            metrics_.setData(summaryDataFrame(registry.summarize()));
+            break;
+    }
+}
+
+}  // namespace inviwo
@@ -28,11 +28,36 @@
  *********************************************************************************/
 
 #include <modules/visualneuro/processors/syncpatientdata.h>
-#include <modules/visualneuro/processors/volumesequencefilter.h>
-#include <inviwo/core/util/filesystem.h>
+#include <modules/visualneuro/algorithm/dataframe/csvwriter.h>
+#include <modules/visualneuro/algorithm/dataframe/patientdatasync.h>
+#include <inviwo/core/util/exception.h>
+
+#include <filesystem>
+#include <fstream>
 
 namespace inviwo {
 
+namespace {
+
+std::ofstream openOutput(const std::filesystem::path& file, std::ios::openmode mode) {
+    std::ofstream out(file, mode);
+    if (!out) {
+        throw Exception(fmt::format("Could not open {} for writing", file.string()),
+                        IVW_CONTEXT_CUSTOM("SyncPatientData"));
+    }
+    return out;
+}
+
+void closeOutput(std::ofstream& out, const std::filesystem::path& file) {
+    out.close();
+    if (!out) {
+        throw Exception(fmt::format("Could not write {}", file.string()),
+                        IVW_CONTEXT_CUSTOM("SyncPatientData"));
+    }
+}
+
+}  // namespace
+
 // The Class Identifier has to be globally unique. Use a reverse DNS naming scheme
 const ProcessorInfo SyncPatientData::processorInfo_{
     "org.inviwo.SyncPatientData",  // Class identifier
@@ -44,219 +69,116 @@ const ProcessorInfo SyncPatientData::processorInfo_{
 const ProcessorInfo SyncPatientData::getProcessorInfo() const { return processorInfo_; }
 
 SyncPatientData::SyncPatientData()
-    : Processor()
+    : PoolProcessor()
     , mapping_("mapping")
     , patientData_("patientData")
+    , actions_("actions")
     , folder_("folder", "Volume folder")
     , sync_("sync", "Sync patient data")
+    , dryRun_("dryRun", "Dry run", false)
     , volumeFileIdKeyword_("volumeFileIdKeyword", "Volume file id keyword", "Subject") {
 
     addPort(mapping_);
     addPort(patientData_);
+    addPort(actions_);
 
     addProperty(folder_);
     addProperty(sync_);
+    addProperty(dryRun_);
     addProperty(volumeFileIdKeyword_);
 
     sync_.onChange([this] { buttonPressed_ = true; });
 }
 
-void SyncPatientData::addFilesToMap(std::map<std::string, std::pair<std::string, std::string>>& m,
-                                    std::map<std::string, std::string> mapping,
-                                    std::string directory) {
-
-    // Loop through the files in that folder, extract the patient id from the
-    // filename, translate it and add all id's + filepaths to an map.
-    //for (auto& p : std::filesystem::directory_iterator(directory)) {
-    for (auto& p : filesystem::getDirectoryContents(directory, filesystem::ListMode::Files)) {
-        auto fileAndPath = p;
-        //std::string fileAndPath = p.path().string();
-        std::string file = fileAndPath;
-
-        auto startPositionToErase = file.find(directory);
-        file.erase(startPositionToErase, directory.length());
-
-        // For some reason a "\" is added to the path, which is not very useful...
-        if (file.find("\\") != std::string::npos) {
-            file.replace(file.find("\\"), 1, "");
-        }
-
-        // Ignores alla files that doesn't have the .nii file extension.
-        if (file.find(".nii") == std::string::npos) continue;
-
-        std::string id = VolumeSequenceFilter::extractPatientId(file, volumeFileIdKeyword_.get());
-
-        std::string translatedId = mapping[id];
-
-        m.insert(std::make_pair(translatedId, make_pair(fileAndPath, file)));
-    }
-}
-
 void SyncPatientData::process() {
+    if (!buttonPressed_) return;
+    buttonPressed_ = false;
 
-    if (buttonPressed_) {
-        buttonPressed_ = false;
-
-        if (folder_.get() == "") {
-            LogError("No fMRI volume folder was set! (set it in processor properties)");
-            return;
-        }
-
-        auto mapping = mapping_.getData();
-        auto mappingSize = mapping->getNumberOfRows();
-
-        // Create two maps between the two types of patient id's.
-        // They both contain the same data but the id that is used for key in one map
-        // is the value in the other map etc.
-        std::map<std::string, std::string> patientIdsStringKey;
-        std::map<std::string, std::string> patientIdsNumbKey;
-        for (int i = 0; i < mappingSize; i++) {
-
-            auto id_A = mapping->getColumn(1)->getAsString(i);
-            auto id_B = mapping->getColumn(2)->getAsString(i);
-
-            patientIdsNumbKey[id_B] = id_A;
-            patientIdsStringKey[id_A] = id_B;
-        }
-
-        // Get the fMRI folder location
-        std::string location_fMRI = folder_.get();
-        std::map<std::string, std::pair<std::string, std::string>> files;
-
-        addFilesToMap(files, patientIdsNumbKey, location_fMRI);
-
-        // Go through .csv-file:
-        // - all rows that cannot be found in the unordered_map are not copied to the new .csv-file.
-        auto patientData = patientData_.getData();
-        auto patientDataSize = patientData->getNumberOfRows();
-        std::stringstream newCsvData;
-        std::stringstream patientsWithoutScans;
-        std::set<std::string> patientIdsWithData;
-
-        int matches = 0, nonMatches = 0;
-        for (int i = 0; i < patientDataSize; i++) {
-
-            auto patientId = patientData->getColumn(1)->getAsString(i);
-
-            // If the patient have a fMRI scan, add it to the new .csv file
-            if (patientIdsStringKey.find(patientId) != patientIdsStringKey.end()) {
-                for (int j = 1; j < patientData->getNumberOfColumns(); j++) {
-                    newCsvData << patientData->getColumn(j)->getAsString(i) << ",";
-                }
-                newCsvData << "\n";
-                matches++;
-            } else {
-                // For debugging purposes, save the patients without a matching fMRI scan.
-                patientsWithoutScans << patientData->getColumn(1)->getAsString(i) << "\n";
-                nonMatches++;
-            }
-
-            // Create a stringstream with all patients with other data than the scan.
-            patientIdsWithData.insert(patientData->getColumn(1)->getAsString(i));
-        }
-
-        // Create a folder for all fMRI scans that doesn't have matching data in the .csv-file.
-        const std::string unmatchedLocation = location_fMRI.append("/non_matching_scans/");
-        filesystem::createDirectoryRecursively(unmatchedLocation);
-        //std::filesystem::create_directory(unmatchedLocation);
-        // Add potential files that has already been moved to the files-map, since it will be
-        // used to list all mismatched patients in a logfile later on.
-        addFilesToMap(files, patientIdsNumbKey, unmatchedLocation);
-
-        int movedVolumes = 0;
-        // Loop through the fMRI-files.
-        for (auto file : files) {
-            // If the file is not found among the patients with data
-            if (patientIdsWithData.find(file.first) == patientIdsWithData.end()) {
+    if (folder_.get().empty()) {
+        LogError("No fMRI volume folder was set! (set it in processor properties)");
+        return;
+    }
 
-                std::string newLocation = unmatchedLocation;
-                newLocation.append(file.second.second);
-                // Move the file to another folder.
-                rename(file.second.first.c_str(), newLocation.c_str());
-                movedVolumes++;
+    struct Result {
+        dataframe::PatientDataSyncPlan plan;
+        std::shared_ptr<DataFrame> actions;
+        size_t movedVolumes = 0;
+        std::filesystem::path csvFile;
+        std::filesystem::path logFile;
+    };
+
+    const auto calc = [mapping = mapping_.getData(), patientData = patientData_.getData(),
+                       folder = std::filesystem::path(folder_.get()),
+                       pattern = dataframe::PatientIdPattern(volumeFileIdKeyword_.get()),
+                       dryRun = dryRun_.get()](pool::Stop stop,
+                                               pool::Progress progress) -> std::shared_ptr<Result> {
+        const auto control = util::makeBlockControl(stop, progress);
+        progress(0.f);
+        auto plan = dataframe::planPatientDataSync(*mapping, *patientData, folder, pattern,
+                                                   control);
+        // Exit function if this is not the latest job
+        if (!plan) return nullptr;
+
+        auto result = std::make_shared<Result>();
+        result->actions = dataframe::patientDataSyncActions(*plan, *patientData);
+        if (!dryRun) {
+            // The files are written next to the volume folder. They are opened before any volume
+            // is moved, so a bad output path leaves the folder untouched
+            const auto parent = folder.parent_path();
+            result->logFile = parent / "Non-matching patient cases.csv";
+            auto log = openOutput(result->logFile, std::ios::out);
+            std::ofstream csv;
+            if (!plan->unmatchedRows.empty()) {
+                result->csvFile = parent / "Patients with matching fMRI.csv";
+                csv = openOutput(result->csvFile, std::ios::out | std::ios::binary);
             }
-        }
-
-        // Get fMRI volumes location.
-        std::string saveLocation = folder_.get();
-
-        // Move up one directory.
-        auto pos = saveLocation.find_last_of("/");
-        saveLocation.erase(pos, saveLocation.length());
-        std::string missmatchedCsv = saveLocation.append("/Non-matching patient cases.csv");
 
-        // Create logfile and fill it with values.
-        std::ofstream logFile;
-        const std::string spacing = ",,,,,,";
-        logFile.open(missmatchedCsv);
-        logFile << "fMRI-scans that lack data in the .csv-file,," << spacing;
-        logFile << "Patients in the .csv-file that cannot be coupled with a fMRI-scan\n";
-        logFile << "ID,,Filename" << spacing << "ID\n";
+            result->movedVolumes = dataframe::applyPatientDataSync(*plan, control);
 
-        for (auto file : files) {
-
-            if (patientIdsWithData.find(file.first) == patientIdsWithData.end()) {
-                logFile << file.first << ",," << file.second.second;
-            } else {
-                continue;
-            }
-
-            if (patientsWithoutScans) {
-                std::string temp;
-                patientsWithoutScans >> temp;
-                logFile << spacing << temp;
+            dataframe::writePatientDataSyncLog(log, *plan, *patientData);
+            closeOutput(log, result->logFile);
+            if (csv.is_open()) {
+                dataframe::writeCSV(csv, *patientData, plan->matchedRows, control);
+                closeOutput(csv, result->csvFile);
             }
-            logFile << "\n";
         }
-        while (patientsWithoutScans) {
-            std::string temp;
-            patientsWithoutScans >> temp;
-            logFile << ",," << spacing << temp << "\n";
+        result->plan = std::move(*plan);
+        progress(1.f);
+        return result;
+    };
+
+    dispatchOne(calc, [this, dryRun = dryRun_.get(),
+                       keyword = volumeFileIdKeyword_.get()](std::shared_ptr<Result> result) {
+        if (!result) return;
+        actions_.setData(result->actions);
+        newResults();
+
+        const auto& plan = result->plan;
+        LogInfo("Patients with fMRI-scans: " << plan.matchedRows.size());
+        LogInfo("Patients without fMRI-scans: " << plan.unmatchedRows.size());
+        LogInfo("fMRI volumes without other patient data: " << plan.moves.size());
+        if (!plan.skipped.empty()) {
+            LogWarn(plan.skipped.size() << " fMRI volumes have no patient id after '"
+                                        << keyword
+                                        << "' in their filename and were left in place, e.g. "
+                                        << plan.skipped.front().filename());
         }
-        logFile.close();
-
-        std::string newFileName;
-        if (nonMatches > 0) {
-            // Create a new .csv-file with only patients that has fMRI-scans.
-            std::ofstream newCsvFile;
-
-            // Get fMRI volumes location.
-            saveLocation = folder_.get();
-
-            // Move up one directory.
-            pos = saveLocation.find_last_of("/");
-            saveLocation.erase(pos, saveLocation.length());
-            newFileName = saveLocation.append("/Patients with matching fMRI.csv");
-
-            // Create a new file to put only matching patient cases into.
-            newCsvFile.open(newFileName);
-            for (auto header : patientData->getHeaders()) {
-                newCsvFile << header.first << ",";
-            }
-            newCsvFile << "\n";
-            while (newCsvData) {
-                std::string temp;
-                std::getline(newCsvData, temp);
-                newCsvFile << temp << "\n";
-            }
-            newCsvFile.close();
+        if (dryRun) {
+            LogInfo("Dry run, no files were moved or written");
+            return;
         }
-
-		// Print information about what has been done.
-        LogInfo("Patients with fMRI-scans: " << matches);
-        LogInfo("Patients without fMRI-scans: " << nonMatches);
-        LogInfo("fMRI volumes without other patient data: " << movedVolumes);
-
-        if (movedVolumes > 0)
+        if (result->movedVolumes > 0) {
             LogInfo("fMRI volumes with no matching data in given .csv-file was moved to:\n"
-                    << unmatchedLocation);
-        if (nonMatches) {
-            LogInfo("New .csv-file containting only patients with matching fMRI volumes created at:\n"
-                    << newFileName);
-            LogInfo("A .csv-file with all mismatched patients has been created at:\n"
-                    << missmatchedCsv);
+                    << plan.unmatchedFolder);
         }
-    }
+        if (!result->csvFile.empty()) {
+            LogInfo("New .csv-file containting only patients with matching fMRI volumes "
+                    "created at:\n"
+                    << result->csvFile);
+        }
+        LogInfo("A .csv-file with all mismatched patients has been created at:\n"
+                << result->logFile);
+    });
 }
 
 }  // namespace inviwo
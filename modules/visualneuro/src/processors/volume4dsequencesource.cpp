@@ -28,6 +28,8 @@
  *********************************************************************************/
 
 #include <modules/visualneuro/processors/volume4dsequencesource.h>
+#include <modules/visualneuro/util/jobmetrics.h>
+#include <modules/visualneuro/util/volumememoryaccountant.h>
 
 #include <inviwo/core/common/inviwoapplication.h>
 #include <inviwo/core/io/datareaderfactory.h>
@@ -107,6 +109,7 @@ std::shared_ptr<Volume4DSequence> Volume4DSequenceSource::loadFile(std::filesyst
     progress(0.f);
     if (auto reader = rf->getReaderForTypeAndExtension<VolumeSequence>(sext, path)) {
         try {
+            const util::TraceSpan span("Read", "io", {{"file", path.generic_string()}});
             volumes = std::make_shared<Volume4DSequence>(1, reader->readData(path, this));
         } catch (DataReaderException const& e) {
             LogProcessorError(e.getMessage());
@@ -129,6 +132,7 @@ std::shared_ptr<Volume4DSequence> Volume4DSequenceSource::loadFolder(std::filesy
         auto file = folder / f;
         if (filesystem::wildcardStringMatch(filter_, file.generic_string())) {
             try {
+                const util::TraceSpan span("Read", "io", {{"file", file.generic_string()}});
                 if (auto reader1 = rf->getReaderForTypeAndExtension<Volume>(file)) {
                     auto volume = reader1->readData(file, this);
                     volume->setMetaData<StringMetaData>("filename", file.generic_string());
@@ -169,24 +173,39 @@ void Volume4DSequenceSource::process() {
     if (file_.isModified() || reload_.isModified() || folder_.isModified() ||
         filter_.isModified() || mirrorRanges_.isModified()) {
 
+        auto metrics = std::make_shared<util::JobMetrics>(*this);
         const auto load = [this, path = getPath(), inputType = inputType_.get(),
-                           sext = file_.getSelectedExtension(),
-                           rf = rf_](pool::Stop stop,
-                                     pool::Progress progress) -> std::shared_ptr<Volume4DSequence> {
+                           sext = file_.getSelectedExtension(), rf = rf_,
+                           metrics](pool::Stop stop,
+                                    pool::Progress progress) -> std::shared_ptr<Volume4DSequence> {
+            const auto job = metrics->start();
             if (getPath().empty()) {
                 return std::make_shared<Volume4DSequence>();
             }
+            const util::PhaseTimer timer(metrics.get(), util::JobPhase::Gather);
+            std::shared_ptr<Volume4DSequence> volumes;
             switch (inputType) {
                 case InputType::Folder:
-                    return loadFolder(path, rf, stop, progress);
+                    volumes = loadFolder(path, rf, stop, progress);
                     break;
                 case InputType::SingleFile:
                 default:
-                    return loadFile(path, sext, rf, progress);
+                    volumes = loadFile(path, sext, rf, progress);
                     break;
             }
+            if (volumes) {
+                for (const auto& volumeSequence : *volumes) {
+                    for (const auto& volume : *volumeSequence) {
+                        const auto nVoxels = glm::compMul(volume->getDimensions());
+                        metrics->addVoxels(nVoxels);
+                        metrics->addBytes(nVoxels * volume->getDataFormat()->getSize());
+                    }
+                }
+            }
+            return volumes;
         };
-        dispatchOne(load, [this](std::shared_ptr<Volume4DSequence> result) {
+        dispatchOne(load, [this, metrics](std::shared_ptr<Volume4DSequence> result) {
+            util::PhaseTimer timer(metrics.get(), util::JobPhase::Publish);
             if (result && !result->empty()) {
                 auto valueRange = dvec2(std::numeric_limits<double>::max(),
                                         std::numeric_limits<double>::lowest());
@@ -243,8 +262,16 @@ void Volume4DSequenceSource::process() {
                     }
                 }
                 outport_.setData(result);
+                // The volumes are read lazily and can be reloaded from their disk representation
+                const auto owner = util::VolumeMemoryAccountant::ownerName(outport_);
+                for (const auto& volumeSequence : *result) {
+                    util::VolumeMemoryAccountant::get().track(
+                        *volumeSequence, owner, util::RepresentationSource::Disk);
+                }
                 newResults();
             }
+            timer.stop();
+            metrics->finish();
         });
     }
 }
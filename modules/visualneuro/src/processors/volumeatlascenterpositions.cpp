@@ -28,8 +28,8 @@
  *********************************************************************************/
 
 #include <modules/visualneuro/processors/volumeatlascenterpositions.h>
-#include <inviwo/core/datastructures/volume/volumeramprecision.h>
-#include <inviwo/core/util/indexmapper.h>
+#include <modules/visualneuro/datastructures/atlasindexfile.h>
+#include <modules/visualneuro/util/jobmetrics.h>
 
 namespace inviwo {
 
@@ -51,75 +51,45 @@ VolumeAtlasCenterPositions::VolumeAtlasCenterPositions()
 }
 
 void VolumeAtlasCenterPositions::process() {
-
-    // Create a map between each index in the volume and all the voxel positions associated to
-    // that index.
-    std::map<int, std::vector<vec3>> regionVoxels;
+    util::JobMetrics metrics(*this);
+    const auto job = metrics.start();
 
     std::shared_ptr<const Volume> indexedVolume = indexedVolume_.getData();
-    auto volumeRAM = indexedVolume->getRepresentation<VolumeRAM>();
-
+    // Read from the sidecar index of the atlas file if present, otherwise computed with per-worker
+    // sums, so memory is proportional to the number of labels rather than the number of voxels
+    const auto precomputed =
+        util::precomputedAtlas(*indexedVolume, util::BlockControl{{}, {}, &metrics});
+    if (!precomputed) return;
+    const auto* statistics = &precomputed->statistics;
+
+    util::PhaseTimer timer(&metrics, util::JobPhase::Publish);
     const mat4 indexToWorld = indexedVolume->getCoordinateTransformer().getIndexToWorldMatrix();
-    size3_t dims = indexedVolume->getDimensions();
-    util::IndexMapper3D indexMapper(dims);
-    // Fill the region-voxel map with voxels
-    volumeRAM->dispatch<void, dispatching::filter::Scalars>(
-        [&regionVoxels, dims, indexToWorld, indexMapper](auto vr) {
-            size_t nVoxels = dims.x * dims.y * dims.z;
-            auto firstVxl = vr->getDataTyped();
-            for (size_t vxlNmbr = 0; vxlNmbr < nVoxels; vxlNmbr++) {
-                int regionIndex = static_cast<int>(*(firstVxl + vxlNmbr));
-                vec3 voxelPos(vec3(indexToWorld * ivec4(indexMapper(vxlNmbr), 1)));
-                regionVoxels[regionIndex].push_back(voxelPos);
-            }
-        });
+    const size3_t dims = indexedVolume->getDimensions();
 
-    // Calculate the mean position for every region
-    std::map<int, vec3> regionMeanPositions;
-    for (auto region : regionVoxels) {
-        vec3 meanPosition(0);
-        for (auto voxelPosition : region.second) {
-            meanPosition += voxelPosition;
-        }
-        regionMeanPositions[region.first] = meanPosition / region.second.size();
-    }
-
-    std::map<int, vec3> regionCenterpoints;
-    std::map<int, size_t> regionVoxelNumber;
-    // For every region mean position, find the position of the voxel that is closest to the
-    // mean. So that the end position is guaranteed to be inside the region.
-    for (auto region : regionVoxels) {
-        vec3 regionMean = regionMeanPositions[region.first];
-        vec3 regionCenterpoint = regionMean;
-        float smallestDistance = std::numeric_limits<float>::max();
-        for (vec3 voxel : region.second) {
-            if (distance(voxel, regionMean) < smallestDistance) {
-                smallestDistance = distance(voxel, regionMean);
-                regionCenterpoint = voxel;
-            }
-        }
-        regionCenterpoints[region.first] = regionCenterpoint;
-        regionVoxelNumber[region.first] = region.second.size();
-    }
+    const auto nVoxels = static_cast<float>(glm::compMul(dims));
 
-    // Create and fill dataframe with calculated region positions
+    // Create and fill dataframe with calculated region positions. The center point is the voxel
+    // closest to the mean position of the region, so that it is guaranteed to be inside the
+    // region.
+    const auto labels = statistics->getLabels();
     std::vector<int> indices;
-    indices.reserve(regionCenterpoints.size());
+    indices.reserve(labels.size());
     std::vector<double> centerX;
     std::vector<double> centerY;
     std::vector<double> centerZ;
-    centerX.reserve(regionCenterpoints.size());
-    centerY.reserve(regionCenterpoints.size());
-    centerZ.reserve(regionCenterpoints.size());
+    centerX.reserve(labels.size());
+    centerY.reserve(labels.size());
+    centerZ.reserve(labels.size());
     std::vector<float> coverage;
-    coverage.reserve(regionCenterpoints.size());
-    for (auto entry : regionCenterpoints) {
-        indices.push_back(entry.first);
-        centerX.push_back(entry.second.x);
-        centerY.push_back(entry.second.y);
-        centerZ.push_back(entry.second.z);
-        coverage.push_back(regionVoxelNumber[entry.first] /
-                           static_cast<float>(dims.x * dims.y * dims.z));
+    coverage.reserve(labels.size());
+    for (auto label : labels) {
+        const auto& region = *statistics->find(label);
+        const vec3 center(indexToWorld * vec4(vec3(region.center), 1.f));
+        indices.push_back(label);
+        centerX.push_back(center.x);
+        centerY.push_back(center.y);
+        centerZ.push_back(center.z);
+        coverage.push_back(static_cast<float>(region.voxels) / nVoxels);
     }
     auto resDataFrame = std::make_shared<DataFrame>();
     resDataFrame->addColumnFromBuffer("Region index", util::makeBuffer<int>(std::move(indices)));
@@ -134,6 +104,8 @@ void VolumeAtlasCenterPositions::process() {
     resDataFrame->updateIndexBuffer();
 
     atlasAggregateInfo_.setData(resDataFrame);
+    timer.stop();
+    metrics.finish();
 }
 
 }  // namespace inviwo
@@ -28,7 +28,10 @@
  *********************************************************************************/
 
 #include <modules/visualneuro/processors/volumeatlasprocessor.h>
+#include <modules/visualneuro/algorithm/volume/atlaslabelstatistics.h>
 #include <modules/opengl/openglutils.h>
+#include <modules/opengl/image/layergl.h>
+#include <modules/opengl/texture/texture2d.h>
 #include <modules/opengl/texture/textureunit.h>
 #include <modules/opengl/texture/textureutils.h>
 
@@ -37,10 +40,13 @@
 #include <inviwo/core/interaction/events/mouseevent.h>
 #include <inviwo/core/interaction/events/touchevent.h>
 
+#include <inviwo/core/datastructures/image/layerramprecision.h>
 #include <inviwo/core/datastructures/volume/volumeram.h>
 #include <inviwo/core/network/networklock.h>
 #include <inviwo/core/util/utilities.h>
 
+#include <utility>
+
 namespace inviwo {
 
 // The Class Identifier has to be globally unique. Use a reverse DNS naming scheme
@@ -70,6 +76,7 @@ VolumeAtlasProcessor::VolumeAtlasProcessor()
     , atlasRegionCenterpoints_("atlasRegionCenterpoints_")
     , brushingAndLinking_{"AtlasBrushingAndLinking"}
     , outport_("outport")
+    , labelColorsOutport_("labelColors")
     , atlasTFOutport_("atlasTF")
     , pickingTFOutport_("pickingTF")
     , indexCol_("indexCol", "Index Col")
@@ -106,6 +113,7 @@ VolumeAtlasProcessor::VolumeAtlasProcessor()
     addPort(brushingAndLinking_);
     brushingAndLinking_.setOptional(true);
     addPort(outport_);
+    addPort(labelColorsOutport_);
     addPort(atlasTFOutport_);
     addPort(pickingTFOutport_);
 
@@ -186,60 +194,116 @@ VolumeAtlasProcessor::VolumeAtlasProcessor()
     });
 }
 
-void VolumeAtlasProcessor::updateTransferFunction() {
-    auto &tf = isotfComposite_.tf_.get();
-    auto atlasVolume = atlasVolume_.getData();
-    auto atlasLabels = atlasLabels_.getData();
+vec4 VolumeAtlasProcessor::getLabelColor(int labelId) const {
+    if (!visualizeAtlas_.get() || labelId <= 0) return vec4(0.f);
 
-    auto setLabelColor = [&](int labelId, vec4 color) {
-        if (labelId <= 0) return;
+    auto c = atlas_->getLabelColor(labelId);
+    if (labelId == hoverAtlasId_) {
+        return c ? glm::mix(c.value(), *hoverColor_, *hoverMix_) : *hoverColor_;
+    }
+    vec3 labelColor(c ? vec3(c.value()) : *selectedColor_);
+    if (brushingAndLinking_.isSelected(labelId)) {
+        return vec4(labelColor, *selectedOpacity_);
+    } else if (*applyNotSelectedForEmptySelection_ ||
+               !brushingAndLinking_.getSelectedIndices().empty()) {
+        return vec4(glm::mix(labelColor, *notSelectedColor_, *notSelectedMix_),
+                    *notSelectedOpacity_);
+    } else {
+        return c ? c.value() : vec4(labelColor, *selectedOpacity_);
+    }
+}
 
-        auto normalizedVal = atlas_->getLabelIdNormalized(labelId);
+void VolumeAtlasProcessor::updateLabelColors(bool allLabels) {
+    if (allLabels) {
+        for (const auto &label : *atlas_) {
+            labelColors_.setColor(label.first, getLabelColor(label.first));
+        }
+    } else if (labelColorsHoverId_ != hoverAtlasId_) {
+        // Only the previously and the currently hovered label change color
+        for (auto labelId : {labelColorsHoverId_, hoverAtlasId_}) {
+            if (atlas_->getLabel(labelId)) {
+                labelColors_.setColor(labelId, getLabelColor(labelId));
+            }
+        }
+    }
+    labelColorsHoverId_ = hoverAtlasId_;
+    uploadLabelColors();
+}
 
-        auto it = std::lower_bound(tf.begin(), tf.end(), normalizedVal);
-        if (it != tf.end()) {
-            it->setColor(color);
+void VolumeAtlasProcessor::uploadLabelColors() {
+    if (!labelColorsLayer_ ||
+        labelColorsLayer_->getDimensions() != labelColors_.getLayerDimensions()) {
+        labelColorsLayer_ = labelColors_.createLayer();
+    } else if (labelColors_.isDirty()) {
+        if (labelColorsLayer_->hasRepresentation<LayerGL>()) {
+            // Upload only the changed texels instead of the whole table
+            auto texture = labelColorsLayer_->getEditableRepresentation<LayerGL>()->getTexture();
+            texture->bind();
+            labelColors_.forEachDirtyRow([](size2_t pos, size_t count, const vec4 *colors) {
+                glTexSubImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(pos.x),
+                                static_cast<GLint>(pos.y), static_cast<GLsizei>(count), 1, GL_RGBA,
+                                GL_FLOAT, colors);
+            });
+            texture->unbind();
+        } else {
+            auto ram = static_cast<LayerRAMPrecision<vec4> *>(
+                labelColorsLayer_->getEditableRepresentation<LayerRAM>());
+            auto data = ram->getDataTyped();
+            const auto width = labelColorsLayer_->getDimensions().x;
+            labelColors_.forEachDirtyRow([&](size2_t pos, size_t count, const vec4 *colors) {
+                std::copy(colors, colors + count, data + pos.y * width + pos.x);
+            });
         }
-    };
+    }
+    labelColors_.clearDirty();
+    labelColorsOutport_.setData(labelColorsLayer_);
+}
+
+void VolumeAtlasProcessor::updateTransferFunction() {
+    auto &tf = isotfComposite_.tf_.get();
     for (auto &p : tf) {
         p.setColor(vec4(0.f));
     }
-    if (visualizeAtlas_.get()) {
-        bool applyNotSelected = *applyNotSelectedForEmptySelection_ ||
-                                !brushingAndLinking_.getSelectedIndices().empty();
-
-        for (auto label : *atlas_) {
-            auto labelId = label.first;
-            auto c = atlas_->getLabelColor(labelId);
-            vec3 labelColor(c ? vec3(c.value()) : *selectedColor_);
-            if (brushingAndLinking_.isSelected(labelId)) {
-                setLabelColor(static_cast<int>(labelId), vec4(labelColor, *selectedOpacity_));
-
-            } else if (applyNotSelected) {
-                setLabelColor(static_cast<int>(labelId),
-                              vec4(glm::mix(labelColor, *notSelectedColor_, *notSelectedMix_),
-                                   *notSelectedOpacity_));
-            } else {
-                setLabelColor(static_cast<int>(labelId),
-                              c ? c.value() : vec4(labelColor, *selectedOpacity_));
-            }
+    // The middle control point of the peak of each label holds its color
+    for (const auto &label : *atlas_) {
+        const auto labelId = label.first;
+        if (labelId <= 0) continue;
+        auto it = std::lower_bound(tf.begin(), tf.end(), atlas_->getLabelIdNormalized(labelId));
+        if (it != tf.end()) {
+            it->setColor(labelColors_.getColor(labelId));
         }
-        auto c = atlas_->getLabelColor(hoverAtlasId_);
-        setLabelColor(hoverAtlasId_,
-                      c ? glm::mix(c.value(), *hoverColor_, *hoverMix_) : *hoverColor_);
     }
-
-}  // namespace inviwo
+}
 
 void VolumeAtlasProcessor::process() {
     auto atlasVolume = atlasVolume_.getData();
     auto atlasLabels = atlasLabels_.getData();
+    bool allLabels = brushingAndLinking_.isChanged();
     if (atlasVolume_.isChanged() || atlasLabels_.isChanged()) {
         atlas_ = std::make_unique<VolumeAtlas>(atlasVolume, atlasLabels);
         selectedColor_.setVisible(!atlas_->hasColors());
         updateSelectableRegionProperties();
+
+        int maxLabel = atlas_->begin() == atlas_->end() ? 0 : std::prev(atlas_->end())->first;
+        const auto maxTableLabel = static_cast<int>(stats::maxDenseLabelRange) - 1;
+        if (maxLabel > maxTableLabel) {
+            LogWarn("Labels above " << maxTableLabel << " are not colored");
+            maxLabel = maxTableLabel;
+        }
+        labelColors_ = LabelColorLUT(std::max(maxLabel, 0));
+        labelColorsHoverId_ = -1;
+        allLabels = true;
+    }
+    if (brushingDirty_) {
+        updateBrushing();
+        allLabels = true;
+    }
+    for (const Property *p : std::initializer_list<const Property *>{
+             &visualizeAtlas_, &hoverColor_, &hoverMix_, &selectedColor_, &selectedOpacity_,
+             &applyNotSelectedForEmptySelection_, &notSelectedColor_, &notSelectedMix_,
+             &notSelectedOpacity_}) {
+        allLabels |= p->isModified();
     }
-    if (brushingDirty_) updateBrushing();
 
     // use nearest neighbour interpolation for the volume 3D texture
     TextureUnit unit;
@@ -248,11 +312,18 @@ void VolumeAtlasProcessor::process() {
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-    updateTransferFunction();
+    updateLabelColors(allLabels);
 
     outport_.setData(atlasVolume);
-    atlasTFOutport_.setData(std::make_shared<TransferFunction>(isotfComposite_.tf_.get()));
-    if (enablePicking_.get()) {
+    // Building and moving the control points of a large transfer function is costly, the label
+    // color table replaces them unless the transfer function outports are used
+    if (atlasTFOutport_.isConnected()) {
+        if (std::exchange(labelControlPointsDirty_, false)) updateLabelControlPoints();
+        updateTransferFunction();
+        atlasTFOutport_.setData(std::make_shared<TransferFunction>(isotfComposite_.tf_.get()));
+    }
+    if (enablePicking_.get() && pickingTFOutport_.isConnected()) {
+        if (std::exchange(pickingTFDirty_, false)) updatePickingTransferFunction();
         pickingTFOutport_.setData(pickingTF_);
     } else {
         pickingTFOutport_.setData(std::make_shared<TransferFunction>());
@@ -319,76 +390,79 @@ void VolumeAtlasProcessor::updateSelectableRegionProperties() {
     removeProperties(propertiesToRemove);
 
     atlasPicking_.resize(regionIndices->getSize() + 1);
-    auto atlasVolume = atlasVolume_.getData();
-
-    auto resizeLabelControlPoints = [&](TransferFunction &tf, size_t nSegments) {
-        while (tf.size() > 3 * (nSegments + 1)) {
-            tf.remove(tf.back());
-        }
-        while (tf.size() < 3 * (nSegments + 1)) {
-            tf.add(1.0, vec4{0.0});
-        }
-        std::vector<TFPrimitive *> primitives;
-        for (auto &p : tf) {
-            primitives.push_back(&p);
-        }
-        vec2 dataRange = atlasVolume->dataMap.dataRange;
-        auto delta_ = 1.0 / (dataRange.y - dataRange.x);
-        for (size_t i = 0; i < regionIndices->getSize(); i++) {
-            auto labelId = static_cast<int>(regionIndices->getAsDouble(i));
-            auto normalizedVal = atlas_->getLabelIdNormalized(labelId);
-            double pos1(normalizedVal - delta_ / 2.0);
-            double pos2(normalizedVal);
-            double pos3(normalizedVal + delta_ / 2.0);
-
-            // clamp the transfer function between 0 and 1
-            pos1 = std::clamp(pos1, 0.0, 1.0);
-            pos2 = std::clamp(pos2, std::numeric_limits<double>::epsilon(),
-                              1.f - std::numeric_limits<double>::epsilon());
-            pos3 = std::clamp(pos3, 0.0, 1.0);
-
-            primitives[i * 3]->setPosition(pos1);
-            primitives[i * 3 + 1]->setPosition(pos2);
-            primitives[i * 3 + 2]->setPosition(pos3);
-        }
-    };
+    pickingToLabelId_.clear();
+    for (size_t i = 0; i < regionIndices->getSize(); i++) {
+        pickingToLabelId_.push_back(static_cast<int>(regionIndices->getAsDouble(i)));
+    }
+    // The control points are laid out for the new labels when the transfer functions are used
+    labelControlPointsDirty_ = true;
+    pickingTFDirty_ = true;
+}
 
+void VolumeAtlasProcessor::updateLabelControlPoints() {
+    auto &tf = isotfComposite_.tf_.get();
     Property::OnChangeBlocker tfblock(isotfComposite_.tf_);
-    resizeLabelControlPoints(isotfComposite_.tf_.get(), regionIndices->getSize());
+    const auto nSegments = pickingToLabelId_.size();
+    while (tf.size() > 3 * (nSegments + 1)) {
+        tf.remove(tf.back());
+    }
+    while (tf.size() < 3 * (nSegments + 1)) {
+        tf.add(1.0, vec4{0.0});
+    }
+    std::vector<TFPrimitive *> primitives;
+    for (auto &p : tf) {
+        primitives.push_back(&p);
+    }
+    vec2 dataRange = atlasVolume_.getData()->dataMap.dataRange;
+    auto delta_ = 1.0 / (dataRange.y - dataRange.x);
+    for (size_t i = 0; i < nSegments; i++) {
+        auto normalizedVal = atlas_->getLabelIdNormalized(pickingToLabelId_[i]);
+        double pos1(normalizedVal - delta_ / 2.0);
+        double pos2(normalizedVal);
+        double pos3(normalizedVal + delta_ / 2.0);
+
+        // clamp the transfer function between 0 and 1
+        pos1 = std::clamp(pos1, 0.0, 1.0);
+        pos2 = std::clamp(pos2, std::numeric_limits<double>::epsilon(),
+                          1.f - std::numeric_limits<double>::epsilon());
+        pos3 = std::clamp(pos3, 0.0, 1.0);
+
+        primitives[i * 3]->setPosition(pos1);
+        primitives[i * 3 + 1]->setPosition(pos2);
+        primitives[i * 3 + 2]->setPosition(pos3);
+    }
+}
 
-    auto resizeLabelPickingControlPoints = [&](TransferFunction &tf, size_t nSegments) {
-        while (tf.size() > 2 * (nSegments + 1)) {
-            tf.remove(tf.back());
-        }
-        while (tf.size() < 2 * (nSegments + 1)) {
-            tf.add(1.0, vec4{1.0});
-        }
-        pickingToLabelId_.clear();
-        std::vector<TFPrimitive *> primitives;
-        for (auto &p : tf) {
-            primitives.push_back(&p);
-        }
-        vec2 dataRange = atlasVolume->dataMap.dataRange;
-        auto delta_ = 1.0 / (dataRange.y - dataRange.x);
-        for (size_t i = 0; i < regionIndices->getSize(); i++) {
-            auto labelId = static_cast<int>(regionIndices->getAsDouble(i));
-            auto normalizedVal = atlas_->getLabelIdNormalized(labelId);
-            pickingToLabelId_.push_back(labelId);
-            auto color = atlasPicking_.getColor(i);
-
-            double pos1(normalizedVal - delta_ / 2.0);
-            // Ensure no overlap with next point
-            double pos2(normalizedVal + delta_ / 2.0 - std::numeric_limits<double>::epsilon());
-
-            // clamp the transfer function between 0 and 1
-            pos1 = std::clamp(pos1, 0.0, 1.f - std::numeric_limits<double>::epsilon());
-            pos2 = std::clamp(pos2, 0.0 + 2.0 * std::numeric_limits<double>::epsilon(), 1.0);
-
-            primitives[i * 2 + 0]->setData({pos1, vec4(color, 1.f)});
-            primitives[i * 2 + 1]->setData({pos2, vec4(color, 1.f)});
-        }
-    };
-    resizeLabelPickingControlPoints(*pickingTF_, regionIndices->getSize());
+void VolumeAtlasProcessor::updatePickingTransferFunction() {
+    auto &tf = *pickingTF_;
+    const auto nSegments = pickingToLabelId_.size();
+    while (tf.size() > 2 * (nSegments + 1)) {
+        tf.remove(tf.back());
+    }
+    while (tf.size() < 2 * (nSegments + 1)) {
+        tf.add(1.0, vec4{1.0});
+    }
+    std::vector<TFPrimitive *> primitives;
+    for (auto &p : tf) {
+        primitives.push_back(&p);
+    }
+    vec2 dataRange = atlasVolume_.getData()->dataMap.dataRange;
+    auto delta_ = 1.0 / (dataRange.y - dataRange.x);
+    for (size_t i = 0; i < nSegments; i++) {
+        auto normalizedVal = atlas_->getLabelIdNormalized(pickingToLabelId_[i]);
+        auto color = atlasPicking_.getColor(i);
+
+        double pos1(normalizedVal - delta_ / 2.0);
+        // Ensure no overlap with next point
+        double pos2(normalizedVal + delta_ / 2.0 - std::numeric_limits<double>::epsilon());
+
+        // clamp the transfer function between 0 and 1
+        pos1 = std::clamp(pos1, 0.0, 1.f - std::numeric_limits<double>::epsilon());
+        pos2 = std::clamp(pos2, 0.0 + 2.0 * std::numeric_limits<double>::epsilon(), 1.0);
+
+        primitives[i * 2 + 0]->setData({pos1, vec4(color, 1.f)});
+        primitives[i * 2 + 1]->setData({pos2, vec4(color, 1.f)});
+    }
 }
 
 void VolumeAtlasProcessor::handlePicking(PickingEvent *e) {
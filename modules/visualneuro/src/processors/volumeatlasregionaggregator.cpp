@@ -0,0 +1,192 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/processors/volumeatlasregionaggregator.h>
+#include <modules/visualneuro/datastructures/volumeatlas.h>
+#include <modules/visualneuro/util/jobmetrics.h>
+#include <inviwo/core/util/zip.h>
+
+#include <numeric>
+#include <unordered_map>
+
+namespace inviwo {
+
+namespace {
+
+std::string regionName(const VolumeAtlas* names, int label) {
+    auto name = names ? names->getLabelName(label) : std::string{};
+    return name.empty() ? fmt::format("Region {}", label) : name;
+}
+
+// Region names made unique to be used as column headers next to the Subject column
+std::vector<std::string> regionHeaders(const std::vector<int>& labels, const VolumeAtlas* names) {
+    std::vector<std::string> headers;
+    std::unordered_map<std::string, size_t> counts{{"Subject", 1}};
+    for (auto label : labels) {
+        ++counts[headers.emplace_back(regionName(names, label))];
+    }
+    for (auto&& [label, header] : util::zip(labels, headers)) {
+        if (counts[header] > 1) header = fmt::format("{} ({})", header, label);
+    }
+    return headers;
+}
+
+std::shared_ptr<DataFrame> subjectsByRegions(const stats::RegionAggregates& aggregates,
+                                             const std::vector<double>& values,
+                                             const VolumeAtlas* names) {
+    const auto nRegions = aggregates.labels.size();
+    std::vector<int> subjects(aggregates.subjects);
+    std::iota(subjects.begin(), subjects.end(), 0);
+
+    const auto headers = regionHeaders(aggregates.labels, names);
+    auto dataFrame = std::make_shared<DataFrame>();
+    dataFrame->addColumn<int>("Subject", subjects);
+    for (size_t r = 0; r < nRegions; ++r) {
+        std::vector<float> column(aggregates.subjects);
+        for (size_t s = 0; s < aggregates.subjects; ++s) {
+            column[s] = static_cast<float>(values[s * nRegions + r]);
+        }
+        dataFrame->addColumn<float>(headers[r], column);
+    }
+    dataFrame->updateIndexBuffer();
+    return dataFrame;
+}
+
+}  // namespace
+
+// The Class Identifier has to be globally unique. Use a reverse DNS naming scheme
+const ProcessorInfo VolumeAtlasRegionAggregator::processorInfo_{
+    "org.inviwo.VolumeAtlasRegionAggregator",  // Class identifier
+    "Volume Atlas Region Aggregator",          // Display name
+    "Statistics",                              // Category
+    CodeState::Experimental,                   // Code state
+    Tags::CPU,                                 // Tags
+};
+const ProcessorInfo VolumeAtlasRegionAggregator::getProcessorInfo() const {
+    return processorInfo_;
+}
+
+VolumeAtlasRegionAggregator::VolumeAtlasRegionAggregator()
+    : PoolProcessor()
+    , volumes_("volumes")
+    , atlas_("atlas")
+    , labels_("labels")
+    , means_("means")
+    , medians_("medians")
+    , regions_("regions")
+    , computeMedians_("computeMedians", "Compute Medians", false) {
+
+    labels_.setOptional(true);
+    addPort(volumes_);
+    addPort(atlas_);
+    addPort(labels_);
+    addPort(means_);
+    addPort(medians_);
+    addPort(regions_);
+
+    addProperty(computeMedians_);
+}
+
+void VolumeAtlasRegionAggregator::process() {
+    const auto volumes = volumes_.getData();
+    const auto atlas = atlas_.getData();
+    const bool medians = computeMedians_.get();
+    // Only the label names are used, no need for the label statistics of an atlas volume
+    std::shared_ptr<const VolumeAtlas> names;
+    if (labels_.hasData()) names = std::make_shared<VolumeAtlas>(nullptr, labels_.getData());
+
+    if (volumes->empty()) {
+        means_.clear();
+        medians_.clear();
+        regions_.clear();
+        return;
+    }
+    if (cache_.aggregates && cache_.volumes.lock() == volumes && cache_.atlas.lock() == atlas &&
+        (cache_.medians || !medians)) {
+        publish(*cache_.aggregates, names.get());
+        return;
+    }
+
+    auto metrics = std::make_shared<util::JobMetrics>(*this);
+    using Result = std::shared_ptr<const stats::RegionAggregates>;
+    const auto calc = [metrics, volumes, atlas, medians](pool::Stop stop,
+                                                         pool::Progress progress) -> Result {
+        const auto job = metrics->start();
+        progress(0.f);
+
+        util::PhaseTimer resample(metrics.get(), util::JobPhase::Gather);
+        const auto lookup = stats::atlasRegionLookup(*atlas, *volumes->front());
+        resample.stop();
+
+        const stats::VolumeSequenceVoxelSource source(*volumes);
+        auto aggregates = stats::aggregateRegions(
+            source, lookup, medians, util::makeBlockControl(stop, progress, metrics.get()));
+        // Exit function if this is not the latest job
+        if (!aggregates) return nullptr;
+        progress(1.f);
+        return std::make_shared<const stats::RegionAggregates>(std::move(*aggregates));
+    };
+
+    dispatchOne(calc, [this, metrics, volumes, atlas, medians,
+                       names](Result result) {
+        util::PhaseTimer timer(metrics.get(), util::JobPhase::Publish);
+        if (result) {
+            cache_ = Cache{volumes, atlas, medians, result};
+            publish(*result, names.get());
+        }
+        newResults();
+        timer.stop();
+        metrics->finish();
+    });
+}
+
+void VolumeAtlasRegionAggregator::publish(const stats::RegionAggregates& aggregates,
+                                          const VolumeAtlas* names) {
+    means_.setData(subjectsByRegions(aggregates, aggregates.means, names));
+    if (computeMedians_ && !aggregates.medians.empty()) {
+        medians_.setData(subjectsByRegions(aggregates, aggregates.medians, names));
+    } else {
+        medians_.clear();
+    }
+
+    std::vector<std::string> regionNames;
+    std::vector<int> voxels;
+    for (auto&& [label, count] : util::zip(aggregates.labels, aggregates.voxels)) {
+        regionNames.push_back(regionName(names, label));
+        voxels.push_back(static_cast<int>(count));
+    }
+    auto regions = std::make_shared<DataFrame>();
+    regions->addColumn<int>("Region index", aggregates.labels);
+    regions->addCategoricalColumn("Region", regionNames);
+    regions->addColumn<int>("Voxels", voxels);
+    regions->updateIndexBuffer();
+    regions_.setData(regions);
+}
+
+}  // namespace inviwo
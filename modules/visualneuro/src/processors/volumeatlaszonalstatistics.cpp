@@ -0,0 +1,149 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/processors/volumeatlaszonalstatistics.h>
+#include <modules/visualneuro/datastructures/volumeatlas.h>
+#include <modules/visualneuro/util/jobmetrics.h>
+
+namespace inviwo {
+
+// The Class Identifier has to be globally unique. Use a reverse DNS naming scheme
+const ProcessorInfo VolumeAtlasZonalStatistics::processorInfo_{
+    "org.inviwo.VolumeAtlasZonalStatistics",  // Class identifier
+    "Volume Atlas Zonal Statistics",          // Display name
+    "Statistics",                             // Category
+    CodeState::Experimental,                  // Code state
+    Tags::CPU,                                // Tags
+};
+const ProcessorInfo VolumeAtlasZonalStatistics::getProcessorInfo() const {
+    return processorInfo_;
+}
+
+VolumeAtlasZonalStatistics::VolumeAtlasZonalStatistics()
+    : PoolProcessor()
+    , map_("map")
+    , atlas_("atlas")
+    , labels_("labels")
+    , statistics_("statistics")
+    , significanceThreshold_("significanceThreshold", "Significance Threshold", 0.0, 0.0, 10.0,
+                             0.01)
+    , lookup_{std::make_shared<LookupCache>()} {
+
+    labels_.setOptional(true);
+    addPort(map_);
+    addPort(atlas_);
+    addPort(labels_);
+    addPort(statistics_);
+
+    addProperty(significanceThreshold_);
+}
+
+std::shared_ptr<const stats::RegionLookup> VolumeAtlasZonalStatistics::LookupCache::get(
+    const std::shared_ptr<const Volume>& newAtlas, const Volume& reference) {
+    std::scoped_lock lock{mutex};
+    const auto newIndexToWorld = reference.getCoordinateTransformer().getIndexToWorldMatrix();
+    if (!lookup || atlas.lock() != newAtlas || lookup->dims != reference.getDimensions() ||
+        indexToWorld != newIndexToWorld) {
+        lookup = std::make_shared<const stats::RegionLookup>(
+            stats::atlasRegionLookup(*newAtlas, reference));
+        atlas = newAtlas;
+        indexToWorld = newIndexToWorld;
+    }
+    return lookup;
+}
+
+void VolumeAtlasZonalStatistics::process() {
+    // Only the label names are used, no need for the label statistics of an atlas volume
+    std::shared_ptr<const VolumeAtlas> names;
+    if (labels_.hasData()) names = std::make_shared<VolumeAtlas>(nullptr, labels_.getData());
+
+    auto metrics = std::make_shared<util::JobMetrics>(*this);
+    const auto calc = [metrics, lookupCache = lookup_, map = map_.getData(),
+                       atlas = atlas_.getData(), names,
+                       threshold = significanceThreshold_.get()](
+                          pool::Stop stop,
+                          pool::Progress progress) -> std::shared_ptr<DataFrame> {
+        const auto job = metrics->start();
+        progress(0.f);
+
+        util::PhaseTimer resample(metrics.get(), util::JobPhase::Gather);
+        const auto lookup = lookupCache->get(atlas, *map);
+        resample.stop();
+
+        const auto zonal = stats::zonalStatistics(
+            *map, *lookup, threshold, util::makeBlockControl(stop, progress, metrics.get()));
+        // Exit function if this is not the latest job
+        if (!zonal) return nullptr;
+
+        const util::PhaseTimer timer(metrics.get(), util::JobPhase::Threshold);
+        const auto indexToWorld = map->getCoordinateTransformer().getIndexToWorldMatrix();
+        std::vector<std::string> regionNames;
+        std::vector<int> voxels;
+        std::vector<float> means, maxima, fractions, peakValues, peakX, peakY, peakZ;
+        for (size_t r = 0; r < zonal->labels.size(); ++r) {
+            const auto label = zonal->labels[r];
+            auto name = names ? names->getLabelName(label) : std::string{};
+            regionNames.push_back(name.empty() ? fmt::format("Region {}", label) : name);
+            voxels.push_back(static_cast<int>(zonal->voxels[r]));
+            means.push_back(static_cast<float>(zonal->means[r]));
+            maxima.push_back(static_cast<float>(zonal->maxima[r]));
+            fractions.push_back(static_cast<float>(zonal->significantFractions[r]));
+            peakValues.push_back(static_cast<float>(zonal->peakValues[r]));
+            const auto peak = vec3(indexToWorld * vec4(vec3(zonal->peaks[r]), 1.0f));
+            peakX.push_back(peak.x);
+            peakY.push_back(peak.y);
+            peakZ.push_back(peak.z);
+        }
+        auto dataFrame = std::make_shared<DataFrame>();
+        dataFrame->addColumn<int>("Region index", zonal->labels);
+        dataFrame->addCategoricalColumn("Region", regionNames);
+        dataFrame->addColumn<int>("Voxels", voxels);
+        dataFrame->addColumn<float>("Mean", means);
+        dataFrame->addColumn<float>("Max", maxima);
+        dataFrame->addColumn<float>("Significant fraction", fractions);
+        dataFrame->addColumn<float>("Peak value", peakValues);
+        dataFrame->addColumn<float>("Peak x", peakX);
+        dataFrame->addColumn<float>("Peak y", peakY);
+        dataFrame->addColumn<float>("Peak z", peakZ);
+        dataFrame->updateIndexBuffer();
+
+        progress(1.f);
+        return dataFrame;
+    };
+
+    dispatchOne(calc, [this, metrics](std::shared_ptr<DataFrame> result) {
+        util::PhaseTimer timer(metrics.get(), util::JobPhase::Publish);
+        if (result) statistics_.setData(result);
+        newResults();
+        timer.stop();
+        metrics->finish();
+    });
+}
+
+}  // namespace inviwo
@@ -28,9 +28,10 @@
  *********************************************************************************/
 
 #include <modules/visualneuro/processors/volumeregionparametercorrelation.h>
-#include <modules/visualneuro/statistics/pearsoncorrelation.h>
-#include <modules/visualneuro/statistics/spearmancorrelation.h>
-#include <inviwo/core/datastructures/volume/volumeramprecision.h>
+#include <modules/visualneuro/algorithm/volume/regioncorrelation.h>
+#include <modules/visualneuro/datastructures/atlasindexfile.h>
+#include <modules/visualneuro/datastructures/atlasvoxelindex.h>
+#include <modules/visualneuro/util/jobmetrics.h>
 #include <inviwo/core/util/exception.h>
 #include <inviwo/core/network/networklock.h>
 #include <inviwo/core/properties/boolproperty.h>
@@ -72,7 +73,10 @@ VolumeRegionParameterCorrelation::VolumeRegionParameterCorrelation()
                 {{"twoTailedTest", "Two-tailed test", stats::TailTest::Both},
                  {"rightOneTailedTest", "Right one-tailed test", stats::TailTest::Greater},
                  {"leftOneTailedTest", "Left one-tailed test", stats::TailTest::Less}},
-                0) {
+                0)
+    , voxelIndex_{std::make_shared<VoxelIndexCache>()}
+    , regionCorrelations_{std::make_shared<RegionCorrelationCache>()}
+    , parameters_{std::make_shared<dataframe::ParameterMatrixCache>()} {
 
     addPort(volumes_);
     addPort(dataFrame_);
@@ -86,176 +90,153 @@ VolumeRegionParameterCorrelation::VolumeRegionParameterCorrelation()
     addProperty(tailTest_);
 }
 
-void VolumeRegionParameterCorrelation::process() {
-
-    const auto calc = [volumes = volumes_.getData(), brushing = brushing_.getManager(),
-                       dataFrame = dataFrame_.getData(), atlas = atlas_.getData(),
-                       atlasBrushing = atlasBrushing_.getManager(), tailTest = *tailTest_,
-                       correlationMethod = *correlationMethod_, pVal = *pVal_](
-                          pool::Stop stop, pool::Progress progress) -> std::shared_ptr<DataFrame> {
-        progress(0.f);
-        auto getFormattedData = [brushing = brushing, dataFrame = dataFrame](
-                                    std::vector<std::vector<double>>& parameterValues,
-                                    std::vector<std::string>& parameterNames) {
-            auto brushedIndices = brushing.getFilteredIndices();
-
-            auto dfSize = dataFrame->getNumberOfRows();
-            auto nParameters = dataFrame->getNumberOfColumns();
-            parameterValues.resize(nParameters);
-
-            for (auto i = 0u; i < dfSize; i++) {
-                if (brushing.isFiltered(i)) continue;
-
-                for (auto j = 0u; j < nParameters; j++) {
-                    double value = dataFrame->getColumn(j)->getAsDouble(i);
-                    parameterValues[j].push_back(value);
-                }
-            }
-
-            for (const auto& col : *dataFrame) parameterNames.push_back(col->getHeader());
-        };
-
-        auto getVoxelValues = [](const std::vector<const VolumeRAM*>& volumeRAMs,
-                                 std::shared_ptr<const VolumeSequence> volumeSequence,
-                                 size_t vxlNmbr) {
-            std::vector<double> values;
-            values.reserve(volumeRAMs.size());
-
-            for (size_t index = 0; index < volumeRAMs.size(); index++) {
-                auto dataMap = (*volumeSequence)[index]->dataMap;
-                volumeRAMs[index]->dispatch<void, dispatching::filter::Scalars>(
-                    [&values, vxlNmbr, &dataMap](auto vr) {
-                        auto ptr_first_vxl = vr->getDataTyped();
-                        values.emplace_back(dataMap.mapFromDataToValue(
-                            static_cast<double>(*(ptr_first_vxl + vxlNmbr))));
-                    });
-            }
-            return values;
-        };
-
-        std::vector<std::vector<double>> parameterCorrelations;
-        parameterCorrelations.resize(dataFrame->getNumberOfColumns());
-        if (atlasBrushing.getNumberOfSelected() == 0) {
-            for (auto i = 0u; i < parameterCorrelations.size(); i++) {
-                // Save correlation between parameter i and current voxel
-                std::transform(std::begin(parameterCorrelations[i]),
-                               std::end(parameterCorrelations[i]),
-                               std::begin(parameterCorrelations[i]), [](auto&) { return 0; });
-            }
+std::shared_ptr<const AtlasVoxelIndex> VolumeRegionParameterCorrelation::VoxelIndexCache::get(
+    const std::shared_ptr<const Volume>& newAtlas, const Volume& reference) {
+    std::scoped_lock lock{mutex};
+    const auto newIndexToWorld = reference.getCoordinateTransformer().getIndexToWorldMatrix();
+    if (!index || atlas.lock() != newAtlas || dims != reference.getDimensions() ||
+        indexToWorld != newIndexToWorld) {
+        const auto sameGrid =
+            newAtlas->getDimensions() == reference.getDimensions() &&
+            newAtlas->getCoordinateTransformer().getIndexToWorldMatrix() == newIndexToWorld;
+        // An index in the atlas grid is shared with the precomputed atlas structures, which are
+        // read from the sidecar index of the atlas file if present
+        std::shared_ptr<const PrecomputedAtlas> precomputed;
+        if (sameGrid) precomputed = util::precomputedAtlas(*newAtlas);
+        if (precomputed) {
+            index = std::shared_ptr<const AtlasVoxelIndex>(precomputed, &precomputed->voxelIndex);
         } else {
-            std::vector<std::vector<double>> parameterValues;
-            std::vector<std::string> parameterNames;
-
-            getFormattedData(parameterValues, parameterNames);
-            std::vector<double> parameterMeans;
-            for (auto parameter : parameterValues)
-                parameterMeans.push_back(calculateMeanIgnoreNaNs(parameter));
+            index = std::make_shared<const AtlasVoxelIndex>(
+                AtlasVoxelIndex::resampled(*newAtlas, reference));
+        }
+        atlas = newAtlas;
+        dims = reference.getDimensions();
+        indexToWorld = newIndexToWorld;
+    }
+    return index;
+}
 
-            // Deal with NaN by removing the corresponding subjects
-            std::vector<std::vector<bool>> ignoreSubjects(dataFrame->getNumberOfColumns());
-            for (auto&& [paramValues, ignoreSubject] : util::zip(parameterValues, ignoreSubjects)) {
-                std::transform(paramValues.begin(), paramValues.end(),
-                               std::back_inserter(ignoreSubject),
-                               [](const auto& v) -> bool { return std::isnan(v); });
-                util::erase_remove_if(paramValues, [](const auto& v) { return std::isnan(v); });
-            }
+auto VolumeRegionParameterCorrelation::RegionCorrelationCache::get(int label)
+    -> std::shared_ptr<const Correlations> {
+    std::scoped_lock lock{mutex};
+    auto it = regions.find(label);
+    if (it == regions.end()) return nullptr;
+    entries.splice(entries.begin(), entries, it->second);
+    return it->second->correlations;
+}
 
-            // Calculate total number of voxels in one volume
-            auto dims = volumes->front()->getDimensions();
-            auto nVoxels = dims[0] * dims[1] * dims[2];
-            // Create RAM represenation to be able to read voxels
-            std::vector<const VolumeRAM*> volRam;
-            std::transform(volumes->begin(), volumes->end(), std::back_inserter(volRam),
-                           [](auto vol) { return vol->template getRepresentation<VolumeRAM>(); });
-            // Create matrices for conversion from voxelNmbr -> vec3 index (correlation volume) ->
-            // worldPos -> vec3 index (indexed volume)
-            mat4 indexToWorld =
-                (*volumes->begin())->getCoordinateTransformer().getIndexToWorldMatrix();
-            mat4 worldToIndex = atlas->getCoordinateTransformer().getWorldToIndexMatrix();
-            // Create matrices and RAM representation of index volume only if that inport is
-            // connected
+void VolumeRegionParameterCorrelation::RegionCorrelationCache::set(
+    int label, std::shared_ptr<const Correlations> correlations) {
+    size_t size = sizeof(Correlations);
+    for (const auto& parameter : *correlations) {
+        size += sizeof(parameter) + parameter.capacity() * sizeof(double);
+    }
 
-            auto atlasRam = atlas->getRepresentation<VolumeRAM>();
+    std::scoped_lock lock{mutex};
+    if (auto it = regions.find(label); it != regions.end()) {
+        bytes -= it->second->bytes;
+        entries.erase(it->second);
+    }
+    entries.push_front({label, std::move(correlations), size});
+    regions[label] = entries.begin();
+    bytes += size;
 
-            auto startTime = std::chrono::high_resolution_clock::now();
-            for (size_t vxlNmbr = 0; vxlNmbr < nVoxels; vxlNmbr++) {
-                // Exit function if this is not the latest job
-                if (stop) return std::make_shared<DataFrame>();
+    // Jobs still hold the correlations of the evicted regions they use
+    while (bytes > budget && entries.size() > 1) {
+        bytes -= entries.back().bytes;
+        regions.erase(entries.back().label);
+        entries.pop_back();
+    }
+}
 
-                bool showVoxel = true;
-                // Convert voxelNmbr to ivec3
-                size_t x = vxlNmbr % dims.x;
-                size_t z = vxlNmbr / (dims.x * dims.y);
-                size_t y = (vxlNmbr / dims.x) - (z * dims.y);
-                const ivec3 index(x, y, z);
+void VolumeRegionParameterCorrelation::process() {
+    // Region selections alone reuse the cached correlations
+    if (volumes_.isChanged() || dataFrame_.isChanged() || atlas_.isChanged() ||
+        correlationMethod_.isModified() || pVal_.isModified() || tailTest_.isModified() ||
+        !(filteredRows_ == brushing_.getFilteredIndices())) {
+        regionCorrelations_ = std::make_shared<RegionCorrelationCache>();
+        filteredRows_ = brushing_.getFilteredIndices();
+    }
 
-                // Convert position in correlation volume to position in indexed volume
-                vec3 worldCoordinates(vec3(indexToWorld * ivec4(index, 1)));
-                ivec3 indexCoordinates(ivec3(worldToIndex * vec4(worldCoordinates, 1.0f)));
+    auto metrics = std::make_shared<util::JobMetrics>(*this);
+    const auto calc = [metrics, voxelIndex = voxelIndex_, cache = regionCorrelations_,
+                       parameterCache = parameters_, volumes = volumes_.getData(),
+                       brushing = brushing_.getManager(),
+                       dataFrame = dataFrame_.getData(), atlas = atlas_.getData(),
+                       atlasBrushing = atlasBrushing_.getManager(),
+                       settings = stats::CorrelationSettings{*correlationMethod_, *tailTest_,
+                                                             static_cast<double>(*pVal_)}](
+                          pool::Stop stop, pool::Progress progress) -> std::shared_ptr<DataFrame> {
+        const auto job = metrics->start();
+        progress(0.f);
 
-                // Calculate a value for the voxel only if it's part of a selected region
-                double voxelValue = atlasRam->getAsDouble(indexCoordinates);
-                if (!atlasBrushing.isSelected(static_cast<int>(voxelValue)))
-                    showVoxel = false;
-                if (showVoxel) {
-                    // Create a vector with all values for current voxel
-                    std::vector<double> voxelValues = getVoxelValues(volRam, volumes, vxlNmbr);
+        // Sorted correlations of each selected region, one run per region and parameter
+        std::vector<std::shared_ptr<const RegionCorrelationCache::Correlations>> regions;
+        if (atlasBrushing.getNumberOfSelected() > 0) {
+            util::PhaseTimer resample(metrics.get(), util::JobPhase::Gather);
+            const auto index = voxelIndex->get(atlas, *volumes->front());
+            std::vector<int> missing;
+            size_t missingVoxels = 0;
+            for (auto label : index->getLabels()) {
+                if (!atlasBrushing.isSelected(label)) continue;
+                if (auto correlations = cache->get(label)) {
+                    regions.push_back(std::move(correlations));
+                } else if (!index->getVoxels(label).empty()) {
+                    missing.push_back(label);
+                    missingVoxels += index->getVoxels(label).size();
+                }
+            }
+            resample.stop();
 
-                    // Calculate the correlation between the voxel and all parameters
-                    for (auto i = 0u; i < parameterValues.size(); i++) {
-                        std::vector<double> voxelValuesNoNaN;
-                        voxelValuesNoNaN.reserve(voxelValues.size());
-                        for (auto&& [filter, val] : util::zip(ignoreSubjects[i], voxelValues)) {
-                            if (!filter) {
-                                voxelValuesNoNaN.push_back(val);
-                            }
-                        }
-                        auto [corr, p] = stats::corrTest(parameterValues[i], voxelValuesNoNaN,
-                                                         correlationMethod, tailTest);
-                        if (p < pVal) {
-                            parameterCorrelations[i].push_back(corr);
-                        }
-                    }
+            if (!missing.empty()) {
+                // One subject per row that is not filtered
+                util::PhaseTimer extract(metrics.get(), util::JobPhase::Gather);
+                std::vector<std::uint32_t> rows;
+                for (std::uint32_t row = 0; row < dataFrame->getNumberOfRows(); ++row) {
+                    if (!brushing.isFiltered(row)) rows.push_back(row);
                 }
-                // Update the progress
-                if (std::chrono::high_resolution_clock::now() - startTime >
-                    std::chrono::milliseconds(200)) {
-                    progress(vxlNmbr, nVoxels);
-                    startTime = std::chrono::high_resolution_clock::now();
+                const auto parameters = parameterCache->get(dataFrame, rows);
+                extract.stop();
+
+                const stats::VolumeSequenceVoxelSource source(*volumes);
+                size_t doneVoxels = 0;
+                for (auto label : missing) {
+                    const auto voxels = index->getVoxels(label);
+                    const std::vector<std::uint32_t> regionVoxels(voxels.begin(), voxels.end());
+                    // Report the progress of all missing regions, weighted by their size
+                    auto control = util::makeBlockControl(stop, progress, metrics.get());
+                    control.progress = [&](size_t i, size_t n) {
+                        progress(doneVoxels + i * regionVoxels.size() / std::max(n, size_t{1}),
+                                 missingVoxels);
+                    };
+                    auto correlations = stats::regionParameterCorrelations(
+                        source, *parameters, regionVoxels, settings, control);
+                    // Exit function if this is not the latest job
+                    if (!correlations) return std::make_shared<DataFrame>();
+                    auto summary = std::make_shared<const RegionCorrelationCache::Correlations>(
+                        std::move(*correlations));
+                    cache->set(label, summary);
+                    regions.push_back(std::move(summary));
+                    doneVoxels += regionVoxels.size();
                 }
             }
         }
+
         // Create dataframe from correlations
+        const util::PhaseTimer timer(metrics.get(), util::JobPhase::Threshold);
         auto resDataFrame = std::make_shared<DataFrame>();
-        std::vector<std::string> parameters; 
+        std::vector<std::string> parameters;
         std::vector<float> medians, maxCorrs, minCorrs, firstQuartiles, thirdQuartiles;
-        for (auto&& [i, parameter] : util::enumerate(parameterCorrelations)) {
+        for (size_t i = 0; i < dataFrame->getNumberOfColumns(); ++i) {
             parameters.push_back(dataFrame->getColumn(i)->getHeader());
-            if (parameter.empty()) {
-                medians.push_back(std::numeric_limits<float>::quiet_NaN());
-                maxCorrs.push_back(std::numeric_limits<float>::quiet_NaN());
-                minCorrs.push_back(std::numeric_limits<float>::quiet_NaN());
-                firstQuartiles.push_back(std::numeric_limits<float>::quiet_NaN());
-                thirdQuartiles.push_back(std::numeric_limits<float>::quiet_NaN());
-                continue;
-            }
-
-            std::sort(parameter.begin(), parameter.end());
-
-            double min = parameter[0];
-            double max = parameter[parameter.size() - 1];
-            size_t a = static_cast<int>(parameter.size() / 2.0);
-            double median = parameter[a];
-            size_t b = static_cast<int>(parameter.size() * 0.25);
-            double firstQuartile = parameter[b];
-            size_t c = static_cast<int>(parameter.size() * 0.75);
-            double thirdQuartile = parameter[c];
-            
-            minCorrs.push_back(static_cast<float>(min));
-            maxCorrs.push_back(static_cast<float>(max));
-            medians.push_back(static_cast<float>(median));
-            firstQuartiles.push_back(static_cast<float>(firstQuartile));
-            thirdQuartiles.push_back(static_cast<float>(thirdQuartile));
+            std::vector<const std::vector<double>*> runs;
+            for (const auto& region : regions) runs.push_back(&(*region)[i]);
+            const auto quantiles = stats::correlationQuantiles(runs);
+            minCorrs.push_back(static_cast<float>(quantiles.min));
+            maxCorrs.push_back(static_cast<float>(quantiles.max));
+            medians.push_back(static_cast<float>(quantiles.median));
+            firstQuartiles.push_back(static_cast<float>(quantiles.firstQuartile));
+            thirdQuartiles.push_back(static_cast<float>(quantiles.thirdQuartile));
         }
         resDataFrame->addCategoricalColumn("Parameter", parameters);
         resDataFrame->addColumn<float>("Median_correlation", medians);
@@ -269,9 +250,12 @@ void VolumeRegionParameterCorrelation::process() {
 
         return resDataFrame;
     };
-    dispatchOne(calc, [this](std::shared_ptr<DataFrame> result) {
+    dispatchOne(calc, [this, metrics](std::shared_ptr<DataFrame> result) {
+        util::PhaseTimer timer(metrics.get(), util::JobPhase::Publish);
         correlations_.setData(result);
         newResults();
+        timer.stop();
+        metrics->finish();
     });
 }
 
@@ -32,6 +32,10 @@
 #include <inviwo/core/datastructures/volume/volumeramprecision.h>
 #include <inviwo/core/util/filesystem.h>
 
+#include <filesystem>
+#include <string_view>
+#include <unordered_map>
+
 namespace inviwo {
 
 // The Class Identifier has to be globally unique. Use a reverse DNS naming scheme
@@ -53,6 +57,7 @@ VolumeSequenceFilter::VolumeSequenceFilter()
     })
     , volumesOutport_("volumesOutport")
     , dataOutport_("dataOutport")
+    , selectionOutport_("selection")
     , filenameIdColumn_("filenameIdColumn", "Volume Filename Column", dataFrame_,
                         ColumnOptionProperty::AddNoneOption::No, 1) {
 
@@ -62,113 +67,126 @@ VolumeSequenceFilter::VolumeSequenceFilter()
     brushingAndLinking_.setOptional(false);
     addPort(volumesOutport_);
     addPort(dataOutport_);
+    addPort(selectionOutport_);
 
     addProperty(filenameIdColumn_);
 }
 
-void VolumeSequenceFilter::process() {
-    if (inport_.isChanged() || filenameIdColumn_.isModified() ||
-        brushingAndLinking_.isFilteringModified()) {
-
-        // Create a map between brushing id's and the volume filenames.
-        std::unordered_map<std::string, int> volumeIdMapping;
-
-        auto dataFrame = dataFrame_.getData();
-        auto dfSize = dataFrame->getNumberOfRows();
-        auto fileCol = dataFrame->getColumn(filenameIdColumn_.get());
-        if (!fileCol) {
-            if (dataFrame->getNumberOfColumns() > 0) {
-                fileCol = dataFrame->getColumn(0);
-            } else {
-                throw Exception("No columns in the input data frame.", IVW_CONTEXT);
-            }
-        }
-        for (auto brushingId = 0u; brushingId < dfSize; brushingId++) {
-            auto filename = dataFrame->getColumn(filenameIdColumn_.get())->getAsString(brushingId);
-            volumeIdMapping[filename] = brushingId;
+void VolumeSequenceFilter::updateJoin(const std::shared_ptr<const VolumeSequence>& volumes,
+                                      const std::shared_ptr<const DataFrame>& dataFrame) {
+    if (join_.volumes.lock() == volumes && join_.dataFrame.lock() == dataFrame &&
+        join_.column == filenameIdColumn_.get()) {
+        return;
+    }
+
+    auto fileCol = dataFrame->getColumn(filenameIdColumn_.get());
+    if (!fileCol) {
+        if (dataFrame->getNumberOfColumns() > 0) {
+            fileCol = dataFrame->getColumn(0);
+        } else {
+            throw Exception("No columns in the input data frame.", IVW_CONTEXT);
         }
+    }
 
-        // Check if two different filenames get mapped to the same brushingId.
-        for (auto elem : volumeIdMapping)
-            for (auto compare : volumeIdMapping) {
-                if (elem.first != compare.first)
-                    if (elem.second == compare.second)
-                        LogWarn(elem.second << " has same id as " << compare.second << ": "
-                                            << elem.first << " and " << compare.first);
-                if (elem.second != compare.second)
-                    if (elem.first == compare.first)
-                        LogWarn(elem.second << " has same id as " << compare.second << " => "
-                                            << elem.first << " and " << compare.first);
+    // Map filenames to rows. Duplicated filenames are mapped to their last row, as the volume
+    // cannot be told apart.
+    const auto dfSize = dataFrame->getNumberOfRows();
+    std::vector<std::string> names(dfSize);
+    std::unordered_map<std::string_view, std::uint32_t> volumeIdMapping;
+    volumeIdMapping.reserve(dfSize);
+    size_t duplicates = 0;
+    for (std::uint32_t brushingId = 0; brushingId < dfSize; ++brushingId) {
+        names[brushingId] = fileCol->getAsString(brushingId);
+        auto [it, inserted] = volumeIdMapping.try_emplace(names[brushingId], brushingId);
+        if (!inserted) {
+            if (duplicates == 0) {
+                LogWarn("Rows " << it->second << " and " << brushingId
+                                << " have the same filename: " << names[brushingId]);
             }
+            ++duplicates;
+            it->second = brushingId;
+        }
+    }
+    if (duplicates > 1) {
+        LogWarn(duplicates << " rows have the same filename as a previous row in column "
+                           << fileCol->getHeader());
+    }
 
-        auto volumes = inport_.getData();
-        VolumeSequence outputVolumes;
-
-        if (dfSize != volumes->size()) {
-            LogWarn(
-                fmt::format("The number of volumes does not match the number of entries in the "
+    if (dfSize != volumes->size()) {
+        LogWarn(fmt::format("The number of volumes does not match the number of entries in the "
                             "data frame (.csv). Found {} volumes, but {} rows.",
                             volumes->size(), dfSize));
-        }
-
-        for (const auto& volume : *volumes) {
-
-            std::string defaultFilepath = "No file path found";
-            std::filesystem::path filepath(volume->getMetaData<StringMetaData>("filename", defaultFilepath));
+    }
 
-            auto mapIterator = volumeIdMapping.find(filepath.filename().generic_string());
-            if (mapIterator == volumeIdMapping.end()) {
-                LogWarn("Volume: " << filepath.filename()
-                                   << " cannot be mapped to any value in column "
-                                   << filenameIdColumn_.get());
-                continue;
-            }
-            auto brushingId = mapIterator->second;
-            // Add volumes that are not in the brushed indices to the output
-            if (!brushingAndLinking_.isFiltered(brushingId)) {
-                outputVolumes.push_back(volume);
-            }
+    Join join{volumes, dataFrame, filenameIdColumn_.get(), {}, {}, {}};
+    join.volumeRows.reserve(volumes->size());
+    for (size_t i = 0; i < volumes->size(); ++i) {
+        const std::string defaultFilepath = "No file path found";
+        const std::filesystem::path filepath(
+            (*volumes)[i]->getMetaData<StringMetaData>("filename", defaultFilepath));
+        const auto filename = filepath.filename().generic_string();
+
+        auto mapIterator = volumeIdMapping.find(filename);
+        if (mapIterator == volumeIdMapping.end()) {
+            LogWarn("Volume: " << filename << " cannot be mapped to any value in column "
+                               << fileCol->getHeader());
+            continue;
         }
+        join.volumeRows.emplace_back(i, mapIterator->second);
+    }
+    // The keys of volumeIdMapping view names, so find the rows to keep before moving them
+    std::vector<char> unique(dfSize, 0);
+    for (const auto& [filename, brushingId] : volumeIdMapping) unique[brushingId] = 1;
+    for (std::uint32_t brushingId = 0; brushingId < dfSize; ++brushingId) {
+        if (!unique[brushingId]) continue;
+        join.rows.push_back(brushingId);
+        join.filenames.push_back(std::move(names[brushingId]));
+    }
+    join_ = std::move(join);
+}
 
-        // Add the filtered volumes to the volumesOutport
-        std::shared_ptr<VolumeSequence> volumePointer =
-            std::make_shared<VolumeSequence>(std::move(outputVolumes));
-
-        if (volumePointer->empty()) {
+void VolumeSequenceFilter::process() {
+    auto volumes = inport_.getData();
+    updateJoin(volumes, dataFrame_.getData());
+
+    const auto& filtered = brushingAndLinking_.getFilteredIndices();
+    // Volumes that are not in the brushed indices
+    BitSet selected;
+    for (const auto& [volume, row] : join_.volumeRows) {
+        if (!filtered.contains(row)) selected.add(static_cast<std::uint32_t>(volume));
+    }
+    selection_ = std::make_shared<const VolumeSequenceSelection>(volumes, std::move(selected),
+                                                                 selection_.get());
+    selectionOutport_.setData(selection_);
+
+    std::shared_ptr<const VolumeSequence> volumePointer;
+    if (selection_->size() == volumes->size()) {
+        // Nothing is filtered, pass the input on without copying it
+        volumePointer = volumes;
+    } else {
+        auto outputVolumes = std::make_shared<VolumeSequence>(selection_->getVolumes());
+        if (outputVolumes->empty()) {
             // Send volume with zeroes if all volumes has been brushed away.
             // Processors below will not be evaluated otherwise.
-            volumePointer->push_back(std::make_shared<Volume>(
+            outputVolumes->push_back(std::make_shared<Volume>(
                 std::make_shared<VolumeRAMPrecision<float>>(volumes->front()->getDimensions())));
-            volumePointer->back()->dataMap.dataRange = dvec2(0, 1);
-            volumePointer->back()->dataMap.valueRange = dvec2(0, 1);
+            outputVolumes->back()->dataMap.dataRange = dvec2(0, 1);
+            outputVolumes->back()->dataMap.valueRange = dvec2(0, 1);
         }
-        volumesOutport_.setData(volumePointer);
-
-        // Create dataframe with the id's of all the volumes selected through brushing so that a
-        // list with brushed volumes can be exported.
-        auto dataframe = std::make_shared<DataFrame>();
-        std::vector<std::string> col;
-
-        // Add all non-brushed volumes to the column vector.
-        for (auto& id : volumeIdMapping) {
-            if (!brushingAndLinking_.isFiltered(id.second)) col.push_back(id.first);
-        }
-
-        // Add the created column to the dataframe and send to outport.
-        auto stringCol =
-            dataframe->addCategoricalColumn(filenameIdColumn_.getSelectedDisplayName(), 0);
-        for (auto element : col) stringCol->add(element);
-        dataframe->updateIndexBuffer();
-        dataOutport_.setData(dataframe);
-
-        // If no change has been done in the brushing, take no action.
-    } else if (!brushingAndLinking_.isFilteringModified()) {
-        return;
-        // If no volumes are brushed, send all volumes to the outports.
-    } else {
-        volumesOutport_.setData(inport_.getData());
-        dataOutport_.setData(dataFrame_.getData());
+        volumePointer = outputVolumes;
+    }
+    volumesOutport_.setData(volumePointer);
+
+    // Create dataframe with the id's of all the volumes selected through brushing so that a
+    // list with brushed volumes can be exported.
+    auto dataframe = std::make_shared<DataFrame>();
+    auto stringCol =
+        dataframe->addCategoricalColumn(filenameIdColumn_.getSelectedDisplayName(), 0);
+    for (auto&& [row, filename] : util::zip(join_.rows, join_.filenames)) {
+        if (!filtered.contains(row)) stringCol->add(filename);
     }
+    dataframe->updateIndexBuffer();
+    dataOutport_.setData(dataframe);
 }
 
 }  // namespace inviwo
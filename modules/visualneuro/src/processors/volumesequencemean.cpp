@@ -28,6 +28,9 @@
  *********************************************************************************/
 
 #include <modules/visualneuro/processors/volumesequencemean.h>
+#include <modules/visualneuro/algorithm/volume/voxelstatistics.h>
+#include <modules/visualneuro/util/jobmetrics.h>
+#include <modules/visualneuro/util/volumememoryaccountant.h>
 #include <inviwo/core/network/networklock.h>
 
 namespace inviwo {
@@ -43,62 +46,91 @@ const ProcessorInfo VolumeSequenceMean::processorInfo_{
 };
 const ProcessorInfo VolumeSequenceMean::getProcessorInfo() const { return processorInfo_; }
 
-VolumeSequenceMean::VolumeSequenceMean() : PoolProcessor(), inport_("inport"), outport_("outport") {
+VolumeSequenceMean::VolumeSequenceMean()
+    : PoolProcessor()
+    , inport_("inport")
+    , selection_("selection")
+    , outport_("outport")
+    , selectionSum_{std::make_shared<SelectionSum>()} {
     addPort(inport_);
+    inport_.setOptional(true);
+    addPort(selection_);
+    selection_.setOptional(true);
     addPort(outport_);
 }
 
 void VolumeSequenceMean::process() {
-    const auto calc = [volumes = inport_.getData()](
+    if (selection_.isConnected() && selection_.hasData()) {
+        processSelection();
+        return;
+    }
+    if (!inport_.hasData() || inport_.getData()->empty()) {
+        outport_.clear();
+        return;
+    }
+    auto metrics = std::make_shared<util::JobMetrics>(*this);
+    const auto calc = [volumes = inport_.getData(), metrics](
                           pool::Stop stop, pool::Progress progress) -> std::shared_ptr<Volume> {
+        const auto job = metrics->start();
         progress(0.f);
-        auto dims = (volumes->front()->getDimensions());
-        auto nVoxels = dims[0] * dims[1] * dims[2];
+        auto resVolume = stats::volumeSequenceMean(
+            *volumes, util::makeBlockControl(stop, progress, metrics.get()));
+        progress(1.f);
 
-        auto newVolume = std::make_shared<VolumeRAMPrecision<float>>(dims);
-        auto resVolume = std::make_shared<Volume>(newVolume);
-        // Points to first voxel, changes on 'res' changes 'result'
-        float* res = newVolume->getDataTyped();
-        double residual = 1.0 / static_cast<float>(volumes->size());
-        dvec2 dataRange(0);
-        dvec2 valueRange(0);
+        return resVolume;
+    };
 
-        for (auto i = 0; i < static_cast<int>(volumes->size()); i++) {
-            auto volume = (*volumes)[i];
-            auto volumeRAM = volume->getRepresentation<VolumeRAM>();
-            auto& dataMap = volume->dataMap;
-            dataRange += residual * dataMap.dataRange;
-            valueRange += residual * dataMap.valueRange;
-            // Dispatch function
-            volumeRAM->dispatch<void, dispatching::filter::Scalars>([&res, dataMap, nVoxels,
-                                                                     residual](auto vr) {
-                auto data = vr->getDataTyped();  // pointer to first voxel
+    dispatchOne(calc, [this, metrics](std::shared_ptr<Volume> result) {
+        util::PhaseTimer timer(metrics.get(), util::JobPhase::Publish);
+        outport_.setData(result);
+        util::VolumeMemoryAccountant::get().track(
+            result, util::VolumeMemoryAccountant::ownerName(outport_),
+            util::RepresentationSource::Computed);
+        newResults();
+        timer.stop();
+        metrics->finish();
+    });
+}
 
-                for (auto index = 0u; index < nVoxels; index++) {
-                    *(res + index) +=
-                        static_cast<float>(residual * dataMap.mapFromDataToValue(
-                                                          static_cast<double>(*(data + index))));
-                }
-            });
-            // Exit function if this is not the latest job
-            if (stop) return resVolume;
-            // Update the progress
-            progress(i, volumes->size());
+void VolumeSequenceMean::processSelection() {
+    auto metrics = std::make_shared<util::JobMetrics>(*this);
+    const auto calc = [selection = selection_.getData(), state = selectionSum_, metrics](
+                          pool::Stop stop, pool::Progress progress) -> std::shared_ptr<Volume> {
+        const auto job = metrics->start();
+        progress(0.f);
+        std::scoped_lock lock{state->mutex};
+        const auto control = util::makeBlockControl(stop, progress, metrics.get());
+        bool updated = false;
+        if (state->parent == selection->getParent() &&
+            state->version == selection->getPreviousVersion() && state->version != 0) {
+            // Only read the volumes that changed since the sum was computed
+            updated = state->sum.update(selection->getVolumes(selection->getAdded()),
+                                        selection->getVolumes(selection->getRemoved()), control);
+        } else {
+            state->sum.clear();
+            updated = state->sum.update(selection->getVolumes(), {}, control);
         }
-        // Data is stored in value domain
-        resVolume->dataMap.dataRange = valueRange;
-        resVolume->dataMap.valueRange = valueRange;
-
-        resVolume->setModelMatrix(volumes->front()->getModelMatrix());
-        resVolume->setWorldMatrix(volumes->front()->getWorldMatrix());
+        if (!updated) {
+            state->version = 0;
+            return nullptr;
+        }
+        state->parent = selection->getParent();
+        state->version = selection->getVersion();
         progress(1.f);
 
-        return resVolume;
+        const util::PhaseTimer timer(metrics.get(), util::JobPhase::Compute);
+        return state->sum.mean();
     };
 
-    dispatchOne(calc, [this](std::shared_ptr<Volume> result) {
+    dispatchOne(calc, [this, metrics](std::shared_ptr<Volume> result) {
+        util::PhaseTimer timer(metrics.get(), util::JobPhase::Publish);
         outport_.setData(result);
+        util::VolumeMemoryAccountant::get().track(
+            result, util::VolumeMemoryAccountant::ownerName(outport_),
+            util::RepresentationSource::Computed);
         newResults();
+        timer.stop();
+        metrics->finish();
     });
 }
 
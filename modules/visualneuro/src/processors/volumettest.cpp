@@ -28,19 +28,14 @@
  *********************************************************************************/
 
 #include <modules/visualneuro/processors/volumettest.h>
-#include <math.h>
-#include <stdio.h>
-#include <thread>
+#include <modules/visualneuro/algorithm/volume/voxelstatistics.h>
+#include <modules/visualneuro/util/jobmetrics.h>
+#include <modules/visualneuro/util/volumememoryaccountant.h>
 
-#include <inviwo/core/datastructures/volume/volumeramprecision.h>
 #include <inviwo/core/network/networklock.h>
 #include <inviwo/core/processors/progressbar.h>
 #include <inviwo/core/util/stdextensions.h>
 
-#if defined(ENABLE_OPENMP)
-#include <omp.h>
-#endif
-
 namespace inviwo {
 
 // The Class Identifier has to be globally unique. Use a reverse DNS naming scheme
@@ -74,92 +69,32 @@ VolumeTTest::VolumeTTest()
 }
 
 void VolumeTTest::process() {
-
-    const auto calc = [volumesA = volumeSequenceInport1_.getData(),
-                       volumesB = volumeSequenceInport2_.getData(), tailTest = tailTest_.get(),
-                       equalVariance = equalVariance_.get() ? stats::EqualVariance::Yes
-                                                            : stats::EqualVariance::No,
-                       p_val = pVal_.get()](pool::Stop stop,
-                                            pool::Progress progress) -> std::shared_ptr<Volume> {
-        auto calculateScores = [](const std::vector<const VolumeRAM*>& volumes, int vxlNmbr) {
-            std::vector<double> scores(volumes.size());
-
-            for (auto index = 0u; index < volumes.size(); index++) {
-                volumes[index]->dispatch<void, dispatching::filter::Scalars>(
-                    [&scores, index, vxlNmbr,
-                     dataMap = &volumes[index]->getOwner()->dataMap](auto vr) {
-                        auto ptr_first_vxl = vr->getDataTyped();
-                        scores[index] = dataMap->mapFromDataToValue(
-                            static_cast<double>(*(ptr_first_vxl + vxlNmbr)));
-                    });
-            }
-            return scores;
-        };
-
-        auto dims = volumesA->front()->getDimensions();
-
-        auto nVoxels = dims[0] * dims[1] * dims[2];
-
-        std::vector<const VolumeRAM*> volRamA;
-        std::vector<const VolumeRAM*> volRamB;
-
-        std::transform(volumesA->begin(), volumesA->end(), std::back_inserter(volRamA),
-                       [](auto vol) { return vol->template getRepresentation<VolumeRAM>(); });
-        std::transform(volumesB->begin(), volumesB->end(), std::back_inserter(volRamB),
-                       [](auto vol) { return vol->template getRepresentation<VolumeRAM>(); });
-
-        auto vol = std::make_shared<VolumeRAMPrecision<float>>(dims);
-        auto resVol = std::make_shared<Volume>(vol);
-
-        float* res = vol->getDataTyped();
-
-        dvec2 minMax(std::numeric_limits<double>::max(), std::numeric_limits<double>::lowest());
-
-        auto startTime = std::chrono::high_resolution_clock::now();
-        for (auto vxlNmbr = 0u; vxlNmbr < nVoxels; vxlNmbr++) {
-
-            if (stop) return resVol;
-
-            std::vector<double> groupA = calculateScores(volRamA, vxlNmbr);
-            std::vector<double> groupB = calculateScores(volRamB, vxlNmbr);
-
-            auto [t, p] = stats::tTest(groupA, groupB, equalVariance, tailTest);
-
-            // Check if p-value is statistically significant
-            // The sign indicate if directedness of the t-Test, e.g. A is greater than B.
-            // Other sources:
-            // The t distribution is symmetric about zero, so there's really nothing to
-            // interpret about the sign of the test statistic.  If the p-value is small enough,
-            // you have a significant difference, and otherwise you don't.
-            //*(res + vxlNmbr) = p < p_val ? static_cast<float>(std::abs(t)) : 0.f;
-            *(res + vxlNmbr) = p < p_val ? static_cast<float>(t) : 0.f;
-
-            minMax.x = std::min(minMax.x, static_cast<double>(*(res + vxlNmbr)));
-            minMax.y = std::max(minMax.y, static_cast<double>(*(res + vxlNmbr)));
-
-            if (std::chrono::high_resolution_clock::now() - startTime >
-                std::chrono::milliseconds(200)) {
-                progress(vxlNmbr, nVoxels);
-                startTime = std::chrono::high_resolution_clock::now();
-            }
-        }
-
+    auto metrics = std::make_shared<util::JobMetrics>(*this);
+    const auto calc = [metrics, volumesA = volumeSequenceInport1_.getData(),
+                       volumesB = volumeSequenceInport2_.getData(),
+                       settings = stats::TTestSettings{equalVariance_.get()
+                                                           ? stats::EqualVariance::Yes
+                                                           : stats::EqualVariance::No,
+                                                       tailTest_.get(), pVal_.get()}](
+                          pool::Stop stop, pool::Progress progress) -> std::shared_ptr<Volume> {
+        const auto job = metrics->start();
+        progress(0.f);
+        // Significant voxels get the t-value, where the sign indicates if A is greater than B
+        auto resVol = stats::volumeTTest(*volumesA, *volumesB, settings,
+                                         util::makeBlockControl(stop, progress, metrics.get()));
         progress(1.f);
-        if (std::abs(minMax.y - minMax.x) < std::numeric_limits<double>::denorm_min()) {
-            // Prevent division by zero errors
-            minMax.y += std::numeric_limits<double>::denorm_min();
-        }
-        resVol->dataMap.dataRange = minMax;
-        resVol->dataMap.valueRange = minMax;
-
-        resVol->setModelMatrix(volumesA->front()->getModelMatrix());
-        resVol->setWorldMatrix(volumesA->front()->getWorldMatrix());
 
         return resVol;
     };
-    dispatchOne(calc, [this](std::shared_ptr<Volume> result) {
+    dispatchOne(calc, [this, metrics](std::shared_ptr<Volume> result) {
+        util::PhaseTimer timer(metrics.get(), util::JobPhase::Publish);
         outport_.setData(result);
+        util::VolumeMemoryAccountant::get().track(
+            result, util::VolumeMemoryAccountant::ownerName(outport_),
+            util::RepresentationSource::Computed);
         newResults();
+        timer.stop();
+        metrics->finish();
     });
 }
 
@@ -32,6 +32,8 @@
 #include <modules/visualneuro/statistics/spearmancorrelation.h>
 #include <inviwo/core/util/assertion.h>
 
+#include <cmath>
+
 namespace inviwo {
 
 namespace stats {
@@ -52,12 +54,32 @@ std::tuple<double, double> corrTest(const std::vector<double>& A,
             IVW_ASSERT(true, "Correlation method not implemented");
             break;
     }
+    return {r, correlationPValue(r, A.size(), tailTest)};
+}
+
+double correlationPValue(double r, size_t n, TailTest tailTest) {
     // Test for significance according to Student's t-distribution
-    auto t = r * sqrt((A.size() - 2) / (1.0 - r * r));
-    auto p = stats::tailTest(t, static_cast<double>(A.size()-2), tailTest);
-    return {r, p};
+    const auto degrees = static_cast<double>(n) - 2.0;
+    const auto t = r * std::sqrt(degrees / (1.0 - r * r));
+    return stats::tailTest(t, degrees, tailTest);
 }
 
+std::tuple<double, double> standardizedPearsonTest(const double* standardizedA, const double* b,
+                                                   size_t n, TailTest tailTest) {
+    double mean = 0.0;
+    for (size_t i = 0; i < n; ++i) mean += b[i];
+    mean /= static_cast<double>(n);
+
+    double products = 0.0;
+    double squares = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        const auto diff = b[i] - mean;
+        products += standardizedA[i] * diff;
+        squares += diff * diff;
+    }
+    const auto r = products / std::sqrt(static_cast<double>(n) * squares);
+    return {r, correlationPValue(r, n, tailTest)};
+}
 
 }  // namespace stats
 
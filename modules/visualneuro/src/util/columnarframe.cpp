@@ -0,0 +1,248 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/util/columnarframe.h>
+#include <inviwo/core/datastructures/buffer/bufferramprecision.h>
+#include <inviwo/core/util/exception.h>
+#include <inviwo/core/util/glmutils.h>
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <nlohmann/json.hpp>
+#include <warn/pop>
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace inviwo {
+
+namespace util {
+
+namespace {
+
+using json = nlohmann::json;
+
+constexpr char frameMagic[4] = {'V', 'N', 'C', 'F'};
+constexpr size_t frameHeaderSize = 16;
+
+constexpr size_t align8(size_t offset) { return (offset + 7) & ~size_t{7}; }
+
+// Component types that JavaScript typed arrays can view directly
+template <typename C>
+constexpr bool isTypedArrayType() {
+    return std::is_same_v<C, float> || std::is_same_v<C, double> ||
+           (std::is_integral_v<C> && !std::is_same_v<C, bool> && sizeof(C) <= 4);
+}
+
+template <typename C>
+std::string typedArrayType() {
+    if constexpr (std::is_same_v<C, float>) {
+        return "float32";
+    } else if constexpr (isTypedArrayType<C>() && std::is_integral_v<C>) {
+        return (std::is_signed_v<C> ? "int" : "uint") + std::to_string(8 * sizeof(C));
+    } else {
+        return "float64";
+    }
+}
+
+// Column data before it is copied into the frame
+struct ColumnData {
+    ColumnarColumn info;
+    const void* data = nullptr;
+    // Values converted to float64, used if the component type has no typed array
+    std::vector<double> converted;
+};
+
+// Values of the rows from firstRow to the end of column
+ColumnData columnData(const Column& column, size_t firstRow) {
+    ColumnData res;
+    res.info.name = column.getHeader();
+    res.info.firstRow = firstRow;
+    const auto* ram = column.getBuffer()->getRepresentation<BufferRAM>();
+
+    if (const auto* categorical = dynamic_cast<const CategoricalColumn*>(&column)) {
+        const auto& categories = categorical->getCategories();
+        res.info.type = "categorical";
+        res.info.categories.assign(categories.begin(), categories.end());
+        res.info.bytes = (ram->getSize() - firstRow) * sizeof(std::uint32_t);
+        res.data = static_cast<const std::uint32_t*>(ram->getData()) + firstRow;
+        return res;
+    }
+
+    ram->dispatch<void>([&](auto typedBuf) {
+        using ValueType = util::PrecisionValueType<decltype(typedBuf)>;
+        using ComponentType = typename util::value_type<ValueType>::type;
+        const auto& values = typedBuf->getDataContainer();
+        res.info.type = typedArrayType<ComponentType>();
+        res.info.components = util::extent<ValueType>::value;
+        if constexpr (isTypedArrayType<ComponentType>()) {
+            res.info.bytes = (values.size() - firstRow) * sizeof(ValueType);
+            res.data = values.data() + firstRow;
+        } else {
+            res.converted.reserve((values.size() - firstRow) * res.info.components);
+            for (auto it = values.begin() + firstRow; it != values.end(); ++it) {
+                for (size_t c = 0; c < res.info.components; ++c) {
+                    res.converted.push_back(static_cast<double>(util::glmcomp(*it, c)));
+                }
+            }
+            res.info.bytes = res.converted.size() * sizeof(double);
+            res.data = res.converted.data();
+        }
+    });
+    return res;
+}
+
+std::vector<std::byte> serialize(std::vector<ColumnData>& columns, json metadata) {
+    metadata["columns"] = json::array();
+    size_t dataBytes = 0;
+    for (auto& column : columns) {
+        column.info.offset = dataBytes;
+        dataBytes += align8(column.info.bytes);
+        json desc = {{"name", column.info.name},
+                     {"type", column.info.type},
+                     {"components", column.info.components},
+                     {"firstRow", column.info.firstRow},
+                     {"offset", column.info.offset},
+                     {"bytes", column.info.bytes}};
+        if (column.info.type == "categorical") desc["categories"] = column.info.categories;
+        metadata["columns"].push_back(std::move(desc));
+    }
+    auto text = metadata.dump();
+    text.resize(align8(text.size()), ' ');
+
+    // Zero initialized, which also fills the padding between columns
+    std::vector<std::byte> res(frameHeaderSize + text.size() + dataBytes);
+    const std::uint32_t header[4] = {0, columnarFrameVersion,
+                                     static_cast<std::uint32_t>(text.size()), 0};
+    std::memcpy(res.data(), header, sizeof(header));
+    std::memcpy(res.data(), frameMagic, sizeof(frameMagic));
+    std::memcpy(res.data() + frameHeaderSize, text.data(), text.size());
+    auto* data = res.data() + frameHeaderSize + text.size();
+    for (const auto& column : columns) {
+        if (column.info.bytes > 0) {
+            std::memcpy(data + column.info.offset, column.data, column.info.bytes);
+        }
+    }
+    return res;
+}
+
+json frameMetadata(std::string_view kind, const DataFrame& frame, std::string_view port,
+                   std::string_view processor, std::uint64_t version, std::uint64_t base) {
+    return {{"kind", std::string(kind)},
+            {"version", version},
+            {"base", base},
+            {"rows", frame.getNumberOfRows()},
+            {"port", std::string(port)},
+            {"processor", std::string(processor)}};
+}
+
+}  // namespace
+
+std::vector<std::byte> serializeColumnarFrame(const DataFrame& frame, std::string_view port,
+                                              std::string_view processor,
+                                              std::uint64_t version) {
+    std::vector<ColumnData> columns;
+    columns.reserve(frame.getNumberOfColumns());
+    for (size_t i = 0; i < frame.getNumberOfColumns(); ++i) {
+        columns.push_back(columnData(*frame.getColumn(i), 0));
+    }
+    return serialize(columns, frameMetadata("full", frame, port, processor, version, 0));
+}
+
+std::vector<std::byte> serializeColumnarDelta(const DataFrame& frame, const DataFrameDelta& delta,
+                                              std::string_view port, std::string_view processor,
+                                              std::uint64_t version, std::uint64_t base) {
+    if (delta.full) return serializeColumnarFrame(frame, port, processor, version);
+
+    std::vector<ColumnData> columns;
+    for (size_t i = 0; i < frame.getNumberOfColumns(); ++i) {
+        const auto changed = std::find(delta.changedColumns.begin(), delta.changedColumns.end(),
+                                       i) != delta.changedColumns.end();
+        if (changed) {
+            columns.push_back(columnData(*frame.getColumn(i), 0));
+        } else if (delta.rows > delta.previousRows) {
+            columns.push_back(columnData(*frame.getColumn(i), delta.previousRows));
+        }
+    }
+    return serialize(columns, frameMetadata("delta", frame, port, processor, version, base));
+}
+
+ColumnarFrameInfo readColumnarFrameInfo(const std::byte* data, size_t size) {
+    const auto invalid = [](std::string_view reason) {
+        return Exception(fmt::format("Invalid columnar frame: {}", reason),
+                         IVW_CONTEXT_CUSTOM("ColumnarFrame"));
+    };
+    if (size < frameHeaderSize) throw invalid("truncated header");
+    std::uint32_t header[4];
+    std::memcpy(header, data, sizeof(header));
+    if (std::memcmp(data, frameMagic, sizeof(frameMagic)) != 0) throw invalid("no magic");
+    if (header[1] != columnarFrameVersion) throw invalid("unsupported version");
+    const size_t metadataBytes = header[2];
+    if (metadataBytes % 8 != 0 || frameHeaderSize + metadataBytes > size) {
+        throw invalid("truncated metadata");
+    }
+    const auto dataOffset = frameHeaderSize + metadataBytes;
+
+    ColumnarFrameInfo res;
+    try {
+        const auto text = reinterpret_cast<const char*>(data + frameHeaderSize);
+        const auto metadata = json::parse(text, text + metadataBytes);
+        res.kind = metadata.at("kind").get<std::string>();
+        res.version = metadata.at("version").get<std::uint64_t>();
+        res.base = metadata.at("base").get<std::uint64_t>();
+        res.rows = metadata.at("rows").get<size_t>();
+        res.port = metadata.at("port").get<std::string>();
+        res.processor = metadata.at("processor").get<std::string>();
+        for (const auto& desc : metadata.at("columns")) {
+            auto& column = res.columns.emplace_back();
+            column.name = desc.at("name").get<std::string>();
+            column.type = desc.at("type").get<std::string>();
+            column.components = desc.at("components").get<size_t>();
+            column.firstRow = desc.at("firstRow").get<size_t>();
+            column.offset = dataOffset + desc.at("offset").get<size_t>();
+            column.bytes = desc.at("bytes").get<size_t>();
+            if (auto it = desc.find("categories"); it != desc.end()) {
+                column.categories = it->get<std::vector<std::string>>();
+            }
+        }
+    } catch (const json::exception& e) {
+        throw invalid(e.what());
+    }
+    for (const auto& column : res.columns) {
+        if (column.offset % 8 != 0 || column.offset > size || column.bytes > size - column.offset) {
+            throw invalid(fmt::format("column '{}' outside of the frame", column.name));
+        }
+    }
+    return res;
+}
+
+}  // namespace util
+
+}  // namespace inviwo
@@ -0,0 +1,206 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/util/columnarframestore.h>
+
+#include <fmt/format.h>
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <include/cef_resource_handler.h>
+#include <include/cef_scheme.h>
+#include <warn/pop>
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <string_view>
+
+namespace inviwo {
+
+namespace util {
+
+namespace {
+
+constexpr std::string_view frameDomain = "visualneuro.data";
+constexpr std::string_view framePath = "/frame/";
+
+#include <warn/push>
+#include <warn/ignore/extra-semi>  // Due to IMPLEMENT_REFCOUNTING, remove when upgrading CEF
+class ColumnarFrameResourceHandler : public CefResourceHandler {
+public:
+    ColumnarFrameResourceHandler(std::shared_ptr<const std::vector<std::byte>> frame,
+                                 std::string origin)
+        : frame_{std::move(frame)}, origin_{std::move(origin)} {}
+
+    virtual bool Open(CefRefPtr<CefRequest>, bool& handleRequest,
+                      CefRefPtr<CefCallback>) override {
+        handleRequest = true;
+        return true;
+    }
+
+    virtual void GetResponseHeaders(CefRefPtr<CefResponse> response, int64& responseLength,
+                                    CefString&) override {
+        CefResponse::HeaderMap headers;
+        if (frame_ && !origin_.empty()) {
+            headers.emplace("Access-Control-Allow-Origin", origin_);
+            headers.emplace("Vary", "Origin");
+        }
+        headers.emplace("Cache-Control", "no-store");
+        response->SetHeaderMap(headers);
+        if (frame_) {
+            response->SetStatus(200);
+            response->SetMimeType("application/octet-stream");
+            responseLength = static_cast<int64>(frame_->size());
+        } else {
+            response->SetStatus(404);
+            responseLength = 0;
+        }
+    }
+
+    virtual bool Read(void* dataOut, int bytesToRead, int& bytesRead,
+                      CefRefPtr<CefResourceReadCallback>) override {
+        bytesRead = 0;
+        if (!frame_ || offset_ >= frame_->size()) return false;
+        const auto count = std::min(frame_->size() - offset_, static_cast<size_t>(bytesToRead));
+        std::memcpy(dataOut, frame_->data() + offset_, count);
+        offset_ += count;
+        bytesRead = static_cast<int>(count);
+        return true;
+    }
+
+    virtual void Cancel() override {}
+
+private:
+    std::shared_ptr<const std::vector<std::byte>> frame_;
+    std::string origin_;
+    size_t offset_ = 0;
+    IMPLEMENT_REFCOUNTING(ColumnarFrameResourceHandler);
+};
+
+class ColumnarFrameSchemeHandlerFactory : public CefSchemeHandlerFactory {
+public:
+    virtual CefRefPtr<CefResourceHandler> Create(CefRefPtr<CefBrowser> browser,
+                                                 CefRefPtr<CefFrame> cefFrame, const CefString&,
+                                                 CefRefPtr<CefRequest> request) override {
+        const std::string url = request->GetURL();
+        std::shared_ptr<const std::vector<std::byte>> frame;
+        // Frames are only served to the page they were published for, other requests, e.g. from
+        // iframes or other browsers, are answered with 404
+        if (const auto pos = url.rfind(framePath);
+            pos != std::string::npos && browser && cefFrame && cefFrame->IsMain()) {
+            const auto token = std::string_view{url}.substr(pos + framePath.size());
+            frame = ColumnarFrameStore::get().take(token, browser->GetIdentifier());
+        }
+        std::string origin = request->GetHeaderByName("Origin");
+        return new ColumnarFrameResourceHandler(std::move(frame), std::move(origin));
+    }
+
+private:
+    IMPLEMENT_REFCOUNTING(ColumnarFrameSchemeHandlerFactory);
+};
+#include <warn/pop>
+
+// 128 random bits as hex, frame URLs cannot be guessed from earlier ones
+std::string randomToken() {
+    static std::random_device device;
+    std::string token;
+    for (int i = 0; i < 4; ++i) {
+        token += fmt::format("{:08x}", static_cast<std::uint32_t>(device()));
+    }
+    return token;
+}
+
+}  // namespace
+
+ColumnarFrameStore& ColumnarFrameStore::get() {
+    static ColumnarFrameStore store;
+    return store;
+}
+
+std::uint64_t ColumnarFrameStore::nextVersion() {
+    std::scoped_lock lock{mutex_};
+    return ++version_;
+}
+
+std::string ColumnarFrameStore::set(std::uint64_t version,
+                                    std::shared_ptr<const std::vector<std::byte>> frame,
+                                    int browserId) {
+    std::scoped_lock lock{mutex_};
+    auto& entry = frames_[version];
+    if (entry.token.empty()) {
+        entry.token = randomToken();
+        tokens_[entry.token] = version;
+    }
+    entry.frame = std::move(frame);
+    entry.browserId = browserId;
+    return entry.token;
+}
+
+std::shared_ptr<const std::vector<std::byte>> ColumnarFrameStore::find(
+    std::uint64_t version) const {
+    std::scoped_lock lock{mutex_};
+    auto it = frames_.find(version);
+    return it != frames_.end() ? it->second.frame : nullptr;
+}
+
+std::shared_ptr<const std::vector<std::byte>> ColumnarFrameStore::take(std::string_view token,
+                                                                       int browserId) {
+    std::scoped_lock lock{mutex_};
+    auto it = tokens_.find(std::string{token});
+    if (it == tokens_.end()) return nullptr;
+    auto node = frames_.extract(it->second);
+    if (node.mapped().browserId != browserId) {
+        frames_.insert(std::move(node));
+        return nullptr;
+    }
+    tokens_.erase(it);
+    return std::move(node.mapped().frame);
+}
+
+void ColumnarFrameStore::erase(std::uint64_t version) {
+    std::scoped_lock lock{mutex_};
+    auto it = frames_.find(version);
+    if (it == frames_.end()) return;
+    tokens_.erase(it->second.token);
+    frames_.erase(it);
+}
+
+std::string columnarFrameURL(std::string_view token) {
+    return "https://" + std::string(frameDomain) + std::string(framePath) + std::string(token);
+}
+
+void registerColumnarFrameScheme() {
+    CefRegisterSchemeHandlerFactory("https", std::string(frameDomain),
+                                    new ColumnarFrameSchemeHandlerFactory());
+}
+
+}  // namespace util
+
+}  // namespace inviwo
@@ -0,0 +1,152 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/util/dataframedelta.h>
+#include <inviwo/core/datastructures/buffer/bufferramprecision.h>
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <nlohmann/json.hpp>
+#include <warn/pop>
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace inviwo {
+
+namespace util {
+
+namespace {
+
+bool sameLayout(const Column& previous, const Column& current) {
+    return previous.getHeader() == current.getHeader() &&
+           previous.getColumnType() == current.getColumnType() &&
+           previous.getBuffer()->getDataFormat()->getId() ==
+               current.getBuffer()->getDataFormat()->getId();
+}
+
+// Compares the bytes of the values, so that NaN values compare equal to themselves
+bool sameValues(const Column& previous, const Column& current, size_t rows) {
+    if (&previous == &current) return true;
+    if (const auto* categorical = dynamic_cast<const CategoricalColumn*>(&current)) {
+        const auto& previousCategories =
+            static_cast<const CategoricalColumn&>(previous).getCategories();
+        const auto& categories = categorical->getCategories();
+        if (previousCategories.size() > categories.size() ||
+            !std::equal(previousCategories.begin(), previousCategories.end(),
+                        categories.begin())) {
+            return false;
+        }
+    }
+    const auto* currentRAM = current.getBuffer()->getRepresentation<BufferRAM>();
+    return previous.getBuffer()->getRepresentation<BufferRAM>()->dispatch<bool>(
+        [&](auto typedBuf) {
+            using BufferType = std::remove_pointer_t<decltype(typedBuf)>;
+            using ValueType = util::PrecisionValueType<decltype(typedBuf)>;
+            const auto& before = typedBuf->getDataContainer();
+            const auto& after = static_cast<BufferType*>(currentRAM)->getDataContainer();
+            return rows == 0 ||
+                   std::memcmp(before.data(), after.data(), rows * sizeof(ValueType)) == 0;
+        });
+}
+
+}  // namespace
+
+DataFrameDelta diffDataFrames(const DataFrame& previous, const DataFrame& current) {
+    DataFrameDelta res;
+    res.previousRows = previous.getNumberOfRows();
+    res.rows = current.getNumberOfRows();
+    if (&previous == &current) return res;
+
+    if (previous.getNumberOfColumns() != current.getNumberOfColumns()) {
+        res.full = true;
+        return res;
+    }
+    for (size_t i = 0; i < current.getNumberOfColumns(); ++i) {
+        if (!sameLayout(*previous.getColumn(i), *current.getColumn(i))) {
+            res.full = true;
+            return res;
+        }
+    }
+
+    const auto common = std::min(res.previousRows, res.rows);
+    for (size_t i = 0; i < current.getNumberOfColumns(); ++i) {
+        const auto column = current.getColumn(i);
+        // Index columns always hold the row numbers
+        if (column->getColumnType() == ColumnType::Index) continue;
+        if (!sameValues(*previous.getColumn(i), *column, common)) {
+            res.changedColumns.push_back(i);
+        }
+    }
+    return res;
+}
+
+std::vector<std::pair<std::uint32_t, std::uint32_t>> toRanges(const BitSet& indices) {
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> res;
+    for (auto i : indices) {
+        if (!res.empty() && res.back().second == i) {
+            ++res.back().second;
+        } else {
+            res.emplace_back(i, i + 1);
+        }
+    }
+    return res;
+}
+
+std::string BrushingDelta::toJSON() const {
+    const nlohmann::json json = {
+        {"version", version},
+        {"base", base},
+        {"filtered", {{"added", filteredAdded}, {"removed", filteredRemoved}}},
+        {"selected", {{"added", selectedAdded}, {"removed", selectedRemoved}}}};
+    return json.dump();
+}
+
+BrushingDelta diffBrushing(const BitSet& previousFiltered, const BitSet& filtered,
+                           const BitSet& previousSelected, const BitSet& selected,
+                           std::uint64_t version, std::uint64_t base) {
+    const auto difference = [](const BitSet& lhs, const BitSet& rhs) {
+        BitSet res(lhs);
+        res -= rhs;
+        return toRanges(res);
+    };
+    BrushingDelta res;
+    res.version = version;
+    res.base = base;
+    res.filteredAdded = difference(filtered, previousFiltered);
+    res.filteredRemoved = difference(previousFiltered, filtered);
+    res.selectedAdded = difference(selected, previousSelected);
+    res.selectedRemoved = difference(previousSelected, selected);
+    return res;
+}
+
+}  // namespace util
+
+}  // namespace inviwo
@@ -0,0 +1,277 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/util/jobmetrics.h>
+#include <inviwo/core/common/inviwoapplication.h>
+#include <inviwo/core/processors/processor.h>
+#include <inviwo/core/util/exception.h>
+
+#include <algorithm>
+#include <fstream>
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <nlohmann/json.hpp>
+#include <warn/pop>
+
+namespace inviwo {
+
+namespace util {
+
+namespace {
+
+using json = nlohmann::json;
+
+double toSeconds(JobMetrics::Clock::rep ticks) {
+    return std::chrono::duration<double>(JobMetrics::Clock::duration(ticks)).count();
+}
+
+json phasesToJSON(const std::array<double, numberOfJobPhases>& seconds) {
+    json res = json::object();
+    for (size_t i = 0; i < numberOfJobPhases; ++i) {
+        res[std::string(enumToStr(static_cast<JobPhase>(i)))] = seconds[i];
+    }
+    return res;
+}
+
+}  // namespace
+
+std::string_view enumToStr(JobPhase phase) {
+    switch (phase) {
+        case JobPhase::QueueWait:
+            return "QueueWait";
+        case JobPhase::Gather:
+            return "Gather";
+        case JobPhase::Compute:
+            return "Compute";
+        case JobPhase::Threshold:
+            return "Threshold";
+        case JobPhase::Publish:
+            return "Publish";
+    }
+    throw Exception(fmt::format("Found invalid JobPhase enum value '{}'", static_cast<int>(phase)),
+                    IVW_CONTEXT_CUSTOM("enumName"));
+}
+
+JobMetrics::JobMetrics(std::string_view processorClass, std::string_view processor)
+    : processorClass_{processorClass}, processor_{processor}, dispatched_{Clock::now()} {}
+
+JobMetrics::JobMetrics(const Processor& processor)
+    : JobMetrics(processor.getClassIdentifier(), processor.getIdentifier()) {}
+
+JobMetrics::~JobMetrics() { record(true); }
+
+TraceSpan JobMetrics::start() {
+    const auto now = Clock::now();
+    const auto queueWait = now - dispatched_;
+    started_ = now.time_since_epoch().count();
+    add(JobPhase::QueueWait, queueWait);
+    if (!TraceRecorder::get().isEnabled()) return {};
+
+    const std::chrono::duration<double, std::milli> queueWaitMs = queueWait;
+    return TraceSpan{"Job", "job",
+                     TraceArgs{{"processor", processor_},
+                               {"class", processorClass_},
+                               {"queueWait_ms", fmt::format("{:.3f}", queueWaitMs.count())}}};
+}
+
+void JobMetrics::add(JobPhase phase, Clock::duration duration) {
+    durations_[static_cast<size_t>(phase)] += duration.count();
+}
+
+void JobMetrics::addVoxels(size_t voxels) { voxels_ += voxels; }
+
+void JobMetrics::addBytes(size_t bytes) { bytes_ += bytes; }
+
+void JobMetrics::finish() { record(false); }
+
+void JobMetrics::record(bool cancelled) {
+    if (recorded_.exchange(true)) return;
+    if (cancelled) TraceRecorder::get().instant("Cancelled", "job", {{"processor", processor_}});
+
+    JobRecord job;
+    job.processorClass = processorClass_;
+    job.processor = processor_;
+    job.finished = std::chrono::system_clock::now();
+    for (size_t i = 0; i < numberOfJobPhases; ++i) job.seconds[i] = toSeconds(durations_[i]);
+    // Jobs that never started spent all their time waiting
+    const auto started = started_.load();
+    const auto begin = started != 0 ? Clock::time_point(Clock::duration(started)) : dispatched_;
+    job.elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+    job.voxels = voxels_;
+    job.bytes = bytes_;
+    job.cancelled = cancelled;
+    MetricsRegistry::get().record(std::move(job));
+}
+
+PhaseTimer::PhaseTimer(JobMetrics* metrics, JobPhase phase)
+    : metrics_{metrics}
+    , phase_{phase}
+    , start_{metrics ? JobMetrics::Clock::now() : JobMetrics::Clock::time_point{}} {}
+
+PhaseTimer::~PhaseTimer() { stop(); }
+
+void PhaseTimer::stop() {
+    if (!metrics_) return;
+    const auto end = JobMetrics::Clock::now();
+    metrics_->add(phase_, end - start_);
+    TraceRecorder::get().complete(enumToStr(phase_), "phase", start_, end,
+                                  {{"processor", metrics_->getProcessor()}});
+    metrics_ = nullptr;
+}
+
+double ProcessorMetrics::voxelsPerSecond() const {
+    return elapsed > 0.0 ? static_cast<double>(voxels) / elapsed : 0.0;
+}
+
+MetricsRegistry& MetricsRegistry::get() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+void MetricsRegistry::record(JobRecord job) {
+    {
+        std::scoped_lock lock{mutex_};
+        jobs_.push_back(std::move(job));
+        while (jobs_.size() > capacity_) jobs_.pop_front();
+    }
+    notify();
+}
+
+std::vector<JobRecord> MetricsRegistry::getJobs() const {
+    std::scoped_lock lock{mutex_};
+    return {jobs_.begin(), jobs_.end()};
+}
+
+std::vector<ProcessorMetrics> MetricsRegistry::summarize() const {
+    std::scoped_lock lock{mutex_};
+    std::vector<ProcessorMetrics> res;
+    for (const auto& job : jobs_) {
+        auto it = std::find_if(res.begin(), res.end(), [&](const ProcessorMetrics& m) {
+            return m.processor == job.processor && m.processorClass == job.processorClass;
+        });
+        if (it == res.end()) {
+            it = res.insert(res.end(), ProcessorMetrics{job.processorClass, job.processor});
+        }
+        ++it->jobs;
+        if (job.cancelled) {
+            ++it->cancelled;
+            continue;
+        }
+        for (size_t i = 0; i < numberOfJobPhases; ++i) it->seconds[i] += job.seconds[i];
+        it->elapsed += job.elapsed;
+        it->maxElapsed = std::max(it->maxElapsed, job.elapsed);
+        it->voxels += job.voxels;
+        it->bytes += job.bytes;
+    }
+    return res;
+}
+
+void MetricsRegistry::clear() {
+    {
+        std::scoped_lock lock{mutex_};
+        jobs_.clear();
+    }
+    notify();
+}
+
+size_t MetricsRegistry::getCapacity() const {
+    std::scoped_lock lock{mutex_};
+    return capacity_;
+}
+
+void MetricsRegistry::setCapacity(size_t capacity) {
+    std::scoped_lock lock{mutex_};
+    capacity_ = std::max<size_t>(capacity, 1);
+    while (jobs_.size() > capacity_) jobs_.pop_front();
+}
+
+std::shared_ptr<std::function<void()>> MetricsRegistry::onRecord(std::function<void()> callback) {
+    return onRecord_.add(std::move(callback));
+}
+
+void MetricsRegistry::notify() {
+    // Jobs are recorded from pool threads, the callbacks are only ever touched on the main thread.
+    // Coalesce notifications that arrive before the main thread got to the previous one.
+    if (!InviwoApplication::isInitialized()) return;
+    if (notifyPending_.exchange(true)) return;
+    InviwoApplication::getPtr()->dispatchFront([this]() {
+        notifyPending_ = false;
+        onRecord_.invoke();
+    });
+}
+
+void MetricsRegistry::writeJSON(std::ostream& os) const {
+    json processors = json::array();
+    for (const auto& m : summarize()) {
+        const auto finished = static_cast<double>(std::max<size_t>(m.finished(), 1));
+        auto meanSeconds = m.seconds;
+        for (auto& s : meanSeconds) s /= finished;
+        processors.push_back({{"class", m.processorClass},
+                              {"identifier", m.processor},
+                              {"jobs", m.jobs},
+                              {"cancelled", m.cancelled},
+                              {"totalSeconds", phasesToJSON(m.seconds)},
+                              {"meanSeconds", phasesToJSON(meanSeconds)},
+                              {"meanElapsed", m.elapsed / finished},
+                              {"maxElapsed", m.maxElapsed},
+                              {"voxels", m.voxels},
+                              {"bytes", m.bytes},
+                              {"voxelsPerSecond", m.voxelsPerSecond()}});
+    }
+
+    json jobs = json::array();
+    for (const auto& job : getJobs()) {
+        jobs.push_back({{"class", job.processorClass},
+                        {"identifier", job.processor},
+                        {"finished", std::chrono::duration<double>(
+                                         job.finished.time_since_epoch())
+                                         .count()},
+                        {"seconds", phasesToJSON(job.seconds)},
+                        {"elapsed", job.elapsed},
+                        {"voxels", job.voxels},
+                        {"bytes", job.bytes},
+                        {"cancelled", job.cancelled}});
+    }
+
+    os << json{{"processors", processors}, {"jobs", jobs}}.dump(2) << '\n';
+}
+
+void MetricsRegistry::writeJSON(const std::filesystem::path& file) const {
+    std::ofstream out(file);
+    if (!out) {
+        throw Exception(fmt::format("Could not write {}", file),
+                        IVW_CONTEXT_CUSTOM("MetricsRegistry"));
+    }
+    writeJSON(out);
+}
+
+}  // namespace util
+
+}  // namespace inviwo
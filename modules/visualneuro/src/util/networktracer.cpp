@@ -0,0 +1,85 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/util/networktracer.h>
+#include <inviwo/core/network/processornetwork.h>
+#include <inviwo/core/processors/processor.h>
+
+#include <algorithm>
+
+namespace inviwo {
+
+namespace util {
+
+NetworkTracer::NetworkTracer(ProcessorNetwork& network) {
+    network.addObserver(this);
+    network.forEachProcessor([this](Processor* p) { p->ProcessorObservable::addObserver(this); });
+}
+
+void NetworkTracer::onProcessorNetworkDidAddProcessor(Processor* processor) {
+    processor->ProcessorObservable::addObserver(this);
+}
+
+void NetworkTracer::onProcessorNetworkWillRemoveProcessor(Processor* processor) {
+    processor->ProcessorObservable::removeObserver(this);
+    processing_.erase(processor);
+    backgroundJobs_.erase(processor);
+}
+
+void NetworkTracer::onProcessorAboutToProcess(Processor* processor) {
+    if (!TraceRecorder::get().isEnabled()) return;
+    processing_[processor] = TraceRecorder::Clock::now();
+}
+
+void NetworkTracer::onProcessorFinishedProcess(Processor* processor) {
+    auto it = processing_.find(processor);
+    if (it == processing_.end()) return;
+    TraceRecorder::get().complete(
+        processor->getIdentifier(), "process", it->second, TraceRecorder::Clock::now(),
+        {{"class", processor->getClassIdentifier()}});
+    processing_.erase(it);
+}
+
+void NetworkTracer::onProcessorStartBackgroundWork(Processor* processor, size_t jobs) {
+    auto& running = backgroundJobs_[processor];
+    running += jobs;
+    TraceRecorder::get().counter(processor->getIdentifier() + " jobs",
+                                 static_cast<double>(running));
+}
+
+void NetworkTracer::onProcessorFinishBackgroundWork(Processor* processor, size_t jobs) {
+    auto& running = backgroundJobs_[processor];
+    running -= std::min(running, jobs);
+    TraceRecorder::get().counter(processor->getIdentifier() + " jobs",
+                                 static_cast<double>(running));
+}
+
+}  // namespace util
+
+}  // namespace inviwo
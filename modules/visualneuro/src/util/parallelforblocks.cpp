@@ -0,0 +1,126 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/util/parallelforblocks.h>
+#include <inviwo/core/common/inviwoapplication.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+namespace inviwo {
+
+namespace util {
+
+namespace {
+
+using BlockCallback = std::function<void(size_t, size_t, size_t)>;
+
+struct BlockState {
+    BlockState(size_t count, size_t blockSize)
+        : count{count}, blockSize{blockSize}, nBlocks{(count + blockSize - 1) / blockSize} {}
+
+    const size_t count;
+    const size_t blockSize;
+    const size_t nBlocks;
+    std::atomic<size_t> next{0};
+    std::atomic<bool> cancelled{false};
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t done = 0;
+    std::exception_ptr error;
+};
+
+// Claim and run blocks until none are left. The callback is only dereferenced after a block has
+// been claimed, so a worker that starts after the caller returned exits without touching it.
+void runBlocks(BlockState& state, size_t worker, const BlockCallback* callback,
+               const BlockControl* control) {
+    for (size_t block = state.next++; block < state.nBlocks; block = state.next++) {
+        if (control && control->stopped()) state.cancelled = true;
+
+        if (!state.cancelled) {
+            try {
+                const auto first = block * state.blockSize;
+                (*callback)(worker, first, std::min(state.count, first + state.blockSize));
+            } catch (...) {
+                std::scoped_lock lock{state.mutex};
+                if (!state.error) state.error = std::current_exception();
+                state.cancelled = true;
+            }
+        }
+
+        size_t done = 0;
+        {
+            std::scoped_lock lock{state.mutex};
+            done = ++state.done;
+            if (done == state.nBlocks) state.finished.notify_all();
+        }
+        if (control && control->progress) control->progress(done, state.nBlocks);
+    }
+}
+
+}  // namespace
+
+size_t parallelForBlocksWorkers() {
+    if (!InviwoApplication::isInitialized()) return 1;
+    return InviwoApplication::getPtr()->getPoolSize() + 1;
+}
+
+bool parallelForBlocks(size_t count, size_t blockSize, const BlockCallback& callback,
+                       const BlockControl& control) {
+    if (count == 0) return !control.stopped();
+
+    auto state = std::make_shared<BlockState>(count, std::max<size_t>(blockSize, 1));
+
+    const auto helpers = std::min(parallelForBlocksWorkers() - 1, state->nBlocks - 1);
+    for (size_t i = 0; i < helpers; ++i) {
+        InviwoApplication::getPtr()->dispatchPool(
+            [state, worker = i + 1, cb = &callback]() { runBlocks(*state, worker, cb, nullptr); });
+    }
+
+    runBlocks(*state, 0, &callback, &control);
+
+    std::unique_lock lock{state->mutex};
+    while (state->done < state->nBlocks) {
+        state->finished.wait_for(lock, std::chrono::milliseconds(200));
+        if (control.stopped()) state->cancelled = true;
+    }
+    if (state->error) std::rethrow_exception(state->error);
+
+    return !state->cancelled;
+}
+
+}  // namespace util
+
+}  // namespace inviwo
@@ -0,0 +1,211 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/util/tracerecorder.h>
+#include <inviwo/core/util/exception.h>
+
+#include <algorithm>
+#include <fstream>
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <nlohmann/json.hpp>
+#include <warn/pop>
+
+namespace inviwo {
+
+namespace util {
+
+TraceRecorder& TraceRecorder::get() {
+    static TraceRecorder recorder;
+    return recorder;
+}
+
+TraceRecorder::TraceRecorder() : epoch_{Clock::now()} {}
+
+void TraceRecorder::setEnabled(bool enabled) { enabled_ = enabled; }
+
+void TraceRecorder::complete(std::string_view name, std::string_view category,
+                             Clock::time_point begin, Clock::time_point end, TraceArgs args) {
+    if (!isEnabled()) return;
+    TraceEvent event{std::string{name}, std::string{category}, 'X'};
+    event.timestamp = toMicroseconds(begin);
+    event.duration = std::max<std::int64_t>(toMicroseconds(end) - event.timestamp, 0);
+    event.args = std::move(args);
+    add(std::move(event));
+}
+
+void TraceRecorder::instant(std::string_view name, std::string_view category, TraceArgs args) {
+    if (!isEnabled()) return;
+    TraceEvent event{std::string{name}, std::string{category}, 'i'};
+    event.timestamp = toMicroseconds(Clock::now());
+    event.args = std::move(args);
+    add(std::move(event));
+}
+
+void TraceRecorder::counter(std::string_view name, double value) {
+    if (!isEnabled()) return;
+    TraceEvent event{std::string{name}, "counter", 'C'};
+    event.timestamp = toMicroseconds(Clock::now());
+    event.value = value;
+    add(std::move(event));
+}
+
+std::vector<TraceEvent> TraceRecorder::getEvents() const {
+    std::scoped_lock lock{mutex_};
+    return events_;
+}
+
+size_t TraceRecorder::getDropped() const {
+    std::scoped_lock lock{mutex_};
+    return dropped_;
+}
+
+size_t TraceRecorder::getCapacity() const {
+    std::scoped_lock lock{mutex_};
+    return capacity_;
+}
+
+void TraceRecorder::setCapacity(size_t capacity) {
+    std::scoped_lock lock{mutex_};
+    capacity_ = capacity;
+}
+
+void TraceRecorder::clear() {
+    std::scoped_lock lock{mutex_};
+    events_.clear();
+    dropped_ = 0;
+}
+
+void TraceRecorder::add(TraceEvent event) {
+    std::scoped_lock lock{mutex_};
+    if (events_.size() >= capacity_) {
+        ++dropped_;
+        return;
+    }
+    const auto nThreads = static_cast<std::uint32_t>(threads_.size());
+    event.thread = threads_.try_emplace(std::this_thread::get_id(), nThreads).first->second;
+    events_.push_back(std::move(event));
+}
+
+std::int64_t TraceRecorder::toMicroseconds(Clock::time_point time) const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(time - epoch_).count();
+}
+
+void TraceRecorder::writeJSON(std::ostream& os) const {
+    using json = nlohmann::json;
+    const auto events = getEvents();
+
+    json traceEvents = json::array();
+    std::uint32_t nThreads = 0;
+    for (const auto& e : events) {
+        json event = {{"name", e.name}, {"cat", e.category}, {"ph", std::string(1, e.phase)},
+                      {"ts", e.timestamp},  {"pid", 1},         {"tid", e.thread}};
+        if (e.phase == 'X') event["dur"] = e.duration;
+        // Thread scoped instant events
+        if (e.phase == 'i') event["s"] = "t";
+        if (e.phase == 'C') {
+            event["args"] = {{"value", e.value}};
+        } else if (!e.args.empty()) {
+            json args = json::object();
+            for (const auto& [key, value] : e.args) args[key] = value;
+            event["args"] = args;
+        }
+        nThreads = std::max(nThreads, e.thread + 1);
+        traceEvents.push_back(std::move(event));
+    }
+    // Threads are numbered in order of their first event, the first one is usually the main thread
+    for (std::uint32_t thread = 0; thread < nThreads; ++thread) {
+        traceEvents.push_back({{"name", "thread_name"},
+                               {"ph", "M"},
+                               {"pid", 1},
+                               {"tid", thread},
+                               {"args", {{"name", fmt::format("Thread {}", thread)}}}});
+    }
+    traceEvents.push_back({{"name", "process_name"},
+                           {"ph", "M"},
+                           {"pid", 1},
+                           {"args", {{"name", "VisualNeuro"}}}});
+
+    os << json{{"traceEvents", traceEvents},
+               {"displayTimeUnit", "ms"},
+               {"otherData", {{"droppedEvents", getDropped()}}}}
+              .dump()
+       << '\n';
+}
+
+void TraceRecorder::writeJSON(const std::filesystem::path& file) const {
+    std::ofstream out(file);
+    if (!out) {
+        throw Exception(fmt::format("Could not write {}", file),
+                        IVW_CONTEXT_CUSTOM("TraceRecorder"));
+    }
+    writeJSON(out);
+}
+
+TraceSpan::TraceSpan(std::string_view name, std::string_view category, TraceArgs args)
+    : active_{TraceRecorder::get().isEnabled()} {
+    if (!active_) return;
+    name_ = name;
+    category_ = category;
+    args_ = std::move(args);
+    begin_ = TraceRecorder::Clock::now();
+}
+
+TraceSpan::TraceSpan(TraceSpan&& rhs) noexcept
+    : active_{std::exchange(rhs.active_, false)}
+    , name_{std::move(rhs.name_)}
+    , category_{std::move(rhs.category_)}
+    , args_{std::move(rhs.args_)}
+    , begin_{rhs.begin_} {}
+
+TraceSpan& TraceSpan::operator=(TraceSpan&& rhs) noexcept {
+    if (this != &rhs) {
+        end();
+        active_ = std::exchange(rhs.active_, false);
+        name_ = std::move(rhs.name_);
+        category_ = std::move(rhs.category_);
+        args_ = std::move(rhs.args_);
+        begin_ = rhs.begin_;
+    }
+    return *this;
+}
+
+TraceSpan::~TraceSpan() { end(); }
+
+void TraceSpan::end() {
+    if (!active_) return;
+    active_ = false;
+    TraceRecorder::get().complete(name_, category_, begin_, TraceRecorder::Clock::now(),
+                                  std::move(args_));
+}
+
+}  // namespace util
+
+}  // namespace inviwo
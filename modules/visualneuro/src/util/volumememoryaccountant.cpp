@@ -0,0 +1,298 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/util/volumememoryaccountant.h>
+#include <modules/opengl/volume/volumegl.h>
+#include <inviwo/core/common/inviwoapplication.h>
+#include <inviwo/core/datastructures/volume/volumedisk.h>
+#include <inviwo/core/datastructures/volume/volumeram.h>
+#include <inviwo/core/ports/outport.h>
+#include <inviwo/core/processors/processor.h>
+#include <inviwo/core/util/exception.h>
+#include <inviwo/core/util/logcentral.h>
+#include <inviwo/core/util/rendercontext.h>
+
+#include <algorithm>
+
+namespace inviwo {
+
+namespace util {
+
+namespace {
+
+struct RepresentationBytes {
+    size_t ram = 0;
+    size_t gl = 0;
+    size_t evictableRam = 0;
+    size_t evictableGl = 0;
+};
+
+RepresentationBytes representationBytes(const Volume& volume, RepresentationSource source) {
+    const auto bytes = glm::compMul(volume.getDimensions()) * volume.getDataFormat()->getSize();
+    const bool fromDisk =
+        source == RepresentationSource::Disk && hasValidDiskRepresentation(volume);
+
+    RepresentationBytes res;
+    const bool hasRAM = volume.hasRepresentation<VolumeRAM>();
+    if (hasRAM) {
+        res.ram = bytes;
+        if (fromDisk) res.evictableRam = bytes;
+    }
+    if (volume.hasRepresentation<VolumeGL>()) {
+        res.gl = bytes;
+        if (hasRAM || fromDisk) res.evictableGl = bytes;
+    }
+    return res;
+}
+
+}  // namespace
+
+// An invalid disk representation can no longer rebuild the RAM representation. There are no
+// converters to VolumeDisk, so requesting an invalid disk representation throws instead of
+// creating a new one.
+bool hasValidDiskRepresentation(const Volume& volume) {
+    if (!volume.hasRepresentation<VolumeDisk>()) return false;
+    try {
+        return volume.getRepresentation<VolumeDisk>() != nullptr;
+    } catch (const Exception&) {
+        return false;
+    }
+}
+
+VolumeMemoryAccountant::Pin::Pin(std::vector<const Volume*> volumes)
+    : volumes_{std::move(volumes)} {}
+
+VolumeMemoryAccountant::Pin::Pin(Pin&& rhs) noexcept : volumes_{std::move(rhs.volumes_)} {
+    rhs.volumes_.clear();
+}
+
+VolumeMemoryAccountant::Pin& VolumeMemoryAccountant::Pin::operator=(Pin&& rhs) noexcept {
+    if (this != &rhs) {
+        release();
+        volumes_ = std::move(rhs.volumes_);
+        rhs.volumes_.clear();
+    }
+    return *this;
+}
+
+VolumeMemoryAccountant::Pin::~Pin() { release(); }
+
+void VolumeMemoryAccountant::Pin::release() {
+    if (volumes_.empty()) return;
+    VolumeMemoryAccountant::get().unpin(volumes_);
+    volumes_.clear();
+}
+
+VolumeMemoryAccountant& VolumeMemoryAccountant::get() {
+    static VolumeMemoryAccountant accountant;
+    return accountant;
+}
+
+void VolumeMemoryAccountant::track(const std::shared_ptr<const Volume>& volume,
+                                   std::string_view owner, RepresentationSource source) {
+    if (!volume) return;
+    {
+        std::scoped_lock lock{mutex_};
+        auto& entry = entries_[volume.get()];
+        // The address may belong to a volume that has been destroyed
+        if (entry.volume.expired()) {
+            entry = Entry{volume, std::string{owner}, source, 0};
+        }
+        entry.lastUse = ++clock_;
+    }
+    requestEnforce();
+}
+
+void VolumeMemoryAccountant::track(const VolumeSequence& volumes, std::string_view owner,
+                                   RepresentationSource source) {
+    {
+        std::scoped_lock lock{mutex_};
+        for (const auto& volume : volumes) {
+            if (!volume) continue;
+            auto& entry = entries_[volume.get()];
+            if (entry.volume.expired()) {
+                entry = Entry{volume, std::string{owner}, source, 0};
+            }
+            entry.lastUse = ++clock_;
+        }
+    }
+    requestEnforce();
+}
+
+void VolumeMemoryAccountant::touch(const Volume& volume) {
+    std::scoped_lock lock{mutex_};
+    if (auto it = entries_.find(&volume); it != entries_.end()) it->second.lastUse = ++clock_;
+}
+
+auto VolumeMemoryAccountant::pin(const VolumeSequence& volumes) -> Pin {
+    std::vector<const Volume*> pinned;
+    for (const auto& volume : volumes) pinned.push_back(volume.get());
+    return pin(std::move(pinned));
+}
+
+auto VolumeMemoryAccountant::pin(std::vector<const Volume*> volumes) -> Pin {
+    std::scoped_lock lock{mutex_};
+    for (auto volume : volumes) {
+        ++pins_[volume];
+        if (auto it = entries_.find(volume); it != entries_.end()) it->second.lastUse = ++clock_;
+    }
+    return Pin{std::move(volumes)};
+}
+
+void VolumeMemoryAccountant::unpin(const std::vector<const Volume*>& volumes) {
+    {
+        std::scoped_lock lock{mutex_};
+        for (auto volume : volumes) {
+            if (auto it = pins_.find(volume); it != pins_.end() && --it->second == 0) {
+                pins_.erase(it);
+            }
+        }
+    }
+    requestEnforce();
+}
+
+std::vector<OwnerMemoryUsage> VolumeMemoryAccountant::getUsage() const {
+    std::scoped_lock lock{mutex_};
+    std::vector<OwnerMemoryUsage> res;
+    for (const auto& [ptr, entry] : entries_) {
+        const auto volume = entry.volume.lock();
+        if (!volume) continue;
+        auto it = std::find_if(res.begin(), res.end(),
+                               [&](const OwnerMemoryUsage& u) { return u.owner == entry.owner; });
+        if (it == res.end()) it = res.insert(res.end(), OwnerMemoryUsage{entry.owner});
+
+        const auto bytes = representationBytes(*volume, entry.source);
+        ++it->volumes;
+        it->ramBytes += bytes.ram;
+        it->glBytes += bytes.gl;
+        if (pins_.count(ptr) == 0) it->evictableBytes += bytes.evictableRam + bytes.evictableGl;
+    }
+    std::sort(res.begin(), res.end(), [](const OwnerMemoryUsage& a, const OwnerMemoryUsage& b) {
+        return a.owner < b.owner;
+    });
+    return res;
+}
+
+size_t VolumeMemoryAccountant::getTotalBytes() const {
+    size_t total = 0;
+    for (const auto& usage : getUsage()) total += usage.ramBytes + usage.glBytes;
+    return total;
+}
+
+void VolumeMemoryAccountant::setBudget(size_t bytes) {
+    {
+        std::scoped_lock lock{mutex_};
+        budget_ = bytes;
+    }
+    requestEnforce();
+}
+
+size_t VolumeMemoryAccountant::getBudget() const {
+    std::scoped_lock lock{mutex_};
+    return budget_;
+}
+
+size_t VolumeMemoryAccountant::enforceBudget() {
+    std::scoped_lock lock{mutex_};
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        it = it->second.volume.expired() ? entries_.erase(it) : std::next(it);
+    }
+    if (budget_ == 0) return 0;
+
+    size_t total = 0;
+    std::vector<std::pair<std::uint64_t, const Volume*>> candidates;
+    for (const auto& [ptr, entry] : entries_) {
+        const auto bytes = representationBytes(*entry.volume.lock(), entry.source);
+        total += bytes.ram + bytes.gl;
+        if (pins_.count(ptr) == 0 && bytes.evictableRam + bytes.evictableGl > 0) {
+            candidates.emplace_back(entry.lastUse, ptr);
+        }
+    }
+    if (total <= budget_) return 0;
+
+    // Least recently used first. OpenGL representations go before RAM since they are rebuilt
+    // from it.
+    std::sort(candidates.begin(), candidates.end());
+    size_t freed = 0;
+    bool contextActive = false;
+    for (const auto& [lastUse, ptr] : candidates) {
+        if (total - freed <= budget_) break;
+        const auto& entry = entries_[ptr];
+        const auto volume = entry.volume.lock();
+        if (!volume) continue;
+        const auto bytes = representationBytes(*volume, entry.source);
+        // Representations are caches of the volume data, removing them does not change the
+        // volume as seen by its users.
+        auto& cache = const_cast<Volume&>(*volume);
+        if (bytes.evictableGl > 0) {
+            if (!contextActive) {
+                RenderContext::getPtr()->activateDefaultRenderContext();
+                contextActive = true;
+            }
+            cache.removeRepresentation(volume->getRepresentation<VolumeGL>());
+            freed += bytes.evictableGl;
+        }
+        if (bytes.evictableRam > 0 && total - freed > budget_) {
+            cache.removeRepresentation(volume->getRepresentation<VolumeRAM>());
+            freed += bytes.evictableRam;
+        }
+    }
+    if (freed > 0) {
+        LogInfoCustom("VolumeMemoryAccountant",
+                      fmt::format("Evicted {:.1f} MiB of volume representations to stay within "
+                                  "the budget of {:.1f} MiB",
+                                  static_cast<double>(freed) / (1 << 20),
+                                  static_cast<double>(budget_) / (1 << 20)));
+    }
+    return freed;
+}
+
+void VolumeMemoryAccountant::requestEnforce() {
+    if (!InviwoApplication::isInitialized()) return;
+    {
+        std::scoped_lock lock{mutex_};
+        if (budget_ == 0) return;
+    }
+    if (enforcePending_.exchange(true)) return;
+    InviwoApplication::getPtr()->dispatchFront([this]() {
+        enforcePending_ = false;
+        enforceBudget();
+    });
+}
+
+std::string VolumeMemoryAccountant::ownerName(const Outport& port) {
+    if (const auto processor = port.getProcessor()) {
+        return fmt::format("{}.{}", processor->getIdentifier(), port.getIdentifier());
+    }
+    return port.getIdentifier();
+}
+
+}  // namespace util
+
+}  // namespace inviwo
@@ -28,6 +28,7 @@
  *********************************************************************************/
 
 #include <modules/visualneuro/visualneuromodule.h>
+#include <modules/visualneuro/datastructures/volumesequenceselection.h>
 #include <modules/visualneuro/processors/brainmask.h>
 #include <modules/visualneuro/processors/brainraycaster.h>
 #include <modules/visualneuro/processors/dataframecolumnfilter.h>
@@ -40,14 +41,23 @@
 #include <modules/visualneuro/processors/volumeregionparametercorrelation.h>
 #include <modules/visualneuro/processors/volumesequencemean.h>
 #include <modules/visualneuro/processors/volumeatlascenterpositions.h>
+#include <modules/visualneuro/processors/volumeatlasregionaggregator.h>
+#include <modules/visualneuro/processors/volumeatlaszonalstatistics.h>
 #include <modules/visualneuro/processors/volumettest.h>
 #include <modules/visualneuro/processors/volumevariancemean.h>
 #include <modules/visualneuro/processors/volumeatlasprocessor.h>
 #include <modules/visualneuro/processors/parametervolumesequencecorrelation.h>
 #include <modules/visualneuro/processors/camerapositioncontroller.h>
 #include <modules/visualneuro/processors/fmritransferfunctioncontroller.h>
+#include <modules/visualneuro/processors/processingmetrics.h>
+#include <modules/visualneuro/processors/syncpatientdata.h>
 #include <modules/visualneuro/statistics/correlation.h>
 #include <modules/visualneuro/statistics/statisticstypes.h>
+#include <modules/visualneuro/util/columnarframestore.h>
+#include <modules/visualneuro/util/jobmetrics.h>
+#include <modules/visualneuro/util/tracerecorder.h>
+#include <modules/visualneuro/visualneurosettings.h>
+#include <inviwo/core/common/inviwoapplication.h>
 #include <modules/opengl/shader/shadermanager.h>
 
 #include <modules/json/jsonmodule.h>
@@ -62,7 +72,35 @@
 
 namespace inviwo {
 
-VisualNeuroModule::VisualNeuroModule(InviwoApplication* app) : InviwoModule(app, "VisualNeuro") {
+namespace {
+
+// Starts recording when --trace is parsed, command line callbacks run after the workspace is loaded
+class RecordTraceVisitor : public TCLAP::Visitor {
+public:
+    explicit RecordTraceVisitor(InviwoApplication* app) : app_{app} {}
+    virtual void visit() override {
+        if (auto settings = app_->getSettingsByType<VisualNeuroSettings>()) {
+            settings->recordTrace_.set(true);
+        }
+    }
+
+private:
+    InviwoApplication* app_;
+};
+
+}  // namespace
+
+VisualNeuroModule::VisualNeuroModule(InviwoApplication* app)
+    : InviwoModule(app, "VisualNeuro")
+    , metricsArg_("", "vn-metrics",
+                  "Write the processing metrics of the VisualNeuro processors as JSON to the "
+                  "given file on exit",
+                  false, "", "file")
+    , traceVisitor_{std::make_unique<RecordTraceVisitor>(app)}
+    , traceArg_("", "trace",
+                "Record process() calls, pool jobs and file reads and write them as a Chrome "
+                "trace to the given file on exit",
+                false, "", "file", traceVisitor_.get()) {
     visualneuro::addShaderResources(ShaderManager::getPtr(), {getPath(ModulePath::GLSL)});
 
     registerProcessor<BrainMask>();
@@ -82,7 +120,11 @@ VisualNeuroModule::VisualNeuroModule(InviwoApplication* app) : InviwoModule(app,
     registerProcessor<ParameterVolumeSequenceCorrelation>();
     registerProcessor<CameraPositionController>();
     registerProcessor<VolumeAtlasCenterPositions>();
+    registerProcessor<VolumeAtlasRegionAggregator>();
+    registerProcessor<VolumeAtlasZonalStatistics>();
     registerProcessor<fMRITransferFunctionController>();
+    registerProcessor<ProcessingMetrics>();
+    registerProcessor<SyncPatientData>();
     // Add a directory to the search path of the Shadermanager
     // ShaderManager::getPtr()->addShaderSearchPath(getPath(ModulePath::GLSL));
 
@@ -97,6 +139,8 @@ VisualNeuroModule::VisualNeuroModule(InviwoApplication* app) : InviwoModule(app,
     jsonModule->registerPropertyJSONConverter<OptionProperty<stats::StatisticsType>>();
     jsonModule->registerPropertyJSONConverter<OptionProperty<stats::TailTest>>();
     auto browserModule = app->getModuleByType<WebBrowserModule>();
+    // Serves the data frames of the DataFrameWebBrowserProcessor to the pages
+    util::registerColumnarFrameScheme();
     browserModule
         ->registerPropertyWidgetCEF<PropertyWidgetCEF, OptionProperty<stats::StatisticsType>>();
     browserModule->registerPropertyWidgetCEF<PropertyWidgetCEF, OptionProperty<stats::TailTest>>();
@@ -108,8 +152,8 @@ VisualNeuroModule::VisualNeuroModule(InviwoApplication* app) : InviwoModule(app,
     // registerRepresentationConverter(std::make_unique<VisualNeuroDisk2RAMConverter>());
 
     // Ports
-    // registerPort<VisualNeuroOutport>();
-    // registerPort<VisualNeuroInport>();
+    registerPort<DataOutport<VolumeSequenceSelection>>();
+    registerPort<DataInport<VolumeSequenceSelection>>();
 
     // PropertyWidgets
     // registerPropertyWidget<VisualNeuroPropertyWidget, VisualNeuroProperty>("Default");
@@ -119,11 +163,35 @@ VisualNeuroModule::VisualNeuroModule(InviwoApplication* app) : InviwoModule(app,
 
     // Other things
     // registerCapabilities(std::make_unique<VisualNeuroCapabilities>());
-    // registerSettings(std::make_unique<VisualNeuroSettings>());
+    registerSettings(std::make_unique<VisualNeuroSettings>(app));
     // registerMetaData(std::make_unique<VisualNeuroMetaData>());
     // registerPortInspector("VisualNeuroOutport", "path/workspace.inv");
     // registerProcessorWidget(std::string processorClassName, std::unique_ptr<ProcessorWidget> processorWidget); 
     // registerDrawer(util::make_unique_ptr<VisualNeuroDrawer>());
+
+    app->getCommandLineParser().add(&metricsArg_);
+    app->getCommandLineParser().add(&traceArg_);
+    networkTracer_ = std::make_unique<util::NetworkTracer>(*app->getProcessorNetwork());
+}
+
+VisualNeuroModule::~VisualNeuroModule() {
+    app_->getCommandLineParser().remove(&metricsArg_);
+    if (metricsArg_.isSet() && !metricsArg_.getValue().empty()) {
+        try {
+            util::MetricsRegistry::get().writeJSON(
+                std::filesystem::path{metricsArg_.getValue()});
+        } catch (const Exception& e) {
+            LogError(e.getMessage());
+        }
+    }
+    app_->getCommandLineParser().remove(&traceArg_);
+    if (traceArg_.isSet() && !traceArg_.getValue().empty()) {
+        try {
+            util::TraceRecorder::get().writeJSON(std::filesystem::path{traceArg_.getValue()});
+        } catch (const Exception& e) {
+            LogError(e.getMessage());
+        }
+    }
 }
 
 }  // namespace inviwo
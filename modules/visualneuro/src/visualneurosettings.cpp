@@ -0,0 +1,79 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <modules/visualneuro/visualneurosettings.h>
+#include <modules/visualneuro/util/jobmetrics.h>
+#include <modules/visualneuro/util/tracerecorder.h>
+#include <modules/visualneuro/util/volumememoryaccountant.h>
+#include <inviwo/core/util/logcentral.h>
+
+namespace inviwo {
+
+VisualNeuroSettings::VisualNeuroSettings(InviwoApplication* app)
+    : Settings("VisualNeuro Settings", app)
+    , volumeMemoryBudget_("volumeMemoryBudget", "Volume Memory Budget (MB)", 0, 0, 65536, 256)
+    , recordTrace_("recordTrace", "Record Trace", false)
+    , traceFile_("traceFile", "Trace File", "", "trace")
+    , saveTrace_("saveTrace", "Save Trace")
+    , metricsFile_("metricsFile", "Processing Metrics File", "", "metrics")
+    , saveMetrics_("saveMetrics", "Save Processing Metrics") {
+    volumeMemoryBudget_.onChange([this]() {
+        util::VolumeMemoryAccountant::get().setBudget(
+            static_cast<size_t>(volumeMemoryBudget_.get()) << 20);
+    });
+    addProperty(volumeMemoryBudget_);
+
+    recordTrace_.setSerializationMode(PropertySerializationMode::None);
+    recordTrace_.onChange([this]() { util::TraceRecorder::get().setEnabled(recordTrace_.get()); });
+    traceFile_.setAcceptMode(AcceptMode::Save);
+    traceFile_.addNameFilter(FileExtension("json", "Chrome Trace File"));
+    saveTrace_.onChange([this]() {
+        try {
+            util::TraceRecorder::get().writeJSON(traceFile_.get());
+        } catch (const Exception& e) {
+            LogError("Unable to save trace " << traceFile_.get() << " due to " << e.getMessage());
+        }
+    });
+    metricsFile_.setAcceptMode(AcceptMode::Save);
+    metricsFile_.addNameFilter(FileExtension("json", "JSON File"));
+    saveMetrics_.onChange([this]() {
+        try {
+            util::MetricsRegistry::get().writeJSON(metricsFile_.get());
+        } catch (const Exception& e) {
+            LogError("Unable to save processing metrics " << metricsFile_.get() << " due to "
+                                                          << e.getMessage());
+        }
+    });
+    addProperties(recordTrace_, traceFile_, saveTrace_, metricsFile_, saveMetrics_);
+    load();
+    util::VolumeMemoryAccountant::get().setBudget(static_cast<size_t>(volumeMemoryBudget_.get())
+                                                  << 20);
+}
+
+}  // namespace inviwo
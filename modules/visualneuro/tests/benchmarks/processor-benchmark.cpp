@@ -0,0 +1,372 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <benchmark/benchmark.h>
+#include <warn/pop>
+
+#include <modules/visualneuro/algorithm/dataframe/parametermatrix.h>
+#include <modules/visualneuro/algorithm/volume/atlasvolumemask.h>
+#include <modules/visualneuro/algorithm/volume/regioncorrelation.h>
+#include <modules/visualneuro/algorithm/volume/voxelstatistics.h>
+#include <modules/visualneuro/datastructures/atlasvoxelindex.h>
+
+#include <inviwo/core/common/coremodulesharedlibrary.h>
+#include <inviwo/core/common/inviwoapplication.h>
+#include <inviwo/core/datastructures/volume/volumeramprecision.h>
+#include <inviwo/core/util/consolelogger.h>
+#include <inviwo/core/util/indexmapper.h>
+#include <inviwo/core/util/logcentral.h>
+#include <inviwo/core/util/stringconversion.h>
+#include <inviwo/dataframe/datastructures/dataframe.h>
+
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+/*
+ * Benchmarks the computations of the VolumeSequenceMean, VolumeTTest,
+ * ParameterVolumeSequenceCorrelation, VolumeRegionParameterCorrelation and BrainMask processors on
+ * synthetic cohorts in MNI resolution. Runs headless, no OpenGL context is created.
+ *
+ * In addition to the Google Benchmark flags the cohorts are configured with
+ *   --vn_subjects=50,200      subject counts
+ *   --vn_types=uint8,float    voxel types, any of uint8, int16 and float
+ *   --vn_dims=91x109x91       volume dimensions
+ *   --vn_parameters=10        number of DataFrame columns
+ *   --vn_labels=116           number of atlas labels
+ */
+
+namespace inviwo {
+
+namespace {
+
+struct Config {
+    std::vector<size_t> subjects = {50, 200};
+    std::vector<std::string> types = {"uint8", "float"};
+    size3_t dims{91, 109, 91};
+    size_t parameters = 10;
+    int labels = 116;
+};
+
+struct Cohort {
+    VolumeSequence volumes;
+    std::shared_ptr<DataFrame> dataFrame;
+    std::shared_ptr<Volume> atlas;
+    // Atlas voxels in the grid of the volumes, as cached by VolumeRegionParameterCorrelation
+    std::shared_ptr<AtlasVoxelIndex> atlasIndex;
+};
+
+// Deterministic noise in [0, 1) that is cheap enough to fill hundreds of volumes
+double noise(size_t a, size_t b) {
+    std::uint64_t z = a * 0x9E3779B97F4A7C15ull + b + 0x632BE59BD9B4E5ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z = z ^ (z >> 31);
+    return static_cast<double>(z >> 11) * 0x1.0p-53;
+}
+
+// Subject age in [20, 80), the first parameter and the effect driving the synthetic volumes
+double age(size_t subject) { return 20.0 + 60.0 * noise(subject, 0xA6E); }
+
+// 2 mm voxels centered around the origin, as the MNI templates
+void setMNIGeometry(Volume& volume) {
+    const auto size = vec3(volume.getDimensions()) * 2.0f;
+    volume.setBasis(mat3(vec3(size.x, 0.f, 0.f), vec3(0.f, size.y, 0.f), vec3(0.f, 0.f, size.z)));
+    volume.setOffset(-0.5f * size);
+}
+
+bool insideBrain(const size3_t& pos, const size3_t& dims) {
+    const auto p = (dvec3(pos) + 0.5) / dvec3(dims) * 2.0 - 1.0;
+    return glm::dot(p, p) < 0.8;
+}
+
+template <typename T>
+std::shared_ptr<Volume> makeSubject(const size3_t& dims, size_t subject, dvec2 range) {
+    auto ram = std::make_shared<VolumeRAMPrecision<T>>(dims);
+    auto data = ram->getDataTyped();
+    const util::IndexMapper3D im(dims);
+    const auto effect = (age(subject) - 50.0) / 30.0;
+    util::parallelForBlocks(glm::compMul(dims), size_t{1} << 16,
+                            [&](size_t, size_t first, size_t last) {
+                                for (size_t i = first; i < last; ++i) {
+                                    const auto pos = im(i);
+                                    if (!insideBrain(pos, dims)) {
+                                        data[i] = T{0};
+                                        continue;
+                                    }
+                                    // Grey matter decreases with age in the front half
+                                    const auto trend = pos.y > dims.y / 2 ? -0.15 * effect : 0.0;
+                                    const auto v = 0.5 + trend + 0.3 * (noise(subject, i) - 0.5);
+                                    data[i] = static_cast<T>(range.x + v * (range.y - range.x));
+                                }
+                            });
+    auto volume = std::make_shared<Volume>(ram);
+    volume->dataMap.dataRange = range;
+    volume->dataMap.valueRange = dvec2(0.0, 1.0);
+    setMNIGeometry(*volume);
+    return volume;
+}
+
+std::shared_ptr<Volume> makeAtlas(const size3_t& dims, int labels) {
+    auto ram = std::make_shared<VolumeRAMPrecision<std::uint8_t>>(dims);
+    auto data = ram->getDataTyped();
+    const util::IndexMapper3D im(dims);
+    // Cells of 8x8x8 voxels inside the brain get labels 1..labels
+    const size3_t cells = (dims + size3_t(7)) / size3_t(8);
+    for (size_t i = 0; i < glm::compMul(dims); ++i) {
+        const auto pos = im(i);
+        if (!insideBrain(pos, dims)) {
+            data[i] = 0;
+            continue;
+        }
+        const auto cell = pos / size3_t(8);
+        const auto cellIndex = cell.x + cells.x * (cell.y + cells.y * cell.z);
+        data[i] = static_cast<std::uint8_t>(1 + cellIndex % static_cast<size_t>(labels));
+    }
+    auto atlas = std::make_shared<Volume>(ram);
+    atlas->dataMap.dataRange = dvec2(0.0, 255.0);
+    atlas->dataMap.valueRange = atlas->dataMap.dataRange;
+    setMNIGeometry(*atlas);
+    return atlas;
+}
+
+std::shared_ptr<DataFrame> makeDataFrame(size_t subjects, size_t parameters) {
+    auto dataFrame = std::make_shared<DataFrame>();
+    for (size_t p = 0; p < parameters; ++p) {
+        std::vector<float> values(subjects);
+        for (size_t s = 0; s < subjects; ++s) {
+            if (p == 0) {
+                values[s] = static_cast<float>(age(s));
+            } else if (p % 3 == 2 && noise(s, p) < 0.1) {
+                // Some parameters are missing for a few subjects
+                values[s] = std::numeric_limits<float>::quiet_NaN();
+            } else {
+                values[s] = static_cast<float>(100.0 * noise(s, p));
+            }
+        }
+        dataFrame->addColumn<float>(p == 0 ? "Age" : fmt::format("Parameter {}", p), values);
+    }
+    dataFrame->updateIndexBuffer();
+    return dataFrame;
+}
+
+Cohort makeCohort(const Config& config, const std::string& type, size_t subjects) {
+    Cohort cohort;
+    for (size_t s = 0; s < subjects; ++s) {
+        if (type == "uint8") {
+            cohort.volumes.push_back(makeSubject<std::uint8_t>(config.dims, s, dvec2(0, 255)));
+        } else if (type == "int16") {
+            cohort.volumes.push_back(makeSubject<std::int16_t>(config.dims, s, dvec2(0, 4095)));
+        } else {
+            cohort.volumes.push_back(makeSubject<float>(config.dims, s, dvec2(0, 1)));
+        }
+    }
+    cohort.dataFrame = makeDataFrame(subjects, config.parameters);
+    cohort.atlas = makeAtlas(config.dims, config.labels);
+    cohort.atlasIndex = std::make_shared<AtlasVoxelIndex>(
+        AtlasVoxelIndex::resampled(*cohort.atlas, *cohort.volumes.front()));
+    return cohort;
+}
+
+// Benchmarks run in registration order, keep only the cohort of the current benchmark group
+const Cohort& getCohort(const Config& config, const std::string& type, size_t subjects) {
+    static std::pair<std::string, size_t> key;
+    static Cohort cohort;
+    if (key != std::make_pair(type, subjects)) {
+        cohort = Cohort{};
+        cohort = makeCohort(config, type, subjects);
+        key = {type, subjects};
+    }
+    return cohort;
+}
+
+double peakResidentMiB() {
+#ifdef _WIN32
+    return std::numeric_limits<double>::quiet_NaN();
+#else
+    rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<double>(usage.ru_maxrss) / (1024.0 * 1024.0);  // bytes
+#else
+    return static_cast<double>(usage.ru_maxrss) / 1024.0;  // kilobytes
+#endif
+#endif
+}
+
+void setCounters(benchmark::State& state, const Cohort& cohort) {
+    const auto voxels = static_cast<double>(glm::compMul(cohort.volumes.front()->getDimensions()));
+    state.counters["voxels/s"] =
+        benchmark::Counter(voxels, benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["subject_voxels/s"] = benchmark::Counter(
+        voxels * cohort.volumes.size(), benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["peak_rss_MiB"] = peakResidentMiB();
+}
+
+// Parameters as extracted by the correlation processors, one subject per row
+dataframe::ParameterMatrix parameterMatrix(const DataFrame& dataFrame) {
+    std::vector<size_t> columns;
+    for (size_t i = 0; i < dataFrame.getNumberOfColumns(); ++i) {
+        if (dataFrame.getColumn(i) != dataFrame.getIndexColumn()) columns.push_back(i);
+    }
+    std::vector<std::uint32_t> rows(dataFrame.getNumberOfRows());
+    for (std::uint32_t row = 0; row < rows.size(); ++row) rows[row] = row;
+    return dataframe::ParameterMatrix(dataFrame, columns, rows);
+}
+
+void registerBenchmarks(const Config& config) {
+    using Computation = std::function<void(const Cohort&)>;
+    const std::vector<std::pair<std::string, Computation>> computations = {
+        {"VolumeSequenceMean",
+         [](const Cohort& c) { benchmark::DoNotOptimize(stats::volumeSequenceMean(c.volumes)); }},
+        {"VolumeTTest",
+         [](const Cohort& c) {
+             const auto half = c.volumes.begin() + c.volumes.size() / 2;
+             const VolumeSequence groupA(c.volumes.begin(), half);
+             const VolumeSequence groupB(half, c.volumes.end());
+             benchmark::DoNotOptimize(stats::volumeTTest(groupA, groupB, {}));
+         }},
+        {"ParameterVolumeSequenceCorrelation",
+         [](const Cohort& c) {
+             benchmark::DoNotOptimize(stats::parameterVolumeCorrelation(
+                 c.volumes, parameterMatrix(*c.dataFrame), 0, {}));
+         }},
+        {"VolumeRegionParameterCorrelation",
+         [](const Cohort& c) {
+             // Every eighth region selected
+             const auto regionMask = stats::atlasRegionsToGrid(
+                 *c.atlas, *c.volumes.front(), [](int label) { return label % 8 == 1; });
+             const stats::VolumeSequenceVoxelSource source(c.volumes);
+             benchmark::DoNotOptimize(stats::regionParameterCorrelations(
+                 source, parameterMatrix(*c.dataFrame), regionMask, {}));
+         }},
+        {"VolumeRegionParameterCorrelationIndexed",
+         [](const Cohort& c) {
+             const auto regionVoxels =
+                 c.atlasIndex->selectVoxels([](int label) { return label % 8 == 1; });
+             const stats::VolumeSequenceVoxelSource source(c.volumes);
+             benchmark::DoNotOptimize(stats::regionParameterCorrelations(
+                 source, parameterMatrix(*c.dataFrame), regionVoxels, {}));
+         }},
+        {"BrainMask",
+         [](const Cohort& c) { benchmark::DoNotOptimize(brainMask(c.volumes)); }},
+    };
+
+    for (const auto& type : config.types) {
+        for (auto subjects : config.subjects) {
+            for (const auto& [name, computation] : computations) {
+                benchmark::RegisterBenchmark(
+                    fmt::format("{}/{}/{}", name, type, subjects).c_str(),
+                    [config, type, subjects, computation](benchmark::State& state) {
+                        const auto& cohort = getCohort(config, type, subjects);
+                        for (auto _ : state) computation(cohort);
+                        setCounters(state, cohort);
+                    })
+                    ->Unit(benchmark::kMillisecond)
+                    ->UseRealTime()
+                    ->MeasureProcessCPUTime();
+            }
+        }
+    }
+}
+
+// Remove the --vn_ arguments from argv and apply them to config
+Config parseConfig(int& argc, char** argv) {
+    Config config;
+    int out = 1;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg{argv[i]};
+        auto value = [&](std::string_view flag) -> std::optional<std::string> {
+            if (arg.substr(0, flag.size()) != flag) return std::nullopt;
+            return std::string{arg.substr(flag.size())};
+        };
+        if (auto v = value("--vn_subjects=")) {
+            config.subjects.clear();
+            for (const auto& s : util::splitString(*v, ',')) {
+                config.subjects.push_back(std::stoul(s));
+            }
+        } else if (auto v = value("--vn_types=")) {
+            config.types = util::splitString(*v, ',');
+        } else if (auto v = value("--vn_dims=")) {
+            const auto d = util::splitString(*v, 'x');
+            if (d.size() != 3) throw std::invalid_argument("--vn_dims expects XxYxZ");
+            config.dims = size3_t(std::stoul(d[0]), std::stoul(d[1]), std::stoul(d[2]));
+        } else if (auto v = value("--vn_parameters=")) {
+            config.parameters = std::max<size_t>(std::stoul(*v), 1);
+        } else if (auto v = value("--vn_labels=")) {
+            config.labels = std::clamp(std::stoi(*v), 1, 255);
+        } else {
+            argv[out++] = argv[i];
+        }
+    }
+    argc = out;
+    return config;
+}
+
+}  // namespace
+
+}  // namespace inviwo
+
+int main(int argc, char** argv) {
+    using namespace inviwo;
+
+    LogCentral logCentral;
+    LogCentral::init(&logCentral);
+    logCentral.registerLogger(std::make_shared<ConsoleLogger>());
+
+    InviwoApplication app(argc, argv, "VisualNeuro Processor Benchmark");
+    {
+        std::vector<std::unique_ptr<InviwoModuleFactoryObject>> modules;
+        modules.emplace_back(createInviwoCore());
+        app.registerModules(std::move(modules));
+    }
+    // The calling thread takes part in the computations
+    app.resizePool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+
+    Config config;
+    try {
+        config = parseConfig(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "Invalid argument: " << e.what() << std::endl;
+        return 1;
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    registerBenchmarks(config);
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
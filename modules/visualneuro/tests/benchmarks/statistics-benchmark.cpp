@@ -0,0 +1,186 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <benchmark/benchmark.h>
+#include <warn/pop>
+
+#include <modules/visualneuro/statistics/correlation.h>
+#include <modules/visualneuro/statistics/pearsoncorrelation.h>
+#include <modules/visualneuro/statistics/spearmancorrelation.h>
+#include <modules/visualneuro/statistics/ttest.h>
+
+#include <random>
+#include <vector>
+
+namespace inviwo {
+
+namespace {
+
+// Cohort sizes from small studies to large population cohorts
+const std::vector<int64_t> subjects = {20, 50, 100, 500, 1000, 5000};
+// Percentage of values that are repeated, e.g. scores on a coarse scale
+const std::vector<int64_t> tiePercentages = {0, 50, 90};
+
+/*
+ * Normally distributed values where approximately tiePercent of the values are ties.
+ */
+std::vector<double> makeSample(size_t n, int64_t tiePercent, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::normal_distribution<double> dist(50.0, 10.0);
+    std::vector<double> values(n);
+    if (tiePercent == 0) {
+        std::generate(values.begin(), values.end(), [&]() { return dist(gen); });
+        return values;
+    }
+    const auto distinct = std::max<size_t>(1, n * (100 - tiePercent) / 100);
+    std::vector<double> levels(distinct);
+    std::generate(levels.begin(), levels.end(), [&]() { return dist(gen); });
+    std::uniform_int_distribution<size_t> pick(0, distinct - 1);
+    std::generate(values.begin(), values.end(), [&]() { return levels[pick(gen)]; });
+    return values;
+}
+
+void setCounters(benchmark::State& state, size_t n) {
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * n));
+    state.SetComplexityN(static_cast<int64_t>(n));
+}
+
+}  // namespace
+
+static void BM_pearsonCorrelation(benchmark::State& state) {
+    const auto n = static_cast<size_t>(state.range(0));
+    const auto a = makeSample(n, 0, 1);
+    const auto b = makeSample(n, 0, 2);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(pearsonCorrelation(a, b));
+    }
+    setCounters(state, n);
+}
+BENCHMARK(BM_pearsonCorrelation)->ArgsProduct({subjects})->Complexity();
+
+static void BM_spearmanCorrelation(benchmark::State& state) {
+    const auto n = static_cast<size_t>(state.range(0));
+    const auto a = makeSample(n, state.range(1), 1);
+    const auto b = makeSample(n, state.range(1), 2);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(stats::spearmanCorrelation(a, b));
+    }
+    setCounters(state, n);
+}
+BENCHMARK(BM_spearmanCorrelation)
+    ->ArgsProduct({subjects, tiePercentages})
+    ->ArgNames({"n", "ties%"})
+    ->Complexity();
+
+static void BM_rank(benchmark::State& state) {
+    const auto n = static_cast<size_t>(state.range(0));
+    const auto a = makeSample(n, state.range(1), 1);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(stats::rank(a.begin(), a.end()));
+    }
+    setCounters(state, n);
+}
+BENCHMARK(BM_rank)
+    ->ArgsProduct({subjects, tiePercentages})
+    ->ArgNames({"n", "ties%"})
+    ->Complexity();
+
+static void BM_tTest(benchmark::State& state) {
+    // Two groups of n / 2 subjects each
+    const auto n = static_cast<size_t>(state.range(0));
+    const auto a = makeSample(n / 2, 0, 1);
+    const auto b = makeSample(n - n / 2, 0, 2);
+    const auto equalVariance =
+        state.range(1) != 0 ? stats::EqualVariance::Yes : stats::EqualVariance::No;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(stats::tTest(a, b, equalVariance, stats::TailTest::Both));
+    }
+    setCounters(state, n);
+}
+BENCHMARK(BM_tTest)
+    ->ArgsProduct({subjects, {0, 1}})
+    ->ArgNames({"n", "equalVariance"})
+    ->Complexity();
+
+static void BM_fTest(benchmark::State& state) {
+    const auto n = static_cast<size_t>(state.range(0));
+    const auto a = makeSample(n / 2, 0, 1);
+    const auto b = makeSample(n - n / 2, 0, 2);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(stats::fTest(a, b));
+    }
+    setCounters(state, n);
+}
+BENCHMARK(BM_fTest)->ArgsProduct({subjects})->Complexity();
+
+static void BM_incbeta(benchmark::State& state) {
+    // Arguments as used by student_t_cdf for n - 2 degrees of freedom, over the whole x range
+    const auto df = static_cast<double>(state.range(0) - 2);
+    std::vector<double> xs(256);
+    for (size_t i = 0; i < xs.size(); ++i) xs[i] = (i + 0.5) / xs.size();
+    for (auto _ : state) {
+        for (auto x : xs) benchmark::DoNotOptimize(stats::incbeta(df / 2.0, df / 2.0, x));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * xs.size()));
+}
+BENCHMARK(BM_incbeta)->ArgsProduct({subjects})->ArgNames({"n"});
+
+static void BM_student_t_cdf(benchmark::State& state) {
+    const auto df = static_cast<double>(state.range(0) - 2);
+    std::vector<double> ts(256);
+    for (size_t i = 0; i < ts.size(); ++i) ts[i] = -8.0 + 16.0 * i / ts.size();
+    for (auto _ : state) {
+        for (auto t : ts) benchmark::DoNotOptimize(stats::student_t_cdf(t, df));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * ts.size()));
+}
+BENCHMARK(BM_student_t_cdf)->ArgsProduct({subjects})->ArgNames({"n"});
+
+static void BM_corrTest(benchmark::State& state) {
+    const auto n = static_cast<size_t>(state.range(0));
+    const auto method = state.range(1) == 0 ? stats::CorrelationMethod::Spearman
+                                            : stats::CorrelationMethod::Pearson;
+    const auto a = makeSample(n, state.range(2), 1);
+    const auto b = makeSample(n, state.range(2), 2);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(stats::corrTest(a, b, method, stats::TailTest::Both));
+    }
+    setCounters(state, n);
+}
+// method 0 is Spearman, 1 is Pearson
+BENCHMARK(BM_corrTest)
+    ->ArgsProduct({subjects, {0, 1}, tiePercentages})
+    ->ArgNames({"n", "method", "ties%"})
+    ->Complexity();
+
+}  // namespace inviwo
+
+BENCHMARK_MAIN();
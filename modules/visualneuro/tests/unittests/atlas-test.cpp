@@ -0,0 +1,534 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <gtest/gtest.h>
+#include <warn/pop>
+
+#include <modules/visualneuro/algorithm/dataframe/parametermatrix.h>
+#include <modules/visualneuro/algorithm/volume/atlaslabelstatistics.h>
+#include <modules/visualneuro/algorithm/volume/regionaggregation.h>
+#include <modules/visualneuro/algorithm/volume/regioncorrelation.h>
+#include <modules/visualneuro/datastructures/atlasindexfile.h>
+#include <modules/visualneuro/datastructures/atlasvoxelindex.h>
+#include <modules/visualneuro/datastructures/labelcolorlut.h>
+#include <modules/visualneuro/datastructures/volumeatlas.h>
+#include <modules/visualneuro/statistics/correlation.h>
+#include <inviwo/core/datastructures/image/layerramprecision.h>
+#include <inviwo/core/datastructures/volume/volumeramprecision.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <random>
+
+namespace inviwo {
+
+namespace {
+
+// 4x4x4 atlas with label 1 for x < 2, label 3 for x >= 2 and label 7 at voxel (3, 3, 3)
+std::shared_ptr<Volume> makeAtlas() {
+    const size3_t dims{4};
+    auto ram = std::make_shared<VolumeRAMPrecision<uint8_t>>(dims);
+    auto data = ram->getDataTyped();
+    for (size_t z = 0; z < dims.z; ++z) {
+        for (size_t y = 0; y < dims.y; ++y) {
+            for (size_t x = 0; x < dims.x; ++x) {
+                data[x + dims.x * (y + dims.y * z)] = x < 2 ? 1 : 3;
+            }
+        }
+    }
+    data[63] = 7;
+    return std::make_shared<Volume>(ram);
+}
+
+}  // namespace
+
+TEST(AtlasLabelStatistics, CountsBoundsAndCenters) {
+    const auto atlas = makeAtlas();
+    const auto statistics = stats::computeLabelStatistics(*atlas);
+    ASSERT_TRUE(statistics.has_value());
+
+    EXPECT_EQ((std::vector<int>{1, 3, 7}), statistics->getLabels());
+    EXPECT_EQ(nullptr, statistics->find(2));
+    EXPECT_EQ(nullptr, statistics->find(0));
+    EXPECT_EQ(nullptr, statistics->find(8));
+
+    const auto left = statistics->find(1);
+    ASSERT_NE(nullptr, left);
+    EXPECT_EQ(size_t{32}, left->voxels);
+    EXPECT_EQ(size3_t(0, 0, 0), left->lower);
+    EXPECT_EQ(size3_t(1, 3, 3), left->upper);
+    EXPECT_EQ(dvec3(0.5, 1.5, 1.5), left->centroid);
+    // Eight voxels are equally close to the centroid, the one with the lowest index is used
+    EXPECT_EQ(size3_t(0, 1, 1), left->center);
+
+    const auto right = statistics->find(3);
+    ASSERT_NE(nullptr, right);
+    EXPECT_EQ(size_t{31}, right->voxels);
+
+    const auto dot = statistics->find(7);
+    ASSERT_NE(nullptr, dot);
+    EXPECT_EQ(size_t{1}, dot->voxels);
+    EXPECT_EQ(size3_t(3, 3, 3), dot->center);
+}
+
+TEST(AtlasLabelStatistics, StopReturnsNothing) {
+    const auto atlas = makeAtlas();
+    util::BlockControl control;
+    control.stop = []() { return true; };
+    EXPECT_FALSE(stats::computeLabelStatistics(*atlas, control).has_value());
+}
+
+TEST(VolumeAtlas, LabelLookups) {
+    auto labels = std::make_shared<DataFrame>();
+    labels->addColumn<int>("Index", std::vector<int>{1, 3, 7, 9});
+    labels->addCategoricalColumn("Region", std::vector<std::string>{"Left", "Right", "Dot", "Dot"});
+    labels->updateIndexBuffer();
+
+    const VolumeAtlas atlas(makeAtlas(), labels);
+    EXPECT_EQ(3, atlas.getLabelId(std::string{"Right"}));
+    // The first label with a name is returned
+    EXPECT_EQ(7, atlas.getLabelId(std::string{"Dot"}));
+    EXPECT_EQ(-1, atlas.getLabelId(std::string{"Missing"}));
+    EXPECT_EQ("Left", atlas.getLabelName(1));
+    EXPECT_EQ("", atlas.getLabelName(2));
+    EXPECT_FALSE(atlas.getLabel(5).has_value());
+
+    EXPECT_EQ(size_t{31}, atlas.getVoxelCount(3));
+    EXPECT_EQ(size_t{0}, atlas.getVoxelCount(9));
+    EXPECT_FLOAT_EQ(1.0f / 64.0f, atlas.getCoverage(7));
+
+    std::vector<int> ids;
+    for (const auto& label : atlas) ids.push_back(label.first);
+    EXPECT_EQ((std::vector<int>{1, 3, 7, 9}), ids);
+}
+
+TEST(AtlasVoxelIndex, VoxelsOfLabels) {
+    const auto atlas = makeAtlas();
+    const AtlasVoxelIndex index(*atlas);
+    EXPECT_EQ((std::vector<int>{1, 3, 7}), index.getLabels());
+    EXPECT_EQ(size_t{32}, index.getNumberOfVoxels(1));
+    EXPECT_EQ(size_t{31}, index.getNumberOfVoxels(3));
+    EXPECT_EQ(size_t{0}, index.getNumberOfVoxels(2));
+    EXPECT_TRUE(index.getVoxels(100).empty());
+
+    const auto dot = index.getVoxels(7);
+    ASSERT_EQ(size_t{1}, dot.size());
+    EXPECT_EQ(std::uint32_t{63}, *dot.begin());
+
+    const auto left = index.getVoxels(1);
+    EXPECT_TRUE(std::is_sorted(left.begin(), left.end()));
+    for (auto voxel : left) EXPECT_LT(voxel % 4, std::uint32_t{2});
+
+    size_t visited = 0;
+    index.forEachVoxel({7, 1}, [&](int label, size_t voxel) {
+        EXPECT_TRUE(label == 1 || label == 7);
+        EXPECT_LT(voxel, size_t{64});
+        ++visited;
+    });
+    EXPECT_EQ(size_t{33}, visited);
+
+    const auto selected = index.selectVoxels([](int label) { return label != 1; });
+    EXPECT_EQ(size_t{32}, selected.size());
+    EXPECT_TRUE(std::is_sorted(selected.begin(), selected.end()));
+    EXPECT_EQ(std::uint32_t{63}, selected.back());
+
+    // Resampling to the grid of the atlas itself gives the same index
+    const auto resampled = AtlasVoxelIndex::resampled(*atlas, *atlas);
+    EXPECT_EQ(index.getLabels(), resampled.getLabels());
+    EXPECT_TRUE(std::equal(left.begin(), left.end(), resampled.getVoxels(1).begin()));
+}
+
+TEST(AtlasVoxelIndex, IndexFromParts) {
+    const AtlasVoxelIndex index(*makeAtlas());
+    const auto& offsets = index.getOffsets();
+    auto voxels = std::make_shared<std::vector<std::uint32_t>>(
+        index.getVoxelData(), index.getVoxelData() + offsets.back());
+    const std::shared_ptr<const std::uint32_t> data(voxels, voxels->data());
+    const AtlasVoxelIndex parts(size3_t{4}, index.getLabels(), offsets, data);
+    EXPECT_EQ(index.getLabels(), parts.getLabels());
+    EXPECT_EQ(size_t{31}, parts.getNumberOfVoxels(3));
+    const auto dot = parts.getVoxels(7);
+    ASSERT_EQ(size_t{1}, dot.size());
+    EXPECT_EQ(std::uint32_t{63}, *dot.begin());
+
+    // Labels must be ascending
+    EXPECT_THROW(AtlasVoxelIndex(size3_t{4}, {3, 1}, {0, 1, 2}, data), Exception);
+}
+
+TEST(AtlasIndexFile, RoundTrip) {
+    const auto atlas = makeAtlas();
+    const auto statistics = stats::computeLabelStatistics(*atlas);
+    ASSERT_TRUE(statistics.has_value());
+    const PrecomputedAtlas precomputed{*statistics, AtlasVoxelIndex(*atlas)};
+
+    const auto file = std::filesystem::temp_directory_path() / "visualneuro-atlas-test.vnidx";
+    util::writeAtlasIndexFile(file, 42, precomputed);
+    {
+        const auto read = util::readAtlasIndexFile(file, 42);
+        ASSERT_TRUE(read.has_value());
+        EXPECT_EQ(size3_t{4}, read->statistics.getDimensions());
+        EXPECT_EQ((std::vector<int>{1, 3, 7}), read->statistics.getLabels());
+        const auto left = read->statistics.find(1);
+        ASSERT_NE(nullptr, left);
+        EXPECT_EQ(size_t{32}, left->voxels);
+        EXPECT_EQ(size3_t(1, 3, 3), left->upper);
+        EXPECT_EQ(dvec3(0.5, 1.5, 1.5), left->centroid);
+        EXPECT_EQ(size3_t(0, 1, 1), left->center);
+
+        EXPECT_EQ(precomputed.voxelIndex.getLabels(), read->voxelIndex.getLabels());
+        EXPECT_EQ(precomputed.voxelIndex.getOffsets(), read->voxelIndex.getOffsets());
+        const auto expected = precomputed.voxelIndex.getVoxels(3);
+        const auto voxels = read->voxelIndex.getVoxels(3);
+        EXPECT_TRUE(std::equal(expected.begin(), expected.end(), voxels.begin(), voxels.end()));
+
+        // Index files of another version of the atlas file are ignored
+        EXPECT_FALSE(util::readAtlasIndexFile(file, 43).has_value());
+    }
+    {
+        // The last voxel of the index is outside the 4x4x4 volume
+        std::fstream out(file, std::ios::binary | std::ios::in | std::ios::out);
+        out.seekp(-static_cast<std::streamoff>(sizeof(std::uint32_t)), std::ios::end);
+        const std::uint32_t voxel = 64;
+        out.write(reinterpret_cast<const char*>(&voxel), sizeof(voxel));
+    }
+    EXPECT_FALSE(util::readAtlasIndexFile(file, 42).has_value());
+    std::filesystem::remove(file);
+    EXPECT_FALSE(util::readAtlasIndexFile(file, 42).has_value());
+}
+
+TEST(RegionCorrelation, IndexedVoxelsMatchRegionMask) {
+    const auto atlas = makeAtlas();
+    VolumeSequence volumes;
+    for (size_t subject = 0; subject < 6; ++subject) {
+        auto ram = std::make_shared<VolumeRAMPrecision<float>>(atlas->getDimensions());
+        auto data = ram->getDataTyped();
+        for (size_t i = 0; i < 64; ++i) {
+            data[i] = static_cast<float>(subject * (i % 5) + (i * 7 + subject * 3) % 11);
+        }
+        volumes.push_back(std::make_shared<Volume>(ram));
+    }
+    const std::vector<std::vector<double>> parameters{{0, 1, 2, 3, 4, 5}, {5, 3, 4, 1, 2, 0}};
+    stats::CorrelationSettings settings;
+    settings.method = stats::CorrelationMethod::Pearson;
+    settings.pValue = 1.0;
+
+    const auto isSelected = [](int label) { return label == 1 || label == 7; };
+    const stats::VolumeSequenceVoxelSource source(volumes);
+    const auto fromMask = stats::regionParameterCorrelations(
+        source, parameters, stats::atlasRegionsToGrid(*atlas, *atlas, isSelected), settings);
+    const auto fromIndex = stats::regionParameterCorrelations(
+        source, parameters, AtlasVoxelIndex(*atlas).selectVoxels(isSelected), settings);
+    ASSERT_TRUE(fromMask.has_value());
+    ASSERT_TRUE(fromIndex.has_value());
+    EXPECT_FALSE((*fromIndex)[0].empty());
+    EXPECT_EQ(*fromMask, *fromIndex);
+
+    const std::vector<std::vector<double>> noParameters;
+    const auto noneFromMask = stats::regionParameterCorrelations(
+        source, noParameters, stats::atlasRegionsToGrid(*atlas, *atlas, isSelected), settings);
+    const auto noneFromIndex = stats::regionParameterCorrelations(
+        source, noParameters, AtlasVoxelIndex(*atlas).selectVoxels(isSelected), settings);
+    ASSERT_TRUE(noneFromMask.has_value());
+    ASSERT_TRUE(noneFromIndex.has_value());
+    EXPECT_TRUE(noneFromMask->empty());
+    EXPECT_TRUE(noneFromIndex->empty());
+}
+
+TEST(RegionCorrelation, GroupedParametersMatchCorrTest) {
+    const auto nan = std::numeric_limits<double>::quiet_NaN();
+    const auto voxelValue = [](size_t subject, size_t i) {
+        return static_cast<float>(subject * (i % 5) + (i * 7 + subject * 3) % 11);
+    };
+    VolumeSequence volumes;
+    for (size_t subject = 0; subject < 7; ++subject) {
+        auto ram = std::make_shared<VolumeRAMPrecision<float>>(size3_t{4});
+        auto data = ram->getDataTyped();
+        for (size_t i = 0; i < 64; ++i) data[i] = voxelValue(subject, i);
+        volumes.push_back(std::make_shared<Volume>(ram));
+    }
+    // Parameters 0 and 2 miss the same subjects and share a group
+    const std::vector<std::vector<double>> parameters{{0, 1, nan, 3, 4, 5, 2},
+                                                      {5, 3, 4, 1, 2, 0, 6},
+                                                      {2, 2, nan, 1, 6, 0, 3},
+                                                      {nan, nan, nan, nan, nan, 1, 2}};
+    EXPECT_EQ((std::vector<std::vector<size_t>>{{0, 2}, {1}, {3}}),
+              dataframe::ParameterMatrix(parameters).groupByValidity());
+
+    const stats::VolumeSequenceVoxelSource source(volumes);
+    for (auto method : {stats::CorrelationMethod::Pearson, stats::CorrelationMethod::Spearman}) {
+        stats::CorrelationSettings settings;
+        settings.method = method;
+        settings.pValue = 0.9;
+        const auto res = stats::regionParameterCorrelations(
+            source, parameters, std::vector<unsigned char>(64, 1), settings);
+        ASSERT_TRUE(res.has_value());
+        ASSERT_EQ(parameters.size(), res->size());
+        EXPECT_TRUE(res->back().empty());
+
+        for (size_t param = 0; param < parameters.size(); ++param) {
+            std::vector<double> expected;
+            for (size_t i = 0; i < 64; ++i) {
+                std::vector<double> a;
+                std::vector<double> b;
+                for (size_t subject = 0; subject < volumes.size(); ++subject) {
+                    if (std::isnan(parameters[param][subject])) continue;
+                    a.push_back(parameters[param][subject]);
+                    b.push_back(voxelValue(subject, i));
+                }
+                if (a.size() < 3) continue;
+                const auto [r, p] = stats::corrTest(a, b, method, settings.tail);
+                if (p < settings.pValue) expected.push_back(r);
+            }
+            std::sort(expected.begin(), expected.end());
+            ASSERT_EQ(expected.size(), (*res)[param].size());
+            for (size_t i = 0; i < expected.size(); ++i) {
+                EXPECT_NEAR(expected[i], (*res)[param][i], 1e-9);
+            }
+        }
+    }
+}
+
+TEST(RegionCorrelation, QuantilesOfSortedRunsMatchMergedValues) {
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> dist(-20, 20);
+    for (size_t nRuns : {1, 2, 5}) {
+        std::vector<std::vector<double>> runs(nRuns);
+        std::vector<double> merged;
+        for (auto& run : runs) {
+            // Integer values give many duplicates across runs
+            run.resize(static_cast<size_t>(dist(gen) + 21));
+            for (auto& v : run) v = dist(gen) / 20.0;
+            std::sort(run.begin(), run.end());
+            merged.insert(merged.end(), run.begin(), run.end());
+        }
+        runs.emplace_back();  // Empty runs are ignored
+        std::sort(merged.begin(), merged.end());
+
+        std::vector<const std::vector<double>*> runPointers;
+        for (const auto& run : runs) runPointers.push_back(&run);
+        const auto expected = stats::correlationQuantiles(merged);
+        const auto quantiles = stats::correlationQuantiles(runPointers);
+        EXPECT_EQ(expected.min, quantiles.min);
+        EXPECT_EQ(expected.firstQuartile, quantiles.firstQuartile);
+        EXPECT_EQ(expected.median, quantiles.median);
+        EXPECT_EQ(expected.thirdQuartile, quantiles.thirdQuartile);
+        EXPECT_EQ(expected.max, quantiles.max);
+    }
+    EXPECT_TRUE(std::isnan(stats::correlationQuantiles(std::vector<const std::vector<double>*>{})
+                               .median));
+}
+
+TEST(RegionAggregation, MeansMediansAndCounts) {
+    const auto atlas = makeAtlas();
+    // Voxel i of subject s has value i + 100 * s
+    VolumeSequence volumes;
+    for (int subject = 0; subject < 2; ++subject) {
+        auto ram = std::make_shared<VolumeRAMPrecision<float>>(atlas->getDimensions());
+        auto data = ram->getDataTyped();
+        for (size_t i = 0; i < 64; ++i) data[i] = static_cast<float>(i + 100 * subject);
+        volumes.push_back(std::make_shared<Volume>(ram));
+    }
+
+    const auto lookup = stats::atlasRegionLookup(*atlas, *volumes.front());
+    EXPECT_EQ((std::vector<int>{1, 3, 7}), lookup.labels);
+    EXPECT_EQ((std::vector<size_t>{32, 31, 1}), lookup.voxels);
+    EXPECT_EQ(2, lookup.voxelRegion[63]);
+    EXPECT_EQ(1, lookup.voxelRegion[6]);
+    EXPECT_EQ(2u, lookup.voxelRank[6]);
+    const auto fromIndex = stats::regionLookup(AtlasVoxelIndex(*atlas));
+    EXPECT_EQ(lookup.voxelRegion, fromIndex.voxelRegion);
+    EXPECT_EQ(lookup.voxelRank, fromIndex.voxelRank);
+
+    const stats::VolumeSequenceVoxelSource source(volumes);
+    const auto aggregates = stats::aggregateRegions(source, lookup, true);
+    ASSERT_TRUE(aggregates.has_value());
+    EXPECT_EQ(size_t{2}, aggregates->subjects);
+    // The voxels with x < 2 are symmetric around index 30.5
+    EXPECT_DOUBLE_EQ(30.5, aggregates->mean(0, 0));
+    EXPECT_DOUBLE_EQ(30.5, aggregates->median(0, 0));
+    EXPECT_DOUBLE_EQ(130.5, aggregates->mean(1, 0));
+    EXPECT_DOUBLE_EQ(163.0, aggregates->mean(1, 2));
+    EXPECT_DOUBLE_EQ(163.0, aggregates->median(1, 2));
+
+    const auto withoutMedians = stats::aggregateRegions(source, lookup, false);
+    ASSERT_TRUE(withoutMedians.has_value());
+    EXPECT_TRUE(withoutMedians->medians.empty());
+    EXPECT_EQ(aggregates->means, withoutMedians->means);
+}
+
+TEST(LabelColorLUT, ColorsAndSampling) {
+    LabelColorLUT lut(7);
+    EXPECT_EQ(size_t{8}, lut.size());
+    EXPECT_EQ((std::vector<LabelColorLUT::Range>{{0, 8}}), lut.getDirtyRanges());
+    lut.clearDirty();
+
+    const vec4 red{1.0f, 0.0f, 0.0f, 1.0f};
+    EXPECT_TRUE(lut.setColor(3, red));
+    EXPECT_FALSE(lut.setColor(3, red));
+    EXPECT_FALSE(lut.setColor(8, red));
+    EXPECT_FALSE(lut.setColor(-1, red));
+    EXPECT_EQ(red, lut.getColor(3));
+    EXPECT_EQ(vec4(0.0f), lut.getColor(8));
+
+    EXPECT_EQ(red, lut.sample(3.0));
+    EXPECT_EQ(red, lut.sample(2.6));
+    EXPECT_EQ(vec4(0.0f), lut.sample(3.5));
+    EXPECT_EQ(vec4(0.0f), lut.sample(-3.0));
+
+    EXPECT_THROW(LabelColorLUT(-1), Exception);
+    EXPECT_THROW(LabelColorLUT(static_cast<int>(stats::maxDenseLabelRange)), Exception);
+}
+
+TEST(LabelColorLUT, DirtyRangesAreMerged) {
+    LabelColorLUT lut(20);
+    lut.clearDirty();
+    EXPECT_FALSE(lut.isDirty());
+
+    const vec4 color{1.0f};
+    lut.setColor(5, color);
+    lut.setColor(10, color);
+    lut.setColor(2, color);
+    EXPECT_EQ((std::vector<LabelColorLUT::Range>{{2, 3}, {5, 6}, {10, 11}}),
+              lut.getDirtyRanges());
+    // Adjacent entries join the neighbouring ranges
+    lut.setColor(4, color);
+    lut.setColor(3, color);
+    EXPECT_EQ((std::vector<LabelColorLUT::Range>{{2, 6}, {10, 11}}), lut.getDirtyRanges());
+    lut.setColor(1, color);
+    lut.setColor(5, vec4{0.5f});
+    EXPECT_EQ((std::vector<LabelColorLUT::Range>{{1, 6}, {10, 11}}), lut.getDirtyRanges());
+}
+
+TEST(LabelColorLUT, HoverOfLargeAtlasUpdatesTwoEntries) {
+    const vec4 gray{0.2f, 0.2f, 0.2f, 1.0f};
+    LabelColorLUT lut(1100);
+    for (int label = 1; label <= 1100; ++label) lut.setColor(label, gray);
+    lut.clearDirty();
+
+    const vec4 hover{0.0f, 1.0f, 0.0f, 1.0f};
+    lut.setColor(17, gray);
+    lut.setColor(1023, hover);
+    ASSERT_EQ((std::vector<LabelColorLUT::Range>{{1023, 1024}}), lut.getDirtyRanges());
+    lut.clearDirty();
+    lut.setColor(1023, gray);
+    lut.setColor(1024, hover);
+    lut.setColor(3, hover);
+    EXPECT_EQ((std::vector<LabelColorLUT::Range>{{3, 4}, {1023, 1025}}), lut.getDirtyRanges());
+
+    // The range of labels 1023 and 1024 crosses a row of the layer
+    EXPECT_EQ(size2_t(LabelColorLUT::layerWidth, 2), lut.getLayerDimensions());
+    std::vector<std::pair<size2_t, size_t>> rows;
+    lut.forEachDirtyRow([&](size2_t pos, size_t count, const vec4* colors) {
+        rows.emplace_back(pos, count);
+        EXPECT_EQ(lut.getColors().data() + pos.y * LabelColorLUT::layerWidth + pos.x, colors);
+    });
+    EXPECT_EQ((std::vector<std::pair<size2_t, size_t>>{
+                  {size2_t(3, 0), 1}, {size2_t(1023, 0), 1}, {size2_t(0, 1), 1}}),
+              rows);
+}
+
+TEST(LabelColorLUT, LayerHoldsTable) {
+    LabelColorLUT lut(1500);
+    lut.setColor(1200, vec4{1.0f});
+    const auto layer = lut.createLayer();
+    EXPECT_EQ(size2_t(LabelColorLUT::layerWidth, 2), layer->getDimensions());
+    const auto ram =
+        static_cast<const LayerRAMPrecision<vec4>*>(layer->getRepresentation<LayerRAM>());
+    const auto data = ram->getDataTyped();
+    EXPECT_EQ(vec4{1.0f}, data[1200]);
+    EXPECT_EQ(vec4{0.0f}, data[1199]);
+    EXPECT_EQ(vec4{0.0f}, data[2 * LabelColorLUT::layerWidth - 1]);
+}
+
+TEST(RegionAggregation, ZonalStatistics) {
+    const auto atlas = makeAtlas();
+    // Value x - 1 at voxel (x, y, z) and NaN in the single voxel of label 7
+    auto ram = std::make_shared<VolumeRAMPrecision<float>>(atlas->getDimensions());
+    auto data = ram->getDataTyped();
+    for (size_t i = 0; i < 64; ++i) data[i] = static_cast<float>(i % 4) - 1.0f;
+    data[63] = std::numeric_limits<float>::quiet_NaN();
+    const Volume map(ram);
+
+    const auto lookup = stats::atlasRegionLookup(*atlas, map);
+    const auto zonal = stats::zonalStatistics(map, lookup, 0.5);
+    ASSERT_TRUE(zonal.has_value());
+    EXPECT_EQ((std::vector<int>{1, 3, 7}), zonal->labels);
+    EXPECT_EQ((std::vector<size_t>{32, 31, 1}), zonal->voxels);
+
+    EXPECT_DOUBLE_EQ(-0.5, zonal->means[0]);
+    EXPECT_DOUBLE_EQ(0.0, zonal->maxima[0]);
+    EXPECT_DOUBLE_EQ(0.5, zonal->significantFractions[0]);
+    EXPECT_DOUBLE_EQ(-1.0, zonal->peakValues[0]);
+    EXPECT_EQ(size3_t(0, 0, 0), zonal->peaks[0]);
+
+    EXPECT_DOUBLE_EQ(46.0 / 31.0, zonal->means[1]);
+    EXPECT_DOUBLE_EQ(2.0, zonal->maxima[1]);
+    EXPECT_DOUBLE_EQ(1.0, zonal->significantFractions[1]);
+    EXPECT_DOUBLE_EQ(2.0, zonal->peakValues[1]);
+    EXPECT_EQ(size3_t(3, 0, 0), zonal->peaks[1]);
+
+    EXPECT_TRUE(std::isnan(zonal->means[2]));
+    EXPECT_TRUE(std::isnan(zonal->peakValues[2]));
+    EXPECT_DOUBLE_EQ(0.0, zonal->significantFractions[2]);
+}
+
+TEST(RegionAggregation, ZonalStatisticsOfScaledMap) {
+    const auto atlas = makeAtlas();
+    // Stored value 10 * x at voxel (x, y, z), mapped to 5 * x - 5
+    auto ram = std::make_shared<VolumeRAMPrecision<std::int16_t>>(atlas->getDimensions());
+    auto data = ram->getDataTyped();
+    for (size_t i = 0; i < 64; ++i) data[i] = static_cast<std::int16_t>(10 * (i % 4));
+    Volume map(ram);
+    map.dataMap.dataRange = dvec2(0.0, 100.0);
+    map.dataMap.valueRange = dvec2(-5.0, 45.0);
+
+    const auto lookup = stats::atlasRegionLookup(*atlas, map);
+    const auto zonal = stats::zonalStatistics(map, lookup, 4.0);
+    ASSERT_TRUE(zonal.has_value());
+    EXPECT_EQ((std::vector<int>{1, 3, 7}), zonal->labels);
+
+    EXPECT_DOUBLE_EQ(-2.5, zonal->means[0]);
+    EXPECT_DOUBLE_EQ(0.0, zonal->maxima[0]);
+    EXPECT_DOUBLE_EQ(0.5, zonal->significantFractions[0]);
+    EXPECT_DOUBLE_EQ(-5.0, zonal->peakValues[0]);
+
+    EXPECT_DOUBLE_EQ(230.0 / 31.0, zonal->means[1]);
+    EXPECT_DOUBLE_EQ(10.0, zonal->maxima[1]);
+    EXPECT_DOUBLE_EQ(1.0, zonal->significantFractions[1]);
+    EXPECT_DOUBLE_EQ(10.0, zonal->peakValues[1]);
+    EXPECT_DOUBLE_EQ(10.0, zonal->means[2]);
+}
+
+}  // namespace inviwo
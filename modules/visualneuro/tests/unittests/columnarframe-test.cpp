@@ -0,0 +1,144 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <gtest/gtest.h>
+#include <warn/pop>
+
+#include <modules/visualneuro/util/columnarframe.h>
+#include <modules/visualneuro/util/columnarframestore.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace inviwo {
+
+namespace {
+
+template <typename T>
+std::vector<T> columnValues(const std::vector<std::byte>& frame,
+                            const util::ColumnarColumn& column) {
+    std::vector<T> res(column.bytes / sizeof(T));
+    std::memcpy(res.data(), frame.data() + column.offset, column.bytes);
+    return res;
+}
+
+const util::ColumnarColumn& findColumn(const util::ColumnarFrameInfo& info,
+                                       const std::string& name) {
+    auto it = std::find_if(info.columns.begin(), info.columns.end(),
+                           [&](const auto& column) { return column.name == name; });
+    EXPECT_NE(it, info.columns.end()) << name;
+    return *it;
+}
+
+}  // namespace
+
+TEST(ColumnarFrame, ColumnsAreStoredAsTypedArrays) {
+    DataFrame frame;
+    frame.addColumn<int>("Id", std::vector<int>{4, -2, 7});
+    frame.addColumn<double>("Value", std::vector<double>{0.5, 1.5, -2.25});
+    frame.addColumn<float>("Score", std::vector<float>{1.0f, 2.0f, 3.0f});
+    frame.addColumn<std::int64_t>("Count", std::vector<std::int64_t>{1, 2, 3});
+    frame.addCategoricalColumn("Region", std::vector<std::string>{"Left", "Right", "Left"});
+    frame.updateIndexBuffer();
+
+    const auto bytes = util::serializeColumnarFrame(frame, "outport", "CSVSource");
+    const auto info = util::readColumnarFrameInfo(bytes.data(), bytes.size());
+    EXPECT_EQ(size_t{3}, info.rows);
+    EXPECT_EQ("outport", info.port);
+    EXPECT_EQ("CSVSource", info.processor);
+    EXPECT_EQ(frame.getNumberOfColumns(), info.columns.size());
+
+    const auto& id = findColumn(info, "Id");
+    EXPECT_EQ("int32", id.type);
+    EXPECT_EQ((std::vector<int>{4, -2, 7}), columnValues<int>(bytes, id));
+
+    const auto& value = findColumn(info, "Value");
+    EXPECT_EQ("float64", value.type);
+    EXPECT_EQ((std::vector<double>{0.5, 1.5, -2.25}), columnValues<double>(bytes, value));
+
+    EXPECT_EQ("float32", findColumn(info, "Score").type);
+
+    // 64-bit integers are converted to float64
+    const auto& count = findColumn(info, "Count");
+    EXPECT_EQ("float64", count.type);
+    EXPECT_EQ((std::vector<double>{1.0, 2.0, 3.0}), columnValues<double>(bytes, count));
+
+    const auto& region = findColumn(info, "Region");
+    EXPECT_EQ("categorical", region.type);
+    std::vector<std::string> regions;
+    for (auto code : columnValues<std::uint32_t>(bytes, region)) {
+        regions.push_back(region.categories.at(code));
+    }
+    EXPECT_EQ((std::vector<std::string>{"Left", "Right", "Left"}), regions);
+
+    for (const auto& column : info.columns) EXPECT_EQ(size_t{0}, column.offset % 8);
+}
+
+TEST(ColumnarFrame, InvalidFramesThrow) {
+    DataFrame frame;
+    frame.addColumn<double>("Value", std::vector<double>{0.5, 1.5});
+    frame.updateIndexBuffer();
+    auto bytes = util::serializeColumnarFrame(frame, "outport", "Source");
+
+    EXPECT_THROW(util::readColumnarFrameInfo(bytes.data(), bytes.size() - 8), Exception);
+    EXPECT_THROW(util::readColumnarFrameInfo(bytes.data(), 12), Exception);
+    auto wrongVersion = bytes;
+    wrongVersion[4] = std::byte{2};
+    EXPECT_THROW(util::readColumnarFrameInfo(wrongVersion.data(), wrongVersion.size()), Exception);
+}
+
+TEST(ColumnarFrameStore, FramesByVersion) {
+    auto& store = util::ColumnarFrameStore::get();
+    const auto first = store.nextVersion();
+    const auto second = store.nextVersion();
+    EXPECT_LT(first, second);
+
+    auto frame = std::make_shared<const std::vector<std::byte>>(16, std::byte{1});
+    const auto secondToken = store.set(second, frame, 1);
+    EXPECT_EQ(frame, store.find(second));
+    EXPECT_EQ(nullptr, store.find(first));
+    store.erase(second);
+    EXPECT_EQ(nullptr, store.find(second));
+    EXPECT_EQ(nullptr, store.take(secondToken, 1));
+
+    // Frames are served once and only to their browser, with random tokens
+    const auto firstToken = store.set(first, frame, 1);
+    EXPECT_EQ(size_t{32}, firstToken.size());
+    EXPECT_NE(secondToken, firstToken);
+    EXPECT_EQ(nullptr, store.take(firstToken, 2));
+    EXPECT_EQ(frame, store.take(firstToken, 1));
+    EXPECT_EQ(nullptr, store.take(firstToken, 1));
+    EXPECT_EQ("https://visualneuro.data/frame/" + firstToken, util::columnarFrameURL(firstToken));
+}
+
+}  // namespace inviwo
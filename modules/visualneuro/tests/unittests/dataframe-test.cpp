@@ -0,0 +1,93 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <gtest/gtest.h>
+#include <warn/pop>
+
+#include <modules/visualneuro/algorithm/dataframe/concatenaterows.h>
+
+#include <string>
+#include <vector>
+
+namespace inviwo {
+
+namespace {
+
+std::shared_ptr<const DataFrame> makeFrame(std::vector<int> ids, std::vector<double> values,
+                                           std::vector<std::string> regions) {
+    auto frame = std::make_shared<DataFrame>();
+    frame->addColumn<int>("Id", ids);
+    // Columns in another order than in the other frames are matched by name
+    if (ids.size() == 1) {
+        frame->addCategoricalColumn("Region", regions);
+        frame->addColumn<double>("Value", values);
+    } else {
+        frame->addColumn<double>("Value", values);
+        frame->addCategoricalColumn("Region", regions);
+    }
+    frame->updateIndexBuffer();
+    return frame;
+}
+
+}  // namespace
+
+TEST(ConcatenateRows, RowsOfAllFramesInOrder) {
+    const auto res = dataframe::concatenateRows(
+        {makeFrame({1, 2}, {0.5, 1.5}, {"Left", "Right"}), makeFrame({3}, {2.5}, {"Dot"}),
+         makeFrame({4, 5}, {3.5, 4.5}, {"Right", "Left"})});
+
+    ASSERT_EQ(size_t{5}, res->getNumberOfRows());
+    const auto ids = res->getColumn("Id");
+    const auto values = res->getColumn("Value");
+    const auto regions = res->getColumn("Region");
+    ASSERT_TRUE(ids && values && regions);
+    const std::vector<std::string> expectedRegions{"Left", "Right", "Dot", "Right", "Left"};
+    for (size_t row = 0; row < 5; ++row) {
+        EXPECT_EQ(static_cast<double>(row + 1), ids->getAsDouble(row));
+        EXPECT_EQ(0.5 + static_cast<double>(row), values->getAsDouble(row));
+        EXPECT_EQ(expectedRegions[row], regions->getAsString(row));
+        EXPECT_EQ(static_cast<double>(row), res->getIndexColumn()->getAsDouble(row));
+    }
+}
+
+TEST(ConcatenateRows, MismatchingColumnsThrow) {
+    auto other = std::make_shared<DataFrame>();
+    other->addColumn<int>("Id", std::vector<int>{1});
+    other->addColumn<float>("Value", std::vector<float>{1.0f});
+    other->addCategoricalColumn("Region", std::vector<std::string>{"Left"});
+    other->updateIndexBuffer();
+
+    const auto frame = makeFrame({1, 2}, {0.5, 1.5}, {"Left", "Right"});
+    EXPECT_THROW(dataframe::concatenateRows({frame, other}), Exception);
+    EXPECT_THROW(dataframe::concatenateRows({}), Exception);
+}
+
+}  // namespace inviwo
@@ -0,0 +1,168 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <gtest/gtest.h>
+#include <warn/pop>
+
+#include <modules/visualneuro/util/columnarframe.h>
+#include <modules/visualneuro/util/dataframedelta.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace inviwo {
+
+namespace {
+
+std::shared_ptr<DataFrame> makeFrame(std::vector<double> values,
+                                     std::vector<std::string> regions) {
+    auto frame = std::make_shared<DataFrame>();
+    frame->addColumn<double>("Value", std::move(values));
+    frame->addCategoricalColumn("Region", regions);
+    frame->updateIndexBuffer();
+    return frame;
+}
+
+using Ranges = std::vector<std::pair<std::uint32_t, std::uint32_t>>;
+
+}  // namespace
+
+TEST(DataFrameDelta, AppendedRows) {
+    auto previous = makeFrame({1.0, 2.0}, {"Left", "Right"});
+    auto current = makeFrame({1.0, 2.0, 3.0}, {"Left", "Right", "Top"});
+
+    const auto delta = util::diffDataFrames(*previous, *current);
+    EXPECT_FALSE(delta.full);
+    EXPECT_EQ(size_t{2}, delta.previousRows);
+    EXPECT_EQ(size_t{3}, delta.rows);
+    EXPECT_TRUE(delta.changedColumns.empty());
+    EXPECT_FALSE(delta.empty());
+
+    EXPECT_TRUE(util::diffDataFrames(*current, *current).empty());
+}
+
+TEST(DataFrameDelta, RemovedRows) {
+    auto previous = makeFrame({1.0, 2.0, 3.0}, {"Left", "Right", "Top"});
+    auto current = makeFrame({1.0, 2.0}, {"Left", "Right"});
+
+    const auto delta = util::diffDataFrames(*previous, *current);
+    EXPECT_FALSE(delta.full);
+    EXPECT_EQ(size_t{2}, delta.rows);
+    EXPECT_TRUE(delta.changedColumns.empty());
+}
+
+TEST(DataFrameDelta, ChangedColumns) {
+    auto previous = makeFrame({1.0, 2.0}, {"Left", "Right"});
+    auto current = makeFrame({1.0, 5.0}, {"Left", "Right"});
+
+    auto delta = util::diffDataFrames(*previous, *current);
+    ASSERT_EQ(size_t{1}, delta.changedColumns.size());
+    EXPECT_EQ("Value", current->getColumn(delta.changedColumns[0])->getHeader());
+
+    // Categories in a different order change the meaning of the codes
+    current = makeFrame({1.0, 2.0}, {"Right", "Left"});
+    delta = util::diffDataFrames(*previous, *current);
+    ASSERT_EQ(size_t{1}, delta.changedColumns.size());
+    EXPECT_EQ("Region", current->getColumn(delta.changedColumns[0])->getHeader());
+
+    auto renamed = std::make_shared<DataFrame>();
+    renamed->addColumn<double>("Other", std::vector<double>{1.0, 2.0});
+    renamed->addCategoricalColumn("Region", std::vector<std::string>{"Left", "Right"});
+    renamed->updateIndexBuffer();
+    EXPECT_TRUE(util::diffDataFrames(*previous, *renamed).full);
+}
+
+TEST(DataFrameDelta, DeltaFrameHoldsAppendedRows) {
+    auto previous = makeFrame({1.0, 2.0}, {"Left", "Right"});
+    auto current = makeFrame({1.0, 2.0, 3.0}, {"Left", "Right", "Top"});
+
+    const auto delta = util::diffDataFrames(*previous, *current);
+    const auto bytes = util::serializeColumnarDelta(*current, delta, "outport", "CSVSource", 2, 1);
+    const auto info = util::readColumnarFrameInfo(bytes.data(), bytes.size());
+    EXPECT_EQ("delta", info.kind);
+    EXPECT_EQ(std::uint64_t{2}, info.version);
+    EXPECT_EQ(std::uint64_t{1}, info.base);
+    EXPECT_EQ(size_t{3}, info.rows);
+
+    auto value = std::find_if(info.columns.begin(), info.columns.end(),
+                              [](const auto& column) { return column.name == "Value"; });
+    ASSERT_NE(value, info.columns.end());
+    EXPECT_EQ(size_t{2}, value->firstRow);
+    ASSERT_EQ(sizeof(double), value->bytes);
+    double appended = 0.0;
+    std::memcpy(&appended, bytes.data() + value->offset, sizeof(double));
+    EXPECT_EQ(3.0, appended);
+
+    auto region = std::find_if(info.columns.begin(), info.columns.end(),
+                               [](const auto& column) { return column.name == "Region"; });
+    ASSERT_NE(region, info.columns.end());
+    EXPECT_EQ((std::vector<std::string>{"Left", "Right", "Top"}), region->categories);
+
+    const auto full = util::serializeColumnarFrame(*current, "outport", "CSVSource", 3);
+    EXPECT_EQ("full", util::readColumnarFrameInfo(full.data(), full.size()).kind);
+}
+
+TEST(DataFrameDelta, Ranges) {
+    BitSet indices;
+    for (std::uint32_t i : {1u, 2u, 3u, 7u, 9u, 10u}) indices.add(i);
+    EXPECT_EQ((Ranges{{1, 4}, {7, 8}, {9, 11}}), util::toRanges(indices));
+    EXPECT_TRUE(util::toRanges(BitSet()).empty());
+}
+
+TEST(DataFrameDelta, Brushing) {
+    BitSet previousFiltered;
+    previousFiltered.add(1);
+    previousFiltered.add(2);
+    BitSet filtered;
+    filtered.add(2);
+    filtered.add(3);
+    BitSet selected;
+    selected.add(5);
+
+    const auto delta = util::diffBrushing(previousFiltered, filtered, selected, selected, 4, 3);
+    EXPECT_EQ((Ranges{{3, 4}}), delta.filteredAdded);
+    EXPECT_EQ((Ranges{{1, 2}}), delta.filteredRemoved);
+    EXPECT_TRUE(delta.selectedAdded.empty());
+    EXPECT_TRUE(delta.selectedRemoved.empty());
+    EXPECT_EQ(
+        R"({"base":3,"filtered":{"added":[[3,4]],"removed":[[1,2]]},)"
+        R"("selected":{"added":[],"removed":[]},"version":4})",
+        delta.toJSON());
+
+    EXPECT_TRUE(util::diffBrushing(filtered, filtered, selected, selected, 5, 4).empty());
+    // A delta replacing the state of the page is always sent
+    EXPECT_FALSE(util::diffBrushing(BitSet(), BitSet(), BitSet(), BitSet(), 1, 0).empty());
+}
+
+}  // namespace inviwo
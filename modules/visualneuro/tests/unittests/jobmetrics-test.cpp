@@ -0,0 +1,123 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <gtest/gtest.h>
+#include <warn/pop>
+
+#include <modules/visualneuro/algorithm/volume/voxelstatistics.h>
+#include <modules/visualneuro/util/jobmetrics.h>
+#include <inviwo/core/datastructures/volume/volumeramprecision.h>
+
+#include <sstream>
+
+namespace inviwo {
+
+TEST(JobMetrics, RecordsVoxelsAndBytes) {
+    auto& registry = util::MetricsRegistry::get();
+    registry.clear();
+
+    const size3_t dims{16, 8, 4};
+    VolumeSequence volumes;
+    for (int i = 0; i < 3; ++i) {
+        volumes.push_back(std::make_shared<Volume>(
+            std::make_shared<VolumeRAMPrecision<unsigned short>>(dims)));
+    }
+    {
+        util::JobMetrics metrics("test", "mean");
+        metrics.start();
+        ASSERT_TRUE(stats::volumeSequenceMean(volumes, {{}, {}, &metrics}));
+        {
+            const util::PhaseTimer timer(&metrics, util::JobPhase::Publish);
+        }
+        metrics.finish();
+    }
+
+    const auto jobs = registry.getJobs();
+    ASSERT_EQ(size_t{1}, jobs.size());
+    EXPECT_FALSE(jobs[0].cancelled);
+    EXPECT_EQ("mean", jobs[0].processor);
+    EXPECT_EQ(glm::compMul(dims), jobs[0].voxels);
+    EXPECT_EQ(glm::compMul(dims) * 3 * sizeof(unsigned short), jobs[0].bytes);
+    EXPECT_GT(jobs[0].seconds[static_cast<size_t>(util::JobPhase::Gather)], 0.0);
+    EXPECT_GT(jobs[0].seconds[static_cast<size_t>(util::JobPhase::Compute)], 0.0);
+}
+
+TEST(JobMetrics, UnfinishedJobIsCancelled) {
+    auto& registry = util::MetricsRegistry::get();
+    registry.clear();
+
+    { util::JobMetrics metrics("test", "stopped"); }
+    {
+        util::JobMetrics metrics("test", "stopped");
+        metrics.start();
+        metrics.addVoxels(10);
+        metrics.finish();
+        // Only the first call records the job
+        metrics.finish();
+    }
+
+    const auto summary = registry.summarize();
+    ASSERT_EQ(size_t{1}, summary.size());
+    EXPECT_EQ(size_t{2}, summary[0].jobs);
+    EXPECT_EQ(size_t{1}, summary[0].cancelled);
+    EXPECT_EQ(size_t{1}, summary[0].finished());
+    EXPECT_EQ(size_t{10}, summary[0].voxels);
+}
+
+TEST(JobMetrics, CapacityDropsOldestJobs) {
+    auto& registry = util::MetricsRegistry::get();
+    registry.clear();
+    const auto capacity = registry.getCapacity();
+    registry.setCapacity(2);
+
+    for (const auto* name : {"a", "b", "c"}) util::JobMetrics("test", name).finish();
+
+    const auto jobs = registry.getJobs();
+    registry.setCapacity(capacity);
+    ASSERT_EQ(size_t{2}, jobs.size());
+    EXPECT_EQ("b", jobs[0].processor);
+    EXPECT_EQ("c", jobs[1].processor);
+}
+
+TEST(JobMetrics, WriteJSON) {
+    auto& registry = util::MetricsRegistry::get();
+    registry.clear();
+    util::JobMetrics("org.inviwo.VolumeTTest", "Volume T-Test").finish();
+
+    std::stringstream ss;
+    registry.writeJSON(ss);
+    const auto json = ss.str();
+    EXPECT_NE(std::string::npos, json.find("\"processors\""));
+    EXPECT_NE(std::string::npos, json.find("\"Volume T-Test\""));
+    EXPECT_NE(std::string::npos, json.find("\"QueueWait\""));
+}
+
+}  // namespace inviwo
@@ -0,0 +1,182 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <gtest/gtest.h>
+#include <warn/pop>
+
+#include <modules/visualneuro/util/volumememoryaccountant.h>
+#include <inviwo/core/datastructures/diskrepresentation.h>
+#include <inviwo/core/datastructures/volume/volumedisk.h>
+#include <inviwo/core/datastructures/volume/volumeramprecision.h>
+#include <inviwo/core/util/raiiutils.h>
+
+#include <algorithm>
+#include <numeric>
+
+namespace inviwo {
+
+namespace {
+
+std::shared_ptr<Volume> makeVolume(size3_t dims) {
+    return std::make_shared<Volume>(std::make_shared<VolumeRAMPrecision<float>>(dims));
+}
+
+// Reads a fixed set of float values, standing in for a volume file
+class TestVolumeLoader : public DiskRepresentationLoader<VolumeRepresentation> {
+public:
+    explicit TestVolumeLoader(std::vector<float> values) : values_{std::move(values)} {}
+
+    virtual TestVolumeLoader* clone() const override { return new TestVolumeLoader(*this); }
+    virtual std::shared_ptr<VolumeRepresentation> createRepresentation(
+        const VolumeRepresentation& src) const override {
+        auto ram = std::make_shared<VolumeRAMPrecision<float>>(src.getDimensions());
+        std::copy(values_.begin(), values_.end(), ram->getDataTyped());
+        return ram;
+    }
+    virtual void updateRepresentation(std::shared_ptr<VolumeRepresentation> dest,
+                                      const VolumeRepresentation&) const override {
+        auto ram = std::static_pointer_cast<VolumeRAMPrecision<float>>(dest);
+        std::copy(values_.begin(), values_.end(), ram->getDataTyped());
+    }
+
+private:
+    std::vector<float> values_;
+};
+
+std::shared_ptr<Volume> makeDiskVolume(size3_t dims) {
+    std::vector<float> values(glm::compMul(dims));
+    std::iota(values.begin(), values.end(), 0.0f);
+    auto disk = std::make_shared<VolumeDisk>(dims, DataFloat32::get());
+    disk->setLoader(new TestVolumeLoader(std::move(values)));
+    return std::make_shared<Volume>(disk);
+}
+
+float valueAt(const Volume& volume, size_t i) {
+    return static_cast<const VolumeRAMPrecision<float>*>(volume.getRepresentation<VolumeRAM>())
+        ->getDataTyped()[i];
+}
+
+const util::OwnerMemoryUsage* findOwner(const std::vector<util::OwnerMemoryUsage>& usage,
+                                        std::string_view owner) {
+    auto it = std::find_if(usage.begin(), usage.end(),
+                           [&](const util::OwnerMemoryUsage& u) { return u.owner == owner; });
+    return it != usage.end() ? &*it : nullptr;
+}
+
+}  // namespace
+
+TEST(VolumeMemoryAccountant, UsagePerOwner) {
+    auto& accountant = util::VolumeMemoryAccountant::get();
+    VolumeSequence sequence{makeVolume(size3_t{4}), makeVolume(size3_t{4})};
+    auto result = makeVolume(size3_t{2});
+    accountant.track(sequence, "test.sequence", util::RepresentationSource::Computed);
+    accountant.track(result, "test.result", util::RepresentationSource::Computed);
+    // Tracking again keeps the first owner
+    accountant.track(result, "test.other", util::RepresentationSource::Computed);
+
+    const auto usage = accountant.getUsage();
+    const auto seq = findOwner(usage, "test.sequence");
+    ASSERT_NE(nullptr, seq);
+    EXPECT_EQ(size_t{2}, seq->volumes);
+    EXPECT_EQ(size_t{2 * 64 * sizeof(float)}, seq->ramBytes);
+    EXPECT_EQ(size_t{0}, seq->glBytes);
+    // The RAM representation is the only copy of computed volumes
+    EXPECT_EQ(size_t{0}, seq->evictableBytes);
+
+    const auto res = findOwner(usage, "test.result");
+    ASSERT_NE(nullptr, res);
+    EXPECT_EQ(size_t{8 * sizeof(float)}, res->ramBytes);
+    EXPECT_EQ(nullptr, findOwner(usage, "test.other"));
+}
+
+TEST(VolumeMemoryAccountant, DestroyedVolumesAreNotCounted) {
+    auto& accountant = util::VolumeMemoryAccountant::get();
+    {
+        auto volume = makeVolume(size3_t{8});
+        accountant.track(volume, "test.destroyed", util::RepresentationSource::Computed);
+        EXPECT_NE(nullptr, findOwner(accountant.getUsage(), "test.destroyed"));
+    }
+    EXPECT_EQ(nullptr, findOwner(accountant.getUsage(), "test.destroyed"));
+}
+
+TEST(VolumeMemoryAccountant, ComputedVolumesAreNotEvicted) {
+    auto& accountant = util::VolumeMemoryAccountant::get();
+    const util::OnScopeExit resetBudget{[&, budget = accountant.getBudget()]() {
+        accountant.setBudget(budget);
+    }};
+
+    auto volume = makeVolume(size3_t{16});
+    accountant.track(volume, "test.budget", util::RepresentationSource::Computed);
+    accountant.setBudget(1);
+    EXPECT_EQ(size_t{1}, accountant.getBudget());
+
+    EXPECT_EQ(size_t{0}, accountant.enforceBudget());
+    EXPECT_TRUE(volume->hasRepresentation<VolumeRAM>());
+}
+
+TEST(VolumeMemoryAccountant, DiskVolumesAreEvictedAndReloaded) {
+    auto& accountant = util::VolumeMemoryAccountant::get();
+    const util::OnScopeExit resetBudget{[&, budget = accountant.getBudget()]() {
+        accountant.setBudget(budget);
+    }};
+
+    auto volume = makeDiskVolume(size3_t{4});
+    EXPECT_EQ(5.0f, valueAt(*volume, 5));
+    accountant.track(volume, "test.disk", util::RepresentationSource::Disk);
+    accountant.setBudget(1);
+
+    EXPECT_EQ(size_t{64 * sizeof(float)}, accountant.enforceBudget());
+    EXPECT_FALSE(volume->hasRepresentation<VolumeRAM>());
+    EXPECT_EQ(5.0f, valueAt(*volume, 5));
+    EXPECT_EQ(63.0f, valueAt(*volume, 63));
+}
+
+TEST(VolumeMemoryAccountant, EditedDiskVolumesAreNotEvicted) {
+    auto& accountant = util::VolumeMemoryAccountant::get();
+    const util::OnScopeExit resetBudget{[&, budget = accountant.getBudget()]() {
+        accountant.setBudget(budget);
+    }};
+
+    auto volume = makeDiskVolume(size3_t{4});
+    static_cast<VolumeRAMPrecision<float>*>(volume->getEditableRepresentation<VolumeRAM>())
+        ->getDataTyped()[5] = -1.0f;
+    accountant.track(volume, "test.edited", util::RepresentationSource::Disk);
+    const auto usage = findOwner(accountant.getUsage(), "test.edited");
+    ASSERT_NE(nullptr, usage);
+    EXPECT_EQ(size_t{0}, usage->evictableBytes);
+
+    accountant.setBudget(1);
+    EXPECT_EQ(size_t{0}, accountant.enforceBudget());
+    EXPECT_TRUE(volume->hasRepresentation<VolumeRAM>());
+    EXPECT_EQ(-1.0f, valueAt(*volume, 5));
+}
+
+}  // namespace inviwo
@@ -0,0 +1,138 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <gtest/gtest.h>
+#include <warn/pop>
+
+#include <modules/visualneuro/algorithm/dataframe/parametermatrix.h>
+#include <modules/visualneuro/statistics/correlation.h>
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace inviwo {
+
+namespace {
+
+constexpr auto nan = std::numeric_limits<double>::quiet_NaN();
+
+std::shared_ptr<DataFrame> makeParameters() {
+    auto frame = std::make_shared<DataFrame>();
+    frame->addColumn<int>("Age", std::vector<int>{40, 50, 60, 70});
+    frame->addColumn<float>("Score", std::vector<float>{1.0f, std::nanf(""), 3.0f, 5.0f});
+    frame->updateIndexBuffer();
+    return frame;
+}
+
+}  // namespace
+
+TEST(ParameterMatrix, ExtractsTypedColumns) {
+    auto frame = makeParameters();
+    // Subject 1 has no row, subject 3 is row 0
+    const std::vector<std::uint32_t> rows{1, dataframe::ParameterMatrix::noRow, 3, 0};
+    const dataframe::ParameterMatrix matrix(*frame, {1, 2}, rows);
+
+    ASSERT_EQ(size_t{2}, matrix.getNumberOfParameters());
+    ASSERT_EQ(size_t{4}, matrix.getNumberOfSubjects());
+    EXPECT_EQ("Age", matrix.getName(0));
+    EXPECT_EQ("Score", matrix.getName(1));
+    for (size_t i = 0; i < matrix.getNumberOfParameters(); ++i) {
+        EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(matrix.getValues(i)) % 64);
+    }
+
+    const auto age = matrix.getValues(0);
+    EXPECT_EQ(50.0, age[0]);
+    EXPECT_TRUE(std::isnan(age[1]));
+    EXPECT_EQ(70.0, age[2]);
+    EXPECT_EQ(40.0, age[3]);
+    EXPECT_EQ((std::vector<std::uint32_t>{0, 2, 3}), matrix.getValidSubjects(0));
+    EXPECT_EQ(size_t{3}, matrix.getNumberOfValid(0));
+    EXPECT_DOUBLE_EQ(160.0 / 3.0, matrix.getMean(0));
+
+    // Row 1 of Score is NaN
+    EXPECT_FALSE(matrix.isValid(1, 0));
+    EXPECT_FALSE(matrix.isValid(1, 1));
+    EXPECT_TRUE(matrix.isValid(1, 2));
+    EXPECT_EQ((std::vector<double>{5.0, 1.0}), matrix.getValidValues(1));
+    EXPECT_DOUBLE_EQ(3.0, matrix.getMean(1));
+    EXPECT_DOUBLE_EQ(2.0, matrix.getStandardDeviation(1));
+    EXPECT_EQ((std::vector<double>{1.0, -1.0}), matrix.getStandardizedValues(1));
+
+    EXPECT_THROW(dataframe::ParameterMatrix(*frame, std::vector<size_t>{3}, rows), Exception);
+    EXPECT_THROW(dataframe::ParameterMatrix(*frame, std::vector<size_t>{1},
+                                            std::vector<std::uint32_t>{4}),
+                 Exception);
+}
+
+TEST(ParameterMatrix, FromVectors) {
+    std::vector<std::vector<double>> columns(2, std::vector<double>(130, 1.0));
+    columns[1][64] = nan;
+    const dataframe::ParameterMatrix matrix(columns);
+    EXPECT_EQ(size_t{3}, matrix.getValidityWords());
+    EXPECT_EQ(size_t{130}, matrix.getNumberOfValid(0));
+    EXPECT_EQ(size_t{129}, matrix.getNumberOfValid(1));
+    EXPECT_EQ(~std::uint64_t{1}, matrix.getValidity(1)[1]);
+    EXPECT_EQ(0.0, matrix.getStandardDeviation(0));
+
+    using Columns = std::vector<std::vector<double>>;
+    EXPECT_TRUE(std::isnan(dataframe::ParameterMatrix(Columns{{nan, nan}}).getMean(0)));
+    EXPECT_THROW(dataframe::ParameterMatrix(Columns{{1.0}, {1.0, 2.0}}), Exception);
+}
+
+TEST(ParameterMatrix, CacheReusesMatrix) {
+    auto frame = makeParameters();
+    dataframe::ParameterMatrixCache cache;
+    const std::vector<std::uint32_t> rows{0, 1, 2, 3};
+    const auto first = cache.get(frame, rows);
+    EXPECT_EQ(frame->getNumberOfColumns(), first->getNumberOfParameters());
+    EXPECT_EQ(first, cache.get(frame, rows));
+    EXPECT_NE(first, cache.get(frame, {0, 2}));
+    EXPECT_NE(first, cache.get(makeParameters(), rows));
+}
+
+TEST(ParameterMatrix, StandardizedPearsonTest) {
+    const std::vector<double> a{1.0, 2.5, 3.0, 4.5, 7.0};
+    const std::vector<double> b{2.0, 1.0, 4.0, 3.5, 8.0};
+    const dataframe::ParameterMatrix matrix(std::vector<std::vector<double>>{a});
+    const auto standardized = matrix.getStandardizedValues(0);
+
+    const auto [r, p] = stats::corrTest(a, b, stats::CorrelationMethod::Pearson,
+                                        stats::TailTest::Both);
+    const auto [sr, sp] = stats::standardizedPearsonTest(standardized.data(), b.data(), b.size(),
+                                                         stats::TailTest::Both);
+    EXPECT_NEAR(r, sr, 1e-12);
+    EXPECT_NEAR(p, sp, 1e-12);
+}
+
+}  // namespace inviwo
@@ -0,0 +1,152 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <gtest/gtest.h>
+#include <warn/pop>
+
+#include <modules/visualneuro/algorithm/dataframe/csvwriter.h>
+#include <modules/visualneuro/algorithm/dataframe/patientdatasync.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace inviwo {
+
+namespace {
+
+// Empty folder in the temporary directory, removed with its content at destruction
+class TemporaryFolder {
+public:
+    explicit TemporaryFolder(const std::string& name)
+        : path_{std::filesystem::temp_directory_path() / name} {
+        std::filesystem::remove_all(path_);
+        std::filesystem::create_directories(path_);
+    }
+    ~TemporaryFolder() {
+        std::error_code ec;
+        std::filesystem::remove_all(path_, ec);
+    }
+    const std::filesystem::path& path() const { return path_; }
+
+private:
+    std::filesystem::path path_;
+};
+
+void touch(const std::filesystem::path& file) { std::ofstream{file} << "volume"; }
+
+}  // namespace
+
+TEST(PatientDataSync, PatientIdPattern) {
+    const dataframe::PatientIdPattern pattern("Subject");
+    EXPECT_EQ("0042", pattern.extract("rest_Subject_0042.nii"));
+    EXPECT_EQ("A7", pattern.extract("Subject-A7_run1.nii.gz"));
+    EXPECT_EQ("12", pattern.extract("Subject12.nii"));
+    EXPECT_TRUE(pattern.extract("Patient_12.nii").empty());
+
+    // Keywords are matched literally
+    EXPECT_EQ("3", dataframe::PatientIdPattern("sub.").extract("sub.3.nii"));
+    EXPECT_TRUE(dataframe::PatientIdPattern("sub.").extract("subx3.nii").empty());
+    EXPECT_THROW(dataframe::PatientIdPattern(""), Exception);
+}
+
+TEST(PatientDataSync, WriteCSV) {
+    DataFrame frame;
+    frame.addColumn<int>("Age", std::vector<int>{54, 61, 47});
+    frame.addColumn<double>("Score", std::vector<double>{0.5, 1.25, -3.0});
+    frame.addCategoricalColumn("Note", std::vector<std::string>{"a", "b, c", "say \"hi\""});
+    frame.updateIndexBuffer();
+
+    std::ostringstream os;
+    EXPECT_TRUE(dataframe::writeCSV(os, frame, {0, 2}));
+    EXPECT_EQ("Age,Score,Note\n54,0.5,a\n47,-3,\"say \"\"hi\"\"\"\n", os.str());
+
+    std::ostringstream quoted;
+    dataframe::writeCSV(quoted, frame, {1});
+    EXPECT_EQ("Age,Score,Note\n61,1.25,\"b, c\"\n", quoted.str());
+}
+
+TEST(PatientDataSync, Plan) {
+    TemporaryFolder folder("visualneuro-patientdatasync-test");
+    touch(folder.path() / "Subject_101.nii");
+    touch(folder.path() / "Subject_102.nii");
+    touch(folder.path() / "Subject_999.nii");
+    touch(folder.path() / "unnamed.nii");
+    touch(folder.path() / "notes.txt");
+
+    DataFrame mapping;
+    mapping.addCategoricalColumn("Patient", std::vector<std::string>{"P1", "P2", "P3"});
+    mapping.addCategoricalColumn("Scan", std::vector<std::string>{"101", "102", "103"});
+    mapping.updateIndexBuffer();
+
+    DataFrame patientData;
+    patientData.addCategoricalColumn("Patient", std::vector<std::string>{"P2", "P3", "P1"});
+    patientData.addColumn<float>("Age", std::vector<float>{30.0f, 40.0f, 50.0f});
+    patientData.updateIndexBuffer();
+
+    const dataframe::PatientIdPattern pattern("Subject");
+    const auto plan =
+        dataframe::planPatientDataSync(mapping, patientData, folder.path(), pattern);
+    ASSERT_TRUE(plan);
+    EXPECT_EQ(size_t{4}, plan->volumes);
+    EXPECT_EQ((std::vector<std::uint32_t>{0, 2}), plan->matchedRows);
+    EXPECT_EQ((std::vector<std::uint32_t>{1}), plan->unmatchedRows);
+    ASSERT_EQ(size_t{1}, plan->moves.size());
+    EXPECT_EQ("Subject_999.nii", plan->moves[0].path.filename().string());
+    EXPECT_TRUE(plan->moves[0].id.empty());
+    ASSERT_EQ(size_t{1}, plan->skipped.size());
+    EXPECT_EQ("unnamed.nii", plan->skipped[0].filename().string());
+
+    const auto actions = dataframe::patientDataSyncActions(*plan, patientData);
+    EXPECT_EQ(size_t{2}, actions->getNumberOfRows());
+    EXPECT_EQ("Move volume", actions->getColumn("Action")->getAsString(0));
+    EXPECT_EQ("Drop row", actions->getColumn("Action")->getAsString(1));
+    EXPECT_EQ("P3", actions->getColumn("ID")->getAsString(1));
+
+    EXPECT_EQ(size_t{1}, dataframe::applyPatientDataSync(*plan));
+    EXPECT_FALSE(std::filesystem::exists(folder.path() / "Subject_999.nii"));
+    EXPECT_TRUE(std::filesystem::exists(plan->unmatchedFolder / "Subject_999.nii"));
+
+    // Moved volumes are listed in the log of later syncs but not moved again
+    const auto next =
+        dataframe::planPatientDataSync(mapping, patientData, folder.path(), pattern);
+    ASSERT_TRUE(next);
+    EXPECT_TRUE(next->moves.empty());
+    ASSERT_EQ(size_t{1}, next->unmatchedVolumes.size());
+
+    std::ostringstream log;
+    dataframe::writePatientDataSyncLog(log, *next, patientData);
+    EXPECT_NE(std::string::npos, log.str().find(",,Subject_999.nii,,,,,,P3\n"));
+}
+
+}  // namespace inviwo
@@ -0,0 +1,300 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <gtest/gtest.h>
+#include <warn/pop>
+
+#include <modules/visualneuro/algorithm/volume/cohortfile.h>
+#include <modules/visualneuro/distributed/shardedstatistics.h>
+#include <inviwo/core/datastructures/volume/volumeramprecision.h>
+#include <inviwo/core/util/filesystem.h>
+#include <inviwo/core/util/raiiutils.h>
+
+#include <cstdint>
+#include <fstream>
+#include <random>
+#include <thread>
+
+namespace inviwo {
+
+namespace {
+
+VolumeSequence makeCohort(size3_t dims, size_t nSubjects) {
+    std::mt19937 gen(42);
+    std::normal_distribution<float> noise(0.f, 1.f);
+    VolumeSequence volumes;
+    for (size_t s = 0; s < nSubjects; ++s) {
+        auto ram = std::make_shared<VolumeRAMPrecision<float>>(dims);
+        auto data = ram->getDataTyped();
+        for (size_t i = 0; i < glm::compMul(dims); ++i) {
+            // Every other voxel increases with the subject index
+            data[i] = (i % 2 == 0 ? static_cast<float>(s) : 0.f) + noise(gen);
+        }
+        auto volume = std::make_shared<Volume>(ram);
+        volume->dataMap.dataRange = dvec2(-10.0, 10.0 + nSubjects);
+        volume->dataMap.valueRange = volume->dataMap.dataRange;
+        volumes.push_back(volume);
+    }
+    return volumes;
+}
+
+std::vector<std::string> subjectNames(size_t n) {
+    std::vector<std::string> names;
+    for (size_t i = 0; i < n; ++i) names.push_back(fmt::format("subject{}.nii", i));
+    return names;
+}
+
+}  // namespace
+
+TEST(ShardedStatistics, CohortFileMatchesVolumes) {
+    const auto volumes = makeCohort(size3_t(7, 5, 3), 11);
+    const stats::VolumeSequenceVoxelSource source(volumes);
+    const auto file = std::filesystem::temp_directory_path() / "visualneuro-test-cohort.vncohort";
+    ASSERT_TRUE(stats::writeCohortFile(source, subjectNames(11), file));
+    {
+        const stats::CohortFileVoxelSource cohort(file);
+        EXPECT_EQ(cohort.getDimensions(), source.getDimensions());
+        EXPECT_EQ(cohort.getSubjectNames(), subjectNames(11));
+        EXPECT_TRUE(cohort.getSourceStamps().empty());
+
+        stats::VoxelBlock expected;
+        stats::VoxelBlock actual;
+        source.gather(13, 50, expected);
+        cohort.gather(13, 50, actual);
+        for (size_t v = 0; v < 50; ++v) {
+            for (size_t s = 0; s < 11; ++s) {
+                EXPECT_FLOAT_EQ(static_cast<float>(expected.voxel(v)[s]),
+                                static_cast<float>(actual.voxel(v)[s]));
+            }
+        }
+
+        const stats::SubjectSubsetVoxelSource subset(cohort, {10, 2});
+        subset.gather(13, 50, actual);
+        EXPECT_FLOAT_EQ(static_cast<float>(actual.voxel(4)[0]),
+                        static_cast<float>(expected.voxel(4)[10]));
+        EXPECT_FLOAT_EQ(static_cast<float>(actual.voxel(4)[1]),
+                        static_cast<float>(expected.voxel(4)[2]));
+    }
+    std::filesystem::remove(file);
+}
+
+TEST(ShardedStatistics, CohortFileStoresSourceStamps) {
+    const auto volumes = makeCohort(size3_t(3, 2, 2), 2);
+    const stats::VolumeSequenceVoxelSource source(volumes);
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto file = dir / "visualneuro-test-stamps.vncohort";
+    const auto sourceFile = dir / "visualneuro-test-stamps-source.nii";
+    std::ofstream(sourceFile) << "volume";
+    const auto stamp = stats::CohortSourceStamp::of(sourceFile);
+    EXPECT_EQ(std::uint64_t{6}, stamp.size);
+
+    const std::vector<stats::CohortSourceStamp> stamps{stamp, {7, 42}};
+    ASSERT_TRUE(stats::writeCohortFile(source, subjectNames(2), file, {}, stamps));
+    {
+        const stats::CohortFileVoxelSource cohort(file);
+        EXPECT_EQ(cohort.getSubjectNames(), subjectNames(2));
+        EXPECT_EQ(cohort.getSourceStamps(), stamps);
+    }
+    // A changed source file gives a different stamp
+    std::ofstream(sourceFile, std::ios::app) << " edited";
+    EXPECT_NE(stamp, stats::CohortSourceStamp::of(sourceFile));
+
+    EXPECT_THROW(stats::writeCohortFile(source, subjectNames(2), file, {}, {stamp}), Exception);
+    std::filesystem::remove(sourceFile);
+    std::filesystem::remove(file);
+    EXPECT_THROW(stats::CohortSourceStamp::of(sourceFile), Exception);
+}
+
+TEST(ShardedStatistics, ResultVolumeMatchesSingleProcessDataMap) {
+    auto volumes = makeCohort(size3_t(3, 2, 2), 2);
+    volumes[1]->dataMap.valueRange = dvec2(0.0, 4.0);
+    const auto local = stats::volumeSequenceMean(volumes);
+    std::vector<float> result(12, 1.0f);
+    const auto sharded = stats::shardResultToVolume({stats::ShardKernel::Mean}, result, volumes);
+    EXPECT_EQ(local->dataMap.valueRange, sharded->dataMap.valueRange);
+    EXPECT_EQ(local->dataMap.dataRange, sharded->dataMap.dataRange);
+    EXPECT_THROW(stats::shardResultToVolume({}, result, {}), Exception);
+}
+
+TEST(ShardedStatistics, JobSerializationRoundTrip) {
+    stats::ShardJob job;
+    job.id = 17;
+    job.firstVoxel = 1000;
+    job.nVoxels = 3;
+    job.task.kernel = stats::ShardKernel::Correlation;
+    job.task.cohortFile = "/data/cohort.vncohort";
+    job.task.parameter = {1.0, std::numeric_limits<double>::quiet_NaN(), 3.0};
+    job.task.correlation.method = stats::CorrelationMethod::Pearson;
+    job.task.correlation.pValue = 0.01;
+    job.task.mask = {1, 0, 1};
+
+    const auto res = stats::deserializeShardJob(stats::serialize(job));
+    EXPECT_EQ(res.id, job.id);
+    EXPECT_EQ(res.firstVoxel, job.firstVoxel);
+    EXPECT_EQ(res.nVoxels, job.nVoxels);
+    EXPECT_EQ(res.task.kernel, job.task.kernel);
+    EXPECT_EQ(res.task.cohortFile, job.task.cohortFile);
+    EXPECT_EQ(res.task.parameter[0], 1.0);
+    EXPECT_TRUE(std::isnan(res.task.parameter[1]));
+    EXPECT_EQ(res.task.correlation.method, stats::CorrelationMethod::Pearson);
+    EXPECT_EQ(res.task.correlation.pValue, 0.01);
+    EXPECT_EQ(res.task.mask, job.task.mask);
+
+    auto truncated = stats::serialize(job);
+    truncated.pop_back();
+    EXPECT_THROW(stats::deserializeShardJob(truncated), Exception);
+}
+
+#ifndef _WIN32
+namespace {
+
+// Correlation task over a cohort file written to file and its single process result
+struct CorrelationTask {
+    stats::ShardTask task;
+    std::vector<float> expected;
+};
+
+CorrelationTask makeCorrelationTask(const std::filesystem::path& file) {
+    const size_t nSubjects = 20;
+    const auto volumes = makeCohort(size3_t(16, 12, 9), nSubjects);
+    const stats::VolumeSequenceVoxelSource source(volumes);
+    EXPECT_TRUE(stats::writeCohortFile(source, subjectNames(nSubjects), file));
+
+    CorrelationTask res;
+    auto& task = res.task;
+    task.kernel = stats::ShardKernel::Correlation;
+    task.cohortFile = file;
+    for (size_t s = 0; s < nSubjects; ++s) task.parameter.push_back(static_cast<double>(s));
+    task.parameter[3] = std::numeric_limits<double>::quiet_NaN();
+    task.mask.assign(source.getNumberOfVoxels(), 1);
+    task.mask[5] = 0;
+
+    res.expected.resize(source.getNumberOfVoxels());
+    const stats::CohortFileVoxelSource cohort(file);
+    stats::computeCorrelation(cohort, task.parameter, task.correlation, &task.mask, 0,
+                              res.expected.size(), res.expected.data());
+    return res;
+}
+
+void expectResult(const std::optional<std::vector<float>>& result,
+                  const std::vector<float>& expected) {
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(result->size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ((*result)[i], expected[i]) << "voxel " << i;
+    }
+    EXPECT_EQ((*result)[5], 0.f);
+    EXPECT_NE((*result)[0], 0.f);
+}
+
+enum class Misbehavior { UnreadableJob, NoReply };
+
+// Connects like a worker but answers jobs as a broken worker would, until shutdown
+void misbehavingWorker(std::uint16_t port, Misbehavior misbehavior) {
+    auto connection = stats::ShardConnection::connect("127.0.0.1", port);
+    try {
+        while (connection.receive().first == stats::ShardMessageType::Job) {
+            if (misbehavior == Misbehavior::UnreadableJob) {
+                // The reply of a worker that could not read the id of the job
+                stats::ShardMessageWriter w;
+                w.write(std::uint64_t{0});
+                w.write(std::string{"Unexpected end of shard message"});
+                connection.send(stats::ShardMessageType::Error, w.buffer());
+            }
+        }
+    } catch (const Exception&) {
+        // The coordinator closed the connection
+    }
+}
+
+}  // namespace
+
+TEST(ShardedStatistics, ShardedCorrelationMatchesSingleProcess) {
+    const auto file = std::filesystem::temp_directory_path() / "visualneuro-test-shards.vncohort";
+    const auto [task, expected] = makeCorrelationTask(file);
+    {
+        // This executable computes shards when started with --shard-worker
+        stats::ShardCoordinator coordinator;
+        coordinator.spawnWorkers(filesystem::getExecutablePath(), {"--shard-worker"}, 3);
+        coordinator.waitForWorkers(3, std::chrono::seconds{10});
+        expectResult(coordinator.run(task, 5), expected);
+    }
+    std::filesystem::remove(file);
+}
+
+TEST(ShardedStatistics, ShardsOfExitedWorkerAreRecomputed) {
+    const auto file = std::filesystem::temp_directory_path() / "visualneuro-test-exit.vncohort";
+    const auto [task, expected] = makeCorrelationTask(file);
+    {
+        stats::ShardCoordinator coordinator;
+        coordinator.spawnWorkers(filesystem::getExecutablePath(), {"--shard-worker-exit"}, 1);
+        coordinator.waitForWorkers(1, std::chrono::seconds{10});
+        coordinator.spawnWorkers(filesystem::getExecutablePath(), {"--shard-worker"}, 2);
+        coordinator.waitForWorkers(3, std::chrono::seconds{10});
+        expectResult(coordinator.run(task, 5), expected);
+    }
+    std::filesystem::remove(file);
+}
+
+TEST(ShardedStatistics, MisbehavingWorkersDoNotHangRun) {
+    const auto file = std::filesystem::temp_directory_path() / "visualneuro-test-errors.vncohort";
+    const auto [task, expected] = makeCorrelationTask(file);
+
+    std::vector<std::thread> workers;
+    // Joined after the coordinators have shut down the workers
+    util::OnScopeExit joinWorkers([&]() {
+        for (auto& worker : workers) worker.join();
+    });
+    {
+        stats::ShardCoordinator coordinator;
+        coordinator.setShardTimeout(std::chrono::milliseconds{500});
+        const auto port = coordinator.getPort();
+        workers.emplace_back(misbehavingWorker, port, Misbehavior::UnreadableJob);
+        coordinator.waitForWorkers(1, std::chrono::seconds{10});
+        workers.emplace_back(misbehavingWorker, port, Misbehavior::NoReply);
+        coordinator.waitForWorkers(2, std::chrono::seconds{10});
+        coordinator.spawnWorkers(filesystem::getExecutablePath(), {"--shard-worker"}, 1);
+        coordinator.waitForWorkers(3, std::chrono::seconds{10});
+        // Both misbehaving workers are given a shard first, which goes to the remaining worker
+        expectResult(coordinator.run(task, 5), expected);
+    }
+    {
+        stats::ShardCoordinator coordinator;
+        workers.emplace_back(misbehavingWorker, coordinator.getPort(),
+                             Misbehavior::UnreadableJob);
+        coordinator.waitForWorkers(1, std::chrono::seconds{10});
+        EXPECT_THROW(coordinator.run(task), Exception);
+    }
+    std::filesystem::remove(file);
+}
+#endif
+
+}  // namespace inviwo
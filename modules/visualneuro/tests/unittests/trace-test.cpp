@@ -0,0 +1,128 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <gtest/gtest.h>
+#include <warn/pop>
+
+#include <modules/visualneuro/util/jobmetrics.h>
+#include <modules/visualneuro/util/tracerecorder.h>
+#include <inviwo/core/util/raiiutils.h>
+
+#include <algorithm>
+#include <sstream>
+
+namespace inviwo {
+
+namespace {
+
+size_t count(const std::vector<util::TraceEvent>& events, std::string_view name, char phase) {
+    return static_cast<size_t>(
+        std::count_if(events.begin(), events.end(), [&](const util::TraceEvent& e) {
+            return e.name == name && e.phase == phase;
+        }));
+}
+
+}  // namespace
+
+TEST(TraceRecorder, DisabledRecordsNothing) {
+    auto& recorder = util::TraceRecorder::get();
+    recorder.setEnabled(false);
+    recorder.clear();
+    { const util::TraceSpan span("Read", "io"); }
+    recorder.instant("Cancelled", "job");
+    EXPECT_TRUE(recorder.getEvents().empty());
+}
+
+TEST(TraceRecorder, JobSpans) {
+    auto& recorder = util::TraceRecorder::get();
+    recorder.clear();
+    recorder.setEnabled(true);
+    const util::OnScopeExit disable{[&]() { recorder.setEnabled(false); }};
+
+    {
+        util::JobMetrics metrics("test", "finished");
+        const auto job = metrics.start();
+        { const util::PhaseTimer timer(&metrics, util::JobPhase::Compute); }
+        metrics.finish();
+    }
+    { util::JobMetrics metrics("test", "cancelled"); }
+
+    const auto events = recorder.getEvents();
+    EXPECT_EQ(size_t{1}, count(events, "Job", 'X'));
+    EXPECT_EQ(size_t{1}, count(events, "Compute", 'X'));
+    EXPECT_EQ(size_t{1}, count(events, "Cancelled", 'i'));
+
+    // The phase is nested in the job on the same thread
+    auto find = [&](std::string_view name) {
+        return std::find_if(events.begin(), events.end(),
+                            [&](const util::TraceEvent& e) { return e.name == name; });
+    };
+    const auto job = find("Job");
+    const auto compute = find("Compute");
+    EXPECT_EQ(job->thread, compute->thread);
+    EXPECT_LE(job->timestamp, compute->timestamp);
+    EXPECT_GE(job->timestamp + job->duration, compute->timestamp + compute->duration);
+}
+
+TEST(TraceRecorder, CapacityDropsNewEvents) {
+    auto& recorder = util::TraceRecorder::get();
+    recorder.clear();
+    recorder.setEnabled(true);
+    const auto capacity = recorder.getCapacity();
+    const util::OnScopeExit reset{[&]() {
+        recorder.setEnabled(false);
+        recorder.setCapacity(capacity);
+    }};
+    recorder.setCapacity(2);
+
+    for (int i = 0; i < 5; ++i) recorder.counter("jobs", i);
+
+    EXPECT_EQ(size_t{2}, recorder.getEvents().size());
+    EXPECT_EQ(size_t{3}, recorder.getDropped());
+}
+
+TEST(TraceRecorder, WriteJSON) {
+    auto& recorder = util::TraceRecorder::get();
+    recorder.clear();
+    recorder.setEnabled(true);
+    { const util::TraceSpan span("Read", "io", {{"file", "subject.nii"}}); }
+    recorder.setEnabled(false);
+
+    std::stringstream ss;
+    recorder.writeJSON(ss);
+    const auto json = ss.str();
+    EXPECT_NE(std::string::npos, json.find("\"traceEvents\""));
+    EXPECT_NE(std::string::npos, json.find("\"ph\":\"X\""));
+    EXPECT_NE(std::string::npos, json.find("\"subject.nii\""));
+    EXPECT_NE(std::string::npos, json.find("\"thread_name\""));
+}
+
+}  // namespace inviwo
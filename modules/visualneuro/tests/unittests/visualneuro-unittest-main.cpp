@@ -37,6 +37,7 @@
 #include <inviwo/core/common/coremodulesharedlibrary.h>
 #include <modules/visualneuro/visualneuromodule.h>
 #include <modules/visualneuro/visualneuromodulesharedlibrary.h>
+#include <modules/visualneuro/distributed/shardedstatistics.h>
 
 #include <inviwo/testutil/configurablegtesteventlistener.h>
 
@@ -45,8 +46,39 @@
 #include <gtest/gtest.h>
 #include <warn/pop>
 
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <string_view>
+
 using namespace inviwo;
 
+namespace {
+
+// The sharded statistics tests spawn this executable as worker process with
+// "--shard-worker --connect host:port", see shard-test.cpp. With --shard-worker-exit the worker
+// exits after receiving its first job, as if it crashed.
+std::optional<int> runTestShardWorker(int argc, char** argv) {
+    if (argc != 4 || std::string_view{argv[2]} != "--connect") return std::nullopt;
+    const std::string_view mode{argv[1]};
+    if (mode != "--shard-worker" && mode != "--shard-worker-exit") return std::nullopt;
+
+    const std::string target{argv[3]};
+    const auto colon = target.rfind(':');
+    const auto host = target.substr(0, colon);
+    const auto port = static_cast<std::uint16_t>(std::stoi(target.substr(colon + 1)));
+    if (mode == "--shard-worker") {
+        stats::runShardWorker(host, port);
+        return 0;
+    }
+    auto connection = stats::ShardConnection::connect(host, port);
+    connection.receive();
+    std::_Exit(3);
+}
+
+}  // namespace
+
 int main(int argc, char** argv) {
 
     inviwo::LogCentral::init();
@@ -59,6 +91,8 @@ int main(int argc, char** argv) {
         app.registerModules(std::move(modules));
     }
 
+    if (auto ret = runTestShardWorker(argc, argv)) return *ret;
+
     int ret = -1;
     {
 
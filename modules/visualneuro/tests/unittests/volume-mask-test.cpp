@@ -34,6 +34,9 @@
 
 #include <modules/visualneuro/algorithm/volume/atlasvolumemask.h>
 #include <modules/base/algorithm/volume/volumegeneration.h>
+#include <inviwo/core/datastructures/volume/volumeramprecision.h>
+
+#include <vector>
 
 
 namespace inviwo {
@@ -63,4 +66,75 @@ TEST(atlasVolumeMask, atlasVolumeMaskIsCorrect) {
         << "Atlas mask computation is not correct.";
 }
 
+namespace {
+
+// Label x / 4 + 1 along the x-axis, i.e. four slabs labelled 1 to 4
+std::shared_ptr<Volume> makeSlabAtlas(const size3_t& dims) {
+    auto ram = std::make_shared<VolumeRAMPrecision<uint8_t>>(dims);
+    auto data = ram->getDataTyped();
+    for (size_t i = 0; i < glm::compMul(dims); ++i) {
+        data[i] = static_cast<uint8_t>((i % dims.x) * 4 / dims.x + 1);
+    }
+    return std::make_shared<Volume>(ram);
+}
+
+std::vector<uint8_t> fullMask(const Volume& volume, const Volume& atlas,
+                              const std::unordered_set<size_t>& filter) {
+    auto mask = util::makeSingleVoxelVolume<uint8_t>(volume.getDimensions());
+    atlasVolumeMask(mask.get(), volume, atlas, filter);
+    auto ram =
+        static_cast<const VolumeRAMPrecision<uint8_t>*>(mask->getRepresentation<VolumeRAM>());
+    return {ram->getDataTyped(), ram->getDataTyped() + glm::compMul(volume.getDimensions())};
+}
+
+std::vector<uint8_t> builderMask(const AtlasVolumeMaskBuilder& builder) {
+    const auto& mask = *builder.getMask();
+    auto ram = static_cast<const VolumeRAMPrecision<uint8_t>*>(mask.getRepresentation<VolumeRAM>());
+    return {ram->getDataTyped(), ram->getDataTyped() + glm::compMul(mask.getDimensions())};
+}
+
+}  // namespace
+
+TEST(atlasVolumeMask, builderMatchesFullRecomputation) {
+    const size3_t dim{16};
+    auto vol = util::makeSphericalVolume<float>(dim);
+    auto atlas = makeSlabAtlas(dim);
+
+    AtlasVolumeMaskBuilder builder(*vol, *atlas);
+    EXPECT_EQ(fullMask(*vol, *atlas, {}), builderMask(builder));
+    EXPECT_EQ(size_t{0}, builder.getNumberOfUpdatedVoxels());
+
+    EXPECT_TRUE(builder.addRegion(2));
+    EXPECT_FALSE(builder.addRegion(2));
+    EXPECT_TRUE(builder.addRegion(4));
+    EXPECT_EQ(fullMask(*vol, *atlas, {2, 4}), builderMask(builder));
+
+    EXPECT_TRUE(builder.removeRegion(2));
+    EXPECT_FALSE(builder.removeRegion(3));
+    EXPECT_EQ(fullMask(*vol, *atlas, {4}), builderMask(builder));
+
+    builder.setSelection({1, 4});
+    EXPECT_EQ((std::unordered_set<int>{1, 4}), builder.getSelection());
+    EXPECT_EQ(fullMask(*vol, *atlas, {1, 4}), builderMask(builder));
+}
+
+TEST(atlasVolumeMask, builderOnlyUpdatesToggledRegion) {
+    const size3_t dim{16};
+    auto vol = util::makeSphericalVolume<float>(dim);
+    auto atlas = makeSlabAtlas(dim);
+    const size_t regionVoxels = glm::compMul(dim) / 4;
+
+    AtlasVolumeMaskBuilder builder(*vol, *atlas);
+    builder.addRegion(3);
+    EXPECT_EQ(regionVoxels, builder.getNumberOfUpdatedVoxels());
+    builder.removeRegion(3);
+    EXPECT_EQ(2 * regionVoxels, builder.getNumberOfUpdatedVoxels());
+    // Labels that are not in the atlas do not touch the mask
+    EXPECT_TRUE(builder.addRegion(9));
+    EXPECT_EQ(2 * regionVoxels, builder.getNumberOfUpdatedVoxels());
+    // Only the region that changed is written
+    builder.setSelection({9, 1});
+    EXPECT_EQ(3 * regionVoxels, builder.getNumberOfUpdatedVoxels());
+}
+
 }  // namespace inviwo
@@ -0,0 +1,128 @@
+/*********************************************************************************
+ *
+ * Inviwo - Interactive Visualization Workshop
+ *
+ * Copyright (c) 2024 Inviwo Foundation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************************/
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <gtest/gtest.h>
+#include <warn/pop>
+
+#include <modules/visualneuro/algorithm/volume/voxelstatistics.h>
+#include <modules/visualneuro/datastructures/volumesequenceselection.h>
+#include <inviwo/core/datastructures/volume/volumeramprecision.h>
+
+#include <vector>
+
+namespace inviwo {
+
+namespace {
+
+// Sequence of 2x2x2 volumes where volume i has the value i + voxel index in every voxel
+std::shared_ptr<VolumeSequence> makeSequence(size_t nVolumes) {
+    auto volumes = std::make_shared<VolumeSequence>();
+    for (size_t i = 0; i < nVolumes; ++i) {
+        auto ram = std::make_shared<VolumeRAMPrecision<float>>(size3_t{2});
+        auto data = ram->getDataTyped();
+        for (size_t voxel = 0; voxel < 8; ++voxel) data[voxel] = static_cast<float>(i + voxel);
+        auto volume = std::make_shared<Volume>(ram);
+        volume->dataMap.dataRange = dvec2(0, 20);
+        volume->dataMap.valueRange = dvec2(0, 20);
+        volumes->push_back(volume);
+    }
+    return volumes;
+}
+
+BitSet bits(std::vector<std::uint32_t> indices) {
+    BitSet res;
+    for (auto i : indices) res.add(i);
+    return res;
+}
+
+std::vector<float> values(const Volume& volume) {
+    const auto ram = static_cast<const VolumeRAMPrecision<float>*>(
+        volume.getRepresentation<VolumeRAM>());
+    return {ram->getDataTyped(), ram->getDataTyped() + 8};
+}
+
+}  // namespace
+
+TEST(VolumeSequenceSelection, DeltaToPreviousSelection) {
+    const auto volumes = makeSequence(5);
+    const VolumeSequenceSelection first(volumes, bits({0, 1, 2}));
+    EXPECT_EQ(std::uint64_t{0}, first.getPreviousVersion());
+    EXPECT_EQ(bits({0, 1, 2}), first.getAdded());
+    EXPECT_TRUE(first.getRemoved().empty());
+
+    const VolumeSequenceSelection second(volumes, bits({1, 2, 4}), &first);
+    EXPECT_EQ(first.getVersion(), second.getPreviousVersion());
+    EXPECT_NE(first.getVersion(), second.getVersion());
+    EXPECT_EQ(bits({4}), second.getAdded());
+    EXPECT_EQ(bits({0}), second.getRemoved());
+    ASSERT_EQ(size_t{3}, second.getVolumes().size());
+    EXPECT_EQ((*volumes)[4], second.getVolumes().back());
+
+    // A selection of another sequence has no delta
+    const VolumeSequenceSelection other(makeSequence(5), bits({1}), &second);
+    EXPECT_EQ(std::uint64_t{0}, other.getPreviousVersion());
+    EXPECT_EQ(bits({1}), other.getAdded());
+
+    EXPECT_THROW(VolumeSequenceSelection(volumes, bits({5})), Exception);
+}
+
+TEST(VoxelSum, IncrementalMeanMatchesMean) {
+    const auto volumes = makeSequence(6);
+    stats::VoxelSum sum;
+    EXPECT_EQ(nullptr, sum.mean());
+
+    const VolumeSequenceSelection first(volumes, bits({0, 1, 2, 3}));
+    ASSERT_TRUE(sum.update(first.getVolumes(), {}));
+    const VolumeSequenceSelection second(volumes, bits({2, 3, 5}), &first);
+    ASSERT_TRUE(
+        sum.update(second.getVolumes(second.getAdded()), second.getVolumes(second.getRemoved())));
+    EXPECT_EQ(size_t{3}, sum.getNumberOfSubjects());
+
+    const auto incremental = sum.mean();
+    const auto full = stats::volumeSequenceMean(second.getVolumes());
+    ASSERT_NE(nullptr, incremental);
+    const auto expected = values(*full);
+    const auto actual = values(*incremental);
+    for (size_t i = 0; i < expected.size(); ++i) EXPECT_FLOAT_EQ(expected[i], actual[i]);
+    EXPECT_EQ(full->dataMap.valueRange, incremental->dataMap.valueRange);
+
+    // Removing all volumes gives zeros
+    ASSERT_TRUE(sum.update({}, second.getVolumes()));
+    for (auto value : values(*sum.mean())) EXPECT_EQ(0.0f, value);
+
+    // A stopped update leaves an empty sum
+    util::BlockControl control;
+    control.stop = []() { return true; };
+    EXPECT_FALSE(sum.update(first.getVolumes(), {}, control));
+    EXPECT_EQ(nullptr, sum.mean());
+}
+
+}  // namespace inviwo